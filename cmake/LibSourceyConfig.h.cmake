@@ -22,6 +22,11 @@
 /* Version number of package */
 #cmakedefine SCY_BUILD_SHARED "${BUILD_SHARED_LIBS}" 
 
+/* Log statements below this level are compiled out */
+#ifndef SCY_LOG_MIN_LEVEL
+#define SCY_LOG_MIN_LEVEL ${LibSourcey_LOG_MIN_LEVEL}
+#endif
+
 /* LibSourcey modules
 # cmakedefine HAVE_SCY_base
 # cmakedefine HAVE_SCY_http
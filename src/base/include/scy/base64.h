@@ -0,0 +1,263 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+// This file uses the public domain libb64 library: http://libb64.sourceforge.net/
+//
+
+
+#ifndef SCY_Base64_H
+#define SCY_Base64_H
+
+
+#include "scy/interface.h"
+#include "scy/logger.h" 
+#include "scy/types.h"
+#include <iostream>
+#include <memory>
+
+
+namespace scy {
+namespace base64 {
+
+
+const int BUFFER_SIZE = 16384;
+const int LINE_LENGTH = 72;
+
+
+//
+// Base64 Encoder
+//
+    
+
+namespace internal {
+
+
+typedef enum
+{
+    step_A, step_B, step_C
+} encodestep;
+
+typedef struct
+{
+    encodestep step;
+    char result;
+    int stepcount;
+    int linelength; // added
+    int nullptrlterminate; // added
+} encodestate;
+
+void init_encodestate(internal::encodestate* state_in);
+
+char encode_value(char value_in);
+
+int encode_block(const char* readbuf_in, int length_in, char* code_out, internal::encodestate* state_in);
+
+int encode_blockend(char* code_out, internal::encodestate* state_in);
+
+const char* kernelName();
+    // Returns the name of the bulk codec selected for
+    // this CPU: "avx2", "ssse3" or "scalar".
+
+bool selectKernel(const char* name);
+    // Selects the named bulk codec, returning false if it is
+    // not supported by this CPU. This is intended for testing,
+    // and must not be called while other threads are encoding
+    // or decoding.
+
+
+} // namespace internal
+
+
+struct Encoder: public basic::Encoder
+{
+    Encoder(int buffersize = BUFFER_SIZE) : 
+        _buffersize(buffersize)
+    {
+        internal::init_encodestate(&_state);
+    }
+
+    void encode(std::istream& istrm, std::ostream& ostrm)
+    {
+        const int N = _buffersize;
+        char* readbuf = new char[N];
+        char* encbuf = new char[2*N];
+        int nread;
+        int enclen;
+
+        do
+        {
+            istrm.read(readbuf, N);
+            nread = static_cast<int>(istrm.gcount());            
+            enclen = encode(readbuf, nread, encbuf);
+            ostrm.write(encbuf, enclen);
+        }
+        while (istrm.good() && nread > 0);
+
+        enclen = finalize(encbuf);
+        ostrm.write(encbuf, enclen);
+
+        internal::init_encodestate(&_state);
+
+        delete [] encbuf;
+        delete [] readbuf;
+    }
+        
+    void encode(const std::string& in, std::string& out)
+    {
+        // Encode directly into the output string
+        std::size_t pos = out.size();
+        out.resize(pos + in.length() * 2 + 4);
+        std::size_t enclen = encode(in.data(), in.length(), &out[pos]);
+        enclen += finalize(&out[pos + enclen]);
+        out.resize(pos + enclen);
+
+        internal::init_encodestate(&_state);
+    }
+
+    std::size_t encode(const char* inbuf, std::size_t nread, char* outbuf)
+    {
+        return internal::encode_block(inbuf, nread, outbuf, &_state);
+    }
+
+    std::size_t finalize(char* outbuf)
+    {        
+        return internal::encode_blockend(outbuf, &_state);
+    }
+    
+    void setLineLength(int lineLength)
+    {
+        _state.linelength = lineLength;
+    }
+
+    internal::encodestate _state;
+    int _buffersize;
+};
+
+
+template<typename T>
+inline std::string encode(const T& bytes, int lineLength = LINE_LENGTH)
+    // Converts a STL container to Base64.
+{    
+    std::string res(bytes.size() * 2 + 4, '\0');
+    
+    internal::encodestate state;
+    internal::init_encodestate(&state);
+    state.linelength = lineLength;
+
+    int enclen = internal::encode_block(reinterpret_cast<const char*>(bytes.data()), bytes.size(), &res[0], &state);
+    enclen += internal::encode_blockend(&res[enclen], &state);
+    res.resize(enclen);
+
+    return res;
+}
+
+
+//
+// Base64 Decoder
+//
+
+
+namespace internal {
+
+
+typedef enum
+{
+    step_a, step_b, step_c, step_d
+} decodestep;
+
+typedef struct
+{
+    decodestep step;
+    char plainchar;
+} decodestate;
+
+void init_decodestate(internal::decodestate* state_in);
+
+int decode_value(char value_in);
+
+int decode_block(const char* inbuf, const int nread, char* outbuf, internal::decodestate* state_in);
+
+
+} // namespace internal
+
+
+struct Decoder : public basic::Decoder
+{
+    Decoder(int buffersize = BUFFER_SIZE) : 
+        _buffersize(buffersize)
+    {
+        internal::init_decodestate(&_state);
+    }
+
+    int decode(char value_in)
+    {
+        return internal::decode_value(value_in);
+    }
+
+    std::size_t decode(const char* inbuf, std::size_t nread, char* outbuf)
+    {
+        return internal::decode_block(inbuf, nread, outbuf, &_state);
+    }
+
+    void decode(std::istream& istrm, std::ostream& ostrm)
+    {
+        const int N = _buffersize;
+        char* decbuf = new char[N];
+        char* readbuf = new char[N];
+        int declen;
+        int nread;
+
+        do
+        {
+            istrm.read((char*)decbuf, N);
+            declen = static_cast<int>(istrm.gcount());
+            nread = decode(decbuf, declen, readbuf);
+            ostrm.write((const char*)readbuf, nread);
+        }
+        while (istrm.good() && declen > 0);
+
+        internal::init_decodestate(&_state);
+
+        delete [] decbuf;
+        delete [] readbuf;
+    }
+
+    internal::decodestate _state;
+    int _buffersize;
+};
+
+
+template<typename T>
+inline std::string decode(const T& bytes)
+    /// Decodes a STL container from Base64.
+{    
+    std::string res(bytes.size() * 3 / 4 + 4, '\0');
+    
+    internal::decodestate state;
+    internal::init_decodestate(&state);
+
+    int declen = internal::decode_block(reinterpret_cast<const char*>(bytes.data()), bytes.size(), &res[0], &state);
+    res.resize(declen);
+
+    return res;
+}
+
+
+} } // namespace scy::base64
+
+
+#endif // SCY_Base64_H
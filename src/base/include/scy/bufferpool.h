@@ -0,0 +1,123 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#ifndef SCY_BufferPool_H
+#define SCY_BufferPool_H
+
+
+#include "scy/types.h"
+#include "scy/memory.h"
+#include "scy/mutex.h"
+#include "scy/buffer.h"
+
+#include <memory>
+#include <vector>
+
+
+namespace scy {
+
+
+class PooledBuffer;
+
+
+namespace internal {
+    struct BufferPoolState;
+}
+
+
+class BufferPool
+    /// BufferPool hands out reference counted fixed size buffers
+    /// (slabs) from a free list, so that received data can be retained
+    /// past the receive callback and passed between threads without 
+    /// being copied.
+    ///
+    /// Slabs are returned to the pool when their last reference is 
+    /// released, which may happen on any thread. Slabs may safely
+    /// outlive the BufferPool which created them.
+{
+public:
+    typedef std::shared_ptr<BufferPool> Ptr;
+
+    BufferPool(std::size_t bufferSize = 65536, std::size_t maxFree = 64);
+        // Creates a pool of buffers of bufferSize bytes.
+        // At most maxFree released slabs will be kept for reuse.
+
+    virtual ~BufferPool();
+
+    virtual PooledBuffer* get();
+        // Returns a slab with a reference count of one.
+        // The caller must release() the slab when done.
+        
+    std::size_t bufferSize() const;
+        // Returns the size of the slabs handed out by the pool.
+
+    std::size_t available() const;
+        // Returns the number of slabs on the free list.
+
+    std::size_t allocated() const;
+        // Returns the number of slabs currently allocated,
+        // including those on the free list.
+
+protected:
+    BufferPool(const BufferPool&); // = delete;
+    BufferPool& operator=(const BufferPool&); // = delete;
+
+    std::shared_ptr<internal::BufferPoolState> _state;
+};
+
+
+class PooledBuffer: public SharedObject
+    /// PooledBuffer is a reference counted slab of memory owned by  
+    /// a BufferPool. Use duplicate() to retain a reference to the 
+    /// slab and release() to return it to the pool.
+{
+public:
+    char* data() { return &_data[0]; }
+    const char* data() const { return &_data[0]; }
+        // Returns a pointer to the start of the slab.
+
+    std::size_t capacity() const { return _data.size(); }
+        // Returns the size of the slab in bytes.
+
+    bool contains(const void* ptr) const
+        // Returns true if the given pointer lies within the slab.
+    { 
+        return ptr >= data() && ptr < data() + capacity(); 
+    }
+
+protected:
+    PooledBuffer(std::size_t size);
+    virtual ~PooledBuffer();
+
+    virtual void freeMemory();
+        // Returns the slab to the pool free list.
+
+    Buffer _data;
+    std::shared_ptr<internal::BufferPoolState> _pool;
+
+    friend struct internal::BufferPoolState;
+    friend class BufferPool;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_BufferPool_H
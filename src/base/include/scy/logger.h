@@ -0,0 +1,640 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#ifndef SCY_Logger_H
+#define SCY_Logger_H
+
+
+#include "scy/base.h"
+#include "scy/mutex.h"
+#include "scy/thread.h"
+#include "scy/exception.h"
+#include "scy/singleton.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <ctime>
+//#include <time.h>
+#include <string.h>
+
+
+namespace scy {
+
+
+enum LogLevel
+{
+    LTrace    = 0,
+    LDebug    = 1,
+    LInfo    = 2,
+    LWarn    = 3,
+    LError    = 4,
+    LFatal    = 5,
+};
+
+
+inline LogLevel getLogLevelFromString(const char* level)
+{
+    if (strcmp(level, "trace") == 0)
+        return LTrace;
+    if (strcmp(level, "debug") == 0)
+        return LDebug;
+    if (strcmp(level, "info") == 0)
+        return LInfo;
+    if (strcmp(level, "warn") == 0)
+        return LWarn;
+    if (strcmp(level, "error") == 0)
+        return LError;
+    if (strcmp(level, "fatal") == 0)
+        return LFatal;
+    return LDebug;
+}
+
+
+inline const char* getStringFromLogLevel(LogLevel level)
+{
+    switch(level)
+    {
+        case LTrace:    return "trace";
+        case LDebug:    return "debug";
+        case LInfo:        return "info";
+        case LWarn:        return "warn";
+        case LError:    return "error";
+        case LFatal:    return "fatal";
+    }
+    return "debug";
+}
+
+
+struct LogStream;
+class LogChannel;
+
+
+//
+// Log Record
+//
+
+
+struct LogRecord
+    /// A log message which has already been formatted by its
+    /// channel. Records are handed to LogChannel::write() in
+    /// batches by the AsyncLogWriter. The data and stream
+    /// pointers are only valid for the duration of the call.
+    ///
+    /// Records are only formatted for channels which write
+    /// records themselves (see LogChannel::writesRecords()). 
+    /// Other channels are passed the stream instead.
+{
+    const char* data;
+    std::size_t size;
+    LogLevel level;
+    std::time_t ts;
+    LogChannel* channel;
+    const LogStream* stream; // the message, or nullptr if formatted
+};
+
+
+//
+// Default Log Writer
+//
+
+
+class LogWriter
+{
+public:
+    LogWriter();
+    virtual ~LogWriter();
+
+    virtual void write(LogStream* stream);
+        // Writes the given log message stream.
+
+protected:
+    Mutex _mutex;
+};
+
+
+//
+// Asynchronous Log Writer
+//
+
+
+namespace internal {
+    struct LogBuffer;
+    struct LogQueue;
+}
+
+
+class AsyncLogWriter: public LogWriter, public async::Runnable
+    /// AsyncLogWriter moves formatting and output off the logging thread.
+    ///
+    /// Each logging thread formats its messages directly into a
+    /// preallocated ring buffer of its own, recycles the message stream,
+    /// and hands the resulting records to the writer thread through
+    /// a lock-free queue. The writer thread sleeps until records 
+    /// arrive, then passes them to their channels in batches so file
+    /// channels flush once per batch rather than once per message.
+    /// Once a thread's buffer has been allocated no further 
+    /// allocations are made on the write path. Channels which don't
+    /// write records themselves are passed the message stream instead,
+    /// which is then released by the writer thread.
+    ///
+    /// When a thread's buffer or the queue is full the logging thread
+    /// waits for the writer to catch up, so messages are never lost.
+    /// Messages longer than half the buffer size are truncated.
+    /// When a logging thread exits its buffer is handed on to the
+    /// next thread which logs.
+{
+public:
+    AsyncLogWriter(std::size_t bufferSize = 64 * 1024, std::size_t queueSize = 4096);
+        // Creates the writer and starts its thread.
+        // The bufferSize is the size of each logging thread's
+        // ring buffer, and the queueSize the maximum number of
+        // records waiting to be written.
+
+    virtual ~AsyncLogWriter();
+
+    virtual void write(LogStream* stream);
+        // Formats the given log message stream and queues it.
+
+    void flush();
+        // Blocks until all queued messages have been written.
+
+    void run();
+        // Writes queued messages asynchronously.
+
+    void cancel(bool flag = true);
+        // Cancels and wakes the writer thread.
+
+    void clear();
+        // Discards all queued messages.
+
+protected:
+    internal::LogBuffer* buffer();
+    bool writeNext();
+
+    Thread _thread;
+    std::shared_ptr<internal::LogQueue> _queue;
+    Condition _ready;
+    Condition _flushed;
+    std::atomic<bool> _waiting;
+    std::atomic<UInt64> _queued;
+    std::atomic<UInt64> _written;
+    std::atomic<UInt64> _discard;
+};
+
+
+//
+// Logger
+//
+
+
+class Logger
+{
+public:
+    Logger();
+    ~Logger();
+
+    static Logger& instance();
+        // Returns the default logger singleton.
+        // Logger instances may be created separately as needed.
+
+    static void setInstance(Logger* logger, bool freeExisting = true);
+        // Sets the default logger singleton instance.
+
+    static void destroy();
+        // Destroys the default logger singleton instance.
+
+    void add(LogChannel* channel);
+        // Adds the given log channel.
+
+    void remove(const std::string& name, bool freePointer = true);
+        // Removes the given log channel by name,
+        // and optionally frees the pointer.
+
+    LogChannel* get(const std::string& name, bool whiny = true) const;
+        // Returns the specified log channel.
+        // Throws an exception if the channel doesn't exist.
+
+    void setDefault(const std::string& name);
+        // Sets the default log to the specified log channel.
+
+    void setWriter(LogWriter* writer);
+        // Sets the log writer instance.
+        // The previous writer is deleted once any writes
+        // in progress on other threads have returned.
+
+    LogChannel* getDefault() const;
+        // Returns the default log channel, or the nullptr channel
+        // if no default channel has been set.
+
+    void write(const LogStream& stream);
+        // Writes the given message to the default log channel.
+        // The message will be copied.
+
+    void write(LogStream* stream);
+        // Writes the given message to the default log channel.
+        // The stream pointer will be deleted when appropriate.
+
+    LogStream& send(const char* level = "debug", const char* realm = "",
+        const void* ptr = nullptr, const char* channel = nullptr) const;
+        // Sends to the default log using the given class instance.
+        // Recommend using write(LogStream&) to avoid copying data.
+
+    static bool enabled(LogLevel level)
+        // Returns true if any channel of the default logger accepts
+        // messages of the given level. This is a single relaxed
+        // atomic load, so the logging macros check it before a
+        // message is built or any of its operands are evaluated.
+    {
+        return level >= _threshold.load(std::memory_order_relaxed);
+    }
+
+    void updateThreshold();
+        // Recomputes the level gate from the current channel levels.
+        // Called automatically when channels are added or removed,
+        // or their level is changed.
+
+protected:
+    // Non-copyable and non-movable
+    Logger(const Logger&); // = delete;
+    Logger(Logger&&); // = delete;
+    Logger& operator=(const Logger&); // = delete;
+    Logger& operator=(Logger&&); // = delete;
+
+    typedef std::map<std::string, LogChannel*> LogChannelMap;
+
+    friend class Singleton<Logger>;
+    friend class Thread;
+
+    mutable Mutex _mutex;
+    LogChannelMap _channels;
+    LogChannel*   _defaultChannel;
+    std::shared_ptr<LogWriter> _writer;
+
+    static std::atomic<int> _threshold;
+};
+
+
+//
+// Log Stream
+//
+
+
+struct LogStream
+{
+    LogLevel level;
+    int line;
+    std::string realm;              // depreciate - encode in message
+    std::string address;            // depreciate - encode in message
+    const void* ptr;
+    std::ostringstream message;
+    std::time_t ts;
+    LogChannel* channel;
+
+    LogStream(LogLevel level = LDebug, const std::string& realm = "", int line = 0, const void* ptr = nullptr, const char* channel = nullptr);
+    LogStream(LogLevel level, const std::string& realm = "", const std::string& address = "");
+    LogStream(const LogStream& that);
+    ~LogStream();
+
+    static LogStream* acquire(LogLevel level, const char* function, int line, const void* ptr = nullptr);
+        // Returns a stream from the current thread's free list, or a 
+        // new stream if the list is empty. The realm is taken from the
+        // given function signature. Recycled streams keep their message
+        // buffer, so once a thread's streams have grown to size the
+        // logging macros build messages without allocating.
+
+    static void release(LogStream* stream);
+        // Returns a written stream to the current thread's free list,
+        // or deletes it if the list is full. Streams created with new 
+        // may also be released.
+
+    LogStream& operator << (const LogLevel data) {
+#ifndef SCY_DISABLE_LOGGING
+        level = data;
+#endif
+        return *this;
+    }
+
+    LogStream& operator << (LogChannel* data) {
+#ifndef SCY_DISABLE_LOGGING
+        channel = data;
+#endif
+        return *this;
+    }
+
+    template<typename T>
+    LogStream& operator << (const T& data) {
+#ifndef SCY_DISABLE_LOGGING
+        message << data;
+#endif
+        return *this;
+    }
+
+    LogStream& operator << (std::ostream&(*f)(std::ostream&))
+        // Handle std::endl flags.
+        // This method flushes the log message and queues it for write.
+        // WARNING: After using std::endl to flush the message pointer
+        // should not be accessed.
+    {
+#ifndef SCY_DISABLE_LOGGING
+        message << f;
+
+        // Send to default channel
+        // Channel flag or stream operation
+        Logger::instance().write(this);
+#else
+        // Free the pointer
+        release(this);
+#endif
+        return *this;
+    }
+};
+
+
+//
+// Inline stream accessors
+//
+
+
+// Default output
+inline LogStream& traceL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LTrace, realm, 0, ptr); }
+
+inline LogStream& debugL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LDebug, realm, 0, ptr); }
+
+inline LogStream& infoL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LInfo, realm, 0, ptr); }
+
+inline LogStream& warnL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LWarn, realm, 0, ptr); }
+
+inline LogStream& errorL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LError, realm, 0, ptr); }
+
+inline LogStream& fatalL(const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LFatal, realm, 0, ptr); }
+
+
+// Channel output
+inline LogStream& traceC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LTrace, realm, 0, ptr, channel); }
+
+inline LogStream& debugC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LDebug, realm, 0, ptr, channel); }
+
+inline LogStream& infoC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LInfo, realm, 0, ptr, channel); }
+
+inline LogStream& warnC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LWarn, realm, 0, ptr, channel); }
+
+inline LogStream& errorC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LError, realm, 0, ptr, channel); }
+
+inline LogStream& fatalC(const char* channel, const char* realm = "", const void* ptr = nullptr)
+    { return *new LogStream(LFatal, realm, 0, ptr, channel); }
+
+
+// Level output
+inline LogStream& printL(const char* level = "debug", const char* realm = "", const void* ptr = nullptr, const char* channel = nullptr)
+    { return *new LogStream(getLogLevelFromString(level), realm, 0, ptr, channel); }
+
+inline LogStream& printL(const char* level, const void* ptr, const char* realm = "", const char* channel = nullptr)
+    { return *new LogStream(getLogLevelFromString(level), realm, 0, ptr, channel); }
+
+
+// Macros for debug logging
+//
+// Other useful macros for debug logging: __FILE__, __FUNCTION__, __LINE__
+// KLUDGE: Need a way to shorten __FILE__  which prints the entire relative path
+// __FUNCTION__ might need a fallback on some platforms
+#ifndef __CLASS_FUNCTION__
+#if _MSC_VER
+#define __CLASS_FUNCTION__ __FUNCTION__
+#else
+inline std::string _methodName(const std::string &fsig)
+{
+  size_t colons = fsig.find("::");
+  size_t sbeg = fsig.substr(0, colons).rfind(" ") + 1;
+  size_t send = fsig.rfind("(") - sbeg;
+  return fsig.substr(sbeg, send) + "()";
+}
+#define __CLASS_FUNCTION__ _methodName(__PRETTY_FUNCTION__)
+#endif
+#endif
+
+// Log statements below SCY_LOG_MIN_LEVEL are compiled out entirely,
+// and the rest are skipped at runtime without evaluating any of
+// their operands unless a channel accepts their level.
+#if defined(SCY_DISABLE_LOGGING)
+#undef SCY_LOG_MIN_LEVEL
+#define SCY_LOG_MIN_LEVEL 6
+#elif !defined(SCY_LOG_MIN_LEVEL)
+#define SCY_LOG_MIN_LEVEL 0
+#endif
+
+struct LogVoidify
+    // Turns a log statement into a void expression
+    // so it can be used with the ternary operator.
+{
+    void operator & (LogStream&) {}
+};
+
+#define SCY_LOG_ENABLED(level) ((level) >= SCY_LOG_MIN_LEVEL && Logger::enabled(level))
+#define SCY_LOG_IF(level) !SCY_LOG_ENABLED(level) ? (void)0 : LogVoidify() &
+
+// The raw function signature, which LogStream::acquire() 
+// shortens in place the same way as __CLASS_FUNCTION__.
+#if _MSC_VER
+#define SCY_LOG_FUNCTION __FUNCTION__
+#else
+#define SCY_LOG_FUNCTION __PRETTY_FUNCTION__
+#endif
+
+#define TraceL SCY_LOG_IF(LTrace) *LogStream::acquire(LTrace, SCY_LOG_FUNCTION, __LINE__)
+#define TraceLS(self) SCY_LOG_IF(LTrace) *LogStream::acquire(LTrace, SCY_LOG_FUNCTION, __LINE__, self)
+#define DebugL SCY_LOG_IF(LDebug) *LogStream::acquire(LDebug, SCY_LOG_FUNCTION, __LINE__)
+#define DebugLS(self) SCY_LOG_IF(LDebug) *LogStream::acquire(LDebug, SCY_LOG_FUNCTION, __LINE__, self)
+#define InfoL SCY_LOG_IF(LInfo) *LogStream::acquire(LInfo, SCY_LOG_FUNCTION, __LINE__)
+#define InfoLS(self) SCY_LOG_IF(LInfo) *LogStream::acquire(LInfo, SCY_LOG_FUNCTION, __LINE__, self)
+#define WarnL SCY_LOG_IF(LWarn) *LogStream::acquire(LWarn, SCY_LOG_FUNCTION, __LINE__)
+#define WarnLS(self) SCY_LOG_IF(LWarn) *LogStream::acquire(LWarn, SCY_LOG_FUNCTION, __LINE__, self)
+#define ErrorL SCY_LOG_IF(LError) *LogStream::acquire(LError, SCY_LOG_FUNCTION, __LINE__)
+#define ErrorLS(self) SCY_LOG_IF(LError) *LogStream::acquire(LError, SCY_LOG_FUNCTION, __LINE__, self)
+
+
+//
+// Log Channel
+//
+
+
+class LogChannel
+{
+public:
+    LogChannel(const std::string& name, LogLevel level = LDebug, const char* timeFormat = "%H:%M:%S");
+    virtual ~LogChannel() {};
+
+    virtual void write(const LogStream& stream);
+    virtual void write(const std::string& message, LogLevel level = LDebug,
+        const char* realm = "", const void* ptr = nullptr);
+    virtual void write(const LogRecord* records, std::size_t count);
+        // Writes a batch of records which were formatted by this
+        // channel. Called from the AsyncLogWriter thread.
+        // The default implementation passes each record's stream
+        // to write(const LogStream&).
+    virtual bool writesRecords() const { return false; };
+        // Returns true if the channel implements the batched
+        // write() above, in which case messages are formatted 
+        // on the logging thread and the stream is not retained.
+    virtual void format(const LogStream& stream, std::ostream& ost);
+
+    std::string    name() const { return _name; };
+    LogLevel level() const { return _level; };
+    const char* timeFormat() const { return _timeFormat; };
+
+    void setLevel(LogLevel level);
+    void setDateFormat(const char* format) { _timeFormat = format; };
+
+protected:
+    std::string _name;
+    LogLevel    _level;
+    const char* _timeFormat;
+};
+
+
+//
+// Console Channel
+//
+
+
+class ConsoleChannel: public LogChannel
+{
+public:
+    ConsoleChannel(const std::string& name, LogLevel level = LDebug, const char* timeFormat = "%H:%M:%S");
+    virtual ~ConsoleChannel() {};
+
+    virtual void write(const LogStream& stream);
+    virtual void write(const LogRecord* records, std::size_t count);
+    virtual bool writesRecords() const { return true; };
+};
+
+
+//
+// File Channel
+//
+
+
+class FileChannel: public LogChannel
+{
+public:
+    FileChannel(
+        const std::string& name,
+        const std::string& path,
+        LogLevel level = LDebug,
+        const char* timeFormat = "%H:%M:%S");
+    virtual ~FileChannel();
+
+    virtual void write(const LogStream& stream);
+    virtual void write(const LogRecord* records, std::size_t count);
+    virtual bool writesRecords() const { return true; };
+
+    void setPath(const std::string& path);
+    std::string    path() const;
+
+protected:
+    virtual void open();
+    virtual void close();
+
+protected:
+    std::ofstream    _fstream;
+    std::string        _path;
+};
+
+
+//
+// Rotating File Channel
+//
+
+
+class RotatingFileChannel: public LogChannel
+{
+public:
+    RotatingFileChannel(
+        const std::string& name,
+        const std::string& dir,
+        LogLevel level = LDebug,
+        const std::string& extension = "log",
+        int rotationInterval = 12 * 3600,
+        const char* timeFormat = "%H:%M:%S");
+    virtual ~RotatingFileChannel();
+
+    virtual void write(const LogStream& stream);
+    virtual void write(const LogRecord* records, std::size_t count);
+    virtual bool writesRecords() const { return true; };
+    virtual void rotate();
+
+    std::string dir() const { return _dir; };
+    std::string filename() const { return _filename; };
+    int rotationInterval() const { return _rotationInterval; };
+
+    void setDir(const std::string& dir) { _dir = dir; };
+    void setExtension(const std::string& ext) { _extension = ext; };
+    void setRotationInterval(int interval) { _rotationInterval = interval; };
+
+protected:
+    std::ofstream* _fstream;
+    std::string    _dir;
+    std::string    _filename;
+    std::string    _extension;
+    int            _rotationInterval;    // The log rotation interval in seconds
+    time_t         _rotatedAt;           // The time the log was last rotated
+};
+
+
+#if 0
+class EventedFileChannel: public FileChannel
+{
+public:
+    EventedFileChannel(
+        const std::string& name,
+        const std::string& dir,
+        LogLevel level = LDebug,
+        const std::string& extension = "log",
+        int rotationInterval = 12 * 3600,
+        const char* timeFormat = "%H:%M:%S");
+    virtual ~EventedFileChannel();
+
+    virtual void write(const std::string& message, LogLevel level = LDebug,
+        const char* realm = "", const void* ptr = nullptr);
+    virtual void write(const LogStream& stream);
+
+    Signal3<const std::string&, LogLevel&, const Polymorphic*&> OnLogStream;
+};
+#endif
+
+
+} // namespace scy
+
+
+#endif
@@ -0,0 +1,514 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Packet_H
+#define SCY_Packet_H
+
+
+#include "scy/types.h"
+#include "scy/bitwise.h"
+#include "scy/interface.h"
+#include "scy/buffer.h"
+#include "scy/memory.h"
+#include "scy/logger.h"
+
+#include <list>
+#include <cstring> // memcpy
+#include <stdexcept>
+
+
+namespace scy {
+    
+    
+struct IPacketInfo
+    // An abstract interface for packet sources to
+    // provide extra information about packets.
+{ 
+    IPacketInfo() {}; 
+    virtual ~IPacketInfo() {}; 
+
+    virtual IPacketInfo* clone() const = 0;
+};
+
+
+class IPacket: public basic::Polymorphic
+    // The basic packet type which is passed around the LibSourcey system.
+    // IPacket can be extended for each protocol to enable polymorphic
+    // processing and callbacks using PacketStream and friends.
+{ 
+public:
+    IPacket(void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr, unsigned flags = 0) : 
+        source(source), opaque(opaque), info(info), flags(flags) {}
+    
+    IPacket(const IPacket& r) : 
+        source(r.source),
+        opaque(r.opaque),
+        info(r.info ? r.info->clone() : nullptr),
+        flags(r.flags)
+    {
+    }
+        
+    IPacket& operator = (const IPacket& r) 
+    {
+        source = r.source;
+        opaque = r.opaque;
+        info = (r.info ? r.info->clone() : nullptr);
+        flags = r.flags;
+        return *this;
+    }
+    
+    virtual IPacket* clone() const = 0;    
+
+    virtual ~IPacket() 
+    {
+        if (info) delete info;
+    }
+
+    void* source;
+        // Packet source pointer reference which enables processors
+        // along the signal chain can determine the packet origin.
+        // Often a subclass of PacketStreamSource.
+
+    void* opaque;
+        // Optional client data pointer.
+        // This pointer is not managed by the packet.
+
+    IPacketInfo* info;
+        // Optional extra information about the packet.
+        // This pointer is managed by the packet.
+
+    Bitwise flags;
+        // Provides basic information about the packet.    
+        
+    virtual std::size_t read(const ConstBuffer&) = 0;
+        // Read/parse to the packet from the given input buffer.
+        // The number of bytes read is returned.
+    
+    virtual void write(Buffer&) const = 0;
+        // Copy/generate to the packet given output buffer.
+        // The number of bytes written can be obtained from the buffer.
+        // 
+        // Todo: It may be prefferable to use our pod types here
+        // instead of buffer input, but the current codebase requires
+        // that the buffer be dynamically resizable for some protocols... 
+        //
+        // virtual std::size_t write(MutableBuffer&) const = 0;
+
+    virtual std::size_t size() const { return 0; };
+        // The size of the packet in bytes.
+        //
+        // This is the nember of bytes that will be written on a call
+        // to write(), but may not be the number of bytes that will be
+        // consumed by read().
+    
+    virtual bool hasData() const { return data() != nullptr; }
+    virtual char* data() const { return nullptr; }
+        // The packet data pointer for buffered packets.
+        // Packet payloads may be shared between packet copies,
+        // so processors which modify the payload in place must
+        // use mutableData() instead.
+
+    virtual char* mutableData() { return data(); }
+        // Returns a data pointer which is safe to write to.
+        // Packets which share their payload with other copies
+        // will copy it first (copy-on-write).
+
+    virtual const char* className() const = 0;
+    virtual void print(std::ostream& os) const { os << className() << std::endl; }
+    
+    friend std::ostream& operator << (std::ostream& stream, const IPacket& p) 
+    {
+        p.print(stream);
+        return stream;
+    }
+};
+
+
+class PacketBuffer: public SharedObject
+    /// PacketBuffer is a reference counted packet payload which is
+    /// shared between copies of a RawPacket, so that passing packets
+    /// across queue boundaries only costs a reference count increment.
+    ///
+    /// Shared payloads are treated as immutable, see RawPacket::mutableData().
+{
+public:
+    PacketBuffer(char* data, std::size_t size) :
+        _data(data), _size(size)
+        // Takes ownership of a buffer allocated with new[].
+    {
+    }
+
+    static PacketBuffer* copy(const char* data, std::size_t size)
+        // Creates a PacketBuffer holding a copy of the given data.
+    {
+        char* buf = new char[size];
+        std::memcpy(buf, data, size);
+        return new PacketBuffer(buf, size);
+    }
+
+    char* data() const { return _data; }
+    std::size_t size() const { return _size; }
+
+protected:
+    virtual ~PacketBuffer()
+    {
+        delete [] _data;
+    }
+
+    char* _data;
+    std::size_t _size;
+};
+
+
+class RawPacket: public IPacket 
+    /// RawPacket is the default data packet type which consists
+    /// of an optionally managed char pointer and a size value.
+    ///
+    /// Managed data is held in a reference counted PacketBuffer, so
+    /// copies of a managed packet share its payload. Copies of an
+    /// unmanaged packet take a managed copy of the data, since the
+    /// source buffer may not outlive the original packet.
+{    
+public:
+    RawPacket(char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+        IPacket(source, opaque, info, flags), _data(data), _size(size), _free(false), _buffer(nullptr)
+    {
+    }
+
+    RawPacket(const char* data, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+        IPacket(source, opaque, info, flags), _data(nullptr), _size(size), _free(true), _buffer(nullptr)
+    {
+        copyData(data, size); // copy const data
+    }
+
+    RawPacket(const RawPacket& that) : 
+        IPacket(that), _data(nullptr), _size(0), _free(false), _buffer(nullptr)
+    {        
+        // Share managed data, and copy unmanaged data
+        if (that._buffer) {
+            _buffer = that._buffer;
+            _buffer->duplicate();
+            _data = that._data;
+            _size = that._size;
+            _free = true;
+        }
+        else if (that._data && that._size)
+            copyData(that._data, that._size);
+    }
+    
+    RawPacket& operator = (const RawPacket& that) 
+    {
+        if (this != &that) {
+            IPacket::operator = (that);
+            if (that._buffer)
+                that._buffer->duplicate();
+            if (_buffer)
+                _buffer->release();
+            _buffer = that._buffer;
+            _data = that._data;
+            _size = that._size;
+            _free = that._free;
+        }
+        return *this;
+    }
+    
+    virtual ~RawPacket() 
+    {
+        if (_buffer)
+            _buffer->release();
+    }
+
+    virtual IPacket* clone() const 
+    {
+        return new RawPacket(*this);
+    }
+
+    virtual void setData(char* data, std::size_t size) 
+    {
+        assert(size > 0);
+
+        // Copy data if reuqests
+        if (_free)
+            copyData(data, size);
+
+        // Otherwise just assign the pointer
+        else {
+            _data = data;
+            _size = size; 
+        }
+    }
+
+    virtual void copyData(const char* data, std::size_t size) 
+    {
+        //traceL("RawPacket", this) << "Cloning: " << size << std::endl;
+
+        //assert(_free);
+        assert(size > 0);
+        PacketBuffer* buffer = PacketBuffer::copy(data, size);
+        if (_buffer)
+            _buffer->release();
+        _buffer = buffer;
+        _size = size;
+        _data = buffer->data();
+        _free = true;
+    }    
+    
+    virtual std::size_t read(const ConstBuffer& buf) 
+    { 
+        copyData(bufferCast<const char*>(buf), buf.size());
+        return true;
+    }
+
+    // Old Read API
+    //
+    // virtual bool read(const ConstBuffer& buf) 
+    // { 
+    //     return true;
+    // }
+    
+    virtual void write(Buffer& buf) const 
+    {    
+        buf.insert(buf.end(), _data, _data + _size); 
+        //buf.insert(a.end(), b.begin(), b.end());
+        //buf.append(_data, _size); 
+    }
+    
+    // Future Write API
+    //
+    // virtual void write(MutableBuffer& buf) const 
+    // {    
+    //     assert(buf.size() >= _size);
+    //     std::memcpy(buf.data(), _data, _size);
+    // }
+
+    virtual char* data() const 
+    { 
+        return _data; 
+    }
+
+    virtual char* mutableData()
+        // Copies the payload first if it is shared with other packets.
+    {
+        if (shared())
+            copyData(_data, _size);
+        return _data;
+    }
+
+    bool shared() const
+        // Returns true if the payload is shared with other packets.
+    {
+        return _buffer && _buffer->refCount() > 1;
+    }
+
+    virtual std::size_t size() const 
+    { 
+        return _size; 
+    }
+    
+    virtual const char* className() const 
+    { 
+        return "RawPacket"; 
+    }
+
+    virtual bool ownsBuffer() const
+    {
+        return _free;
+    }
+    
+    virtual void assignDataOwnership()
+        // Takes ownership of the assigned data, which 
+        // must have been allocated with new[].
+    {
+        if (!_free && _data) {
+            assert(!_buffer);
+            _buffer = new PacketBuffer(_data, _size);
+        }
+        _free = true;
+    }
+    
+    char* _data;
+    size_t _size;
+    bool _free;
+    PacketBuffer* _buffer;
+};
+
+
+class GatheredPacket: public IPacket 
+    /// GatheredPacket is a packet made up of a short list of borrowed
+    /// buffer segments, such as a protocol header, a payload and a 
+    /// trailer, which sockets send as a single gathered write without
+    /// joining the segments into a contiguous buffer.
+    ///
+    /// Segments are not copied by the packet. Sockets copy segments of up
+    /// to net::WriteRequest::MaxCopySize bytes into the write request, so
+    /// short framing such as a size line may live on the stack, while
+    /// larger segments are borrowed until the write completes. Copies of
+    /// a gathered packet hold a managed contiguous copy of the data,
+    /// since the borrowed segments may not outlive the original packet.
+{    
+public:
+    enum { MaxSegments = 8 };
+
+    GatheredPacket(unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr) : 
+        IPacket(source, opaque, info, flags), _count(0), _size(0)
+    {
+    }
+
+    GatheredPacket(const GatheredPacket& that) : 
+        IPacket(that), _count(0), _size(0)
+    {
+        that.write(_storage);
+        append(_storage.data(), _storage.size());
+    }
+    
+    GatheredPacket& operator = (const GatheredPacket& that) 
+    {
+        if (this != &that) {
+            IPacket::operator = (that);
+            Buffer storage;
+            that.write(storage);
+            _storage.swap(storage);
+            clear();
+            append(_storage.data(), _storage.size());
+        }
+        return *this;
+    }
+
+    virtual IPacket* clone() const 
+    {
+        return new GatheredPacket(*this);
+    }
+
+    void append(const char* data, std::size_t size)
+        // Appends a borrowed segment to the packet.
+        // Empty segments are ignored.
+        // See the class description for segment lifetime.
+    {
+        if (!size)
+            return;
+        if (_count == MaxSegments)
+            throw std::length_error("Gathered packet segment limit exceeded");
+        _segments[_count++] = ConstBuffer(data, size);
+        _size += size;
+    }
+
+    void append(const std::string& str)
+    {
+        append(str.data(), str.length());
+    }
+
+    void clear()
+        // Removes all segments from the packet.
+    {
+        _count = 0;
+        _size = 0;
+    }
+
+    const ConstBuffer* buffers() const
+        // Returns the segment list for gathered writes.
+    {
+        return _segments;
+    }
+
+    std::size_t count() const
+        // Returns the number of segments.
+    {
+        return _count;
+    }
+    
+    virtual std::size_t read(const ConstBuffer& buf) 
+    { 
+        _storage.assign(bufferCast<const char*>(buf), bufferCast<const char*>(buf) + buf.size());
+        clear();
+        append(_storage.data(), _storage.size());
+        return buf.size();
+    }
+    
+    virtual void write(Buffer& buf) const 
+    {    
+        buf.reserve(buf.size() + _size);
+        for (std::size_t i = 0; i < _count; i++)
+            buf.insert(buf.end(), bufferCast<const char*>(_segments[i]), 
+                bufferCast<const char*>(_segments[i]) + _segments[i].size());
+    }
+
+    virtual char* data() const 
+        // Returns the data pointer if the packet has a single 
+        // segment, otherwise nullptr.
+    { 
+        return _count == 1 ? const_cast<char*>(bufferCast<const char*>(_segments[0])) : nullptr;
+    }
+
+    virtual char* mutableData()
+        // Joins the segments into a managed buffer first
+        // if the packet has more than one segment.
+    {
+        if (_count > 1) {
+            Buffer storage;
+            write(storage);
+            _storage.swap(storage);
+            clear();
+            append(_storage.data(), _storage.size());
+        }
+        return data();
+    }
+
+    virtual std::size_t size() const 
+    { 
+        return _size; 
+    }
+    
+    virtual const char* className() const 
+    { 
+        return "GatheredPacket"; 
+    }
+
+protected:
+    ConstBuffer _segments[MaxSegments];
+    std::size_t _count;
+    std::size_t _size;
+    Buffer _storage;
+};
+
+
+inline RawPacket rawPacket(const MutableBuffer& buf, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{
+    return RawPacket(bufferCast<char*>(buf), buf.size(), flags, source, opaque, info);
+}
+
+inline RawPacket rawPacket(const ConstBuffer& buf, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{        
+    return RawPacket(bufferCast<const char*>(buf), buf.size(), flags, source, opaque, info);  // copy const data
+}
+
+inline RawPacket rawPacket(char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{    
+    return RawPacket(data, size, flags, source, opaque, info);
+}
+
+inline RawPacket rawPacket(const char* data = nullptr, std::size_t size = 0, unsigned flags = 0, void* source = nullptr, void* opaque = nullptr, IPacketInfo* info = nullptr)
+{    
+    return RawPacket(data, size, flags, source, opaque, info);  // copy const data
+}
+
+
+} // namespace scy
+
+
+#endif // SCY_Packet_H
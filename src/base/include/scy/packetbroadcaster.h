@@ -0,0 +1,72 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_PacketBroadcaster_H
+#define SCY_PacketBroadcaster_H
+
+
+#include "scy/packetstream.h"
+#include "scy/packetqueue.h"
+
+
+namespace scy {
+    
+
+//
+// Packet Broadcaster
+//
+
+
+class PacketBroadcaster: public PacketProcessor
+    /// PacketBroadcaster shares the output of a single PacketStream
+    /// between any number of subscriber streams, so expensive processing
+    /// such as media encoding runs once no matter how many subscribers
+    /// there are.
+    ///
+    /// Packets which borrow their data are copied once into a reference
+    /// counted packet before being broadcast, so subscribers which queue
+    /// the packet only take a reference to the shared payload.
+{
+public:
+    PacketBroadcaster();
+    virtual ~PacketBroadcaster();
+
+    virtual void process(IPacket& packet);
+    
+    void subscribe(PacketStream& stream, int queueSize = 16, uv::Loop* loop = uv::defaultLoop());
+        // Attaches the broadcaster as a source of the given stream,
+        // followed by a SyncPacketQueue of the given size at order 0.
+        //
+        // Each subscriber has its own bounded queue, which drops the
+        // subscriber's oldest packets when it falls behind without 
+        // stalling the publisher or any other subscriber.
+        // Packet payloads must not be modified by subscribers.
+        //
+        // The stream must not be active. The stream receives packets
+        // once started, and closing the stream detaches it from the
+        // broadcaster.
+
+    PacketSignal emitter;
+};
+
+
+} // namespace scy
+
+
+#endif // SCY_PacketBroadcaster_H
@@ -0,0 +1,998 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Queue_H
+#define SCY_Queue_H
+
+
+#include "scy/interface.h"
+#include "scy/thread.h"
+#include "scy/platform.h"
+#include "scy/synccontext.h"
+#include "scy/datetime.h"
+#include <queue>
+#include <atomic>
+#include <memory>
+#include <ostream>
+
+
+namespace scy {
+
+    
+template<typename T>
+class Queue
+    /// Implements a thread-safe queue container.
+    /// TODO: Iterators
+{
+private:
+    std::queue<T> _queue;
+    mutable Mutex _mutex;
+
+public:
+    void push(const T& data)
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _queue.push(data);
+    }
+
+    bool empty() const
+    {
+        //Mutex::ScopedLock lock(_mutex);
+        return _queue.empty();
+    }
+
+    T& front()
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue.front();
+    }
+    
+    T const& front() const
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue.front();
+    }
+
+    T& back()
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue.back();
+    }
+    
+    T const& back() const
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue.back();
+    }
+
+    void pop()
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _queue.pop();
+    }
+
+    void popFront()
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _queue.pop_front();
+    }
+};
+
+
+//
+// Latency Histogram
+//
+
+
+class LatencyHistogram
+    /// LatencyHistogram records enqueue to dequeue latency for a queue.
+    ///
+    /// Samples are recorded in microseconds into power of two buckets,
+    /// so bucket N holds samples in the range [2^(N-1), 2^N) and bucket
+    /// 0 holds sub-microsecond samples. Recording is lock-free, so the
+    /// histogram may be read from any thread while the queue is running.
+{
+public:
+    enum { NumBuckets = 32 };
+
+    LatencyHistogram()
+    {
+        reset();
+    }
+
+    void record(UInt64 usec)
+        // Records a single latency sample.
+    {
+        int index = 0;
+        while (usec >> index && index < NumBuckets - 1)
+            index++;
+        _buckets[index].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _total.fetch_add(usec, std::memory_order_relaxed);
+        UInt64 max = _max.load(std::memory_order_relaxed);
+        while (usec > max && !_max.compare_exchange_weak(max, usec, 
+            std::memory_order_relaxed));
+    }
+
+    void reset()
+        // Clears all recorded samples.
+    {
+        for (int i = 0; i < NumBuckets; i++)
+            _buckets[i].store(0, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+        _total.store(0, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+    
+    UInt64 count() const
+        // Returns the number of recorded samples.
+    {
+        return _count.load(std::memory_order_relaxed);
+    }
+    
+    UInt64 bucket(int index) const
+        // Returns the number of samples in the given bucket.
+    {
+        assert(index >= 0 && index < NumBuckets);
+        return _buckets[index].load(std::memory_order_relaxed);
+    }
+    
+    UInt64 max() const
+        // Returns the largest recorded sample in microseconds.
+    {
+        return _max.load(std::memory_order_relaxed);
+    }
+
+    double mean() const
+        // Returns the mean latency in microseconds.
+    {
+        UInt64 n = count();
+        return n ? double(_total.load(std::memory_order_relaxed)) / n : 0;
+    }
+
+    UInt64 percentile(double pct) const
+        // Returns the upper bound in microseconds of the bucket 
+        // which contains the given percentile (0 - 100).
+    {
+        UInt64 n = count();
+        if (n == 0)
+            return 0;
+        UInt64 rank = static_cast<UInt64>(n * pct / 100.0);
+        UInt64 seen = 0;
+        for (int i = 0; i < NumBuckets; i++) {
+            seen += bucket(i);
+            if (seen > rank)
+                return UInt64(1) << i;
+        }
+        return max();
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "count=" << count() 
+            << " mean=" << mean() << "us"
+            << " p50=" << percentile(50) << "us"
+            << " p99=" << percentile(99) << "us"
+            << " max=" << max() << "us";
+    }
+
+    friend std::ostream& operator << (std::ostream& stream, const LatencyHistogram& hist) 
+    {
+        hist.print(stream);
+        return stream;
+    }
+
+protected:
+    std::atomic<UInt64> _buckets[NumBuckets];
+    std::atomic<UInt64> _count;
+    std::atomic<UInt64> _total;
+    std::atomic<UInt64> _max;
+};
+
+
+//
+// Runnable Queue
+//
+
+
+template<class T>
+class RunnableQueue: public async::Runnable
+{
+public:
+    RunnableQueue(int limit = 2048, int timeout = 0) :
+        _limit(limit), 
+        _timeout(timeout),
+        _waiting(false),
+        _inflight(0),
+        _dispatcher(0)
+    {
+    }
+
+    virtual ~RunnableQueue() 
+    {
+        clear();
+    }
+
+    std::function<void(T&)> ondispatch;
+        // The default dispatch function.
+        // Must be set before the queue is running.
+        
+    virtual void dispatch(T& item)
+        // Dispatch a single item to listeners.
+    {
+        if (ondispatch)
+            ondispatch(item);
+    }
+    
+    virtual void push(T* item)
+        // Push an item onto the queue.
+        // The queue takes ownership of the item pointer.        
+    {
+        Mutex::ScopedLock lock(_mutex);    
+                
+        while (_limit > 0 && static_cast<int>(_queue.size()) >= _limit) {
+            warnL("RunnableQueue", this) << "Purging: " << _queue.size() << std::endl;
+            delete _queue.front();
+            _queue.pop_front();
+            _stamps.pop_front();
+        }
+            
+        _queue.push_back(item);
+        _stamps.push_back(uv_hrtime());
+
+        // Only wake the dispatch thread if it is idle
+        if (_waiting)
+            _ready.signal();
+    }
+    
+    virtual void flush()
+        // Flushes all outgoing items.
+        // Any batch currently being dispatched by the run() 
+        // thread is waited on, so the queue is fully drained
+        // once this method returns.
+    {
+        while (dispatchNext());
+
+        Mutex::ScopedLock lock(_mutex);
+        while (_inflight > 0 && _dispatcher != Thread::currentID())
+            _drained.wait(_mutex);
+    }
+    
+    void clear()
+        // Clears all queued items.
+    {
+        Mutex::ScopedLock lock(_mutex);    
+        util::clearDeque(_queue);
+        _stamps.clear();
+    }
+    
+    bool empty()
+    {
+        // Disabling mutex lock for bool check.
+        //Mutex::ScopedLock lock(_mutex);    
+        return _queue.empty();
+    }
+    
+    std::size_t size()
+    {
+        Mutex::ScopedLock lock(_mutex);    
+        return _queue.size();
+    }
+    
+    virtual std::deque<T*> queue()
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue;
+    }
+    
+    virtual void run()
+        // Called asynchronously to dispatch queued items.
+        // If not timeout is set this method blocks until cancel()
+        // is called, otherwise runTimeout() will be called.
+        // Pseudo protected for std::bind compatability.
+    {
+        if (_timeout) {
+            runTimeout();
+        }
+        else {
+            {
+                Mutex::ScopedLock lock(_mutex);
+                _dispatcher = Thread::currentID();
+            }
+            while (!cancelled()) {
+                dispatchBatch();
+            }
+        }
+    }
+    
+    virtual void runTimeout()
+        // Called asynchronously to dispatch queued items
+        // until the queue is empty or the timeout expires.
+        // Pseudo protected for std::bind compatability.
+    {
+        Stopwatch sw;
+        sw.start();
+        do {
+            // scy::sleep(1);
+        }
+        while (!cancelled() && sw.elapsedMilliseconds() < _timeout && dispatchNext());
+    }
+    
+    virtual void cancel(bool flag = true)
+        // Cancels the queue and wakes the dispatch thread.
+    {
+        async::Runnable::cancel(flag);
+
+        Mutex::ScopedLock lock(_mutex);
+        _ready.broadcast();
+    }
+    
+    int timeout()    
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _timeout;
+    }
+    
+    void setTimeout(int miliseconds)
+    {
+        Mutex::ScopedLock lock(_mutex);
+        assert(_queue.empty() && "queue must not be active");
+        _timeout = miliseconds;
+    }
+
+    const LatencyHistogram& latency() const
+        // Returns the enqueue to dequeue latency histogram.
+    {
+        return _latency;
+    }
+    
+protected:    
+    RunnableQueue(const RunnableQueue&);
+    RunnableQueue& operator = (const RunnableQueue&);
+
+    virtual T* popNext()
+        // Pops the next waiting item.
+    {
+        T* next;
+        UInt64 stamp;
+        {
+            Mutex::ScopedLock lock(_mutex);
+            if (_queue.empty())
+                return nullptr;
+
+            next = _queue.front();
+            stamp = _stamps.front();
+            _queue.pop_front();
+            _stamps.pop_front();
+        }        
+        _latency.record((uv_hrtime() - stamp) / 1000);
+        return next;
+    }
+    
+    virtual bool dispatchNext()
+        // Pops and dispatches the next waiting item.
+    {
+        T* next = popNext();    
+        if (next) {
+            dispatch(*next);
+            delete next;
+            return true;
+        }
+        return false;
+    }
+
+    virtual bool dispatchBatch()
+        // Blocks until items are available or the queue is cancelled,
+        // and then takes and dispatches all waiting items at once. 
+        // Items which remain undispatched due to cancellation are deleted.
+    {
+        std::deque<T*> items;
+        std::deque<UInt64> stamps;
+        {
+            Mutex::ScopedLock lock(_mutex);
+            _waiting = true;
+            while (_queue.empty() && !cancelled())
+                _ready.wait(_mutex);
+            _waiting = false;
+
+            items.swap(_queue);
+            stamps.swap(_stamps);
+            _inflight = items.size();
+        }    
+        if (items.empty())
+            return false;
+        
+        UInt64 now = uv_hrtime();
+        for (auto stamp : stamps)
+            _latency.record((now - stamp) / 1000);
+        
+        for (auto item : items) {
+            if (!cancelled())
+                dispatch(*item);
+            delete item;
+        }
+        
+        Mutex::ScopedLock lock(_mutex);
+        _inflight = 0;
+        _drained.broadcast();
+        return true;
+    }
+    
+    int _limit;
+    int _timeout;
+    bool _waiting;
+    std::size_t _inflight;
+    unsigned long _dispatcher;
+    std::deque<T*> _queue;
+    std::deque<UInt64> _stamps;
+    LatencyHistogram _latency;
+    Condition _ready;
+    Condition _drained;
+    mutable Mutex _mutex;
+};
+
+
+//
+// Synchronization Queue
+//
+
+
+template<class T>
+class SyncQueue: public RunnableQueue<T>
+    // SyncQueue extends SyncContext to implement a synchronized FIFO
+    // queue which receives T objects from any thread and synchronizes
+    // them for safe consumption by the associated event loop.
+{
+public:
+    SyncQueue(uv::Loop* loop, int limit = 2048, int timeout = 20) :
+        RunnableQueue<T>(limit, timeout), 
+        // Note: The SyncQueue instance must not be destroyed
+        // while the RunnableQueue is still dispatching items.
+        _sync(loop, std::bind(&SyncQueue::run, this))
+    {
+    }
+
+    virtual ~SyncQueue() 
+        // Destruction is deferred to allow enough    
+        // time for all callbacks to return.
+    {
+    }
+    
+    virtual void push(T* item)
+        // Pushes an item onto the queue.
+        // Item pointers are now managed by the SyncQueue.        
+    {
+        RunnableQueue<T>::push(item);
+        _sync.post();
+    }
+    
+    virtual void cancel()
+    {
+        RunnableQueue<T>::cancel();
+        _sync.cancel();
+
+        // Call uv_close on the handle if calling from  
+        // the event loop thread or we deadlock.
+        if (Thread::currentID() == _sync.tid())
+            _sync.close();
+    }
+    
+    SyncContext& sync()
+    {
+        return _sync;
+    }    
+
+protected:
+    SyncContext _sync;
+};
+
+
+//
+// Asynchronous Queue
+//
+
+
+template<class T>
+class AsyncQueue: public RunnableQueue<T>
+    // AsyncQueue is a thread-based queue which receives packets  
+    // from any thread source and dispatches them asynchronously.
+    //
+    // This queue is useful for deferring load from operation 
+    // critical system devices before performing long running tasks.
+    //
+    // The thread will call the RunnableQueue's run() method to
+    // constantly flush outgoing packets until cancel() is called. 
+{
+public:
+    AsyncQueue(int limit = 2048) : 
+        RunnableQueue<T>(limit),
+        _thread(std::bind(&AsyncQueue::run, this))
+    {
+    }    
+    
+    virtual void cancel()
+    {
+        RunnableQueue<T>::cancel();
+        _thread.cancel();
+    }
+
+protected:
+    virtual ~AsyncQueue() 
+    {
+    }
+
+    Thread _thread;
+};
+
+
+//
+// Lock-free Ring Buffers
+//
+
+
+template<class T>
+class SPSCRing
+    /// SPSCRing is a bounded lock-free ring buffer which is safe for 
+    /// exactly one producer thread and one consumer thread.
+    ///
+    /// The capacity is rounded up to the next power of two.
+    /// The head and tail indices are kept on separate cache lines
+    /// so the producer and consumer don't false share.
+{
+public:
+    SPSCRing(std::size_t capacity = 1024) :
+        _mask(roundCapacity(capacity) - 1),
+        _cells(new T[_mask + 1]),
+        _head(0),
+        _tail(0)
+    {
+    }
+    
+    bool push(const T& item)
+        // Pushes an item from the producer thread.
+        // Returns false if the ring is full.
+    {
+        std::size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) > _mask)
+            return false;
+        _cells[tail & _mask] = item;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool pop(T& item)
+        // Pops an item from the consumer thread.
+        // Returns false if the ring is empty.
+    {
+        std::size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire))
+            return false;
+        item = _cells[head & _mask];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    std::size_t size() const
+        // Returns the approximate number of items in the ring.
+    {
+        return _tail.load(std::memory_order_acquire) - 
+            _head.load(std::memory_order_acquire);
+    }
+    
+    std::size_t capacity() const
+    {
+        return _mask + 1;
+    }
+    
+    static std::size_t roundCapacity(std::size_t capacity)
+        // Returns the given capacity rounded up to a power of two.
+    {
+        std::size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        return n;
+    }
+
+protected:
+    SPSCRing(const SPSCRing&);
+    SPSCRing& operator = (const SPSCRing&);
+
+    const std::size_t _mask;
+    std::unique_ptr<T[]> _cells;
+    char _pad0[64];
+    std::atomic<std::size_t> _head;
+    char _pad1[64];
+    std::atomic<std::size_t> _tail;
+    char _pad2[64];
+};
+
+
+template<class T>
+class MPSCRing
+    /// MPSCRing is a bounded lock-free ring buffer which is safe for
+    /// any number of producer threads and a single consumer thread.
+    ///
+    /// Each cell carries a sequence number which tells producers
+    /// whether the cell is free and the consumer whether it has been
+    /// published, so producers only contend on a single CAS of the
+    /// tail index. The capacity is rounded up to a power of two.
+{
+public:
+    MPSCRing(std::size_t capacity = 1024) :
+        _mask(SPSCRing<T>::roundCapacity(capacity) - 1),
+        _cells(new Cell[_mask + 1]),
+        _head(0),
+        _tail(0)
+    {
+        for (std::size_t i = 0; i <= _mask; i++)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    
+    bool push(const T& item)
+        // Pushes an item from any producer thread.
+        // Returns false if the ring is full.
+    {
+        Cell* cell;
+        std::size_t pos = _tail.load(std::memory_order_relaxed);
+        for (;;) {
+            cell = &_cells[pos & _mask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::ptrdiff_t diff = std::ptrdiff_t(seq) - std::ptrdiff_t(pos);
+            if (diff == 0) {
+                if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = _tail.load(std::memory_order_relaxed);
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+    
+    bool pop(T& item)
+        // Pops an item from the consumer thread.
+        // Returns false if the ring is empty, or if the next item
+        // has been claimed but not yet published by its producer.
+    {
+        std::size_t pos = _head.load(std::memory_order_relaxed);
+        Cell* cell = &_cells[pos & _mask];
+        std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+        if (std::ptrdiff_t(seq) - std::ptrdiff_t(pos + 1) < 0)
+            return false;
+        item = cell->data;
+        cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+        _head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    std::size_t size() const
+        // Returns the approximate number of items in the ring.
+    {
+        std::size_t head = _head.load(std::memory_order_acquire);
+        std::size_t tail = _tail.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+    
+    std::size_t capacity() const
+    {
+        return _mask + 1;
+    }
+
+protected:
+    MPSCRing(const MPSCRing&);
+    MPSCRing& operator = (const MPSCRing&);
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence;
+        T data;
+    };
+
+    const std::size_t _mask;
+    std::unique_ptr<Cell[]> _cells;
+    char _pad0[64];
+    std::atomic<std::size_t> _head;
+    char _pad1[64];
+    std::atomic<std::size_t> _tail;
+    char _pad2[64];
+};
+
+
+//
+// Ring Queue
+//
+
+
+template<class T, template<class> class Ring = MPSCRing>
+class RingQueue: public async::Runnable
+    /// RingQueue is a bounded counterpart to RunnableQueue which is
+    /// backed by a lock-free ring buffer, so pushing an item never 
+    /// takes a lock unless the dispatch thread is asleep.
+    ///
+    /// Use SPSCRing when there is only a single producer thread,
+    /// and the default MPSCRing otherwise. Unlike RunnableQueue
+    /// a full queue drops the newest item rather than the oldest.
+{
+public:
+    struct Entry
+    {
+        T* item;
+        UInt64 stamp;
+    };
+
+    RingQueue(std::size_t capacity = 1024) :
+        _ring(capacity),
+        _waiting(false),
+        _dropped(0)
+    {
+    }
+
+    virtual ~RingQueue() 
+    {
+        clear();
+    }
+
+    std::function<void(T&)> ondispatch;
+        // The default dispatch function.
+        // Must be set before the queue is running.
+        
+    virtual void dispatch(T& item)
+        // Dispatch a single item to listeners.
+    {
+        if (ondispatch)
+            ondispatch(item);
+    }
+    
+    virtual bool push(T* item)
+        // Push an item onto the queue.
+        // The queue takes ownership of the item pointer.
+        // If the queue is full the item is deleted and 
+        // false is returned.
+    {
+        Entry entry = { item, uv_hrtime() };
+        if (!_ring.push(entry)) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            delete item;
+            return false;
+        }
+
+        // Pairs with the fence in dispatchBatch() so either the 
+        // consumer sees the new item or we see it waiting.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiting.load(std::memory_order_relaxed)) {
+            Mutex::ScopedLock lock(_mutex);
+            _ready.signal();
+        }
+        return true;
+    }
+    
+    virtual void flush()
+        // Dispatches all queued items from the calling thread.
+        // Since the ring only supports a single consumer this must
+        // be called from the dispatch thread, or once it has exited.
+    {
+        while (dispatchNext());
+    }
+
+    void clear()
+        // Deletes all queued items.
+        // The same threading rules as flush() apply.
+    {
+        Entry entry;
+        while (_ring.pop(entry))
+            delete entry.item;
+    }
+    
+    bool empty() const
+    {
+        return _ring.empty();
+    }
+    
+    std::size_t size() const
+    {
+        return _ring.size();
+    }
+    
+    std::size_t capacity() const
+    {
+        return _ring.capacity();
+    }
+    
+    UInt64 dropped() const
+        // Returns the number of items dropped because the queue was full.
+    {
+        return _dropped.load(std::memory_order_relaxed);
+    }
+
+    virtual void run()
+        // Called asynchronously to dispatch queued items.
+        // This method blocks until cancel() is called.
+        // Pseudo protected for std::bind compatability.
+    {
+        while (!cancelled()) {
+            dispatchBatch();
+        }
+    }
+    
+    virtual void cancel(bool flag = true)
+        // Cancels the queue and wakes the dispatch thread.
+    {
+        async::Runnable::cancel(flag);
+
+        Mutex::ScopedLock lock(_mutex);
+        _ready.broadcast();
+    }
+
+    const LatencyHistogram& latency() const
+        // Returns the enqueue to dequeue latency histogram.
+    {
+        return _latency;
+    }
+    
+protected:    
+    RingQueue(const RingQueue&);
+    RingQueue& operator = (const RingQueue&);
+    
+    virtual bool dispatchNext()
+        // Pops and dispatches the next waiting item.
+    {
+        Entry entry;
+        if (!_ring.pop(entry))
+            return false;
+        
+        _latency.record((uv_hrtime() - entry.stamp) / 1000);
+        dispatch(*entry.item);
+        delete entry.item;
+        return true;
+    }
+
+    virtual bool dispatchBatch()
+        // Dispatches all waiting items, or blocks until items 
+        // are pushed or the queue is cancelled.
+    {
+        if (dispatchNext()) {
+            while (!cancelled() && dispatchNext());
+            return true;
+        }
+            
+        Mutex::ScopedLock lock(_mutex);
+        _waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        
+        // A cell which has been claimed but not yet published counts
+        // towards size(), so we spin rather than sleep in that case.
+        if (_ring.empty() && !cancelled())
+            _ready.wait(_mutex);
+        _waiting.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    
+    Ring<Entry> _ring;
+    std::atomic<bool> _waiting;
+    std::atomic<UInt64> _dropped;
+    LatencyHistogram _latency;
+    Condition _ready;
+    Mutex _mutex;
+};
+
+
+template<class T, template<class> class Ring = MPSCRing>
+class AsyncRingQueue: public RingQueue<T, Ring>
+    // AsyncRingQueue is a thread-based RingQueue which receives 
+    // items from any thread source and dispatches them asynchronously.
+    //
+    // The thread blocks until items are pushed, and dispatches 
+    // all waiting items in a batch until cancel() is called.
+{
+public:
+    AsyncRingQueue(std::size_t capacity = 1024) : 
+        RingQueue<T, Ring>(capacity),
+        _thread(std::bind(&AsyncRingQueue::run, this))
+    {
+    }    
+    
+    virtual void cancel()
+    {
+        RingQueue<T, Ring>::cancel();
+        _thread.cancel();
+    }
+
+protected:
+    virtual ~AsyncRingQueue() 
+    {
+    }
+
+    Thread _thread;
+};
+
+
+#if 0
+//
+// Concurrent Queue
+//
+// TODO: Re-implement Condition class from libuv primitives
+//
+
+template<typename T>
+class ConcurrentQueue
+    // Implements a simple thread-safe multiple producer, 
+    // multiple consumer queue. 
+{
+private:
+    std::queue<T> _queue;
+    mutable Mutex _mutex;
+    Poco::Condition _condition;
+
+public:
+    void push(T const& data)
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _queue.push(data);
+        lock.unlock();
+        _condition.signal();
+    }
+
+    bool empty() const
+    {
+        Mutex::ScopedLock lock(_mutex);
+        return _queue.empty();
+    }
+
+    bool tryPop(T& out)
+    {
+        Mutex::ScopedLock lock(_mutex);
+        if (_queue.empty())
+            return false;
+        
+        out = _queue.front();
+        _queue.pop();
+        return true;
+    }
+
+    void waitAndPop(T& out)
+    {
+        Mutex::ScopedLock lock(_mutex);
+        while (_queue.empty())
+            _cond.wait(_mutex);
+        
+        out = _queue.front();
+        _queue.pop();
+    }
+};
+#endif
+
+
+} // namespace scy
+
+
+
+#endif // SCY_Queue_H
\ No newline at end of file
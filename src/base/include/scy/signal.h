@@ -0,0 +1,379 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Signal_H
+#define SCY_Signal_H
+
+
+#include "scy/types.h"
+#include "scy/delegate.h"
+#include "scy/util.h"
+#include "scy/mutex.h"
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <algorithm>
+#include <assert.h>
+
+#if defined(__GNUC__)
+   // We're all grown up and we know that simulating
+   // reinterpret_cast<> may cause strict aliasing problems
+   // at runtime.
+#  pragma GCC diagnostic ignored "-Wstrict-aliasing"
+#endif
+
+
+namespace scy {
+
+
+class StopPropagation: public std::exception
+    /// This exception is used to break out of a Signal callback scope.
+{
+public:
+    virtual ~StopPropagation() throw() {};
+};
+
+
+template <class DelegateT, DelegateDefaultArgs>
+class SignalBase 
+    /// This class implements a thread-safe signal which
+    /// broadcasts arbitrary data to multiple receiver delegates.
+    ///
+    /// Delegates are stored in an immutable, priority sorted snapshot
+    /// which is only rebuilt when delegates are attached or detached. 
+    /// Emitting a signal reads the current snapshot without taking a 
+    /// lock or allocating memory.
+    ///
+    /// Replaced snapshots and detached delegates are retired, and 
+    /// only deleted once no emit is in progress. Detached delegates
+    /// are cancelled first, so an in-progress emit will skip them.
+    ///
+    /// The snapshot and retired lists live in a shared state which
+    /// each emit holds a reference to, so a delegate may safely 
+    /// destroy the signal while it is being emitted.
+{
+public:
+    typedef std::list<DelegateT*>                  DelegateList;
+    typedef typename DelegateList::iterator       Iterator;
+    typedef typename DelegateList::const_iterator ConstIterator;
+    typedef std::vector<DelegateT*>               DelegateVector;
+
+    SignalBase() : 
+        _state(std::make_shared<State>()),
+        _enabled(true), 
+        _count(0)
+    {
+    }    
+
+    virtual ~SignalBase() 
+    { 
+        // Anything still referenced by an in-progress emit is 
+        // deleted along with the shared state.
+        clear();
+        _state->reclaim();
+    }
+
+    void operator += (const DelegateT& delegate) { attach(delegate); }    
+    void operator -= (const DelegateT& delegate) { detach(delegate); }    
+    void operator -= (const void* klass) { detach(klass); }
+
+    void attach(const DelegateT& delegate) 
+        // Attaches a delegate to the signal. If the delegate 
+        // already exists it will overwrite the previous delegate.
+    {
+        detach(delegate);
+        Mutex::ScopedLock lock(_state->mutex);
+        const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+        DelegateVector* next = current ? new DelegateVector(*current) : new DelegateVector;
+        next->push_back(delegate.clone());
+        std::stable_sort(next->begin(), next->end(), DelegateT::ComparePrioroty); 
+        _state->publish(next);
+        _count++;
+    }
+
+    bool detach(const DelegateT& delegate) 
+        // Detaches a delegate from the signal.
+        // Returns true if the delegate was detached, false otherwise.
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+        if (!current)
+            return false;
+        for (auto it = current->begin(); it != current->end(); ++it) {
+            if (delegate.equals(*it)) {
+                DelegateVector* next = new DelegateVector(current->begin(), it);
+                next->insert(next->end(), it + 1, current->end());
+                _state->retire(*it);
+                _state->publish(next);
+                _count--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void detach(const void* klass) 
+        // Detaches all delegates associated with the given class instance.
+    {
+        {
+            Mutex::ScopedLock lock(_state->mutex);
+            const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+            if (!current)
+                return;
+            DelegateVector* next = new DelegateVector;
+            for (auto it = current->begin(); it != current->end(); ++it) {
+                if (klass == (*it)->object()) {
+                    _state->retire(*it);
+                    _count--;
+                }
+                else
+                    next->push_back(*it);
+            }
+            if (next->size() == current->size())
+                delete next;
+            else
+                _state->publish(next);
+        }
+
+        // Call cleanup after detaching a class
+        cleanup();
+    }
+
+    void cleanup() 
+        // Deletes detached delegates and retired snapshots,
+        // unless the signal is currently being emitted.
+    {
+        if (_state->retired.load(std::memory_order_relaxed))
+            _state->reclaim();
+    }
+
+    void obtain(DelegateList& active) 
+        // Retrieves a list of active delegates.
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        if (!_enabled) // skip if disabled
+            return;
+        const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+        if (current)
+            active.insert(active.end(), current->begin(), current->end());
+    }
+
+    virtual void emit(void* sender) 
+    {
+        void* empty = nullptr;
+        emit(sender, (P)empty, (P2)empty, (P3)empty, (P4)empty);
+    }
+
+    virtual void emit(void* sender, P arg) 
+    {
+        void* empty = nullptr;
+        emit(sender, arg, (P2)empty, (P3)empty, (P4)empty);
+    }
+
+    virtual void emit(void* sender, P arg, P2 arg2) 
+    {
+        void* empty = nullptr;
+        emit(sender, arg, arg2, (P3)empty, (P4)empty);
+    }    
+
+    virtual void emit(void* sender, P arg, P2 arg2, P3 arg3) 
+    {
+        void* empty = nullptr;
+        emit(sender, arg, arg2, arg3, (P4)empty);
+    }
+
+    virtual void emit(void* sender, P arg, P2 arg2, P3 arg3, P4 arg4) 
+    {
+        if (!_enabled.load(std::memory_order_relaxed)) // skip if disabled
+            return;
+
+        // A delegate may destroy the signal, so only the local state 
+        // reference is used once delegates are being called.
+        // Registering as a reader before loading the snapshot 
+        // guarantees it won't be reclaimed until we are done.
+        std::shared_ptr<State> state(_state);
+        state->readers.fetch_add(1, std::memory_order_seq_cst);
+        const DelegateVector* current = state->snapshot.load(std::memory_order_seq_cst);
+        try {
+            if (current) {
+                for (auto it = current->begin(); it != current->end(); ++it) {
+                    if (!(*it)->cancelled() && (*it)->accepts(sender, arg, arg2, arg3, arg4))
+                        (*it)->emit(sender, arg, arg2, arg3, arg4); 
+                }
+            }
+        }
+        catch (StopPropagation&) {
+        }
+        catch (...) {
+            state->release();
+            throw;
+        }
+        state->release();
+    }
+
+    void clear() 
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+        if (current) {
+            for (auto it = current->begin(); it != current->end(); ++it)
+                _state->retire(*it);
+            _state->publish(nullptr);
+        }
+        _count = 0;
+    }
+
+    void enable(bool flag = true) 
+    {
+        _enabled.store(flag);
+    }
+
+    bool enabled() const
+    {
+        return _enabled.load();
+    }
+
+    DelegateList delegates() const 
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        DelegateList list;
+        const DelegateVector* current = _state->snapshot.load(std::memory_order_relaxed);
+        if (current)
+            list.insert(list.end(), current->begin(), current->end());
+        return list;
+    }
+    
+    int ndelegates() const 
+        // Returns the number of delegates connected to the signal.
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        return _count;
+    }
+        
+protected:
+    struct State
+        /// Delegate snapshots shared between the signal and 
+        /// any emits in progress.
+    {
+        std::atomic<const DelegateVector*> snapshot;
+        std::atomic<int> readers;
+        std::atomic<bool> retired;
+        std::vector<const DelegateVector*> retiredSnapshots;
+        std::vector<DelegateT*> retiredDelegates;
+        Mutex mutex;
+
+        State() : 
+            snapshot(nullptr), 
+            readers(0), 
+            retired(false)
+        {
+        }
+
+        ~State()
+        {
+            const DelegateVector* current = snapshot.load();
+            if (current) {
+                for (auto it = current->begin(); it != current->end(); ++it)
+                    delete *it;
+                delete current;
+            }
+            readers = 0;
+            reclaim();
+        }
+
+        void publish(const DelegateVector* next)
+            // Replaces the current snapshot.
+            // Must be called with the mutex held.
+        {
+            const DelegateVector* prev = snapshot.exchange(next, std::memory_order_seq_cst);
+            if (prev) {
+                retiredSnapshots.push_back(prev);
+                retired.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        void retire(DelegateT* delegate)
+            // Cancels the delegate and schedules it for deletion.
+            // Must be called with the mutex held.
+        {
+            delegate->cancel();
+            retiredDelegates.push_back(delegate);
+            retired.store(true, std::memory_order_relaxed);
+        }
+
+        void release()
+            // Unregisters an emitting reader. The last reader out 
+            // reclaims anything retired while it was emitting.
+        {
+            if (readers.fetch_sub(1, std::memory_order_seq_cst) == 1 && 
+                retired.load(std::memory_order_relaxed))
+                reclaim();
+        }
+
+        void reclaim()
+            // Deletes retired snapshots and delegates if no readers
+            // could still be referencing them.
+        {
+            Mutex::ScopedLock lock(mutex);
+            if (readers.load(std::memory_order_seq_cst) > 0)
+                return;
+            for (auto it = retiredSnapshots.begin(); it != retiredSnapshots.end(); ++it)
+                delete *it;
+            for (auto it = retiredDelegates.begin(); it != retiredDelegates.end(); ++it)
+                delete *it;
+            retiredSnapshots.clear();
+            retiredDelegates.clear();
+            retired.store(false, std::memory_order_relaxed);
+        }
+    };
+
+    std::shared_ptr<State> _state;
+    std::atomic<bool> _enabled;
+    int _count;
+};
+
+
+//
+// Signal Types
+//
+
+
+class NullSignal: public SignalBase<DelegateBase<>> {};
+
+
+template <typename P>
+class Signal: public SignalBase<DelegateBase<P>, P> {};
+
+
+template <typename P, typename P2>
+class Signal2: public SignalBase<DelegateBase<P, P2>, P, P2> {};
+
+
+template <typename P, typename P2, typename P3>
+class Signal3: public SignalBase<DelegateBase<P, P2, P3>, P, P2, P3> {};
+
+
+template <typename P, typename P2, typename P3, typename P4>
+class Signal4: public SignalBase<DelegateBase<P, P2, P3, P4>, P, P2, P3, P4> {};
+
+
+} // namespace scy
+
+
+#endif // SCY_Signal_H
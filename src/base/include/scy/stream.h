@@ -0,0 +1,534 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Net_Stream_H
+#define SCY_Net_Stream_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/memory.h"
+
+#include "scy/signal.h"
+#include "scy/buffer.h"
+#include "scy/bufferpool.h"
+#include "scy/mutex.h"
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+
+namespace scy {
+namespace net {
+
+
+typedef std::function<void(int /* status */)> WriteCallback;
+    // Called once the write request completes.
+    // The status argument is zero on success, or a 
+    // libuv error code such as UV_ECANCELED on failure.
+
+
+class WriteRequestPool;
+
+
+struct WriteRequest
+    /// WriteRequest wraps a libuv write request along with the
+    /// optional payload buffer owned by the request for the
+    /// lifetime of the write, and an optional completion callback.
+    ///
+    /// WriteRequests are recycled by the WriteRequestPool
+    /// and should not be created or deleted directly.
+{
+    enum { 
+        MaxCopySize = 1024,       // Gathered buffers up to this size are copied
+        MaxRetainedPayload = 4096 // Payload capacity kept when recycled
+    };
+
+    uv_write_t req;
+    std::size_t size;
+    Buffer payload;
+    WriteCallback callback;
+    WriteRequestPool* pool;
+};
+
+
+class WriteRequestPool
+    /// WriteRequestPool maintains a free list of WriteRequests for a
+    /// single event loop so that stream writes do not allocate a new
+    /// libuv request on every call.
+    ///
+    /// The pool also keeps track of the number of outstanding
+    /// requests and bytes queued for writing on the loop.
+    ///
+    /// With the exception of forLoop() all methods must be 
+    /// called from the event loop thread.
+{
+public:
+    WriteRequestPool(std::size_t maxFree = 1024);
+    ~WriteRequestPool();
+
+    static WriteRequestPool& forLoop(uv::Loop* loop);
+        // Returns the pool for the given event loop,
+        // creating it on first use.
+
+    static void destroy(uv::Loop* loop);
+        // Destroys the pool for the given event loop, if any.
+        // This must be called when a loop other than the default
+        // loop is closed, once all of its streams are destroyed,
+        // so the pool isn't leaked or handed to a new loop which
+        // reuses the address.
+
+    WriteRequest* acquire(std::size_t size);
+        // Returns a free WriteRequest, or allocates a new one
+        // if the free list is empty. The size argument is
+        // the number of bytes to be written with the request.
+
+    void release(WriteRequest* req);
+        // Returns the request to the free list once the write 
+        // completes. Payloads owned by the request are cleared, and
+        // freed if larger than WriteRequest::MaxRetainedPayload.
+        // Requests in excess of maxFree are deleted.
+
+    std::size_t outstanding() const;
+        // Returns the number of write requests in flight.
+
+    std::size_t outstandingBytes() const;
+        // Returns the number of bytes queued for writing.
+
+    std::size_t allocated() const;
+        // Returns the total number of requests allocated by the pool.
+
+    std::size_t available() const;
+        // Returns the number of requests on the free list.
+
+protected:
+    WriteRequestPool(const WriteRequestPool&); // = delete;
+    WriteRequestPool& operator=(const WriteRequestPool&); // = delete;
+
+    std::vector<WriteRequest*> _free;
+    std::size_t _maxFree;
+    std::size_t _outstanding;
+    std::size_t _outstandingBytes;
+    std::size_t _allocated;
+};
+
+
+class Stream: public uv::Handle
+{
+ public:  
+    Stream(uv::Loop* loop = uv::defaultLoop(), void* stream = nullptr) :
+        uv::Handle(loop, stream), 
+        _writePool(nullptr),
+        _recvBuffer(nullptr)
+    {
+    }
+    
+    void close()
+        // Closes and resets the stream handle.
+        // This will close the active socket/pipe
+        // and destroy the uv_stream_t handle.
+        //
+        // If the stream is already closed this call
+        // will have no side-effects.
+    {
+        TraceL << "Close: " << ptr() << std::endl;
+        if (active())
+            readStop();
+        uv::Handle::close();
+    }
+    
+    bool shutdown()
+        // Sends a shutdown packet to the connected peer.
+        // Returns true if the shutdown packet was sent.
+    {
+        assertTID();
+
+        TraceL << "Send shutdown" << std::endl;
+        if (!active()) {
+            WarnL << "Attempted shutdown on closed stream" << std::endl;
+            return false;
+        }
+
+        // XXX: Sending shutdown causes an eof error to be  
+        // returned via handleRead() which sets the stream 
+        // to error state. This is not really an error,
+        // perhaps it should be handled differently?
+        int r = uv_shutdown(new uv_shutdown_t, ptr<uv_stream_t>(), [](uv_shutdown_t* req, int) {
+            delete req;
+        });
+
+        return r == 0;
+    }
+
+    bool write(const char* data, std::size_t len)
+        // Writes data to the stream.
+        //
+        // The data buffer must remain valid until the write
+        // completes. Use one of the overloads below to receive
+        // a completion callback or to transfer buffer ownership.
+        //
+        // Returns false if the underlying socket is closed.
+        // This method does not throw an exception.
+    {        
+        return write(data, len, WriteCallback());
+    }
+
+    bool write(const char* data, std::size_t len, const WriteCallback& callback)
+        // Writes data to the stream and calls the given callback
+        // once the write completes. The data buffer must remain 
+        // valid until the callback is called.
+        //
+        // Note that the callback will be called with UV_ECANCELED 
+        // if the stream is closed with the write still pending.
+    {
+        assertTID();
+
+        if (!active())
+            return false;
+
+        auto wr = writePool().acquire(len);
+        wr->callback = callback;
+        uv_buf_t buf = uv_buf_init((char*)data, len);
+        return writeRequest(wr, &buf, 1);
+    }
+
+    bool write(Buffer&& data, const WriteCallback& callback = WriteCallback())
+        // Writes data to the stream, transferring ownership of 
+        // the data buffer to the write request. The buffer will 
+        // be freed once the write completes.
+    {
+        assertTID();
+
+        if (!active())
+            return false;
+
+        auto wr = writePool().acquire(data.size());
+        wr->payload.swap(data);
+        wr->callback = callback;
+        uv_buf_t buf = uv_buf_init(wr->payload.data(), wr->payload.size());
+        return writeRequest(wr, &buf, 1);
+    }
+
+    bool write(const ConstBuffer* bufs, std::size_t count, const WriteCallback& callback = WriteCallback())
+        // Writes the given buffers to the stream as a single 
+        // gathered write, so protocol headers can be sent along
+        // with the payload without copying the payload.
+        //
+        // Buffers of up to WriteRequest::MaxCopySize bytes are copied 
+        // into the write request, so short framing such as frame headers
+        // and chunk size lines may be built on the stack. Larger buffers
+        // are borrowed and must remain valid until the write completes.
+    {
+        assertTID();
+
+        if (!active())
+            return false;
+
+        std::size_t size = 0;
+        std::size_t copySize = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            size += bufs[i].size();
+            if (bufs[i].size() <= WriteRequest::MaxCopySize)
+                copySize += bufs[i].size();
+        }
+
+        auto wr = writePool().acquire(size);
+        wr->callback = callback;
+
+        // The payload is reserved up front so copied 
+        // buffers don't move while it is filled.
+        Buffer& payload = wr->payload;
+        payload.reserve(copySize);
+        
+        UVBufs ubufs(count);
+        for (std::size_t i = 0; i < count; i++) {
+            const char* data = bufferCast<const char*>(bufs[i]);
+            if (bufs[i].size() <= WriteRequest::MaxCopySize) {
+                std::size_t offset = payload.size();
+                payload.insert(payload.end(), data, data + bufs[i].size());
+                data = payload.data() + offset;
+            }
+            ubufs[i] = uv_buf_init((char*)data, bufs[i].size());
+        }
+        return writeRequest(wr, ubufs.data(), count);
+    }
+
+    bool write(Buffer&& payload, const ConstBuffer* bufs, std::size_t count, const WriteCallback& callback = WriteCallback())
+        // Writes the given buffers to the stream as a single gathered
+        // write, and transfers ownership of the payload buffer to the 
+        // write request. The buffers may point into the payload, which
+        // is freed once the write completes, or be borrowed as above.
+        // Buffers are not copied.
+    {
+        assertTID();
+
+        if (!active())
+            return false;
+
+        std::size_t size = 0;
+        UVBufs ubufs(count);
+        for (std::size_t i = 0; i < count; i++) {
+            ubufs[i] = uv_buf_init((char*)bufs[i].data(), bufs[i].size());
+            size += bufs[i].size();
+        }
+
+        auto wr = writePool().acquire(size);
+        wr->payload.swap(payload);
+        wr->callback = callback;
+        return writeRequest(wr, ubufs.data(), count);
+    }
+
+    WriteRequestPool& writePool()
+        // Returns the write request pool for the stream event loop.
+    {
+        if (!_writePool)
+            _writePool = &WriteRequestPool::forLoop(loop());
+        return *_writePool;
+    }
+    
+    std::size_t writeQueueSize()
+        // Returns the number of bytes queued for writing which 
+        // the kernel has not accepted yet. Streaming applications
+        // can use this to detect and drop data for slow peers.
+    {
+        if (!active())
+            return 0;
+        return ptr<uv_stream_t>()->write_queue_size;
+    }
+    
+    Buffer& buffer()
+        // Returns the read buffer.
+        // The buffer is allocated on first use so that idle 
+        // streams and streams which read into pooled buffers 
+        // do not reserve the memory.
+    { 
+        assertTID();
+        if (_buffer.empty())
+            _buffer.resize(65536);
+        return _buffer;
+    }
+
+    void setRecvBufferPool(const BufferPool::Ptr& pool)
+        // Sets the pool from which read buffers are allocated.
+        //
+        // When a pool is set each read is made into a reference 
+        // counted slab which can be retained past the read callback
+        // using recvBuffer(). When no pool is set all reads share the
+        // single stream buffer returned by buffer().
+    {
+        assertTID();
+        _recvPool = pool;
+    }
+
+    const BufferPool::Ptr& recvBufferPool() const
+        // Returns the read buffer pool, if any.
+    {
+        return _recvPool;
+    }
+
+    PooledBuffer* recvBuffer() const
+        // Returns the pooled buffer which holds the data of the 
+        // current read callback, or nullptr if no pool is set.
+        // The buffer is only valid during the callback: call 
+        // duplicate() on it to retain the data past the callback,
+        // and release() once done with it. Retained buffers are
+        // not reused for subsequent reads.
+    {
+        return _recvBuffer;
+    }
+
+    virtual bool closed() const
+        // Returns true if the native socket handle is closed.
+    {
+        return uv::Handle::closed();
+    }
+
+    Signal2<const char*, const int&> Read;
+        // Signals when data can be read from the stream.
+
+ protected:    
+    bool readStart()
+    {
+        //TraceL << "Read start: " << ptr() << std::endl;
+        int r = uv_read_start(this->ptr<uv_stream_t>(), Stream::allocReadBuffer, handleRead);
+        if (r) setUVError("Stream read error", r);    
+        return r == 0;
+    }
+
+    bool readStop()
+    {        
+        //TraceL << "Read stop: " << ptr() << std::endl;
+        int r = uv_read_stop(ptr<uv_stream_t>());
+        if (r) setUVError("Stream read error", r);
+        return r == 0;
+    }
+
+    virtual void onRead(const char* data, std::size_t len)
+    {
+        //TraceL << "On read: " << len << std::endl;
+        Read.emit(self(), data, len);
+    }
+
+    static void handleReadCommon(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf, uv_handle_type pending) 
+    {    
+        auto self = reinterpret_cast<Stream*>(handle->data);
+        //TraceL << "Handle read: " << nread << std::endl;
+
+        // The pooled buffer is referenced for the duration of the 
+        // callback, since the callback may destroy the stream. 
+        // Only the local reference may be used afterwards.
+        PooledBuffer* pooled = self->_recvBuffer;
+        if (pooled)
+            pooled->duplicate();
+        
+        if (nread >= 0) {
+            self->onRead(buf->base, nread);
+        }
+        else {
+            // The stream was closed in error
+            // The value of nread is the error number 
+            // ie. UV_ECONNRESET or UV_EOF etc ...
+            self->setUVError("Stream error", nread);
+        }
+
+        if (pooled)
+            pooled->release();
+    }
+
+    struct UVBufs
+        /// Holds the uv_buf_t array for a gathered write. libuv copies
+        /// the array into the request, so it only needs to be valid 
+        /// for the duration of the write call.
+    {
+        uv_buf_t local[16];
+        std::vector<uv_buf_t> extra;
+        uv_buf_t* bufs;
+
+        UVBufs(std::size_t count) : bufs(local)
+        {
+            if (count > 16) {
+                extra.resize(count);
+                bufs = &extra[0];
+            }
+        }
+
+        uv_buf_t& operator [] (std::size_t i) { return bufs[i]; }
+        uv_buf_t* data() { return bufs; }
+    };
+
+    bool writeRequest(WriteRequest* wr, const uv_buf_t* bufs, std::size_t count)
+        // Queues the given write request on the stream.
+        // The request is returned to the pool on failure.
+    {
+        int r;
+        uv_stream_t* stream = this->ptr<uv_stream_t>();
+        bool isIPC = stream->type == UV_NAMED_PIPE && 
+            reinterpret_cast<uv_pipe_t*>(stream)->ipc;
+
+        if (!isIPC)
+            r = uv_write(&wr->req, stream, bufs, count, Stream::afterWrite);
+        else
+            r = uv_write2(&wr->req, stream, bufs, count, nullptr, Stream::afterWrite);
+
+        if (r) {
+            // The callback is not called for requests which 
+            // were never queued.
+            wr->callback = nullptr;
+            wr->pool->release(wr);
+            //setAndThrowError(r, "Stream write error");
+        }
+        return r == 0;
+    }
+
+    virtual ~Stream() 
+    {    
+        if (_recvBuffer)
+            _recvBuffer->release();
+    }
+    
+    virtual void* self() 
+    { 
+        return this;
+    }    
+
+    
+    //
+    // UV callbacks
+    //
+    
+    static void afterWrite(uv_write_t* req, int status)
+    {
+        // Note: The Stream instance may already be destroyed
+        // here so only the request may be accessed.
+        auto wr = reinterpret_cast<WriteRequest*>(req->data);
+        if (wr->callback)
+            wr->callback(status);
+        wr->pool->release(wr);
+    }
+    
+    static void handleRead(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) 
+    {
+        handleReadCommon(handle, nread, buf, UV_UNKNOWN_HANDLE);
+    }
+    
+    static void handleRead2(uv_pipe_t* handle, ssize_t nread, const uv_buf_t* buf, uv_handle_type pending) 
+    {
+        handleReadCommon((uv_stream_t*)handle, nread, buf, pending);
+    }
+    
+    static void allocReadBuffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t* buf)
+    {
+        auto self = reinterpret_cast<Stream*>(handle->data);
+
+        // Read into a pooled buffer if a pool is set. The stream holds
+        // a reference to the current buffer, which is reused for the
+        // next read unless the application retained it.
+        if (self->_recvPool) {
+            if (self->_recvBuffer && self->_recvBuffer->refCount() > 1) {
+                self->_recvBuffer->release();
+                self->_recvBuffer = nullptr;
+            }
+            if (!self->_recvBuffer)
+                self->_recvBuffer = self->_recvPool->get();
+            buf->base = self->_recvBuffer->data();
+            buf->len = self->_recvBuffer->capacity();
+            return;
+        }
+
+        // Reserve the recommended buffer size
+        //if (suggested_size > self->_buffer.capacity())
+        //    self->_buffer.capacity(suggested_size); 
+        Buffer& buffer = self->buffer();
+        assert(buffer.size() >= suggested_size);
+
+        // Reset the buffer position on each read
+        buf->base = buffer.data();
+        buf->len = buffer.size();
+    }
+
+    Buffer _buffer;
+    WriteRequestPool* _writePool;
+    BufferPool::Ptr _recvPool;
+    PooledBuffer* _recvBuffer;
+};
+
+
+} } // namespace scy::net
+
+
+#endif // SCY_Net_Stream_H
\ No newline at end of file
@@ -0,0 +1,544 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+// This file uses the public domain libb64 library: http://libb64.sourceforge.net/
+//
+
+
+#include "scy/base64.h"
+#include <algorithm>
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define SCY_BASE64_X86 1
+#include <immintrin.h>
+#endif
+
+
+namespace scy {
+namespace base64 {
+namespace internal {
+
+
+namespace {
+
+
+const char encoding[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+const signed char decoding[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 62, -1, -1, -1, 63,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, -1, -1, -1, -2, -1, -1,
+    -1,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, -1, -1, -1, -1, -1,
+    -1, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
+
+
+//
+// Bulk kernels
+//
+// Whole 3 byte groups and 4 character quads are converted in bulk when
+// the streaming state is on a group boundary, which is almost always the
+// case. The libb64 state machine below handles the remainder, padding 
+// and any characters the bulk decoder rejects (line breaks, padding or
+// invalid input), so the output is identical to the scalar codec.
+//
+
+
+void encodeGroupsScalar(const UInt8* in, std::size_t groups, std::size_t /* available */, char* out)
+{
+    for (; groups > 0; --groups, in += 3, out += 4) {
+        UInt32 v = (UInt32(in[0]) << 16) | (UInt32(in[1]) << 8) | in[2];
+        out[0] = encoding[v >> 18];
+        out[1] = encoding[(v >> 12) & 0x3f];
+        out[2] = encoding[(v >> 6) & 0x3f];
+        out[3] = encoding[v & 0x3f];
+    }
+}
+
+
+std::size_t decodeQuadsScalar(const char* in, std::size_t length, char* out)
+{
+    // Stops at the first quad containing a character which
+    // is not in the base64 alphabet.
+    const char* begin = in;
+    for (; length >= 4; length -= 4, in += 4, out += 3) {
+        int a = decoding[UInt8(in[0])];
+        int b = decoding[UInt8(in[1])];
+        int c = decoding[UInt8(in[2])];
+        int d = decoding[UInt8(in[3])];
+        if ((a | b | c | d) < 0)
+            break;
+        UInt32 v = (UInt32(a) << 18) | (UInt32(b) << 12) | (UInt32(c) << 6) | UInt32(d);
+        out[0] = char(v >> 16);
+        out[1] = char(v >> 8);
+        out[2] = char(v);
+    }
+    return in - begin;
+}
+
+
+#if SCY_BASE64_X86
+
+
+// The SIMD kernels use the pshufb based lookup and validation
+// described by Wojciech Mula and Daniel Lemire (arXiv:1704.00605).
+
+
+__attribute__((target("ssse3")))
+void encodeGroupsSSSE3(const UInt8* in, std::size_t groups, std::size_t available, char* out)
+{
+    // Each iteration reads 16 bytes and encodes the first 12.
+    const __m128i split = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shift = _mm_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    for (; groups >= 4 && available >= 16; groups -= 4, available -= 12, in += 12, out += 16) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), split);
+        const __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        const __m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        const __m128i indices = _mm_or_si128(t0, t1);
+        __m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+        result = _mm_add_epi8(_mm_shuffle_epi8(shift, result), indices);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+    }
+    encodeGroupsScalar(in, groups, available, out);
+}
+
+
+__attribute__((target("ssse3")))
+std::size_t decodeQuadsSSSE3(const char* in, std::size_t length, char* out)
+{
+    // Each iteration validates 16 characters and writes 12 bytes.
+    const char* begin = in;
+    const __m128i lutLo = _mm_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m128i lutHi = _mm_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lutRoll = _mm_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    for (; length >= 16; length -= 16, in += 16, out += 12) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        const __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi8(0x0f));
+        const __m128i loNibbles = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+        const __m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+        const __m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xffff)
+            break;
+        const __m128i eq2F = _mm_cmpeq_epi8(v, _mm_set1_epi8(0x2f));
+        v = _mm_add_epi8(v, _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles)));
+        v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+        v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+        v = _mm_shuffle_epi8(v, pack);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), v);
+        UInt32 tail = UInt32(_mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+        memcpy(out + 8, &tail, 4);
+    }
+    return (in - begin) + decodeQuadsScalar(in, length, out);
+}
+
+
+__attribute__((target("avx2")))
+void encodeGroupsAVX2(const UInt8* in, std::size_t groups, std::size_t available, char* out)
+{
+    // Each iteration reads 16 bytes at offsets 0 and 12
+    // and encodes 24 bytes, 12 bytes per 128 bit lane.
+    // The AVX2 kernels finish with the scalar kernels, since
+    // falling through to the non-VEX SSSE3 code with dirty
+    // upper registers stalls on every line break.
+    const __m256i split = _mm256_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shift = _mm256_setr_epi8(
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+        'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+        '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    for (; groups >= 8 && available >= 28; groups -= 8, available -= 24, in += 24, out += 32) {
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 12)), 1);
+        v = _mm256_shuffle_epi8(v, split);
+        const __m256i t0 = _mm256_mulhi_epu16(_mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        const __m256i t1 = _mm256_mullo_epi16(_mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t0, t1);
+        __m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        result = _mm256_add_epi8(_mm256_shuffle_epi8(shift, result), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+    }
+    encodeGroupsScalar(in, groups, available, out);
+}
+
+
+__attribute__((target("avx2")))
+std::size_t decodeQuadsAVX2(const char* in, std::size_t length, char* out)
+{
+    // Each iteration validates 32 characters and writes 24 bytes.
+    const char* begin = in;
+    const __m256i lutLo = _mm256_setr_epi8(
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a,
+        0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+    const __m256i lutHi = _mm256_setr_epi8(
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+        0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lutRoll = _mm256_setr_epi8(
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack = _mm256_setr_epi8(
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+        2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    for (; length >= 32; length -= 32, in += 32, out += 24) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        const __m256i hiNibbles = _mm256_and_si256(_mm256_srli_epi32(v, 4), _mm256_set1_epi8(0x0f));
+        const __m256i loNibbles = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+        const __m256i lo = _mm256_shuffle_epi8(lutLo, loNibbles);
+        const __m256i hi = _mm256_shuffle_epi8(lutHi, hiNibbles);
+        if (!_mm256_testz_si256(lo, hi))
+            break;
+        const __m256i eq2F = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(0x2f));
+        v = _mm256_add_epi8(v, _mm256_shuffle_epi8(lutRoll, _mm256_add_epi8(eq2F, hiNibbles)));
+        v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+        v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+        v = _mm256_shuffle_epi8(v, pack);
+        const __m128i lane0 = _mm256_castsi256_si128(v);
+        const __m128i lane1 = _mm256_extracti128_si256(v, 1);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), lane0);
+        UInt32 tail = UInt32(_mm_cvtsi128_si32(_mm_srli_si128(lane0, 8)));
+        memcpy(out + 8, &tail, 4);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 12), lane1);
+        tail = UInt32(_mm_cvtsi128_si32(_mm_srli_si128(lane1, 8)));
+        memcpy(out + 20, &tail, 4);
+    }
+    return (in - begin) + decodeQuadsScalar(in, length, out);
+}
+
+
+#endif // SCY_BASE64_X86
+
+
+typedef void (*EncodeGroupsFn)(const UInt8*, std::size_t, std::size_t, char*);
+typedef std::size_t (*DecodeQuadsFn)(const char*, std::size_t, char*);
+
+
+struct Kernels 
+    // Selects the widest kernels supported by the CPU.
+{
+    EncodeGroupsFn encode;
+    DecodeQuadsFn decode;
+    const char* name;
+
+    Kernels() : encode(encodeGroupsScalar), decode(decodeQuadsScalar), name("scalar")
+    {
+        if (!select("avx2"))
+            select("ssse3");
+    }
+
+    bool select(const char* which)
+    {
+        if (strcmp(which, "scalar") == 0) {
+            encode = encodeGroupsScalar;
+            decode = decodeQuadsScalar;
+            name = "scalar";
+            return true;
+        }
+#if SCY_BASE64_X86
+        __builtin_cpu_init();
+        if (strcmp(which, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+            encode = encodeGroupsAVX2;
+            decode = decodeQuadsAVX2;
+            name = "avx2";
+            return true;
+        }
+        if (strcmp(which, "ssse3") == 0 && __builtin_cpu_supports("ssse3")) {
+            encode = encodeGroupsSSSE3;
+            decode = decodeQuadsSSSE3;
+            name = "ssse3";
+            return true;
+        }
+#endif
+        return false;
+    }
+};
+
+
+Kernels kernels;
+
+
+void encodeBulk(const char*& in, const char* end, char*& out, encodestate* state)
+{
+    // Encodes all whole groups of input, inserting 
+    // line feeds every linelength characters.
+    std::size_t groups = (end - in) / 3;
+    int groupsPerLine = state->linelength / 4;
+    if (groupsPerLine <= 0) {
+        kernels.encode(reinterpret_cast<const UInt8*>(in), groups, end - in, out);
+        in += groups * 3;
+        out += groups * 4;
+        return;
+    }
+
+    if (state->stepcount >= groupsPerLine)
+        state->stepcount = 0;
+    while (groups > 0) {
+        std::size_t n = std::min<std::size_t>(groups, groupsPerLine - state->stepcount);
+        kernels.encode(reinterpret_cast<const UInt8*>(in), n, end - in, out);
+        in += n * 3;
+        out += n * 4;
+        groups -= n;
+        state->stepcount += static_cast<int>(n);
+        if (state->stepcount == groupsPerLine) {
+            *out++ = '\n';
+            state->stepcount = 0;
+        }
+    }
+}
+
+
+} // anonymous namespace
+
+
+const char* kernelName()
+{
+    return kernels.name;
+}
+
+
+bool selectKernel(const char* name)
+{
+    return kernels.select(name);
+}
+
+    
+//
+// Encoder
+//
+
+
+void init_encodestate(encodestate* state_in)
+{
+    state_in->step = step_A;
+    state_in->result = 0;
+    state_in->stepcount = 0;
+    state_in->linelength = LINE_LENGTH; // added: set 0 for no line feeds
+    state_in->nullptrlterminate = 0;  // added: set 1 for nullptrl terminated output string
+}
+
+
+char encode_value(char value_in)
+{
+    if (value_in > 63) return '=';
+    return encoding[(int)value_in];
+}
+
+
+int encode_block(const char* plaintext_in, int length_in, char* code_out, encodestate* state_in)
+{
+    const char* plainchar = plaintext_in;
+    const char* const plaintextend = plaintext_in + length_in;
+    char* codechar = code_out;
+    char result;
+    char fragment;
+
+    result = state_in->result;
+
+    switch (state_in->step)
+    {
+        while (1)
+        {
+    case step_A:
+        if (plaintextend - plainchar >= 3)
+            encodeBulk(plainchar, plaintextend, codechar, state_in);
+        if (plainchar == plaintextend)
+        {
+            state_in->result = result;
+            state_in->step = step_A;
+            return codechar - code_out;
+        }
+        fragment = *plainchar++;
+        result = (fragment & 0x0fc) >> 2;
+        *codechar++ = encode_value(result);
+        result = (fragment & 0x003) << 4;
+    case step_B:
+        if (plainchar == plaintextend)
+        {
+            state_in->result = result;
+            state_in->step = step_B;
+            return codechar - code_out;
+        }
+        fragment = *plainchar++;
+        result |= (fragment & 0x0f0) >> 4;
+        *codechar++ = encode_value(result);
+        result = (fragment & 0x00f) << 2;
+    case step_C:
+        if (plainchar == plaintextend)
+        {
+            state_in->result = result;
+            state_in->step = step_C;
+            return codechar - code_out;
+        }
+        fragment = *plainchar++;
+        result |= (fragment & 0x0c0) >> 6;
+        *codechar++ = encode_value(result);
+        result  = (fragment & 0x03f) >> 0;
+        *codechar++ = encode_value(result);
+
+        if (state_in->linelength) { // added
+            ++(state_in->stepcount);
+            if (state_in->stepcount == state_in->linelength/4)
+            {
+                *codechar++ = '\n';
+                state_in->stepcount = 0;
+            }
+        }
+        }
+    }
+    /* control should not reach here */
+    return codechar - code_out;
+}
+
+
+int encode_blockend(char* code_out, encodestate* state_in)
+{
+    char* codechar = code_out;
+
+    switch (state_in->step)
+    {
+    case step_B:
+        *codechar++ = encode_value(state_in->result);
+        *codechar++ = '=';
+        *codechar++ = '=';
+        break;
+    case step_C:
+        *codechar++ = encode_value(state_in->result);
+        *codechar++ = '=';
+        break;
+    case step_A:
+        break;
+    }
+    if (state_in->nullptrlterminate)
+        *codechar++ = '\n';
+
+    return codechar - code_out;
+}
+
+
+//
+// Decoder
+//
+
+
+int decode_value(char value_in)
+{
+    return decoding[UInt8(value_in)];
+}
+
+
+void init_decodestate(decodestate* state_in)
+{
+    state_in->step = step_a;
+    state_in->plainchar = 0;
+}
+
+
+int decode_block(const char* code_in, const int length_in, char* plaintext_out, decodestate* state_in)
+{
+    const char* codechar = code_in;
+    char* plainchar = plaintext_out;
+    char fragment;
+
+    *plainchar = state_in->plainchar;
+
+    switch (state_in->step)
+    {
+        while (1)
+        {
+    case step_a:
+        if (code_in + length_in - codechar >= 4) {
+            std::size_t n = kernels.decode(codechar, code_in + length_in - codechar, plainchar);
+            codechar += n;
+            plainchar += n / 4 * 3;
+        }
+        do {
+            if (codechar == code_in+length_in)
+            {
+                state_in->step = step_a;
+                state_in->plainchar = *plainchar;
+                return plainchar - plaintext_out;
+            }
+            fragment = (char)decode_value(*codechar++);
+        } while (fragment < 0);
+        *plainchar    = (fragment & 0x03f) << 2;
+    case step_b:
+        do {
+            if (codechar == code_in+length_in)
+            {
+                state_in->step = step_b;
+                state_in->plainchar = *plainchar;
+                return plainchar - plaintext_out;
+            }
+            fragment = (char)decode_value(*codechar++);
+        } while (fragment < 0);
+        *plainchar++ |= (fragment & 0x030) >> 4;
+        *plainchar    = (fragment & 0x00f) << 4;
+    case step_c:
+        do {
+            if (codechar == code_in+length_in)
+            {
+                state_in->step = step_c;
+                state_in->plainchar = *plainchar;
+                return plainchar - plaintext_out;
+            }
+            fragment = (char)decode_value(*codechar++);
+        } while (fragment < 0);
+        *plainchar++ |= (fragment & 0x03c) >> 2;
+        *plainchar    = (fragment & 0x003) << 6;
+    case step_d:
+        do {
+            if (codechar == code_in+length_in)
+            {
+                state_in->step = step_d;
+                state_in->plainchar = *plainchar;
+                return plainchar - plaintext_out;
+            }
+            fragment = (char)decode_value(*codechar++);
+        } while (fragment < 0);
+        *plainchar++   |= (fragment & 0x03f);
+        }
+    }
+    /* control should not reach here */
+    return plainchar - plaintext_out;
+}
+
+
+} } } // namespace scy::base64::internal
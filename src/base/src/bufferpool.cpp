@@ -0,0 +1,157 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "scy/bufferpool.h"
+
+
+namespace scy {
+
+
+namespace internal {
+
+    struct BufferPoolState
+        /// The shared BufferPool state which is kept alive
+        /// by outstanding slabs once the pool is destroyed.
+    {
+        Mutex mutex;
+        std::vector<PooledBuffer*> free;
+        std::size_t bufferSize;
+        std::size_t maxFree;
+        std::size_t allocated;
+        bool closed;
+
+        BufferPoolState(std::size_t bufferSize, std::size_t maxFree) :
+            bufferSize(bufferSize), maxFree(maxFree), allocated(0), closed(false)
+        {
+        }
+
+        void recycle(PooledBuffer* buf)
+        {
+            {
+                Mutex::ScopedLock lock(mutex);
+                if (!closed && free.size() < maxFree) {
+                    // Free slabs don't reference the pool state 
+                    // so that it can be freed with the pool.
+                    buf->_pool.reset();
+                    free.push_back(buf);
+                    return;
+                }
+                allocated--;
+            }
+            delete buf;
+        }
+    };
+
+}
+
+
+//
+// Buffer Pool
+//
+
+
+BufferPool::BufferPool(std::size_t bufferSize, std::size_t maxFree) :
+    _state(std::make_shared<internal::BufferPoolState>(bufferSize, maxFree))
+{
+}
+
+
+BufferPool::~BufferPool()
+{
+    std::vector<PooledBuffer*> free;
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        _state->closed = true;
+        _state->allocated -= _state->free.size();
+        free.swap(_state->free);
+    }
+    for (auto it = free.begin(); it != free.end(); ++it)
+        delete *it;
+}
+
+
+PooledBuffer* BufferPool::get()
+{
+    PooledBuffer* buf = nullptr;
+    {
+        Mutex::ScopedLock lock(_state->mutex);
+        if (!_state->free.empty()) {
+            buf = _state->free.back();
+            _state->free.pop_back();
+        }
+        else
+            _state->allocated++;
+    }
+    if (!buf)
+        buf = new PooledBuffer(_state->bufferSize);
+    buf->count = 1;
+    buf->_pool = _state;
+    return buf;
+}
+
+
+std::size_t BufferPool::bufferSize() const
+{
+    return _state->bufferSize;
+}
+
+
+std::size_t BufferPool::available() const
+{
+    Mutex::ScopedLock lock(_state->mutex);
+    return _state->free.size();
+}
+
+
+std::size_t BufferPool::allocated() const
+{
+    Mutex::ScopedLock lock(_state->mutex);
+    return _state->allocated;
+}
+
+
+//
+// Pooled Buffer
+//
+
+
+PooledBuffer::PooledBuffer(std::size_t size) :
+    _data(size)
+{
+}
+
+
+PooledBuffer::~PooledBuffer()
+{
+}
+
+
+void PooledBuffer::freeMemory()
+{
+    // Hold a reference to the pool state while recycling
+    auto pool(_pool);
+    if (pool)
+        pool->recycle(this);
+    else
+        delete this;
+}
+
+
+} // namespace scy
@@ -0,0 +1,1083 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/logger.h"
+#include "scy/time.h"
+#include "scy/datetime.h"
+#include "scy/platform.h"
+#include "scy/filesystem.h"
+#include "scy/util.h"
+#include "scy/queue.h"
+#include <assert.h>
+#include <cstring>
+#include <algorithm>
+#include <thread>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+static Singleton<Logger> singleton;
+
+
+std::atomic<int> Logger::_threshold(LTrace);
+
+
+Logger::Logger() :
+    _defaultChannel(nullptr),
+    _writer(new LogWriter)
+{
+}
+
+
+Logger::~Logger()
+{
+    _writer.reset();
+    util::clearMap(_channels);
+    _defaultChannel = nullptr;
+}
+
+
+Logger& Logger::instance()
+{
+    return *singleton.get();
+}
+
+
+void Logger::setInstance(Logger* logger, bool freeExisting)
+{
+    auto current = singleton.swap(logger);
+    if (logger)
+        logger->updateThreshold();
+    if (current && freeExisting)
+        delete current;
+}
+
+
+void Logger::destroy()
+{
+    // Gate off the logging macros first, since the channels 
+    // and writer may log while they are being destroyed.
+    _threshold.store(LFatal + 1, std::memory_order_relaxed);
+    singleton.destroy();
+}
+
+
+void Logger::add(LogChannel* channel)
+{
+    {
+        Mutex::ScopedLock lock(_mutex);
+        // The first channel added will be the default channel.
+        if (_defaultChannel == nullptr)
+            _defaultChannel = channel;
+        _channels[channel->name()] = channel;
+    }
+    updateThreshold();
+}
+
+
+void Logger::remove(const std::string& name, bool freePointer)
+{
+    {
+        Mutex::ScopedLock lock(_mutex);
+        LogChannelMap::iterator it = _channels.find(name);
+        assert(it != _channels.end());
+        if (it != _channels.end()) {
+            if (_defaultChannel == it->second)
+                _defaultChannel = nullptr;
+            if (freePointer)
+                delete it->second;
+            _channels.erase(it);
+        }
+    }
+    updateThreshold();
+}
+
+
+LogChannel* Logger::get(const std::string& name, bool whiny) const
+{
+    Mutex::ScopedLock lock(_mutex);
+    LogChannelMap::const_iterator it = _channels.find(name);
+    if (it != _channels.end())
+        return it->second;
+    if (whiny)
+        throw std::runtime_error("Not found: No log channel named: " + name);
+    return nullptr;
+}
+
+
+void Logger::setDefault(const std::string& name)
+{
+    Mutex::ScopedLock lock(_mutex);
+    _defaultChannel = get(name, true);
+}
+
+
+LogChannel* Logger::getDefault() const
+{
+    Mutex::ScopedLock lock(_mutex);
+    return _defaultChannel;
+}
+
+
+void Logger::setWriter(LogWriter* writer)
+{
+    std::shared_ptr<LogWriter> previous(writer);
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _writer.swap(previous);
+    }
+
+    // Release outside the lock since an asynchronous
+    // writer may log while shutting down. Threads which
+    // are still writing hold their own reference.
+    previous.reset();
+}
+
+
+void Logger::write(const LogStream& stream)
+{
+    // avoid if possible, requires extra copy
+    write(new LogStream(stream));
+}
+
+
+void Logger::write(LogStream* stream)
+{
+    std::shared_ptr<LogWriter> writer;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        if (stream->channel == nullptr)
+            stream->channel = _defaultChannel;
+        writer = _writer;
+    }
+
+    // Drop messages if there is no output channel, or if the
+    // channel would filter them anyway, before any formatting.
+    if (stream->channel == nullptr ||
+        stream->channel->level() > stream->level) {
+        LogStream::release(stream);
+        return;
+    }
+    writer->write(stream);
+}
+
+
+void Logger::updateThreshold()
+{
+    // Only the default logger drives the logging macros
+    if (this != singleton.peek())
+        return;
+
+    int threshold = LFatal + 1;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        for (auto& kv : _channels)
+            threshold = std::min<int>(threshold, kv.second->level());
+    }
+    _threshold.store(threshold, std::memory_order_relaxed);
+}
+
+
+LogStream& Logger::send(const char* level, const char* realm, const void* ptr, const char* channel) const
+{
+    return *new LogStream(getLogLevelFromString(level), realm, 0, ptr, channel);
+}
+
+
+//
+// Log Writer
+//
+
+
+LogWriter::LogWriter()
+{
+}
+
+
+LogWriter::~LogWriter()
+{
+}
+
+
+void LogWriter::write(LogStream* stream)
+{
+    // TODO: Make safer; if the app exists and async stuff
+    // is still logging we can end up with a crash here.
+    {
+        Mutex::ScopedLock lock(_mutex);
+        stream->channel->write(*stream);
+    }
+    LogStream::release(stream);
+}
+
+
+//
+// Asynchronous Log Writer
+//
+
+
+namespace internal {
+
+
+class LogStreamBuf: public std::streambuf
+    // Stream buffer which formats directly into a fixed region
+    // of a log buffer, and records whether the region overflowed.
+{
+public:
+    LogStreamBuf() : _full(false)
+    {
+    }
+
+    void reset(char* data, std::size_t size)
+    {
+        setp(data, data + size);
+        _full = false;
+    }
+
+    std::size_t size() const { return pptr() - pbase(); }
+    bool full() const { return _full; }
+
+protected:
+    virtual int_type overflow(int_type c)
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            _full = true;
+        return traits_type::eof();
+    }
+
+    bool _full;
+};
+
+
+struct LogBuffer
+    // Ring of formatted records written by a single logging
+    // thread and released in order by the writer thread.
+    //
+    // Records never wrap around the end of the ring; any space
+    // skipped at the end is accounted to the record's span.
+{
+    LogBuffer(std::size_t capacity) :
+        data(capacity),
+        head(0),
+        tail(0),
+        stream(&streambuf)
+    {
+    }
+
+    bool format(const LogStream& message, char*& record, std::size_t& size, std::size_t& span)
+        // Formats the message directly into the free space of the ring.
+        // Records are capped at half the ring so they always fit,
+        // including any space skipped at the end, once it drains.
+        // Returns false if the writer has not yet released enough.
+    {
+        std::size_t maxSize = data.size() / 2;
+        std::size_t offset = tail % data.size();
+        std::size_t free = data.size() - (tail - head.load(std::memory_order_acquire));
+        for (std::size_t skip = 0;; skip = data.size() - offset) {
+            std::size_t start = skip ? 0 : offset;
+            std::size_t room = data.size() - start;
+            std::size_t limit = std::min(std::min(maxSize, room), free > skip ? free - skip : 0);
+            streambuf.reset(&data[start], limit);
+            stream.clear();
+            message.channel->format(message, stream);
+
+            // Longer messages are truncated
+            if (!streambuf.full() || limit == maxSize) {
+                record = &data[start];
+                size = streambuf.size();
+                span = skip + size;
+                tail += span;
+                return true;
+            }
+            
+            // Retry from the start of the ring if the message didn't
+            // fit before the end, otherwise wait for the writer.
+            if (limit < room || skip)
+                return false;
+        }
+    }
+
+    void release(std::size_t span)
+        // Called by the writer once a record has been written.
+    {
+        head.store(head.load(std::memory_order_relaxed) + span, 
+            std::memory_order_release);
+    }
+
+    std::vector<char> data;
+    std::atomic<std::size_t> head;  // writer thread
+    std::size_t tail;               // logging thread
+    LogStreamBuf streambuf;
+    std::ostream stream;
+};
+
+
+struct LogEntry
+{
+    LogRecord record;
+    LogBuffer* buffer;
+    std::size_t span;
+};
+
+
+struct LogQueue
+{
+    LogQueue(std::size_t bufferSize, std::size_t queueSize) :
+        entries(queueSize),
+        bufferSize(bufferSize)
+    {
+        uv_key_create(&key);
+    }
+
+    ~LogQueue()
+    {
+        util::clearVector(buffers);
+        uv_key_delete(&key);
+    }
+
+    MPSCRing<LogEntry> entries;
+    std::vector<LogBuffer*> buffers; // all buffers, owned by the queue
+    std::vector<LogBuffer*> spare;   // buffers of threads which have exited
+    std::size_t bufferSize;
+    uv_key_t key;
+    Mutex mutex;
+};
+
+
+struct ThreadLogBuffers
+    // Hands the buffers of an exiting thread back to their 
+    // queues, so short lived threads don't each leave a
+    // buffer behind for the lifetime of the writer.
+{
+    ~ThreadLogBuffers()
+    {
+        exited = true;
+        for (auto& kv : buffers) {
+            auto queue = kv.first.lock();
+            if (!queue)
+                continue;
+
+            // The thread is gone so no further records will be
+            // reserved, and those still queued keep their place
+            // in the ring for the next thread to append after.
+            uv_key_set(&queue->key, nullptr);
+            Mutex::ScopedLock lock(queue->mutex);
+            queue->spare.push_back(kv.second);
+        }
+    }
+
+    void add(const std::shared_ptr<LogQueue>& queue, LogBuffer* buffer)
+    {
+        buffers.erase(std::remove_if(buffers.begin(), buffers.end(), 
+            [](const Entry& kv) { return kv.first.expired(); }), buffers.end());
+        buffers.push_back(Entry(queue, buffer));
+    }
+
+    typedef std::pair<std::weak_ptr<LogQueue>, LogBuffer*> Entry;
+    std::vector<Entry> buffers;
+    static thread_local bool exited;
+};
+
+
+thread_local bool ThreadLogBuffers::exited = false;
+static thread_local ThreadLogBuffers threadLogBuffers;
+
+
+} // namespace internal
+
+
+AsyncLogWriter::AsyncLogWriter(std::size_t bufferSize, std::size_t queueSize) :
+    _queue(std::make_shared<internal::LogQueue>(bufferSize, queueSize)),
+    _waiting(false),
+    _queued(0),
+    _written(0),
+    _discard(0)
+{
+    _thread.start(*this);
+}
+
+
+AsyncLogWriter::~AsyncLogWriter()
+{
+    // Cancel and wait for the thread
+    cancel();
+
+    // Note: Not using join here as it is causing a deadlock
+    // when unloading shared libraries when the logger is not
+    // explicitly shutdown().
+    //while (_thread.running())
+    //    scy::sleep(10);
+    _thread.join();
+
+    // Flush remaining items synchronously
+    flush();
+
+    // Exiting logging threads may briefly hold the queue
+    assert(_queue->entries.empty());
+    _queue.reset();
+}
+
+
+internal::LogBuffer* AsyncLogWriter::buffer()
+{
+    auto buffer = static_cast<internal::LogBuffer*>(uv_key_get(&_queue->key));
+    if (!buffer) {
+        {
+            Mutex::ScopedLock lock(_queue->mutex);
+            if (!_queue->spare.empty()) {
+                buffer = _queue->spare.back();
+                _queue->spare.pop_back();
+            }
+            else {
+                buffer = new internal::LogBuffer(_queue->bufferSize);
+                _queue->buffers.push_back(buffer);
+            }
+        }
+        uv_key_set(&_queue->key, buffer);
+
+        // Messages logged during thread exit keep their buffer 
+        // until the writer is destroyed
+        if (!internal::ThreadLogBuffers::exited)
+            internal::threadLogBuffers.add(_queue, buffer);
+    }
+    return buffer;
+}
+
+
+void AsyncLogWriter::write(LogStream* stream)
+{
+    internal::LogBuffer* buffer = this->buffer();
+    internal::LogEntry entry;
+    entry.record.data = nullptr;
+    entry.record.size = 0;
+    entry.record.level = stream->level;
+    entry.record.ts = stream->ts;
+    entry.record.channel = stream->channel;
+    entry.record.stream = nullptr;
+    entry.buffer = buffer;
+    entry.span = 0;
+
+    // Format on the logging thread straight into the ring, and free
+    // the stream here rather than on the writer thread. Only channels
+    // which write each message themselves are passed the stream.
+    if (stream->channel->writesRecords()) {
+        char* data;
+        while (!buffer->format(*stream, data, entry.record.size, entry.span)) {
+            _ready.signal();
+            std::this_thread::yield();
+        }
+        entry.record.data = data;
+        LogStream::release(stream);
+    }
+    else entry.record.stream = stream;
+    
+    _queued.fetch_add(1, std::memory_order_relaxed);
+    while (!_queue->entries.push(entry)) {
+        _ready.signal();
+        std::this_thread::yield();
+    }
+
+    // Pairs with the fence in run() so either the writer 
+    // sees the new entry or we see it waiting. Only the first
+    // thread to see it waiting signals, so a burst of messages
+    // costs a single wakeup.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_waiting.load(std::memory_order_relaxed) && 
+        _waiting.exchange(false)) {
+        Mutex::ScopedLock lock(_mutex);
+        _ready.signal();
+    }
+}
+
+
+void AsyncLogWriter::clear()
+{
+    _discard.store(_queued.load(), std::memory_order_relaxed);
+    flush();
+}
+
+
+void AsyncLogWriter::flush()
+{
+    UInt64 target = _queued.load();
+    if (!cancelled()) {
+        Mutex::ScopedLock lock(_mutex);
+        while (_written.load() < target && !cancelled()) {
+            _ready.signal();
+            _flushed.tryWait(_mutex, 10);
+        }
+        return;
+    }
+
+    // The writer thread has been cancelled and joined,
+    // so we are the only consumer
+    while (writeNext());
+}
+
+
+void AsyncLogWriter::cancel(bool flag)
+{
+    async::Runnable::cancel(flag);
+
+    Mutex::ScopedLock lock(_mutex);
+    _ready.broadcast();
+}
+
+
+void AsyncLogWriter::run()
+{
+    while (!cancelled()) {
+        if (writeNext()) 
+            continue;
+        
+        Mutex::ScopedLock lock(_mutex);
+        _flushed.broadcast();
+        _waiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_queue->entries.empty() && !cancelled()) {
+            _ready.wait(_mutex);
+
+            // Linger briefly so a burst of messages is written in
+            // a few large batches rather than a wakeup per message.
+            // Only full buffers, flush() and cancel() cut this short.
+            _waiting.store(false, std::memory_order_relaxed);
+            if (!cancelled())
+                _ready.tryWait(_mutex, 1);
+        }
+        _waiting.store(false, std::memory_order_relaxed);
+    }
+}
+
+
+bool AsyncLogWriter::writeNext()
+{
+    // Records going to the same channel are written as one batch
+    static const std::size_t kMaxBatch = 64;
+    internal::LogEntry entries[kMaxBatch];
+    LogRecord records[kMaxBatch];
+    std::size_t count = 0;
+    while (count < kMaxBatch && _queue->entries.pop(entries[count])) {
+        records[count] = entries[count].record;
+        count++;
+    }
+    if (count == 0)
+        return false;
+
+    UInt64 written = _written.load(std::memory_order_relaxed);
+    UInt64 discard = _discard.load(std::memory_order_relaxed);
+    std::size_t first = 0;
+    if (written < discard)
+        first = static_cast<std::size_t>(std::min<UInt64>(discard - written, count));
+    for (std::size_t i = first; i < count; ) {
+        std::size_t n = 1;
+        while (i + n < count && records[i + n].channel == records[i].channel)
+            n++;
+        records[i].channel->write(&records[i], n);
+        i += n;
+    }
+    
+    for (std::size_t i = 0; i < count; i++) {
+        entries[i].buffer->release(entries[i].span);
+        if (entries[i].record.stream)
+            LogStream::release(const_cast<LogStream*>(entries[i].record.stream));
+    }
+    _written.store(written + count, std::memory_order_release);
+    return true;
+}
+
+
+//
+// Log Stream
+//
+
+
+LogStream::LogStream(LogLevel level, const std::string& realm, int line, const void* ptr, const char* channel) :
+    level(level), line(line), realm(realm), ptr(ptr), ts(time::now()), channel(nullptr)
+{
+#ifndef SCY_DISABLE_LOGGING
+    if (channel)
+        this->channel = Logger::instance().get(channel, false);
+#endif
+}
+
+
+LogStream::LogStream(LogLevel level, const std::string& realm, const std::string& address) :
+    level(level), line(0), realm(realm), address(address), ptr(nullptr), ts(time::now()), channel(nullptr)
+{
+}
+
+
+LogStream::LogStream(const LogStream& that) :
+    level(that.level), line(that.line), realm(that.realm), address(that.address),
+    ptr(that.ptr), ts(that.ts), channel(that.channel)
+{
+    // try to avoid copy assign
+    message.str(that.message.str());
+}
+
+
+LogStream::~LogStream()
+{
+}
+
+
+namespace internal {
+
+
+    struct LogStreamCache
+        // Written log streams kept for reuse by the current thread.
+    {
+        enum { MaxSize = 16 };
+
+        std::vector<LogStream*> streams;
+        static thread_local bool exited;
+
+        ~LogStreamCache()
+        {
+            exited = true;
+            for (auto stream : streams)
+                delete stream;
+        }
+    };
+
+
+    thread_local bool LogStreamCache::exited = false;
+    static thread_local LogStreamCache logStreamCache;
+
+
+    struct LogMessageBuf: public std::stringbuf
+        // Reads the characters written to a message stream 
+        // without copying them into a new string.
+    {
+        static void write(const std::ostringstream& message, std::ostream& ost)
+        {
+            std::stringbuf* buf = message.rdbuf();
+            char* begin = (buf->*&LogMessageBuf::pbase)();
+            char* end = std::max((buf->*&LogMessageBuf::pptr)(), (buf->*&LogMessageBuf::egptr)());
+            if (begin)
+                ost.write(begin, end - begin);
+        }
+    };
+
+
+}
+
+
+LogStream* LogStream::acquire(LogLevel level, const char* function, int line, const void* ptr)
+{
+    LogStream* stream;
+    if (!internal::LogStreamCache::exited && !internal::logStreamCache.streams.empty()) {
+        stream = internal::logStreamCache.streams.back();
+        internal::logStreamCache.streams.pop_back();
+        stream->level = level;
+        stream->line = line;
+        stream->address.clear();
+        stream->ptr = ptr;
+        stream->ts = time::now();
+        stream->channel = nullptr;
+
+        // Keep the message buffer, but not the formatting 
+        // state left by the previous message.
+        stream->message.str(std::string());
+        stream->message.clear();
+        stream->message.flags(std::ios_base::skipws | std::ios_base::dec);
+        stream->message.precision(6);
+        stream->message.width(0);
+        stream->message.fill(' ');
+    }
+    else stream = new LogStream(level, "", line, ptr);
+
+#if _MSC_VER
+    stream->realm.assign(function);
+#else
+    // Shorten the signature to Class::method() as _methodName() 
+    // does, reusing the capacity of the realm string.
+    const char* colons = strstr(function, "::");
+    const char* begin = colons ? colons : function + strlen(function);
+    while (begin > function && *(begin - 1) != ' ')
+        begin--;
+    const char* end = strrchr(function, '(');
+    if (!end || end < begin)
+        end = function + strlen(function);
+    stream->realm.assign(begin, end - begin);
+    stream->realm.append("()");
+#endif
+    return stream;
+}
+
+
+void LogStream::release(LogStream* stream)
+{
+    if (!internal::LogStreamCache::exited && 
+        internal::logStreamCache.streams.size() < internal::LogStreamCache::MaxSize)
+        internal::logStreamCache.streams.push_back(stream);
+    else
+        delete stream;
+}
+
+
+//
+// Log Channel
+//
+
+
+LogChannel::LogChannel(const std::string& name, LogLevel level, const char* timeFormat) :
+    _name(name),
+    _level(level),
+    _timeFormat(timeFormat)
+{
+}
+
+
+void LogChannel::setLevel(LogLevel level)
+{
+    _level = level;
+
+    // Don't recreate the default logger if it was destroyed
+    Logger* logger = singleton.peek();
+    if (logger)
+        logger->updateThreshold();
+}
+
+
+void LogChannel::write(const std::string& message, LogLevel level, const char* realm, const void* ptr)
+{
+    LogStream stream(level, realm, 0, ptr);
+    stream << message;
+    write(stream);
+}
+
+
+void LogChannel::write(const LogStream& stream)
+{
+    (void)stream;
+}
+
+
+void LogChannel::write(const LogRecord* records, std::size_t count)
+{
+    // Channels which only implement the single message 
+    // interface format and write each message themselves
+    for (std::size_t i = 0; i < count; i++) {
+        if (records[i].stream)
+            write(*records[i].stream);
+    }
+}
+
+
+void LogChannel::format(const LogStream& stream, std::ostream& ost)
+{
+    if (_timeFormat)
+        ost << time::print(time::toLocal(stream.ts), _timeFormat);
+    ost << " [" << getStringFromLogLevel(stream.level) << "] ";
+    if (!stream.realm.empty() || !stream.address.empty() || stream.ptr) {
+        ost << "[";
+        if (!stream.realm.empty())
+            ost << stream.realm;
+        if (stream.line > 0)
+            ost << "(" << stream.line << ")" ;
+        if (!stream.address.empty())
+            ost << ":" << stream.address;
+        else if (stream.ptr)
+            ost << ":" << stream.ptr;
+        ost << "] ";
+    }
+    internal::LogMessageBuf::write(stream.message, ost);
+    ost.flush();
+}
+
+
+//
+// Console Channel
+//
+
+
+ConsoleChannel::ConsoleChannel(const std::string& name, LogLevel level, const char* timeFormat) :
+    LogChannel(name, level, timeFormat)
+{
+}
+
+
+void ConsoleChannel::write(const LogStream& stream)
+{
+    if (this->level() > stream.level)
+        return;
+
+    std::ostringstream ss;
+    format(stream, ss);
+#if !defined(WIN32) || defined(_CONSOLE) || defined(_DEBUG)
+    std::cout << ss.str();
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG)
+    std::string s(ss.str());
+    std::wstring temp(s.length(), L' ');
+    std::copy(s.begin(), s.end(), temp.begin());
+    OutputDebugString(temp.c_str());
+#endif
+}
+
+
+void ConsoleChannel::write(const LogRecord* records, std::size_t count)
+{
+#if !defined(WIN32) || defined(_CONSOLE) || defined(_DEBUG)
+    for (std::size_t i = 0; i < count; i++)
+        std::cout.write(records[i].data, records[i].size);
+    std::cout.flush();
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG)
+    for (std::size_t i = 0; i < count; i++) {
+        std::wstring temp(records[i].data, records[i].data + records[i].size);
+        OutputDebugString(temp.c_str());
+    }
+#endif
+}
+
+
+//
+// File Channel
+//
+
+
+FileChannel::FileChannel(const std::string& name,
+                         const std::string& path,
+                         LogLevel level,
+                         const char* timeFormat) :
+    LogChannel(name, level, timeFormat),
+    _path(path)
+{
+}
+
+
+FileChannel::~FileChannel()
+{
+    close();
+}
+
+
+void FileChannel::open()
+{
+    // Ensure a path was set
+    if (_path.empty())
+        throw std::runtime_error("Log file path must be set.");
+
+    // Create directories if needed
+    fs::mkdirr(fs::dirname(_path));
+
+    // Open the file stream
+    _fstream.close();
+    _fstream.open(_path.c_str(), std::ios::out | std::ios::app);
+
+    // Throw on failure
+    if (!_fstream.is_open())
+        throw std::runtime_error("Failed to open log file: " + _path);
+}
+
+
+void FileChannel::close()
+{
+    _fstream.close();
+}
+
+
+void FileChannel::write(const LogStream& stream)
+{
+    if (this->level() > stream.level)
+        return;
+
+    if (!_fstream.is_open())
+        open();
+
+    std::ostringstream ss;
+    format(stream, ss);
+    _fstream << ss.str() << std::endl;
+    _fstream.flush();
+
+#if defined(_CONSOLE) || defined(_DEBUG)
+    std::cout << ss.str();
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG)
+    std::string s(ss.str());
+    std::wstring temp(s.length(), L' ');
+    std::copy(s.begin(), s.end(), temp.begin());
+    OutputDebugString(temp.c_str());
+#endif
+}
+
+
+void FileChannel::write(const LogRecord* records, std::size_t count)
+{
+    if (!_fstream.is_open())
+        open();
+
+    // Buffer the whole batch and flush once
+    for (std::size_t i = 0; i < count; i++) {
+        _fstream.write(records[i].data, records[i].size);
+        _fstream.put('\n');
+#if defined(_CONSOLE) || defined(_DEBUG)
+        std::cout.write(records[i].data, records[i].size);
+#endif
+    }
+    _fstream.flush();
+}
+
+
+void FileChannel::setPath(const std::string& path)
+{
+    _path = path;
+    open();
+}
+
+
+std::string FileChannel::path() const
+{
+    return _path;
+}
+
+
+//
+// Rotating File Channel
+//
+
+
+RotatingFileChannel::RotatingFileChannel(const std::string& name,
+                                         const std::string& dir,
+                                         LogLevel level,
+                                         const std::string& extension,
+                                         int rotationInterval,
+                                         const char* timeFormat) :
+    LogChannel(name, level, timeFormat),
+    _fstream(nullptr),
+    _dir(dir),
+    _extension(extension),
+    _rotationInterval(rotationInterval),
+    _rotatedAt(0)
+{
+    // The initial log file will be opened on the first call to rotate()
+}
+
+
+RotatingFileChannel::~RotatingFileChannel()
+{
+    if (_fstream) {
+        _fstream->close();
+        delete _fstream;
+    }
+}
+
+
+void RotatingFileChannel::write(const LogStream& stream)
+{
+    if (this->level() > stream.level)
+        return;
+
+    if (_fstream == nullptr || stream.ts - _rotatedAt > _rotationInterval)
+        rotate();
+
+    std::ostringstream ss;
+    format(stream, ss);
+    *_fstream << ss.str();
+    _fstream->flush();
+
+#if defined(_CONSOLE) && defined(_DEBUG)
+    cout << ss.str();
+#endif
+#if defined(_MSC_VER) && defined(_DEBUG)
+    std::string s(ss.str());
+    std::wstring temp(s.length(), L' ');
+    std::copy(s.begin(), s.end(), temp.begin());
+    OutputDebugString(temp.c_str());
+#endif
+}
+
+
+void RotatingFileChannel::write(const LogRecord* records, std::size_t count)
+{
+    // Buffer the whole batch and flush once
+    for (std::size_t i = 0; i < count; i++) {
+        if (_fstream == nullptr || records[i].ts - _rotatedAt > _rotationInterval) {
+            if (_fstream)
+                _fstream->flush();
+            rotate();
+        }
+        _fstream->write(records[i].data, records[i].size);
+#if defined(_CONSOLE) && defined(_DEBUG)
+        std::cout.write(records[i].data, records[i].size);
+#endif
+    }
+    _fstream->flush();
+}
+
+
+void RotatingFileChannel::rotate()
+{
+    if (_fstream) {
+        _fstream->close();
+        delete _fstream;
+    }
+
+    // Always try to create the directory
+    fs::mkdirr(_dir);
+
+    // Open the next log file
+    _filename = util::format("%s_%ld.%s", _name.c_str(), static_cast<long>(Timestamp().epochTime()), _extension.c_str());
+
+    std::string path(_dir);
+    fs::addnode(path, _filename);
+    _fstream = new std::ofstream(path);
+    _rotatedAt = time::now();
+}
+
+
+#if 0
+// ---------------------------------------------------------------------
+// Evented File Channel
+//
+EventedFileChannel::EventedFileChannel(const std::string& name,
+                         const std::string& dir,
+                         LogLevel level,
+                         const std::string& extension,
+                         int rotationInterval,
+                         const char* timeFormat) :
+    FileChannel(name, dir, level, extension, rotationInterval, timeFormat)
+{
+}
+
+
+EventedFileChannel::~EventedFileChannel()
+{
+}
+
+
+void EventedFileChannel::write(const LogStream& stream, LogLevel level, const char* realm, const void* ptr)
+{
+    if (this->level() > level)
+        return;
+
+    FileChannel::write(message, level, ptr);
+    OnLogStream.emit(this, message, level, ptr);
+}
+#endif
+
+
+
+} // namespace scy
@@ -0,0 +1,63 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/packetbroadcaster.h"
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+PacketBroadcaster::PacketBroadcaster() : 
+    PacketProcessor(this->emitter)
+{    
+    TraceLS(this) << "Create" << endl;
+}
+    
+
+PacketBroadcaster::~PacketBroadcaster()
+{
+    TraceLS(this) << "Destroy" << endl;
+}
+
+
+void PacketBroadcaster::process(IPacket& packet)
+{
+    // Packets which borrow their data would be copied again by
+    // every subscriber queue, so take a managed copy once here.
+    auto raw = dynamic_cast<RawPacket*>(&packet);
+    if (raw && !raw->ownsBuffer() && raw->size() > 0) {
+        std::unique_ptr<IPacket> shared(raw->clone());
+        emit(*shared);
+    }
+    else emit(packet);
+}
+
+
+void PacketBroadcaster::subscribe(PacketStream& stream, int queueSize, uv::Loop* loop)
+{
+    TraceLS(this) << "Subscribe: " << &stream << endl;
+    stream.attachSource(emitter);
+    stream.attach(new SyncPacketQueue(loop, queueSize), 0, true);
+}
+
+
+} // namespace scy
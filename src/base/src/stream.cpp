@@ -0,0 +1,170 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+
+#include "scy/stream.h"
+#include <map>
+
+
+namespace scy {
+namespace net {
+
+
+namespace internal {
+
+    struct WriteRequestPoolRegistry
+        /// Holds the WriteRequestPool instances for each event loop.
+        /// Pools are freed by WriteRequestPool::destroy() when their
+        /// loop is closed, and any remaining pools on static destruction.
+    {
+        Mutex mutex;
+        std::map<uv::Loop*, WriteRequestPool*> pools;
+
+        ~WriteRequestPoolRegistry()
+        {
+            for (auto it = pools.begin(); it != pools.end(); ++it)
+                delete it->second;
+        }
+    };
+
+    static WriteRequestPoolRegistry& writeRequestPools()
+    {
+        static WriteRequestPoolRegistry registry;
+        return registry;
+    }
+
+}
+
+
+WriteRequestPool::WriteRequestPool(std::size_t maxFree) :
+    _maxFree(maxFree),
+    _outstanding(0),
+    _outstandingBytes(0),
+    _allocated(0)
+{
+}
+
+
+WriteRequestPool::~WriteRequestPool()
+{
+    assert(_outstanding == 0);
+    for (auto it = _free.begin(); it != _free.end(); ++it)
+        delete *it;
+}
+
+
+WriteRequestPool& WriteRequestPool::forLoop(uv::Loop* loop)
+{
+    auto& registry = internal::writeRequestPools();
+    Mutex::ScopedLock lock(registry.mutex);
+    auto it = registry.pools.find(loop);
+    if (it != registry.pools.end())
+        return *it->second;
+    auto pool = new WriteRequestPool;
+    registry.pools[loop] = pool;
+    return *pool;
+}
+
+
+void WriteRequestPool::destroy(uv::Loop* loop)
+{
+    WriteRequestPool* pool = nullptr;
+    {
+        auto& registry = internal::writeRequestPools();
+        Mutex::ScopedLock lock(registry.mutex);
+        auto it = registry.pools.find(loop);
+        if (it == registry.pools.end())
+            return;
+        pool = it->second;
+        registry.pools.erase(it);
+    }
+    delete pool;
+}
+
+
+WriteRequest* WriteRequestPool::acquire(std::size_t size)
+{
+    WriteRequest* wr;
+    if (!_free.empty()) {
+        wr = _free.back();
+        _free.pop_back();
+    }
+    else {
+        wr = new WriteRequest;
+        wr->pool = this;
+        _allocated++;
+    }
+    wr->req.data = wr;
+    wr->size = size;
+    _outstanding++;
+    _outstandingBytes += size;
+    return wr;
+}
+
+
+void WriteRequestPool::release(WriteRequest* wr)
+{
+    assert(wr->pool == this);
+    assert(_outstanding > 0);
+    _outstanding--;
+    _outstandingBytes -= wr->size;
+
+    // Free the callback state and large payloads. Small payloads 
+    // are kept so gathered writes can copy short buffers into the 
+    // request without allocating.
+    if (wr->payload.capacity() > WriteRequest::MaxRetainedPayload)
+        Buffer().swap(wr->payload);
+    else
+        wr->payload.clear();
+    wr->callback = nullptr;
+
+    if (_free.size() < _maxFree)
+        _free.push_back(wr);
+    else {
+        delete wr;
+        _allocated--;
+    }
+}
+
+
+std::size_t WriteRequestPool::outstanding() const
+{
+    return _outstanding;
+}
+
+
+std::size_t WriteRequestPool::outstandingBytes() const
+{
+    return _outstandingBytes;
+}
+
+
+std::size_t WriteRequestPool::allocated() const
+{
+    return _allocated;
+}
+
+
+std::size_t WriteRequestPool::available() const
+{
+    return _free.size();
+}
+
+
+} } // namespace scy::net
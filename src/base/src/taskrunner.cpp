@@ -0,0 +1,425 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/taskrunner.h"
+#include "scy/logger.h"
+#include "scy/memory.h"
+#include "scy/singleton.h"
+#include "scy/platform.h"
+#include "scy/thread.h"
+
+#include <iostream>
+#include <algorithm>
+#include <assert.h>
+
+
+using std::endl;
+
+
+namespace scy {
+
+
+//
+// Task Runner
+//
+
+
+TaskRunner::TaskRunner(async::Runner::Ptr runner) :
+    _sinceIdle(0)
+{    
+    if (runner)
+        setRunner(runner);
+    else
+        setRunner(std::make_shared<Thread>());
+}
+
+
+TaskRunner::~TaskRunner()
+{    
+    Shutdown.emit(this);
+    //Idler::stop();
+    cancelRunner();
+    clear();
+}
+
+
+bool TaskRunner::start(Task* task)
+{
+    task->_runner = this;
+    add(task);
+
+    //if (task->_cancelled) {
+        //task->_cancelled = false;
+        //task->start();
+        TraceLS(this) << "Start task: " << task << endl;
+        onStart(task);
+        wakeUp();
+        return true;
+    //}
+    //return false;
+}
+
+
+bool TaskRunner::cancel(Task* task)
+{        
+    //if (!task->_cancelled) {
+        //task->_cancelled = true;
+        //task->cancel();
+        //TraceLS(this) << "Cancelled task: " << task << endl;
+        //onCancel(task);
+        //_wakeUp.set();
+        //return true;
+    //}
+    
+    if (!task->cancelled()) {
+        task->cancel();
+        TraceLS(this) << "Cancel task: " << task << endl;
+        onCancel(task);
+        //_wakeUp.set();
+        return true;
+    }
+    
+    return false;
+}
+
+
+bool TaskRunner::destroy(Task* task)
+{
+    TraceLS(this) << "Abort task: " << task << endl;
+    
+    // Tasks are never deleted here, since the caller may be the
+    // task's own run() method. Managed tasks are deleted by the 
+    // runner once flagged, and unmanaged tasks are queued for 
+    // deletion on the next iteration.
+    Mutex::ScopedLock lock(_mutex);
+    task->_destroyed = true;
+    if (std::find(_tasks.begin(), _tasks.end(), task) == _tasks.end() &&
+        std::find(_deleted.begin(), _deleted.end(), task) == _deleted.end()) {
+        TraceLS(this) << "Queue unmanaged task for deletion: " << task << endl;
+        _deleted.push_back(task);
+    }
+    _wakeUp.broadcast();
+    return true;
+}
+    
+
+bool TaskRunner::add(Task* task)
+{
+    TraceLS(this) << "Add task: " << task << endl;
+    if (!exists(task)) {
+        Mutex::ScopedLock lock(_mutex);    
+        _tasks.push_back(task);
+        //uv_ref(Idler::handle.ptr()); // reference the idler handle when a task is added
+        onAdd(task);
+        return true;
+    }
+    return false;
+}
+
+
+bool TaskRunner::remove(Task* task)
+{    
+    TraceLS(this) << "Remove task: " << task << endl;
+
+    Mutex::ScopedLock lock(_mutex);
+    for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+        if (*it == task) {                    
+            _tasks.erase(it);
+            //uv_unref(Idler::handle.ptr()); // dereference the idler handle when a task is removed
+            onRemove(task);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool TaskRunner::exists(Task* task) const
+{    
+    Mutex::ScopedLock lock(_mutex);
+    for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+        if (*it == task)
+            return true;
+    }
+    return false;
+}
+
+
+Task* TaskRunner::get(UInt32 id) const
+{
+    Mutex::ScopedLock lock(_mutex);
+    for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+        if ((*it)->id() == id)
+            return *it;
+    }            
+    return nullptr;
+}
+
+
+Task* TaskRunner::next() const
+{
+    Mutex::ScopedLock lock(_mutex);
+    for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+        if (!(*it)->cancelled())
+            return *it;
+    }            
+    return nullptr;
+}
+
+
+void TaskRunner::clear()
+{
+    TaskList tasks;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        tasks.swap(_tasks);
+        tasks.insert(tasks.end(), _deleted.begin(), _deleted.end());
+        _deleted.clear();
+    }
+
+    // Delete outside the lock so task destructors may use the runner
+    for (auto it = tasks.begin(); it != tasks.end(); ++it) {    
+        TraceLS(this) << "Clear: Destroying task: " << *it << endl;
+        delete *it;
+    }
+}
+
+
+void TaskRunner::setRunner(async::Runner::Ptr runner)
+{
+    TraceLS(this) << "Set async: " << runner << endl;
+
+    Mutex::ScopedLock lock(_mutex);
+    assert(!_runner);
+    _runner = runner;
+    _runner->setRepeating(true);
+    _runner->start(*this);
+}
+
+
+void TaskRunner::run()
+{
+    // Thread based runners stay inside this loop until cancelled,
+    // while loop driven runners return after each iteration.
+    bool async = _runner && _runner->async();
+    do {
+        runNext();
+    }
+    while (async && !_runner->cancelled());
+}
+
+
+void TaskRunner::runNext()
+{
+    Task* task = next();
+    //TraceLS(this) << "Next task: " << task << endl;
+        
+    // Run the task
+    if (task) 
+    {
+        // Check once more that the task has not been cancelled
+        if (!task->cancelled()) {
+            TraceLS(this) << "Run task: " << task << endl;
+            task->run();
+
+            onRun(task);
+
+            // Cancel the task if not repeating
+            if (!task->repeating())
+                task->cancel();
+
+            //if (task->cancelled())
+            //    task->_destroyed = true;
+        }
+
+        // Advance the task queue
+        {
+            Mutex::ScopedLock lock(_mutex);
+            Task* t = _tasks.front();
+            _tasks.pop_front();
+            _tasks.push_back(t);
+        }
+                        
+        // Destroy the task if required
+        if (task->destroyed()) {
+            TraceLS(this) << "Destroy task: " << task << endl;
+            remove(task);
+            delete task;
+        }
+    }
+
+    // Tasks which are destroyed after being cancelled are never 
+    // returned by next(), so collect them while idle along with
+    // unmanaged tasks queued by destroy(). They are deleted outside
+    // the lock so their destructors may use the runner.
+    TaskList deleted;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        if (!task) {
+            for (auto it = _tasks.begin(); it != _tasks.end();) {
+                Task* t = *it;
+                if (t->destroyed()) {
+                    it = _tasks.erase(it);
+                    onRemove(t);
+                    deleted.push_back(t);
+                }
+                else ++it;
+            }
+        }
+        deleted.insert(deleted.end(), _deleted.begin(), _deleted.end());
+        _deleted.clear();
+    }
+    for (auto it = deleted.begin(); it != deleted.end(); ++it) {
+        TraceLS(this) << "Destroy task: " << *it << endl;
+        delete *it;
+    }
+
+    // Dispatch the Idle signal
+    //TraceLS(this) << "idle: "<< Idle.ndelegates() << endl;
+    Idle.emit(this);
+
+    // Loop driven runners must never block
+    if (!_runner || !_runner->async())
+        return;
+
+    Mutex::ScopedLock lock(_mutex);
+    if (!task) {
+
+        // Sleep until a task is started. The task list is checked
+        // again under lock so we don't miss a wakeup.
+        bool pending = !_deleted.empty();
+        for (auto it = _tasks.begin(); it != _tasks.end() && !pending; ++it)
+            pending = !(*it)->cancelled() || (*it)->destroyed();
+        if (!pending && !_runner->cancelled())
+            _wakeUp.wait(_mutex);
+    }
+    else if (++_sinceIdle >= _tasks.size()) {
+
+        // Yield after each pass over the task list so 
+        // repeating tasks don't consume 100% CPU.
+        _sinceIdle = 0;
+        _wakeUp.tryWait(_mutex, 1);
+    }
+}
+
+
+void TaskRunner::wakeUp()
+{
+    Mutex::ScopedLock lock(_mutex);
+    _wakeUp.broadcast();
+}
+
+
+void TaskRunner::cancelRunner()
+{
+    if (!_runner || _runner->cancelled())
+        return;
+
+    _runner->cancel();
+    wakeUp();
+
+    // Wait for the runner thread to leave run() so it 
+    // doesn't touch members which are being destroyed.
+    if (_runner->async() && _runner->tid() != Thread::currentID()) {
+        while (_runner->running())
+            scy::sleep(1);
+    }
+}
+
+
+void TaskRunner::onAdd(Task*) 
+{
+}
+
+
+void TaskRunner::onStart(Task*) 
+{
+}
+
+
+void TaskRunner::onCancel(Task*) 
+{
+}
+
+
+void TaskRunner::onRemove(Task*) 
+{
+}
+
+
+void TaskRunner::onRun(Task*) 
+{
+}
+
+
+TaskRunner& TaskRunner::getDefault() 
+{
+    static Singleton<TaskRunner> sh;
+    return *sh.get();
+}
+
+
+//
+// Async Task
+//
+
+
+Task::Task(bool repeat) : 
+    _id(util::randomNumber()),
+    _repeating(repeat),
+    _destroyed(false),
+    _runner(nullptr)
+{     
+}
+
+
+Task::~Task()
+{
+    //assert(destroyed());
+}
+
+
+void Task::destroy()            
+{
+    if (_runner)
+        _runner->destroy(this);
+    else
+        _destroyed = true;
+}
+
+
+UInt32 Task::id() const
+{
+    return _id;
+}
+
+
+bool Task::destroyed() const                         
+{ 
+    return _destroyed;
+}
+
+
+bool Task::repeating() const                         
+{ 
+    return _repeating;
+}
+
+
+} // namespace scy
\ No newline at end of file
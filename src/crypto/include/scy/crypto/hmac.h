@@ -0,0 +1,98 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Crypto_HMAC_H
+#define SCY_Crypto_HMAC_H
+
+
+#include "scy/crypto/crypto.h"
+#include <string>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+
+namespace scy {
+namespace crypto {
+    
+    
+std::string computeHMAC(const std::string& input, const std::string& key);
+    /// HMAC is a MAC (message authentication code), i.e. a keyed hash function 
+    /// used for message authentication, which is based on a hash function (SHA1).
+    ///
+    /// Input is the data to be signed, and key is the private password.
+
+
+class HMACEngine
+    /// HMACEngine is a reusable HMAC context for signing many messages.
+    ///
+    /// The OpenSSL context is allocated once, and the inner and outer
+    /// key pads are only recomputed when the key changes, so signing
+    /// successive messages with the same key performs no allocation.
+    /// The engine is not thread-safe; use one engine per thread.
+    ///
+    /// The EVP_MAC interface is used with OpenSSL 3.0 and newer,
+    /// where HMAC_CTX is deprecated.
+{
+public:
+    HMACEngine(const std::string& algorithm = "SHA1");
+    ~HMACEngine();
+
+    void init(const std::string& key);
+    void init(const void* key, std::size_t length);
+        // Starts a new signature with the given key.
+        // The key setup is skipped when the key is the
+        // same as the one used for the previous signature.
+
+    void update(const void* data, std::size_t length);
+        // Adds the given data to the signature.
+        // May be called many times between init() and final().
+
+    unsigned final(void* out);
+        // Finishes the signature and writes it to out, which
+        // must hold at least size() bytes (EVP_MAX_MD_SIZE is
+        // always sufficient). Returns the signature length.
+
+    unsigned size() const;
+        // Returns the signature length in bytes.
+
+    const std::string& algorithm() const;
+        // Returns the hash algorithm being used.
+
+protected:
+    HMACEngine(const HMACEngine&);
+    HMACEngine& operator=(const HMACEngine&);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC* _mac;
+    EVP_MAC_CTX* _ctx;
+#else
+    HMAC_CTX* _ctx;
+#endif
+    const EVP_MD* _md;
+    std::string _key;
+    std::string _algorithm;
+    bool _keyed;
+};
+
+
+} } // namespace scy::crypto
+
+
+#endif // SCY_Crypto_HMAC_H
\ No newline at end of file
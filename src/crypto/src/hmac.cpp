@@ -0,0 +1,176 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/crypto/hmac.h"
+#include "scy/util.h"
+#include <assert.h>
+#include <string.h>
+#include <stdexcept>
+    
+#ifdef WIN32
+// hack for name collision of OCSP_RESPONSE and wincrypto.h in openssl release 0.9.8h
+// http://www.google.com/search?q=OCSP%5fRESPONSE+wincrypt%2eh
+// continue to watch this issue for a real fix.
+#undef OCSP_RESPONSE
+#endif
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/params.h>
+#endif
+
+
+namespace scy {
+namespace crypto {
+
+
+std::string computeHMAC(const std::string& input, const std::string& key) 
+{    
+    //DebugL << "Compute HMAC: input='" << util::dumpbin(input.c_str(), input.length()) 
+    //    << "', inputLength=" << input.length() << ", key='" << key << "', keyLength=" << key.length() << std::endl;
+    unsigned int len = 0;
+    char buf[20];    
+    HMAC(EVP_sha1(), 
+        key.c_str(), key.length(), 
+        reinterpret_cast<const unsigned char*>(input.c_str()), input.length(), 
+        reinterpret_cast<unsigned char*>(&buf), &len);
+    assert(len == 20);
+    return std::string(buf, len);
+}
+
+
+HMACEngine::HMACEngine(const std::string& algorithm) :
+    _algorithm(algorithm),
+    _keyed(false)
+{
+    crypto::initializeEngine();
+
+    _md = EVP_get_digestbyname(algorithm.data());
+    if (!_md)
+        throw std::runtime_error("Algorithm not supported: " + algorithm);
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    _mac = EVP_MAC_fetch(nullptr, "HMAC", nullptr);
+    if (!_mac)
+        internal::throwError();
+    _ctx = EVP_MAC_CTX_new(_mac);
+    if (!_ctx) {
+        EVP_MAC_free(_mac);
+        internal::throwError();
+    }
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+    _ctx = new HMAC_CTX;
+    HMAC_CTX_init(_ctx);
+#else
+    _ctx = HMAC_CTX_new();
+    if (!_ctx)
+        internal::throwError();
+#endif
+}
+
+
+HMACEngine::~HMACEngine()
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_MAC_CTX_free(_ctx);
+    EVP_MAC_free(_mac);
+#elif OPENSSL_VERSION_NUMBER < 0x10100000L
+    HMAC_CTX_cleanup(_ctx);
+    delete _ctx;
+#else
+    HMAC_CTX_free(_ctx);
+#endif
+
+    crypto::uninitializeEngine();
+}
+
+
+void HMACEngine::init(const std::string& key)
+{
+    init(key.data(), key.size());
+}
+
+
+void HMACEngine::init(const void* key, std::size_t length)
+{
+    // Passing a null key reuses the pads derived 
+    // from the previous key.
+    if (_keyed && _key.size() == length && 
+        memcmp(_key.data(), key, length) == 0) {
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+        internal::api(EVP_MAC_init(_ctx, nullptr, 0, nullptr));
+#else
+        internal::api(HMAC_Init_ex(_ctx, nullptr, 0, nullptr, nullptr));
+#endif
+        return;
+    }
+
+    _keyed = false;
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    OSSL_PARAM params[] = {
+        OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, 
+            const_cast<char*>(EVP_MD_get0_name(_md)), 0),
+        OSSL_PARAM_construct_end()
+    };
+    internal::api(EVP_MAC_init(_ctx, reinterpret_cast<const unsigned char*>(key), length, params));
+#else
+    internal::api(HMAC_Init_ex(_ctx, key, static_cast<int>(length), _md, nullptr));
+#endif
+    _key.assign(reinterpret_cast<const char*>(key), length);
+    _keyed = true;
+}
+
+
+void HMACEngine::update(const void* data, std::size_t length)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    internal::api(EVP_MAC_update(_ctx, reinterpret_cast<const unsigned char*>(data), length));
+#else
+    internal::api(HMAC_Update(_ctx, reinterpret_cast<const unsigned char*>(data), length));
+#endif
+}
+
+
+unsigned HMACEngine::final(void* out)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    std::size_t len = 0;
+    internal::api(EVP_MAC_final(_ctx, reinterpret_cast<unsigned char*>(out), &len, EVP_MAX_MD_SIZE));
+    return static_cast<unsigned>(len);
+#else
+    unsigned int len = 0;
+    internal::api(HMAC_Final(_ctx, reinterpret_cast<unsigned char*>(out), &len));
+    return len;
+#endif
+}
+
+
+unsigned HMACEngine::size() const
+{
+    return static_cast<unsigned>(EVP_MD_size(_md));
+}
+
+
+const std::string& HMACEngine::algorithm() const
+{
+    return _algorithm;
+}
+
+
+} } // namespace scy::crypto
\ No newline at end of file
@@ -0,0 +1,302 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_HTTP_Packetizers_H
+#define SCY_HTTP_Packetizers_H
+
+
+#include "scy/signal.h"
+#include "scy/http/connection.h"
+#include "scy/packet.h"
+
+
+namespace scy { 
+namespace http {
+
+
+//
+// HTTP Chunked Adapter
+//
+
+
+class ChunkedAdapter: public IPacketizer
+    /// Frames packets as HTTP chunks. Each chunk is emitted as a single
+    /// GatheredPacket made up of the chunk size line, the frame separator,
+    /// the payload and the trailing CRLF, so the payload is not copied
+    /// and sockets send the chunk with one vectored write.
+    ///
+    /// The size line is built on the stack, which is safe because sockets
+    /// copy short segments into the write request. The response header
+    /// is written once and not modified while the adapter is alive.
+{
+public:
+    Connection* connection;
+    std::string contentType;
+    std::string frameSeparator;
+    bool initial;
+    bool nocopy;
+
+    ChunkedAdapter(Connection* connection = nullptr, const std::string& frameSeparator = "", bool nocopy = true) : 
+        PacketProcessor(this->emitter),
+        connection(connection), 
+        contentType(connection->outgoingHeader()->getContentType()),
+        frameSeparator(frameSeparator),
+        initial(true),
+        nocopy(nocopy)
+    {
+    }
+
+    ChunkedAdapter(const std::string& contentType, const std::string& frameSeparator = "", bool nocopy = true) : 
+        PacketProcessor(this->emitter),
+        connection(nullptr), 
+        contentType(contentType),
+        frameSeparator(frameSeparator),
+        initial(true),
+        nocopy(nocopy)
+    {
+    }
+    
+    virtual ~ChunkedAdapter() 
+    {
+    }
+    
+    virtual void writeHeader(std::string& head)
+        // Sets HTTP headers for the initial response.
+        //
+        // If the connection is set the connection headers are updated,
+        // and the ConnectionAdapter sends them with the first chunk.
+        // Otherwise the response header is written to the given
+        // buffer, which is sent in front of the first chunk.
+    {    
+        // Flush connection headers if the connection is set.
+        if (connection) {
+            connection->shouldSendHeader(true);                    
+            connection->response().setChunkedTransferEncoding(true);
+            connection->response().set("Cache-Control", "no-store, no-cache, max-age=0, must-revalidate");
+            connection->response().set("Cache-Control", "post-check=0, pre-check=0, FALSE");
+            connection->response().set("Access-Control-Allow-Origin", "*");
+            connection->response().set("Transfer-Encoding", "chunked");
+            connection->response().set("Content-Type", contentType);
+            connection->response().set("Connection", "keep-alive");
+            connection->response().set("Pragma", "no-cache");
+            connection->response().set("Expires", "0");
+        }
+
+        // Otherwise make up the response.
+        else {
+            head.append("HTTP/1.1 200 OK\r\n"
+                // Note: If Cache-Control: no-store is not used Chrome's (27.0.1453.110) 
+                // memory usage grows exponentially for HTTP streaming:
+                // https://code.google.com/p/chromium/issues/detail?id=28035
+                "Cache-Control: no-store, no-cache, max-age=0, must-revalidate\r\n"
+                "Cache-Control: post-check=0, pre-check=0, FALSE\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Connection: keep-alive\r\n"
+                "Pragma: no-cache\r\n"
+                "Expires: 0\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                "Content-Type: ");
+            head.append(contentType);
+            head.append("\r\n\r\n");
+        }
+    }
+    
+    virtual void process(IPacket& packet)
+    {
+        traceL("ChunkedAdapter", this) << "Processing: " << packet.size() << std::endl;
+        
+        if (!packet.hasData())
+            throw std::invalid_argument("Incompatible packet type");
+        
+        GatheredPacket chunk(packet.flags.data, packet.source, packet.opaque);
+
+        // Send the HTTP response header with the first chunk        
+        if (initial) {            
+            initial = false;    
+            writeHeader(_header);
+            chunk.append(_header);
+        }
+        
+        // Write the hex chunk size line
+        char sizeLine[sizeof(std::size_t) * 2 + 2];
+        static_assert(sizeof(sizeLine) <= net::WriteRequest::MaxCopySize, 
+            "chunk size lines must be copied by the socket");
+        char* end = sizeLine + sizeof(sizeLine);
+        char* pos = end - 2;
+        pos[0] = '\r';
+        pos[1] = '\n';
+        std::size_t size = packet.size();
+        do {
+            *--pos = "0123456789abcdef"[size & 0xF];
+            size >>= 4;
+        } while (size);
+
+        chunk.append(pos, end - pos);
+        chunk.append(frameSeparator);
+        chunk.append(packet.data(), packet.size());
+        chunk.append("\r\n", 2);
+        
+        // Emit the chunk as a single gathered packet
+        if (nocopy)
+            emit(chunk);
+        
+        // Join the pieces for processors which need contiguous data
+        else {
+            _buffer.clear();
+            chunk.write(_buffer);
+            emit(_buffer.data(), _buffer.size(), packet.flags.data);
+        }
+    }
+        
+    PacketSignal emitter;
+
+protected:
+    std::string _header;
+    Buffer _buffer;
+};
+
+
+//
+// HTTP Multipart Adapter
+//
+
+
+class MultipartAdapter: public IPacketizer
+    /// Frames packets as multipart/x-mixed-replace parts. The part
+    /// header and the payload are emitted as a single GatheredPacket,
+    /// so the payload is not copied and sockets send each part with
+    /// one vectored write.
+    ///
+    /// The response and part headers are written once and not modified
+    /// while the adapter is alive, so they can be borrowed by writes
+    /// which are still pending.
+{
+public:
+    Connection* connection;
+    std::string contentType;
+    bool isBase64;
+    bool initial;
+
+    MultipartAdapter(Connection* connection, bool base64 = false) :    
+        IPacketizer(this->emitter),
+        connection(connection),
+        contentType(connection->outgoingHeader()->getContentType()),
+        isBase64(base64),
+        initial(true)
+    {
+    }
+
+    MultipartAdapter(const std::string& contentType, bool base64 = false) :    
+        IPacketizer(this->emitter),
+        connection(nullptr),
+        contentType(contentType),
+        isBase64(base64),
+        initial(true)
+    {
+    }
+    
+    virtual ~MultipartAdapter() 
+    {
+    }
+        
+    virtual void writeHeader(std::string& head)
+        // Sets HTTP headers for the initial response.
+        //
+        // If the connection is set the connection headers are updated,
+        // and the ConnectionAdapter sends them with the first part.
+        // Otherwise the response header is written to the given
+        // buffer, which is sent in front of the first part.
+    {    
+        // Flush connection headers if the connection is set.
+        if (connection) {
+            connection->shouldSendHeader(true);                
+            connection->response().set("Content-Type", "multipart/x-mixed-replace; boundary=end");
+            connection->response().set("Cache-Control", "no-store, no-cache, max-age=0, must-revalidate");
+            connection->response().set("Cache-Control", "post-check=0, pre-check=0, FALSE");
+            connection->response().set("Access-Control-Allow-Origin", "*");
+            connection->response().set("Transfer-Encoding", "chunked");
+            connection->response().set("Connection", "keep-alive");
+            connection->response().set("Pragma", "no-cache");
+            connection->response().set("Expires", "0");
+        }
+
+        // Otherwise make up the response.
+        else {
+            head.append("HTTP/1.1 200 OK\r\n"
+                "Content-Type: multipart/x-mixed-replace; boundary=end\r\n"
+                "Cache-Control: no-store, no-cache, max-age=0, must-revalidate\r\n"
+                "Cache-Control: post-check=0, pre-check=0, FALSE\r\n"
+                "Access-Control-Allow-Origin: *\r\n"
+                "Pragma: no-cache\r\n"
+                "Expires: 0\r\n"
+                "\r\n");
+        }
+    }
+    
+    virtual void writeChunkHeader(std::string& head)
+        // Writes the HTTP header for each part.
+        // The header is written once and reused for every part.
+    {    
+        head.append("--end\r\nContent-Type: ");
+        head.append(contentType);
+        head.append("\r\n");
+        if (isBase64)
+            head.append("Content-Transfer-Encoding: base64\r\n");    
+        head.append("\r\n");    
+    }
+    
+    virtual void process(IPacket& packet)
+    {        
+        // Write the initial HTTP response header        
+        GatheredPacket part(packet.flags.data, packet.source, packet.opaque);
+        if (initial) {            
+            initial = false;    
+            writeHeader(_header);
+            writeChunkHeader(_chunkHeader);
+            part.append(_header);
+        }
+        part.append(_chunkHeader);
+        
+        // Send the part header and payload as a single 
+        // gathered packet so we don't need to copy any data.
+        if (packet.hasData()) {
+            part.append(packet.data(), packet.size());
+            emit(part);
+        }
+
+        // Packets without a data buffer are proxied 
+        // after the headers.
+        else {
+            emit(part);
+            emit(packet);
+        }
+    }
+            
+    PacketSignal emitter;
+
+protected:
+    std::string _header;
+    std::string _chunkHeader;
+};
+
+
+} } // namespace scy::http
+
+
+#endif
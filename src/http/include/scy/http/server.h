@@ -0,0 +1,366 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_HTTP_Server_H
+#define SCY_HTTP_Server_H
+
+
+#include "scy/base.h"
+#include "scy/logger.h"
+#include "scy/net/socket.h"
+#include "scy/http/connection.h"
+#include "scy/http/request.h"
+#include "scy/http/response.h"
+#include "scy/http/parser.h"
+#include "scy/timer.h"
+
+#include <unordered_map>
+
+    
+namespace scy { 
+namespace http {
+
+
+class Server;
+class ServerAdapter;
+class ServerResponder;
+class ServerConnection: public Connection
+    /// An HTTP connection accepted by the Server.
+    ///
+    /// Requests on a keep-alive connection, including requests 
+    /// pipelined in a single read, are handled in order. A new 
+    /// ServerResponder is created for each request. Once a request
+    /// has been received nothing more is read from the connection
+    /// until the response is finished, after which the previous 
+    /// responder is destroyed and the next request is handled. 
+    /// Data which arrives in the meantime is buffered.
+    ///
+    /// The response is finished automatically when:
+    ///   - the responder returns from onRequest() having sent the 
+    ///     response header through the connection, without an
+    ///     active Outgoing stream;
+    ///   - Content-Length bytes of body have been sent through
+    ///     the connection;
+    ///   - the Outgoing stream is stopped or closed, in which case
+    ///     the last chunk is sent for chunked responses; or
+    ///   - the responder returns to the event loop after sending a
+    ///     header or data through the connection, including its own
+    ///     header, unless a declared body is incomplete or a chunked
+    ///     response is still streaming.
+    /// Responders which close the connection need do nothing.
+    ///
+    /// Note: Responders which write their whole response directly 
+    /// to the socket, bypassing the connection, must now call
+    /// finishResponse(), otherwise later requests on a keep-alive
+    /// connection are not handled.
+{
+public:
+    typedef std::shared_ptr<ServerConnection> Ptr;
+
+    ServerConnection(Server& server, net::Socket::Ptr socket);
+    virtual ~ServerConnection();
+    
+    //virtual bool send();
+        /// Sends the HTTP response
+    
+    virtual void close();
+        // Closes the HTTP connection
+
+    virtual int sendHeader();
+        // Sends the response header, and checks whether the
+        // response is finished once the responder returns.
+
+    void finishResponse();
+        // Signals that the response to the current request has 
+        // been sent, so the next request on a keep-alive connection
+        // can be handled. Pipelined requests which have already
+        // arrived are handled from an idle callback, so the responder
+        // is not destroyed before this call returns.
+    
+protected:        
+    virtual void onHeaders();
+    virtual void onPayload(const MutableBuffer& buffer);
+    virtual void onMessage();
+    virtual void onClose();
+                
+    Server& server();
+
+    bool headerSent() const;
+    bool responseSent() const;
+        // Returns true if the response to the current request
+        // appears to have been sent in full.
+
+    void scheduleResume();
+        // Checks the response, and handles any pipelined 
+        // requests once it is finished, from an idle callback.
+
+    void onResponseBody(std::size_t len);
+    void onOutgoingStateChange(void*, PacketStreamState& state, const PacketStreamState&);
+    static void onResume(uv_idle_t* handle);
+
+    http::Message* incomingHeader();
+    http::Message* outgoingHeader();
+
+    //
+    /// Server callbacks
+    //void onServerShutdown(void*);
+    
+protected:
+    Server& _server;
+    ServerResponder* _responder;    
+    bool _upgrade;
+    bool _requestComplete;
+    bool _responseComplete;
+    UInt64 _bodySent;
+    ServerAdapter* _serverAdapter;
+    uv_idle_t* _resumeIdle;
+
+    friend class ServerAdapter;
+};
+
+
+typedef std::vector<ServerConnection::Ptr> ServerConnectionList;
+typedef std::unordered_map<ServerConnection*, ServerConnection::Ptr> ServerConnectionMap;
+
+    
+// -------------------------------------------------------------------
+//
+class ServerAdapter: public ConnectionAdapter
+    /// Reads requests for a ServerConnection, holding back
+    /// pipelined requests until the current response is finished.
+{
+public:
+    ServerAdapter(ServerConnection& connection);
+    virtual ~ServerAdapter();
+
+    bool hasPending() const;
+        // Returns true if pipelined data is waiting for
+        // the current response to finish.
+
+    void parsePending();
+        // Parses the pipelined data once the response is finished.
+
+    virtual int send(const char* data, std::size_t len, int flags = 0);
+    virtual int send(const ConstBuffer* bufs, std::size_t count, int flags = 0);
+        // Counts the response body sent through the connection.
+
+    static const std::size_t MaxPendingSize = 64 * 1024;
+        // The most data buffered while waiting for a response
+        // before the connection is closed.
+
+protected:
+    virtual void onSocketRecv(const MutableBuffer& buffer, const net::Address& peerAddress);
+    virtual void onParserEnd();
+
+    void parse(const char* data, std::size_t len);
+
+    ServerConnection& _serverConnection;
+    Buffer _pending;
+};
+
+
+// -------------------------------------------------------------------
+//
+class ServerResponder
+    /// The abstract base class for HTTP ServerResponders 
+    /// created by HTTP Server.
+    ///
+    /// Derived classes must override the handleRequest() method.
+    ///
+    /// A new HTTPServerResponder object will be created for
+    /// each new HTTP request that is received by the HTTP Server.
+    ///
+{
+public:
+    ServerResponder(ServerConnection& connection) : 
+        _connection(connection)
+    {
+    }
+
+    virtual ~ServerResponder() {}
+
+    virtual void onHeaders(Request& /* request */) {}
+    virtual void onPayload(const MutableBuffer& /* body */) {}
+    virtual void onRequest(Request& /* request */, Response& /* response */) {}
+    virtual void onClose() {};
+
+    ServerConnection& connection()
+    {
+        return _connection;
+    }
+        
+    Request& request()
+    {
+        return _connection.request();
+    }
+    
+    Response& response()
+    {
+        return _connection.response();
+    }
+
+protected:
+    ServerConnection& _connection;
+
+private:
+    ServerResponder(const ServerResponder&); // = delete;
+    ServerResponder(ServerResponder&&); // = delete;
+    ServerResponder& operator=(const ServerResponder&); // = delete;
+    ServerResponder& operator=(ServerResponder&&); // = delete;
+};
+
+
+// -------------------------------------------------------------------
+//
+class ServerResponderFactory
+    /// This implementation of a ServerResponderFactory
+    /// is used by HTTPServer to create ServerResponder objects.
+{
+public:
+    ServerResponderFactory() {};
+    virtual ~ServerResponderFactory() {};
+
+    virtual ServerResponder* createResponder(ServerConnection& connection) = 0;
+        /// Factory method for instantiating the ServerResponder
+        /// instance using the given ServerConnection.
+};
+
+
+// -------------------------------------------------------------------
+//
+class Server
+    /// DISCLAIMER: This HTTP server is not intended to be standards 
+    /// compliant. It was created to be a fast (nocopy where possible)
+    /// solution for streaming video to web browsers.
+    ///
+    /// TODO: 
+    /// - SSL Server
+    /// - Enable responders (controllers?) to be instantiated via
+    ///    registered routes.
+{
+public:
+    net::TCPSocket::Ptr socket;
+    ServerResponderFactory* factory;
+    ServerConnectionMap connections;
+    net::Address address;
+    bool reusePort;             // Bind the listen socket with SO_REUSEPORT so  
+                                // several servers can share the port.
+    //Timer timer;
+
+    Server(short port, ServerResponderFactory* factory, uv::Loop* loop = uv::defaultLoop());
+        // Creates the server on the given event loop. Accepted 
+        // connections and their responders run on the same loop.
+        // The server takes ownership of the factory.
+
+    virtual ~Server();
+    
+    void start();
+    void shutdown();
+
+    UInt16 port();    
+
+    uv::Loop* loop() const;
+
+    NullSignal Shutdown;
+
+protected:    
+    ServerConnection::Ptr createConnection(const net::Socket::Ptr& sock);
+    ServerResponder* createResponder(ServerConnection& conn);
+
+    virtual void addConnection(ServerConnection::Ptr conn);
+    virtual void removeConnection(ServerConnection* conn);
+
+    void onAccept(const net::TCPSocket::Ptr& sock);
+    void onClose(); // main socket close
+    void onConnectionClose(void*); // connection socket close
+
+    friend class ServerConnection;
+};
+
+
+// ---------------------------------------------------------------------
+//
+class BadRequestHandler: public ServerResponder
+{
+public:
+    BadRequestHandler(ServerConnection& connection) :         
+        ServerResponder(connection)
+    {        
+    }
+
+    void onRequest(Request&, Response& response)
+    {
+        response.setStatus(http::StatusCode::BadRequest);
+        connection().sendHeader();
+        connection().close();
+    }
+};
+
+
+} } // namespace scy::http
+
+
+#endif
+
+
+
+
+/*
+// ---------------------------------------------------------------------
+//
+class FlashPolicyConnectionHook: public ServerResponder
+{
+public:
+    Poco::Net::TCPServerConnection* createConnection(const Poco::Net::StreamSocket& socket, const std::string& rawRequest)
+    {        
+        try 
+        {            
+            if (rawRequest.find("policy-file-request") != std::string::npos) {
+                traceL("HTTPStreamingRequestHandlerFactory") << "Send Flash Crossdomain XMLSocket Policy" << std::endl;
+                return new Net::FlashPolicyRequestHandler(socket, false);
+            }
+            else if (rawRequest.find("crossdomain.xml") != std::string::npos) {
+                traceL("HTTPStreamingRequestHandlerFactory") << "Send Flash Crossdomain HTTP Policy" << std::endl;
+                return new Net::FlashPolicyRequestHandler(socket, true);
+            }            
+        }
+        catch (std::exception&Exception& exc)
+        {
+            LogError("ServerConnectionHook") << "Bad Request: " << exc.what()/message()/ << std::endl;
+        }    
+        return nullptr;
+    };
+};
+*/
+    
+    /*
+    void onTimer(void*)
+    {
+        ServerConnectionList conns = ServerConnectionList(connections);
+        for (ServerConnectionList::iterator it = conns.begin(); it != conns.end();) {
+            if ((*it)->closed()) {
+                traceL("Server", this) << "Deleting connection: " << (*it) << std::endl;
+                //delete *it;
+                it = connections.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+    */
@@ -0,0 +1,114 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_HTTP_ShardedServer_H
+#define SCY_HTTP_ShardedServer_H
+
+
+#include "scy/http/server.h"
+#include "scy/net/shardrunner.h"
+#include "scy/mutex.h"
+
+#include <atomic>
+#include <vector>
+
+
+namespace scy { 
+namespace http {
+
+
+class ShardedServer
+    /// ShardedServer runs an HTTP server on each of a number of event
+    /// loop threads so request handling scales across CPU cores.
+    ///
+    /// Each shard owns a Server with its own SO_REUSEPORT listen socket,
+    /// and the kernel balances incoming connections between the shards.
+    /// A connection and its responders live on the shard which accepted
+    /// it, so shards share no state once a request has been dispatched.
+    ///
+    /// The ShardedServer takes ownership of the responder factory.
+    /// Factory calls are serialized so existing factories can be used 
+    /// unchanged, while the responders themselves run concurrently on 
+    /// the shard threads.
+{
+public:
+    struct Stats
+    {
+        std::size_t connections;    // Number of open connections
+        UInt64 accepted;            // Number of connections accepted
+        UInt64 requests;            // Number of requests dispatched
+
+        Stats() : connections(0), accepted(0), requests(0) {}
+    };
+
+    ShardedServer(short port, ServerResponderFactory* factory, int numThreads = 0);
+        // Creates the sharded server. One shard is created per 
+        // CPU core if numThreads is 0.
+
+    virtual ~ShardedServer();
+
+    virtual void start();
+        // Starts the shard threads and waits until each shard is
+        // listening. Throws an exception if any shard fails to start.
+
+    virtual void shutdown();
+        // Shuts down the shards and waits for their threads to exit.
+
+    UInt16 port() const;
+
+    int numThreads() const;
+
+    Stats stats() const;
+        // Returns the connection and request counts across all shards.
+
+    Stats stats(int shard) const;
+        // Returns the connection and request counts of the given shard.
+
+protected:
+    struct ShardStats
+    {
+        std::atomic<std::size_t> connections;
+        std::atomic<UInt64> accepted;
+        std::atomic<UInt64> requests;
+
+        ShardStats() : connections(0), accepted(0), requests(0) {}
+    };
+
+    class ShardServer;
+    class ShardFactory;
+
+    virtual ServerResponder* createResponder(ShardStats& stats, ServerConnection& conn);
+        // Creates a responder for a request received by a shard.
+
+    ServerResponderFactory* _factory;
+    net::ShardRunner _runner;
+    std::vector<ShardStats> _stats;
+    short _port;
+    mutable Mutex _mutex;
+
+private:
+    ShardedServer(const ShardedServer&); // = delete;
+    ShardedServer& operator=(const ShardedServer&); // = delete;
+};
+
+
+} } // namespace scy::http
+
+
+#endif // SCY_HTTP_ShardedServer_H
@@ -0,0 +1,520 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/http/parser.h"
+#include "scy/http/connection.h"
+#include "scy/logger.h"
+#include "scy/crypto/crypto.h"
+#include "scy/http/util.h"
+#include <stdexcept>
+
+
+using std::endl;
+
+
+namespace scy { 
+namespace http {
+
+
+Parser::Parser(http::Response* response) : 
+    _observer(nullptr),
+    _request(nullptr),
+    _response(response),
+    _parsed(0),
+    _error(nullptr)
+{
+    init(HTTP_RESPONSE);
+}
+
+
+Parser::Parser(http::Request* request) : 
+    _observer(nullptr),
+    _request(request),
+    _response(nullptr),
+    _parsed(0),
+    _error(nullptr)
+{
+    init(HTTP_REQUEST);
+}
+
+
+Parser::Parser(http_parser_type type) : 
+    _observer(nullptr),
+    _request(nullptr),
+    _response(nullptr),
+    _parsed(0),
+    _error(nullptr)
+{
+    init(type);
+}
+
+
+Parser::~Parser() 
+{
+    TraceLS(this) << "Destroy" << endl;    
+    reset();
+}
+
+
+void Parser::init(http_parser_type type)
+{
+    TraceLS(this) << "Init: " << type << endl;    
+
+    assert(_parser.data != this);
+
+    ::http_parser_init(&_parser, type);
+    _parser.data = this;
+    _settings.on_message_begin = on_message_begin;
+    _settings.on_url = on_url;
+    _settings.on_status_complete = on_status_complete;
+    _settings.on_header_field = on_header_field;
+    _settings.on_header_value = on_header_value;
+    _settings.on_headers_complete = on_headers_complete;
+    _settings.on_body = on_body;
+    _settings.on_message_complete = on_message_complete;
+
+    reset();
+}
+
+
+bool Parser::parse(const char* data, std::size_t len)
+{
+    TraceLS(this) << "Parse: " << len << endl;    
+    
+    assert(!complete());
+    assert(_parser.data == this);
+
+    if (complete()) {
+        setParserError("Parsing already complete");
+    }
+    
+    // Parse and handle errors
+    _parsed = ::http_parser_execute(&_parser, &_settings, data, len);
+    if (_parsed != len && !_parser.upgrade && !paused()) { //_parser.http_errno != HPE_OK
+        setParserError();
+    }
+
+    // Tokens which are split across reads must be copied, 
+    // since the read buffer will be reused.
+    _url.detach();
+    _lastHeaderField.detach();
+    _lastHeaderValue.detach();
+    
+    return complete();
+}
+
+
+void Parser::reset() 
+{
+    _complete = false;
+    _wasHeaderValue = true;
+    _url.clear();
+    _lastHeaderField.clear();
+    _lastHeaderValue.clear();
+    if (_error) {
+        delete _error;
+        _error = nullptr;
+    }
+    if (paused())
+        ::http_parser_pause(&_parser, 0);
+
+    // TODO: Reset parser internal state?
+}
+
+
+void Parser::pause()
+{
+    ::http_parser_pause(&_parser, 1);
+}
+
+
+bool Parser::paused() const
+{
+    return HTTP_PARSER_ERRNO(&_parser) == HPE_PAUSED;
+}
+
+
+std::size_t Parser::parsed() const
+{
+    return _parsed;
+}
+
+
+void Parser::setParserError(const std::string& message) //bool throwException, 
+{
+    assert(_parser.http_errno != HPE_OK);    
+    ParserError err;
+    err.code = HTTP_PARSER_ERRNO(&_parser);
+    err.message = message.empty() ? http_errno_name(err.code) : message;
+    onError(err);
+
+    //if (throwException)
+    //    throw std::runtime_error(err.message);
+}
+
+
+void Parser::setRequest(http::Request* request)
+{
+    assert(!_request);
+    assert(!_response);
+    assert(_parser.type == HTTP_REQUEST);
+    _request = request;
+}
+
+
+void Parser::setResponse(http::Response* response)
+{
+    assert(!_request);
+    assert(!_response);
+    assert(_parser.type == HTTP_RESPONSE);
+    _response = response;
+}
+    
+
+void Parser::setObserver(ParserObserver* observer)
+{
+    _observer = observer;
+}
+    
+
+http::Message* Parser::message()
+{
+    return _request ? static_cast<http::Message*>(_request) 
+        : _response ? static_cast<http::Message*>(_response) 
+        : nullptr;
+}
+
+
+ParserObserver* Parser::observer() const
+{
+    return _observer;
+}
+
+
+bool Parser::complete() const 
+{
+    return _complete;
+}
+
+
+bool Parser::upgrade() const 
+{
+    return _parser.upgrade > 0;
+}
+
+
+bool Parser::shouldKeepAlive() const 
+{
+    return http_should_keep_alive(&_parser) > 0;
+}
+
+
+//
+// Events
+//
+
+void Parser::onURL(const std::string& value)
+{
+    if (_request)
+        _request->setURI(value);
+}
+
+
+void Parser::onHeader(const char* name, std::size_t nameLen, const char* value, std::size_t valueLen)
+{
+    if (message()) {
+        message()->add(name, nameLen, value, valueLen);
+        if (_observer) {
+            auto entry = message()->end() - 1;
+            _observer->onParserHeader(entry->first, entry->second);
+        }
+    }
+    else if (_observer)
+        _observer->onParserHeader(std::string(name, nameLen), std::string(value, valueLen));
+}
+
+
+void Parser::flushURL()
+{
+    if (!_url.active)
+        return;
+
+    // The URL is materialized in the token buffer, which 
+    // keeps its capacity between messages.
+    _url.detach();
+    onURL(_url.buffer);
+    _url.clear();
+}
+
+
+void Parser::flushHeader()
+{
+    if (_lastHeaderField.active) {
+        onHeader(_lastHeaderField.begin(), _lastHeaderField.length(), 
+            _lastHeaderValue.begin(), _lastHeaderValue.length());
+    }
+    _lastHeaderField.clear();
+    _lastHeaderValue.clear();
+}
+
+
+void Parser::onHeadersEnd()
+{            
+    /// HTTP version
+    //start_line_.version(parser_.http_major, parser_.http_minor);
+
+    /// KeepAlive
+    //headers->setKeepAlive(http_should_keep_alive(parser) > 0);
+    
+    /// Request HTTP method
+    if (_request)
+        _request->setMethod(http_method_str(static_cast<http_method>(_parser.method)));
+    
+    if (_observer)
+        _observer->onParserHeadersEnd();
+}
+
+
+void Parser::onBody(const char* buf, std::size_t len) //size_t off, 
+{
+    TraceLS(this) << "onBody" << endl;    
+    if (_observer)
+        _observer->onParserChunk(buf, len); //Buffer(buf+off,len) + off
+}
+
+
+void Parser::onMessageEnd() 
+{
+    TraceLS(this) << "onMessageEnd" << endl;        
+    _complete = true;
+    if (_observer)
+        _observer->onParserEnd();
+}
+
+
+void Parser::onError(const ParserError& err)
+{
+    TraceLS(this) << "On error: " << err.code << ": " << err.message << endl;    
+    _complete = true;
+    _error = new ParserError;
+    _error->code = err.code;
+    _error->message = err.message;
+    if (_observer)
+        _observer->onParserError(err);
+}
+
+
+
+//
+// http_parser callbacks
+//
+
+int Parser::on_message_begin(http_parser* parser) 
+{    
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    self->reset();
+
+    // Clear headers left over from the previous message
+    // on a keep-alive connection.
+    if (self->message())
+        self->message()->clear();
+    return 0;
+}
+
+
+int Parser::on_url(http_parser* parser, const char *at, std::size_t len) 
+{
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+    assert(at);    
+
+    // http_parser reports an empty fragment if a 
+    // read ends where the URL begins.
+    if (!len)
+        return 0;
+
+    if (self->_url.active)
+        self->_url.append(at, len);
+    else
+        self->_url.assign(at, len);
+    return 0;
+}
+
+
+int Parser::on_status_complete(http_parser* parser)
+{
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    /// Handle response status line
+    if (self->_response)
+        self->_response->setStatus((http::StatusCode)parser->status_code);
+
+    return 0;
+}
+
+
+int Parser::on_header_field(http_parser* parser, const char* at, std::size_t len) 
+{    
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    self->flushURL();
+    if (self->_wasHeaderValue) {
+        self->flushHeader();
+        self->_lastHeaderField.assign(at, len);
+        self->_wasHeaderValue = false;
+    } 
+    else {
+        self->_lastHeaderField.append(at, len);
+    }
+
+    return 0;
+}
+
+
+int Parser::on_header_value(http_parser* parser, const char* at, std::size_t len) 
+{
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    if (!self->_wasHeaderValue) {
+        self->_lastHeaderValue.assign(at, len);
+        self->_wasHeaderValue = true;
+    } 
+    else {
+        self->_lastHeaderValue.append(at, len);
+    }
+
+    return 0;
+}
+
+
+int Parser::on_headers_complete(http_parser* parser)
+{
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+    assert(&self->_parser == parser);
+
+    // Add last entry if any
+    self->flushURL();
+    self->flushHeader();
+    self->_wasHeaderValue = true;
+
+    self->onHeadersEnd();
+    return 0;
+}
+
+
+int Parser::on_body(http_parser* parser, const char* at, std::size_t len) 
+{        
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    self->onBody(at, len);
+    return 0;
+}
+
+
+int Parser::on_message_complete(http_parser* parser) 
+{    
+    /// When http_parser finished receiving a message, signal message complete
+    auto self = reinterpret_cast<Parser*>(parser->data);
+    assert(self);
+
+    self->onMessageEnd();
+    return 0;
+}
+
+
+
+//
+// Parser token
+//
+
+Parser::Token::Token() :
+    data(nullptr),
+    size(0),
+    active(false),
+    copied(false)
+{
+}
+
+
+void Parser::Token::assign(const char* at, std::size_t len)
+{
+    data = at;
+    size = len;
+    active = true;
+    copied = false;
+}
+
+
+void Parser::Token::append(const char* at, std::size_t len)
+{
+    if (!active) {
+        assign(at, len);
+        return;
+    }
+
+    // Fragments reported within the same parse() call are
+    // contiguous, otherwise the token has already been copied.
+    if (!copied && data + size == at) {
+        size += len;
+        return;
+    }
+    detach();
+    buffer.append(at, len);
+}
+
+
+void Parser::Token::detach()
+{
+    if (!active || copied)
+        return;
+    buffer.assign(data, size);
+    copied = true;
+}
+
+
+void Parser::Token::clear()
+{
+    data = nullptr;
+    size = 0;
+    active = false;
+    copied = false;
+    buffer.clear();
+}
+
+
+const char* Parser::Token::begin() const
+{
+    return copied ? buffer.data() : data;
+}
+
+
+std::size_t Parser::Token::length() const
+{
+    return copied ? buffer.size() : size;
+}
+
+
+} } // namespace scy::http
\ No newline at end of file
@@ -0,0 +1,611 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/http/server.h"
+#include "scy/http/websocket.h"
+#include "scy/logger.h"
+#include "scy/util.h"
+
+
+using std::endl;
+
+
+namespace scy { 
+namespace http {
+
+    
+Server::Server(short port, ServerResponderFactory* factory, uv::Loop* loop) :
+    socket(net::makeSocket<net::TCPSocket>(loop)),
+    factory(factory),
+    address("0.0.0.0", port),
+    reusePort(false)
+{
+    TraceLS(this) << "Create" << endl;
+}
+
+
+Server::~Server()
+{
+    TraceLS(this) << "Destroy" << endl;
+    shutdown();
+    if (factory)
+        delete factory;
+}
+
+    
+void Server::start()
+{    
+    // TODO: Register self as an observer
+    //socket.reset(new net::TCPSocket);
+    socket->AcceptConnection += delegate(this, &Server::onAccept);    
+    socket->Close += delegate(this, &Server::onClose);
+    socket->bind(address, reusePort ? net::ReusePort : 0);
+    socket->listen();
+
+    TraceLS(this) << "Server listening on " << port() << endl;        
+
+    //timer.Timeout += delegate(this, &Server::onTimer);
+    //timer.start(5000, 5000);
+}
+
+
+void Server::shutdown() 
+{        
+    TraceLS(this) << "Shutdown" << endl;
+
+    if (socket) {
+        socket->AcceptConnection -= delegate(this, &Server::onAccept);    
+        socket->Close -= delegate(this, &Server::onClose);
+        socket->close();
+    }
+
+    Shutdown.emit(this);
+
+    // Connections are removed via the close callback
+    // so close a copy of the connection list.
+    ServerConnectionList conns;
+    conns.reserve(connections.size());
+    for (auto& kv : connections)
+        conns.push_back(kv.second);
+    for (auto& conn : conns)
+        conn->close();
+    assert(this->connections.empty());
+}
+
+
+UInt16 Server::port()
+{
+    return address.port();
+}    
+
+
+uv::Loop* Server::loop() const
+{
+    return socket->loop();
+}
+
+
+ServerConnection::Ptr Server::createConnection(const net::Socket::Ptr& sock)
+{
+    auto conn = std::shared_ptr<ServerConnection>(
+        new ServerConnection(*this, sock), 
+            deleter::Deferred<ServerConnection>());
+    addConnection(conn);
+    return conn; //return new ServerConnection(*this, sock);
+}
+
+
+ServerResponder* Server::createResponder(ServerConnection& conn)
+{
+    // The initial HTTP request headers have already
+    // been parsed by now, but the request body may 
+    // be incomplete (especially if chunked).
+    return factory->createResponder(conn);
+}
+
+
+void Server::addConnection(ServerConnection::Ptr conn) 
+{        
+    TraceLS(this) << "Adding connection: " << conn << endl;
+    conn->Close += sdelegate(this, &Server::onConnectionClose, -1); // lowest priority
+    connections[conn.get()] = conn;
+}
+
+
+void Server::removeConnection(ServerConnection* conn) 
+{        
+    TraceLS(this) << "Removing connection: " << conn << endl;
+    auto it = connections.find(conn);
+    if (it != connections.end()) {
+        connections.erase(it);
+        return;
+    }
+    assert(0 && "unknown connection");
+}
+
+
+void Server::onAccept(const net::TCPSocket::Ptr& sock)
+{    
+    TraceLS(this) << "On server accept" << endl;
+    ServerConnection::Ptr conn = createConnection(sock);
+    if (!conn) {        
+        WarnL << "Cannot create connection" << endl;
+        assert(0);
+    }
+}
+
+
+void Server::onClose() 
+{
+    TraceLS(this) << "On server socket close" << endl;
+}
+
+
+void Server::onConnectionClose(void* sender)
+{
+    TraceLS(this) << "On connection close" << endl;
+    removeConnection(reinterpret_cast<ServerConnection*>(sender));
+}
+
+
+//
+// Server Connection
+//
+
+
+ServerConnection::ServerConnection(Server& server, net::Socket::Ptr socket) : 
+    Connection(socket), 
+    _server(server), 
+    _responder(nullptr),
+    _upgrade(false),
+    _requestComplete(false),
+    _responseComplete(false),
+    _bodySent(0),
+    _serverAdapter(new ServerAdapter(*this)),
+    _resumeIdle(nullptr)
+{    
+    TraceLS(this) << "Create" << endl;
+
+    replaceAdapter(_serverAdapter);
+    Outgoing.StateChange += sdelegate(this, &ServerConnection::onOutgoingStateChange);
+}
+
+    
+ServerConnection::~ServerConnection() 
+{    
+    TraceLS(this) << "Destroy" << endl;
+
+    if (_responder) {
+        TraceLS(this) << "Destroy: Responder: " << _responder << endl;
+        delete _responder;
+    }
+    if (_resumeIdle) {
+        uv_close(reinterpret_cast<uv_handle_t*>(_resumeIdle), [](uv_handle_t* handle) {
+            delete reinterpret_cast<uv_idle_t*>(handle);
+        });
+    }
+    Outgoing.StateChange -= sdelegate(this, &ServerConnection::onOutgoingStateChange);
+}
+
+    
+void ServerConnection::close()
+{
+    if (!closed()) {
+        Connection::close(); // close and destroy
+    }
+}
+
+            
+Server& ServerConnection::server()
+{
+    return _server;
+}
+
+
+void ServerConnection::finishResponse()
+{
+    if (_responseComplete)
+        return;
+
+    TraceLS(this) << "Finish response" << endl;
+
+    _responseComplete = true;
+    if (closed() || _upgrade || !_serverAdapter->hasPending())
+        return;
+
+    // The responder may still be on the stack, so handle
+    // pipelined requests from the event loop.
+    scheduleResume();
+}
+
+
+int ServerConnection::sendHeader()
+{
+    int res = Connection::sendHeader();
+    if (_requestComplete && !_responseComplete)
+        scheduleResume();
+    return res;
+}
+
+
+void ServerConnection::scheduleResume()
+{
+    if (closed())
+        return;
+    if (!_resumeIdle) {
+        _resumeIdle = new uv_idle_t;
+        _resumeIdle->data = this;
+        uv_idle_init(socket()->loop(), _resumeIdle);
+    }
+    uv_idle_start(_resumeIdle, ServerConnection::onResume);
+}
+
+
+void ServerConnection::onResume(uv_idle_t* handle)
+{
+    auto self = reinterpret_cast<ServerConnection*>(handle->data);
+    TraceLS(self) << "On resume" << endl;
+
+    uv_idle_stop(handle);
+    if (self->closed() || self->_upgrade)
+        return;
+
+    // The responder has returned to the event loop since it last
+    // sent something, so finish the response if it looks complete.
+    if (!self->_responseComplete) {
+        if (!self->_requestComplete || !self->responseSent())
+            return;
+        self->finishResponse();
+    }
+    if (self->_serverAdapter->hasPending())
+        self->_serverAdapter->parsePending();
+}
+
+
+bool ServerConnection::headerSent() const
+{
+    // The header buffer is only written when the connection sends 
+    // the response header, and is cleared for each new request.
+    return !_headerBuffer.empty();
+}
+
+
+bool ServerConnection::responseSent() const
+{
+    // Something has been sent for the current request, any declared
+    // body has been sent through the connection, and chunked responses
+    // are no longer streaming.
+    if (!headerSent() && _bodySent == 0)
+        return false;
+    if (_response.isChunkedTransferEncoding() && Outgoing.active())
+        return false;
+    return !_response.hasContentLength() || _bodySent == 0 || 
+        _bodySent >= _response.getContentLength();
+}
+
+
+void ServerConnection::onResponseBody(std::size_t len)
+{
+    // The response is finished once the declared body has been sent,
+    // otherwise check again once the responder returns to the loop.
+    _bodySent += len;
+    if (!_requestComplete || _responseComplete)
+        return;
+    if (_response.hasContentLength() && 
+        _bodySent >= _response.getContentLength())
+        finishResponse();
+    else
+        scheduleResume();
+}
+
+
+void ServerConnection::onOutgoingStateChange(void*, PacketStreamState& state, const PacketStreamState&)
+{
+    if (!_requestComplete || _responseComplete || _upgrade || closed() || !headerSent())
+        return;
+
+    // Stopping the Outgoing stream ends a streamed response
+    if (state.equals(PacketStreamState::Stopped) || 
+        state.equals(PacketStreamState::Closed)) {
+        TraceLS(this) << "Outgoing stream ended" << endl;
+        if (_response.isChunkedTransferEncoding())
+            _socket->send("0\r\n\r\n", 5);
+        finishResponse();
+    }
+}
+    
+
+//
+// Connection Callbacks
+
+void ServerConnection::onHeaders() 
+{
+    TraceLS(this) << "On headers" << endl;    
+
+    // The connection may have been closed while handling a
+    // previous request contained in the same read.
+    if (closed()) {
+        TraceLS(this) << "On headers: Closed" << endl;    
+        return;
+    }
+
+    // A keep-alive or pipelined request follows the previous one.
+    // The adapter only reads it once the previous responder has
+    // finished, and never from within one of its callbacks.
+    if (_requestComplete) {
+        TraceLS(this) << "On headers: Next request" << endl;    
+        assert(_responseComplete);
+        delete _responder;
+        _responder = nullptr;
+        _requestComplete = false;
+        _responseComplete = false;
+        _bodySent = 0;
+        _headerBuffer.clear();
+        _response.clear();
+        _response.setStatus(StatusCode::OK);
+        shouldSendHeader(true);
+    }
+    
+    /*
+    // Note: To upgrade the connection we need to upgrade the 
+    // ConnectionAdapter, but we can't do it yet since we are
+    // still inside the default adapter's parser callback scope.
+    // Just set the _upgrade flag for now, and we will do the actual 
+    // upgrade when the parser is complete (on the on next iteration).
+    _upgrade = _request.hasToken("Connection", "upgrade");
+    */    
+
+    // Upgrade the connection if required
+    if (util::icompare(_request.get("Connection", ""), "upgrade") == 0 && 
+        util::icompare(_request.get("Upgrade", ""), "websocket") == 0) {            
+        TraceLS(this) << "Upgrading to WebSocket: " << _request << endl;
+        _upgrade = true;
+
+        auto wsAdapter = new ws::ConnectionAdapter(*this, ws::ServerSide);
+                
+        // Note: To upgrade the connection we need to replace the 
+        // underlying SocketAdapter instance. Since we are currently 
+        // inside the default ConnectionAdapter's HTTP sarser callback 
+        // scope we just swap the SocketAdapter instance pointers and do
+        // a deferred delete on the old adapter. No more callbacks will be 
+        // received from the old adapter after replaceAdapter is called.
+        //socket()->adapter = new ws::ConnectionAdapter(*this, ws::ServerSide); //wsAdapter; //replaceAdapter(wsAdapter);        
+        replaceAdapter(wsAdapter);
+
+        std::string buffer;
+        _request.write(buffer);
+
+        // Send the handshake request to the WS adapter for handling.
+        // If the request fails the underlying socket will be closed
+        // resulting in the destruction of the current connection.
+        wsAdapter->onSocketRecv(mutableBuffer(buffer), socket()->peerAddress());
+    }
+    
+    // Instantiate the responder when request headers have been parsed
+    _responder = _server.createResponder(*this);
+
+    // If no responder was created we close the connection.
+    // TODO: Should we return a 404 instead?
+    if (!_responder) {
+        WarnL << "Ignoring unhandled request: " << _request << endl;    
+        close();
+        return;
+    }
+
+    // Upgraded connections don't receive the onHeaders callback
+    if (!_upgrade)
+        _responder->onHeaders(_request);
+
+    // NOTE: Outgoing.start() must be manually called by the ServerResponder,
+    // since adapters cannot be added once started.
+    // Start the Outgoing packet stream
+    //Outgoing.start();
+}
+
+
+void ServerConnection::onPayload(const MutableBuffer& buffer)
+{
+    TraceLS(this) << "On payload: " << buffer.size() << endl;    
+
+    // The connection may have been closed inside a previous callback.
+    if (closed()) {
+        TraceLS(this) << "On payload: Closed" << endl;    
+        return;
+    }
+    
+    //assert(_upgrade); // no payload for upgrade requests
+    assert(_responder);
+    _responder->onPayload(buffer);
+}
+
+
+void ServerConnection::onMessage() 
+{
+    TraceLS(this) << "On complete" << endl;    
+
+    // The connection may have been closed inside a previous callback.
+    if (closed()) {
+        TraceLS(this) << "On complete: Closed" << endl;    
+        return;
+    }
+
+    // The HTTP request is complete.
+    // The request handler can give a response.
+    assert(_responder);
+    assert(!_requestComplete);
+    _requestComplete = true;
+    _responder->onRequest(_request, _response);
+
+    // A responder which has sent its response header and isn't 
+    // streaming is done. Other responders answer later.
+    if (!closed() && !_upgrade && headerSent() && !Outgoing.active() && 
+        responseSent())
+        finishResponse();
+}
+
+
+void ServerConnection::onClose() 
+{
+    TraceLS(this) << "On close" << endl;    
+
+    if (_responder)
+        _responder->onClose();
+
+    Connection::onClose();
+}
+
+
+/*
+void ServerConnection::onServerShutdown(void*)
+{
+    TraceLS(this) << "On server shutdown" << endl;    
+
+    close();
+}
+*/
+
+
+http::Message* ServerConnection::incomingHeader() 
+{ 
+    return static_cast<http::Message*>(&_request);
+}
+
+
+http::Message* ServerConnection::outgoingHeader() 
+{ 
+    return static_cast<http::Message*>(&_response);
+}
+
+
+//
+// Server Adapter
+//
+
+
+ServerAdapter::ServerAdapter(ServerConnection& connection) : 
+    ConnectionAdapter(connection, HTTP_REQUEST),
+    _serverConnection(connection)
+{
+}
+
+
+ServerAdapter::~ServerAdapter()
+{
+}
+
+
+bool ServerAdapter::hasPending() const
+{
+    return _parser.paused() && !_pending.empty();
+}
+
+
+void ServerAdapter::parsePending()
+{
+    TraceLS(this) << "Parse pending: " << _pending.size() << endl;    
+
+    Buffer pending;
+    pending.swap(_pending);
+    parse(pending.data(), pending.size());
+}
+
+
+int ServerAdapter::send(const char* data, std::size_t len, int flags)
+{
+    int res = ConnectionAdapter::send(data, len, flags);
+    if (res >= 0 && len)
+        _serverConnection.onResponseBody(len);
+    return res;
+}
+
+
+int ServerAdapter::send(const ConstBuffer* bufs, std::size_t count, int flags)
+{
+    int res = ConnectionAdapter::send(bufs, count, flags);
+    if (res > 0)
+        _serverConnection.onResponseBody(res);
+    return res;
+}
+
+
+void ServerAdapter::onSocketRecv(const MutableBuffer& buf, const net::Address& /* peerAddr */)
+{
+    TraceLS(this) << "On socket recv: " << buf.size() << endl;    
+
+    // Hold back pipelined requests until the current response is
+    // finished, and behind any which are already waiting.
+    if (_parser.paused() && (!_serverConnection._responseComplete || !_pending.empty())) {
+        if (_pending.size() + buf.size() > MaxPendingSize) {
+            WarnL << "Closing connection with too many pipelined requests" << endl;    
+            _connection.close();
+            return;
+        }
+        _pending.insert(_pending.end(), bufferCast<const char*>(buf), 
+            bufferCast<const char*>(buf) + buf.size());
+        return;
+    }
+
+    parse(bufferCast<const char*>(buf), buf.size());
+}
+
+
+void ServerAdapter::parse(const char* data, std::size_t len)
+{
+    while (true) {
+        if (_parser.complete()) {
+            // Only keep-alive requests pause the parser
+            if (!_parser.paused()) {
+                WarnL << "Discarding data after the last request: " << len << endl;
+                return;
+            }
+
+            // The response to the previous request is finished
+            _parser.reset();
+        }
+
+        _parser.parse(data, len);
+        if (_connection.closed() || !_parser.paused())
+            return;
+
+        // The parser stopped at the end of a keep-alive request
+        data += _parser.parsed();
+        len -= _parser.parsed();
+        if (!len)
+            return;
+
+        if (!_serverConnection._responseComplete) {
+            _pending.assign(data, data + len);
+            return;
+        }
+    }
+}
+
+
+void ServerAdapter::onParserEnd()
+{
+    ConnectionAdapter::onParserEnd();
+
+    // Stop at the end of a keep-alive request, so pipelined
+    // requests wait for the response.
+    if (!_connection.closed() && _parser.shouldKeepAlive() && !_parser.upgrade())
+        _parser.pause();
+}
+
+
+} } // namespace scy::http
\ No newline at end of file
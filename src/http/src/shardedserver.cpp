@@ -0,0 +1,187 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/http/shardedserver.h"
+#include "scy/logger.h"
+
+#include <stdexcept>
+
+
+using std::endl;
+
+
+namespace scy { 
+namespace http {
+
+
+class ShardedServer::ShardServer: public Server, public async::Startable
+    /// The Server run by each shard. Connection counts
+    /// are recorded in the shard stats.
+{
+public:
+    ShardServer(short port, ServerResponderFactory* factory, uv::Loop* loop, ShardStats& stats) :
+        Server(port, factory, loop),
+        _stats(stats)
+    {
+        reusePort = true;
+    }
+
+    virtual void start() 
+    { 
+        Server::start(); 
+    }
+
+    virtual void stop() 
+    { 
+        Server::shutdown(); 
+    }
+
+protected:
+    virtual void addConnection(ServerConnection::Ptr conn)
+    {
+        Server::addConnection(conn);
+        _stats.connections.fetch_add(1, std::memory_order_relaxed);
+        _stats.accepted.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    virtual void removeConnection(ServerConnection* conn)
+    {
+        Server::removeConnection(conn);
+        _stats.connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    ShardStats& _stats;
+};
+
+
+class ShardedServer::ShardFactory: public ServerResponderFactory
+    /// Forwards responder creation on a shard 
+    /// to the ShardedServer.
+{
+public:
+    ShardFactory(ShardedServer& server, ShardStats& stats) :
+        _server(server),
+        _stats(stats)
+    {
+    }
+
+    virtual ServerResponder* createResponder(ServerConnection& conn)
+    {
+        return _server.createResponder(_stats, conn);
+    }
+
+protected:
+    ShardedServer& _server;
+    ShardStats& _stats;
+};
+
+
+ShardedServer::ShardedServer(short port, ServerResponderFactory* factory, int numThreads) :
+    _factory(factory),
+    _runner(numThreads),
+    _stats(_runner.numThreads()),
+    _port(port)
+{
+}
+
+
+ShardedServer::~ShardedServer() 
+{
+    shutdown();
+    if (_factory)
+        delete _factory;
+}
+
+
+void ShardedServer::start()
+{
+    assert(!_runner.running());
+
+    for (auto& stats : _stats) {
+        stats.connections = 0;
+        stats.accepted = 0;
+        stats.requests = 0;
+    }
+
+    try {
+        _runner.start([this](int index, uv::Loop* loop) {
+            ShardStats& stats = _stats[index];
+            return new ShardServer(_port, new ShardFactory(*this, stats), loop, stats);
+        });
+    }
+    catch (std::exception& exc) {
+        throw std::runtime_error(std::string("Cannot start HTTP server shard: ") + exc.what());
+    }
+    
+    InfoL << "Started " << numThreads() << " shards on port " << _port << endl;
+}
+
+
+void ShardedServer::shutdown()
+{
+    _runner.stop();
+}
+
+
+ServerResponder* ShardedServer::createResponder(ShardStats& stats, ServerConnection& conn)
+{
+    stats.requests.fetch_add(1, std::memory_order_relaxed);
+
+    Mutex::ScopedLock lock(_mutex);
+    return _factory->createResponder(conn);
+}
+
+
+UInt16 ShardedServer::port() const
+{
+    return _port;
+}
+
+
+int ShardedServer::numThreads() const
+{
+    return _runner.numThreads();
+}
+
+
+ShardedServer::Stats ShardedServer::stats() const
+{
+    Stats stats;
+    for (int i = 0; i < static_cast<int>(_stats.size()); i++) {
+        Stats s = this->stats(i);
+        stats.connections += s.connections;
+        stats.accepted += s.accepted;
+        stats.requests += s.requests;
+    }
+    return stats;
+}
+
+
+ShardedServer::Stats ShardedServer::stats(int index) const
+{
+    assert(index >= 0 && index < static_cast<int>(_stats.size()));
+    Stats stats;
+    stats.connections = _stats[index].connections.load(std::memory_order_relaxed);
+    stats.accepted = _stats[index].accepted.load(std::memory_order_relaxed);
+    stats.requests = _stats[index].requests.load(std::memory_order_relaxed);
+    return stats;
+}
+
+
+} } // namespace scy::http
@@ -0,0 +1,1640 @@
+#include "scy/application.h"
+#include "scy/http/server.h"
+#include "scy/http/shardedserver.h"
+#include "scy/http/connection.h"
+#include "scy/http/client.h"
+#include "scy/http/websocket.h"
+#include "scy/http/packetizers.h"
+#include "scy/http/form.h"
+#include "scy/http/util.h"
+#include "scy/http/url.h"
+#include "scy/http/parser.h"
+#include "scy/async.h"
+#include "scy/timer.h"
+#include "scy/idler.h"
+
+#include "scy/base.h"
+#include "scy/logger.h"
+#include "scy/net/sslmanager.h"
+#include "scy/net/sslcontext.h"
+#include "scy/net/address.h"
+
+#include "assert.h"
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <map>
+
+
+using std::endl;
+using namespace scy;
+
+
+/*
+// Detect memory leaks on winders
+#if defined(_DEBUG) && defined(_WIN32)
+#include "MemLeakDetect/MemLeakDetect.h"
+#include "MemLeakDetect/MemLeakDetect.cpp"
+CMemLeakDetect memLeakDetect;
+#endif
+*/
+
+
+namespace scy {
+namespace http {
+
+    
+#define TEST_SSL 1 //
+#define TEST_HTTP_PORT 1337
+#define TEST_HTTPS_PORT 1338
+
+    
+//
+/// HTTP Server test helpers
+//
+
+struct RandomDataSource: public Idler 
+{
+    PacketSignal signal;
+
+    virtual void onIdle()
+    {
+      RawPacket packet("hello", 5);
+        signal.emit(this, packet);
+    }
+};    
+
+
+class BasicResponder: public ServerResponder
+    /// Basic server responder (make echo?)
+{
+public:
+    BasicResponder(ServerConnection& conn) : 
+        ServerResponder(conn)
+    {
+        DebugL << "Creating" << endl;
+    }
+
+    void onRequest(Request& request, Response& response) 
+    {
+        DebugL << "On complete" << endl;
+
+        response.setContentLength(14);  // headers will be auto flushed
+
+        connection().send("hello universe", 14); 
+        connection().close();
+    }
+};
+
+
+class KeepAliveResponder: public ServerResponder
+    /// Responds without closing the connection. The response
+    /// is finished when onRequest() returns.
+{
+public:
+    KeepAliveResponder(ServerConnection& conn) : 
+        ServerResponder(conn)
+    {
+    }
+
+    void onRequest(Request& request, Response& response) 
+    {
+        response.setContentLength(5);
+        connection().sendHeader();
+        connection().socket()->send("hello", 5); 
+    }
+};
+
+
+class DeferredResponder: public ServerResponder
+    /// Responds from a timer callback some time after the 
+    /// request, echoing the request's number as the body.
+    ///
+    /// The header is sent through the connection and the body 
+    /// through the socket for /deferred, the response is sent 
+    /// through the connection with a Content-Length for /sent,
+    /// streamed as chunks through the Outgoing stream for /streamed,
+    /// and sent with the responder's own header for /own. None of
+    /// the responses are finished explicitly.
+{
+public:
+    Timer timer;
+    ChunkedAdapter chunker;
+
+    DeferredResponder(ServerConnection& conn) : 
+        ServerResponder(conn),
+        timer(conn.socket()->loop()),
+        chunker(&conn)
+    {
+    }
+
+    void onRequest(Request& request, Response& response) 
+    {
+        timer.Timeout += delegate(this, &DeferredResponder::onTimeout);
+        timer.start(10, 0);
+    }
+
+    void onTimeout(void*) 
+    {
+        // The request is not replaced by a pipelined one
+        // until the response is finished
+        timer.stop();
+        const std::string& uri = request().getURI();
+        std::string body(uri.substr(uri.find('=') + 1));
+        if (uri.find("/sent") == 0) {
+            response().setContentLength(body.size());
+            connection().Outgoing.start();
+            connection().send(body.data(), body.size());
+        }
+        else if (uri.find("/streamed") == 0) {
+            // A previous response may have left the stream running
+            connection().Outgoing.stop();
+            connection().Outgoing.attach(&chunker, 0, false);
+            connection().Outgoing.start();
+            connection().send(body.data(), body.size());
+            connection().Outgoing.stop();
+            connection().Outgoing.detach(&chunker);
+        }
+        else if (uri.find("/own") == 0) {
+            std::string raw("HTTP/1.1 200 OK\r\nConnection: keep-alive\r\n\r\n" + body);
+            connection().shouldSendHeader(false);
+            connection().Outgoing.start();
+            connection().send(raw.data(), raw.size());
+        }
+        else {
+            response().setContentLength(body.size());
+            connection().sendHeader();
+            connection().socket()->send(body.data(), body.size()); 
+        }
+    }
+};
+
+
+class ChunkedResponder: public ServerResponder
+    /// Chunked responder which broadcasts random data.
+{
+public:
+    RandomDataSource dataSource;
+    bool gotHeaders;
+    bool gotRequest;
+    bool gotClose;
+
+    ChunkedResponder(ServerConnection& conn) : 
+        ServerResponder(conn), 
+        gotHeaders(false), 
+        gotRequest(false), 
+        gotClose(false)
+    {
+        //conn.Outgoing.attach(new http::ChunkedAdapter(conn)); //"text/html"
+        //conn.Outgoing.attachSource(&dataSource.signal, false);
+        //dataSource.signal += sdelegate(&conn.socket(), &Socket::send);
+    }
+
+    ~ChunkedResponder()
+    {
+        assert(gotHeaders);
+        assert(gotRequest);
+        assert(gotClose);
+    }
+
+    void onHeaders(Request& request) 
+    {
+        gotHeaders = true;
+    }
+
+    void onRequest(Request& request, Response& response) 
+    {
+        gotRequest = true;
+        
+        connection().response().set("Access-Control-Allow-Origin", "*");
+        connection().response().set("Content-Type", "text/html");
+        connection().response().set("Transfer-Encoding", "chunked");
+
+        // headers pushed through automatically
+        //connection().sendHeader();
+
+        // Start shooting data at the client
+        //dataSource.start();
+        assert(0);
+    }
+
+    void onClose()
+    {
+        DebugL << "On connection close" << endl;
+        gotClose = true;
+        dataSource.cancel();
+    }
+};
+
+
+class WebSocketResponder: public ServerResponder
+{
+public:
+    bool gotPayload;
+    bool gotClose;
+
+    WebSocketResponder(ServerConnection& conn) : 
+        ServerResponder(conn), 
+        gotPayload(false), 
+        gotClose(false)
+    {
+        DebugL << "Creating" << endl;
+    }
+
+    ~WebSocketResponder()
+    {
+        DebugL << "destroy" << endl;
+        assert(gotPayload);
+        assert(gotClose);
+    }
+
+    void onPayload(const Buffer& body)
+    {
+        DebugL << "On payload: " << body.size() << endl;
+
+        gotPayload = true;
+
+        // Enco the request back to the client
+        connection().send(body.data(), body.size());
+    }
+
+    void onClose()
+    {
+        DebugL << "On connection close" << endl;
+        gotClose = true;
+    }
+};
+
+
+class OurServerResponderFactory: public ServerResponderFactory
+// A Server Responder Factory for testing the HTTP server
+{
+public:
+    ServerResponder* createResponder(ServerConnection& conn)
+    {        
+        std::ostringstream os;
+        conn.request().write(os);
+        std::string headers(os.str().data(), os.str().length());
+        DebugL << "Incoming Request: " << headers << endl; // remove me
+
+        if (conn.request().getURI() == "/chunked")
+            return new ChunkedResponder(conn);
+        else if (conn.request().getURI() == "/keepalive")
+            return new KeepAliveResponder(conn);
+        else if (conn.request().getURI().find("/deferred") == 0 ||
+            conn.request().getURI().find("/sent") == 0 ||
+            conn.request().getURI().find("/streamed") == 0 ||
+            conn.request().getURI().find("/own") == 0)
+            return new DeferredResponder(conn);
+        else if (conn.request().getURI() == "/websocket")
+            return new WebSocketResponder(conn);
+        else
+            return new BasicResponder(conn);
+    }
+};
+
+
+//
+/// Socket test helpers
+//
+
+template <typename SocketT>
+class SocketClientEchoTest
+    /// Helper class for testing sockets (TCP, SLL, UDP)
+{
+public:
+    SocketT socket;
+    net::Address address;
+
+    SocketClientEchoTest(const net::Address& addr) : //, bool ghost = false
+        address(addr)
+    {        
+        DebugL << "Creating: " << addr << endl;
+
+        socket.Recv += sdelegate(this, &SocketClientEchoTest::onRecv);
+        socket.Connect += sdelegate(this, &SocketClientEchoTest::onConnect);
+        socket.Error += sdelegate(this, &SocketClientEchoTest::onError);
+        socket.Close += sdelegate(this, &SocketClientEchoTest::onClose);
+    }
+
+    ~SocketClientEchoTest()
+    {
+        DebugL << "destroy" << endl;
+
+        assert(socket.base().refCount() == 1);
+    }
+
+    void start() 
+    {
+        // Create the socket instance on the stack.
+        // When the socket is closed it will unref the main loop
+        // causing the test to complete successfully.
+        socket.connect(address);
+        assert(socket.base().refCount() == 1);
+    }
+
+    void stop() 
+    {
+        //socket.close();
+        socket.shutdown();
+    }
+    
+    void onConnect(void* sender)
+    {
+        DebugL << "connected" << endl;
+        assert(sender == &socket);
+        socket.send("client > server", 15, ws::SendFlags::Text);
+    }
+    
+    void onRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress)
+    {
+        assert(sender == &socket);
+        std::string data(buffer.data(), buffer.size());
+        DebugL << "recv: " << data << endl;    
+
+        // Check for return packet echoing sent data
+        if (data == "client > server") {
+            DebugL << "got return packet" << endl;
+            
+            // Send the shutdown command to close the connection gracefully.
+            // The peer disconnection will trigger an error callback which
+            // will result is socket closure.
+            socket.base().shutdown();
+        }
+        else
+            assert(0 && "not echo response"); // fail...
+    }
+
+    void onError(void* sender, const Error& err)
+    {
+        ErrorL << "on error: " << err.message << endl;
+        assert(sender == &socket);
+    }
+    
+    void onClose(void* sender)
+    {
+        DebugL << "on close" << endl;
+        assert(sender == &socket);
+    }
+};
+
+
+//
+/// HTTP Tests
+//
+
+class Tests
+{
+public:
+    Application app;     
+
+    Tests()
+    {    
+        DebugL << "#################### Starting" << endl;
+#ifdef _MSC_VER
+        _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+#if TEST_SSL
+            // Init SSL Context 
+            net::SSLManager::initNoVerifyClient();
+#endif
+        {        
+            
+            testWebSocketMask();
+            runWebSocketMaskBenchmark();
+            runParserBenchmark();
+            testPacketizers();
+            testChunkedPartialWrite();
+            testShardedServer();
+            testPipelinedRequests();
+            testGoogleDriveMultipartUpload();    
+            
+#if 0
+            testStandaloneHTTPClientConnection();    
+            testStandaloneHTTPSClientConnection();    
+            runSecureClientConnectionTest();
+            runClientConnectionDownloadTest();
+            runSecureClientConnectionDownloadTest();
+            testURLParameters();
+            testURL();
+            runClientConnectionChunkedTest();    
+            runClientConnectionTest();
+            runHTTPClientTest();    
+            runWebSocketClientServerTest();
+            runWebSocketSocketTest();
+            runHTTPClientWebSocketTest();    
+            runWebSocketSecureClientConnectionTest();
+            testClientWebSocket();
+#endif
+
+            // NOTE: Must be terminated with Crtl-C
+            runHTTPServerTest();
+            
+        }
+#if TEST_SSL
+            // Shutdown SSL
+            net::SSLManager::destroy();
+#endif
+
+        // Shutdown the garbage collector so we can free memory.
+        //GarbageCollector::instance().shutdown();
+        
+        // Run the final cleanup
+        //runCleanup();
+        
+        DebugL << "#################### Finalizing" << endl;
+        app.finalize();
+        DebugL << "#################### Exiting" << endl;
+    }
+
+    void runLoop() {
+        DebugL << "#################### Running" << endl;
+        app.run();
+        DebugL << "#################### Ended" << endl;
+    }
+    
+
+    //
+    /// WebSocket Masking Test
+    //
+
+
+    void testWebSocketMask()
+    {
+        // Check the masking kernel against the byte at a time loop for
+        // every length up to and past the 16 byte vector threshold, as 
+        // well as lengths which take the wide and SIMD paths, with 
+        // unaligned source and destination starts and key offsets.
+        const char key[4] = { 0x11, char(0xa2), 0x33, char(0xc4) };
+        std::size_t lengths[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 
+            31, 32, 33, 127, 128, 129, 4099 };
+        const std::size_t pad = 8;
+        for (auto len : lengths) {
+            std::vector<char> src(len + pad), dst(len + pad);
+            for (std::size_t i = 0; i < src.size(); i++)
+                src[i] = static_cast<char>(i * 7 + 1);
+            for (std::size_t align = 0; align < 4; align++) {
+                for (std::size_t offset = 0; offset < 4; offset++) {
+                    // Out of place, with distinct source and destination alignment
+                    std::fill(dst.begin(), dst.end(), char(0x5a));
+                    ws::applyMask(&dst[align], &src[3 - align], len, key, offset);
+                    for (std::size_t i = 0; i < len; i++)
+                        assert(dst[align + i] == (src[3 - align + i] ^ key[(i + offset) % 4]));
+                    for (std::size_t i = 0; i < align; i++)
+                        assert(dst[i] == char(0x5a));
+                    for (std::size_t i = align + len; i < dst.size(); i++)
+                        assert(dst[i] == char(0x5a));
+
+                    // In place
+                    std::vector<char> buf(src);
+                    ws::applyMask(&buf[align], &buf[align], len, key, offset);
+                    for (std::size_t i = 0; i < buf.size(); i++) {
+                        if (i >= align && i < align + len)
+                            assert(buf[i] == (src[i] ^ key[(i - align + offset) % 4]));
+                        else
+                            assert(buf[i] == src[i]);
+                    }
+                }
+            }
+        }
+    }
+
+
+    //
+    /// WebSocket Masking Benchmark
+    //
+
+
+    double runWebSocketMaskBenchmark(std::size_t size, bool bytewise)
+    {
+        const char key[4] = { 0x37, char(0xfa), 0x21, 0x3d };
+        std::vector<char> src(size, 'x');
+        std::vector<char> dst(size);
+
+        // Mask roughly 32MB for each payload size, which is enough 
+        // for a stable figure without slowing down the test run
+        std::size_t iterations = std::max<std::size_t>(1, (32 * 1024 * 1024) / size);
+        UInt64 start = uv_hrtime();
+        for (std::size_t n = 0; n < iterations; n++) {
+            if (bytewise) {
+                for (std::size_t i = 0; i < size; i++)
+                    dst[i] = src[i] ^ key[i % 4];
+            }
+            else ws::applyMask(&dst[0], &src[0], size, key);
+
+            // Stop the compiler from hoisting the loop
+            src[n % size] = dst[(n + 1) % size];
+        }
+        double secs = (uv_hrtime() - start) / 1e9;
+        return (double(size) * iterations) / secs / (1024 * 1024);
+    }
+
+    void runWebSocketMaskBenchmark()
+    {
+        std::size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 262144, 1048576 };
+        for (auto size : sizes) {
+            double bytewise = runWebSocketMaskBenchmark(size, true);
+            double masked = runWebSocketMaskBenchmark(size, false);
+            std::cout << "WebSocket mask benchmark: " << size << " bytes: " 
+                << "bytewise=" << bytewise << "MB/s, " 
+                << "applyMask=" << masked << "MB/s, "
+                << "speedup=" << (masked / bytewise) << endl;
+        }
+    }
+
+
+    //
+    /// HTTP Parser Benchmark
+    //
+
+
+    struct LegacyParser
+        /// Reference implementation of the previous parser callbacks,
+        /// which copy every URL and header fragment into a new string 
+        /// and store headers in a case-insensitive multimap.
+    {
+        typedef std::multimap<std::string, std::string, NVCollection::ILT> Headers;
+
+        http_parser parser;
+        http_parser_settings settings;
+        std::string uri;
+        std::string method;
+        Headers headers;
+        std::string field;
+        std::string value;
+        bool wasValue;
+        std::size_t messages;
+
+        LegacyParser() : wasValue(true), messages(0)
+        {
+            ::http_parser_init(&parser, HTTP_REQUEST);
+            parser.data = this;
+            std::memset(&settings, 0, sizeof(settings));
+            settings.on_message_begin = [](http_parser* p) {
+                auto self = reinterpret_cast<LegacyParser*>(p->data);
+                self->headers.clear();
+                self->field.clear();
+                self->value.clear();
+                self->wasValue = true;
+                return 0;
+            };
+            settings.on_url = [](http_parser* p, const char* at, std::size_t len) {
+                reinterpret_cast<LegacyParser*>(p->data)->uri = std::string(at, len);
+                return 0;
+            };
+            settings.on_header_field = [](http_parser* p, const char* at, std::size_t len) {
+                auto self = reinterpret_cast<LegacyParser*>(p->data);
+                if (self->wasValue) {
+                    if (!self->field.empty()) {
+                        self->headers.insert(std::make_pair(self->field, self->value));
+                        self->value.clear();
+                    }
+                    self->field = std::string(at, len);
+                    self->wasValue = false;
+                }
+                else self->field += std::string(at, len);
+                return 0;
+            };
+            settings.on_header_value = [](http_parser* p, const char* at, std::size_t len) {
+                auto self = reinterpret_cast<LegacyParser*>(p->data);
+                if (!self->wasValue) {
+                    self->value = std::string(at, len);
+                    self->wasValue = true;
+                }
+                else self->value += std::string(at, len);
+                return 0;
+            };
+            settings.on_headers_complete = [](http_parser* p) {
+                auto self = reinterpret_cast<LegacyParser*>(p->data);
+                if (!self->field.empty())
+                    self->headers.insert(std::make_pair(self->field, self->value));
+                self->field.clear();
+                self->method = http_method_str(static_cast<http_method>(p->method));
+                return 0;
+            };
+            settings.on_message_complete = [](http_parser* p) {
+                reinterpret_cast<LegacyParser*>(p->data)->messages++;
+                return 0;
+            };
+        }
+
+        void parse(const char* data, std::size_t len)
+        {
+            std::size_t nparsed = ::http_parser_execute(&parser, &settings, data, len);
+            assert(nparsed == len);
+        }
+    };
+
+    struct CountingObserver: public ParserObserver
+    {
+        std::size_t messages;
+
+        CountingObserver() : messages(0) {}
+        void onParserHeader(const std::string&, const std::string&) {}
+        void onParserHeadersEnd() {}
+        void onParserChunk(const char*, std::size_t) {}
+        void onParserEnd() { messages++; }
+        void onParserError(const ParserError& err) { assert(0 && "parser error"); }
+    };
+
+    double runParserBenchmark(const std::string& data, std::size_t count, std::size_t readSize, bool legacy)
+    {
+        const std::size_t rounds = 20;
+        UInt64 start = uv_hrtime();
+        if (legacy) {
+            LegacyParser parser;
+            for (std::size_t n = 0; n < rounds; n++) {
+                for (std::size_t i = 0; i < data.size(); i += readSize)
+                    parser.parse(&data[i], std::min(readSize, data.size() - i));
+            }
+            assert(parser.messages == count * rounds);
+            assert(parser.uri == "/static/img/logo.png?v=2");
+        }
+        else {
+            Request request;
+            CountingObserver observer;
+            Parser parser(&request);
+            parser.setObserver(&observer);
+            for (std::size_t n = 0; n < rounds; n++) {
+                for (std::size_t i = 0; i < data.size(); i += readSize) {
+                    if (parser.complete())
+                        parser.reset();
+                    parser.parse(&data[i], std::min(readSize, data.size() - i));
+                }
+            }
+            assert(observer.messages == count * rounds);
+            assert(request.getURI() == "/static/img/logo.png?v=2");
+            assert(request.getMethod() == "GET");
+            assert(request.get("host") == "localhost:1337");
+            assert(request.get("Accept-Language") == "en-US,en;q=0.8");
+            assert(request.size() == 8);
+        }
+        double secs = (uv_hrtime() - start) / 1e9;
+        return (count * rounds) / secs;
+    }
+
+    // ============================================================================
+    // Packetizers
+    //
+    Buffer framedData;
+    int framedPackets;
+    bool framedZeroCopy;
+    const char* framedPayload;
+
+    void onFramedPacket(void*, IPacket& packet) 
+    {
+        framedPackets++;
+        packet.write(framedData);
+
+        // The payload must be referenced rather than copied
+        auto gathered = dynamic_cast<GatheredPacket*>(&packet);
+        if (gathered) {
+            for (std::size_t i = 0; i < gathered->count(); i++) {
+                if (gathered->buffers()[i].data() == framedPayload)
+                    framedZeroCopy = true;
+            }
+        }
+    }
+
+    void testPacketizers()
+    {
+        char payload[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        std::size_t size = sizeof(payload) - 1;
+        framedPayload = payload;
+        
+        // Chunked: header, size line, separator, payload and trailer
+        // are emitted as one gathered packet per chunk
+        {
+            http::ChunkedAdapter chunked("image/jpeg", "--sep\r\n");
+            chunked.emitter += packetDelegate(this, &Tests::onFramedPacket);
+            framedData.clear();
+            framedPackets = 0;
+            framedZeroCopy = false;
+            RawPacket first(payload, size);
+            chunked.process(first);
+            assert(framedPackets == 1);
+            assert(framedZeroCopy);
+            std::string framed(framedData.data(), framedData.size());
+            assert(framed.find("HTTP/1.1 200 OK\r\n") == 0);
+            assert(framed.find("Content-Type: image/jpeg\r\n\r\n24\r\n--sep\r\n") != std::string::npos);
+            assert(framed.substr(framed.size() - size - 2) == std::string(payload, size) + "\r\n");
+
+            framedData.clear();
+            RawPacket second(payload, 10);
+            chunked.process(second);
+            assert(framedPackets == 2);
+            assert(std::string(framedData.data(), framedData.size()) == "a\r\n--sep\r\n0123456789\r\n");
+        }
+
+        // Chunked without nocopy emits contiguous packets
+        {
+            http::ChunkedAdapter chunked("image/jpeg", "", false);
+            chunked.emitter += packetDelegate(this, &Tests::onFramedPacket);
+            chunked.initial = false;
+            framedData.clear();
+            framedPackets = 0;
+            RawPacket packet(payload, size);
+            chunked.process(packet);
+            assert(framedPackets == 1);
+            assert(std::string(framedData.data(), framedData.size()) == "24\r\n" + std::string(payload, size) + "\r\n");
+        }
+
+        // Multipart: part header and payload in one gathered packet
+        {
+            http::MultipartAdapter multipart("image/jpeg", true);
+            multipart.emitter += packetDelegate(this, &Tests::onFramedPacket);
+            framedData.clear();
+            framedPackets = 0;
+            framedZeroCopy = false;
+            RawPacket first(payload, size);
+            multipart.process(first);
+            framedData.clear();
+            RawPacket second(payload, size);
+            multipart.process(second);
+            assert(framedPackets == 2);
+            assert(framedZeroCopy);
+            assert(std::string(framedData.data(), framedData.size()) == 
+                "--end\r\nContent-Type: image/jpeg\r\nContent-Transfer-Encoding: base64\r\n\r\n" + std::string(payload, size));
+        }
+
+        // Copies of a gathered packet own their data
+        {
+            std::string head("head");
+            GatheredPacket gathered;
+            gathered.append(head);
+            gathered.append(payload, size);
+            std::unique_ptr<IPacket> copy(gathered.clone());
+            head[0] = 'X';
+            assert(copy->size() == 4 + size);
+            assert(std::string(copy->data(), copy->size()) == "head" + std::string(payload, size));
+        }
+    }
+
+
+    // ============================================================================
+    // Chunked Partial Write Test
+    //
+    // Sends enough chunks in one loop iteration to fill the loopback
+    // socket buffers, so the size lines built on the stack by the
+    // ChunkedAdapter are still queued when the adapter is destroyed.
+    //
+    const static int partialChunks = 64;
+    const static int partialChunkSize = 65536;
+
+    net::TCPSocket* partialServerSock;
+    net::TCPSocket* partialClientSock;
+    net::TCPSocket::Ptr partialAcceptedSock;
+    std::string partialPayload;
+    std::string partialReceived;
+    std::size_t partialExpectedSize;
+    std::size_t partialQueueSize;
+
+    std::size_t partialChunkLength(int i)
+    {
+        return partialChunkSize - i * 7;
+    }
+
+    void testChunkedPartialWrite()
+    {
+        partialPayload.resize(partialChunks * partialChunkSize);
+        for (std::size_t i = 0; i < partialPayload.size(); i++)
+            partialPayload[i] = static_cast<char>('a' + (i * 31 + i / 997) % 26);
+        partialReceived.clear();
+        partialExpectedSize = 0;
+        partialQueueSize = 0;
+
+        net::TCPSocket serverSock;
+        net::TCPSocket clientSock;
+        partialServerSock = &serverSock;
+        partialClientSock = &clientSock;
+        serverSock.AcceptConnection += delegate(this, &Tests::onPartialAccept);
+        serverSock.bind(net::Address("127.0.0.1", 0));
+        serverSock.listen();
+        clientSock.Connect += sdelegate(this, &Tests::onPartialConnect);
+        clientSock.connect(net::Address("127.0.0.1", serverSock.address().port()));
+
+        runLoop();
+
+        // The kernel did not accept all chunks in the sending iteration
+        assert(partialQueueSize > 0);
+        assert(partialReceived.size() == partialExpectedSize);
+
+        // Parse the chunked framing and verify every chunk
+        std::size_t pos = partialReceived.find("\r\n\r\n");
+        assert(partialReceived.find("HTTP/1.1 200 OK\r\n") == 0);
+        assert(pos != std::string::npos);
+        pos += 4;
+        for (int i = 0; i < partialChunks; i++) {
+            std::size_t eol = partialReceived.find("\r\n", pos);
+            assert(eol != std::string::npos);
+            std::size_t size = std::stoul(partialReceived.substr(pos, eol - pos), nullptr, 16);
+            assert(size == partialChunkLength(i));
+            pos = eol + 2;
+            assert(partialReceived.compare(pos, size, partialPayload, i * partialChunkSize, size) == 0);
+            pos += size;
+            assert(partialReceived.compare(pos, 2, "\r\n") == 0);
+            pos += 2;
+        }
+        assert(pos == partialReceived.size());
+        partialAcceptedSock.reset();
+    }
+
+    void onPartialConnect(void*)
+    {
+        // The adapter and its stack framing go out of scope
+        // while the chunks are still queued for writing.
+        http::ChunkedAdapter chunked("application/octet-stream");
+        chunked.emitter += packetDelegate(this, &Tests::onPartialChunk);
+        for (int i = 0; i < partialChunks; i++) {
+            RawPacket packet(&partialPayload[i * partialChunkSize], partialChunkLength(i));
+            chunked.process(packet);
+        }
+        partialQueueSize = partialClientSock->writeQueueSize();
+        TraceL << "Partial write queue size: " << partialQueueSize << endl;
+    }
+
+    void onPartialChunk(void*, IPacket& packet) 
+    {
+        partialExpectedSize += packet.size();
+        int sent = partialClientSock->sendPacket(packet, 0);
+        assert(sent > 0);
+    }
+
+    void onPartialAccept(const net::TCPSocket::Ptr& sock)
+    {
+        partialAcceptedSock = sock;
+        sock->Recv += sdelegate(this, &Tests::onPartialRecv);
+    }
+
+    void onPartialRecv(void*, const MutableBuffer& buffer, const net::Address&)
+    {
+        partialReceived.append(bufferCast<const char*>(buffer), buffer.size());
+        if (partialReceived.size() >= partialExpectedSize) {
+            partialAcceptedSock->close();
+            partialClientSock->close();
+            partialServerSock->close();
+        }
+    }
+
+    //
+    /// Sharded Server Test
+    //
+
+    struct ShardClient
+    {
+        net::TCPSocket::Ptr socket;
+        std::string received;
+        int responses;
+        bool closed;
+    };
+
+    ShardedServer* shardedServer;
+    std::vector<ShardClient> shardClients;
+    int shardClientsDone;
+    int shardClientsClosed;
+    static const int shardNumClients = 16;
+    static const int shardNumRequests = 4;
+
+    void testShardedServer()
+    {
+        ShardedServer server(TEST_HTTP_PORT, new OurServerResponderFactory, 2);
+        server.start();
+        assert(server.numThreads() == 2);
+        shardedServer = &server;
+        shardClientsDone = 0;
+        shardClientsClosed = 0;
+
+        // Each client sends its requests one at a time on a 
+        // single keep-alive connection.
+        shardClients.resize(shardNumClients);
+        for (auto& client : shardClients) {
+            client.socket = std::make_shared<net::TCPSocket>();
+            client.responses = 0;
+            client.closed = false;
+            client.socket->Connect += sdelegate(this, &Tests::onShardClientConnect);
+            client.socket->Recv += sdelegate(this, &Tests::onShardClientRecv);
+            client.socket->Close += sdelegate(this, &Tests::onShardClientClose);
+            client.socket->connect(net::Address("127.0.0.1", TEST_HTTP_PORT));
+        }
+
+        runLoop();
+
+        // Shutting down the server closed the open connections
+        assert(shardClientsDone == shardNumClients);
+        assert(shardClientsClosed == shardNumClients);
+        for (auto& client : shardClients) {
+            assert(client.responses == shardNumRequests);
+            assert(client.closed);
+        }
+        shardClients.clear();
+    }
+
+    ShardClient& shardClient(void* sender)
+    {
+        for (auto& client : shardClients) {
+            if (static_cast<net::Socket*>(client.socket.get()) == sender)
+                return client;
+        }
+        throw std::runtime_error("Unknown client socket");
+    }
+
+    void sendShardRequest(ShardClient& client)
+    {
+        const char request[] = "GET /keepalive HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        client.socket->send(request, sizeof(request) - 1);
+    }
+
+    void onShardClientConnect(void* sender)
+    {
+        sendShardRequest(shardClient(sender));
+    }
+
+    void onShardClientRecv(void* sender, const MutableBuffer& buffer, const net::Address&)
+    {
+        ShardClient& client = shardClient(sender);
+        client.received.append(bufferCast<const char*>(buffer), buffer.size());
+
+        // Count complete responses
+        std::size_t pos;
+        while ((pos = client.received.find("\r\n\r\n")) != std::string::npos && 
+            client.received.size() >= pos + 4 + 5) {
+            assert(client.received.find("HTTP/1.1 200 OK\r\n") == 0);
+            assert(client.received.compare(pos + 4, 5, "hello") == 0);
+            client.received.erase(0, pos + 4 + 5);
+            client.responses++;
+            if (client.responses < shardNumRequests)
+                sendShardRequest(client);
+            else if (++shardClientsDone == shardNumClients)
+                onShardClientsDone();
+        }
+    }
+
+    void onShardClientsDone()
+    {
+        // Every connection is still open, and each 
+        // shard accepted some of them.
+        ShardedServer::Stats stats = shardedServer->stats();
+        assert(stats.accepted == shardNumClients);
+        assert(stats.connections == shardNumClients);
+        assert(stats.requests == shardNumClients * shardNumRequests);
+        UInt64 accepted = 0, requests = 0;
+        for (int i = 0; i < shardedServer->numThreads(); i++) {
+            ShardedServer::Stats shard = shardedServer->stats(i);
+            TraceL << "Shard " << i << ": accepted " << shard.accepted 
+                << ", requests " << shard.requests << endl;
+            assert(shard.accepted > 0);
+            assert(shard.requests == shard.accepted * shardNumRequests);
+            accepted += shard.accepted;
+            requests += shard.requests;
+        }
+        assert(accepted == stats.accepted);
+        assert(requests == stats.requests);
+
+        // Shut down with the keep-alive connections open
+        shardedServer->shutdown();
+    }
+
+    void onShardClientClose(void* sender)
+    {
+        ShardClient& client = shardClient(sender);
+        assert(!client.closed);
+        client.closed = true;
+        shardClientsClosed++;
+    }
+
+    //
+    /// Pipelined Request Test
+    //
+
+    http::Server* pipelineServer;
+    net::TCPSocket::Ptr pipelineSocket;
+    std::string pipelineReceived;
+    std::vector<std::string> pipelineResponses;
+    static const int pipelineNumRequests = 8;
+
+    void testPipelinedRequests()
+    {
+        // Requests sent in a single write are answered in order,
+        // even though each responder answers after returning
+        // from onRequest(). Responses are finished by their 
+        // Content-Length, by stopping a chunked stream, and once
+        // the responder returns to the loop having sent them.
+        http::Server server(TEST_HTTP_PORT, new OurServerResponderFactory);
+        server.start();
+        pipelineServer = &server;
+        pipelineResponses.clear();
+        pipelineSocket = std::make_shared<net::TCPSocket>();
+        pipelineSocket->Connect += sdelegate(this, &Tests::onPipelineConnect);
+        pipelineSocket->Recv += sdelegate(this, &Tests::onPipelineRecv);
+        pipelineSocket->connect(net::Address("127.0.0.1", TEST_HTTP_PORT));
+
+        runLoop();
+
+        assert(pipelineResponses.size() == pipelineNumRequests);
+        for (int i = 0; i < pipelineNumRequests; i++)
+            assert(pipelineResponses[i] == util::itostr(i));
+        pipelineSocket.reset();
+    }
+
+    void onPipelineConnect(void*)
+    {
+        std::string requests;
+        const char* paths[] = { "/deferred", "/sent", "/streamed", "/own" };
+        for (int i = 0; i < pipelineNumRequests; i++)
+            requests += "GET " + std::string(paths[i % 4]) + "?n=" + util::itostr(i) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        pipelineSocket->send(requests.data(), requests.size());
+    }
+
+    void onPipelineRecv(void*, const MutableBuffer& buffer, const net::Address&)
+    {
+        pipelineReceived.append(bufferCast<const char*>(buffer), buffer.size());
+
+        // Each response has a single character body, which
+        // is sent as one chunk followed by the last chunk
+        // for chunked responses.
+        std::size_t pos;
+        while ((pos = pipelineReceived.find("\r\n\r\n")) != std::string::npos) {
+            assert(pipelineReceived.find("HTTP/1.1 200 OK\r\n") == 0);
+            bool chunked = pipelineReceived.substr(0, pos).find("Transfer-Encoding: chunked") != std::string::npos;
+            std::size_t size = chunked ? 11 : 1;
+            if (pipelineReceived.size() < pos + 4 + size)
+                break;
+            std::string body(pipelineReceived.substr(pos + 4, size));
+            if (chunked) {
+                assert(body.compare(0, 3, "1\r\n") == 0);
+                assert(body.compare(4, 7, "\r\n0\r\n\r\n") == 0);
+                body = body.substr(3, 1);
+            }
+            pipelineResponses.push_back(body);
+            pipelineReceived.erase(0, pos + 4 + size);
+        }
+        if (pipelineResponses.size() == pipelineNumRequests)
+            pipelineServer->shutdown();
+    }
+
+    void runParserBenchmark()
+    {
+        // A stream of pipelined browser style requests
+        const std::size_t count = 5000;
+        std::string request(
+            "GET /static/img/logo.png?v=2 HTTP/1.1\r\n"
+            "Host: localhost:1337\r\n"
+            "Connection: keep-alive\r\n"
+            "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/35.0.1916.153 Safari/537.36\r\n"
+            "Accept: image/webp,*/*;q=0.8\r\n"
+            "Referer: http://localhost:1337/index.html\r\n"
+            "Accept-Encoding: gzip,deflate,sdch\r\n"
+            "Accept-Language: en-US,en;q=0.8\r\n"
+            "Cookie: session=2f7c1b9e0a6d4c3f8b5e; theme=dark\r\n"
+            "\r\n");
+        std::string data;
+        data.reserve(request.size() * count);
+        for (std::size_t i = 0; i < count; i++)
+            data += request;
+
+        // Odd read sizes split tokens across reads
+        std::size_t readSizes[] = { 1021, 8192, 65536 };
+        for (auto readSize : readSizes) {
+            double legacy = runParserBenchmark(data, count, readSize, true);
+            double views = runParserBenchmark(data, count, readSize, false);
+            std::cout << "HTTP parser benchmark: " << readSize << " byte reads: " 
+                << "copying=" << legacy << "req/s, " 
+                << "views=" << views << "req/s, "
+                << "speedup=" << (views / legacy) << endl;
+        }
+    }
+
+
+    //
+    /// HTTP URL Parameters Tests
+    //
+
+
+    void testURLParameters()
+    {
+        NVCollection params;
+        splitURIParameters("/streaming?format=MJPEG&width=400&height=300&encoding=Base64&packetizer=chunked&rand=0.09983996045775712", params);            
+        for (NVCollection::ConstIterator it = params.begin(); it != params.end(); ++it) {
+            DebugL << "URL Parameter: " << it->first << ": " << it->second << endl;
+        }
+        
+        assert(params.get("format") == "MJPEG");
+        assert(params.get("Format") == "MJPEG");
+        assert(params.get("width") == "400");
+        assert(params.get("WIDTH") == "400");
+        assert(params.get("height") == "300");
+        assert(params.get("encoding") == "Base64");
+        assert(params.get("ENCODING") == "Base64");
+        assert(params.get("packetizer") == "chunked");
+        assert(params.get("rand") == "0.09983996045775712");
+        assert(params.get("RaNd") == "0.09983996045775712");
+        assert(params.get("0") == "streaming");
+
+        scy::pause();
+    }
+
+
+    //
+    /// HTTP URL Tests
+    //
+
+
+    void testURL()
+    {    
+        http::URL url;
+        assert(url.scheme().empty());
+        assert(url.authority().empty());
+        assert(url.userInfo().empty());
+        assert(url.host().empty());
+        assert(url.port() == 0);
+        assert(url.path().empty());
+        assert(url.query().empty());
+        assert(url.fragment().empty());
+
+        URL url2("HTTP", "localhost", "/home/sourcey/foo.bar");
+        assert(url2.scheme() == "http");
+        assert(url2.host() == "localhost");
+        assert(url2.path() == "/home/sourcey/foo.bar");
+    
+        URL url3("http", "www.sourcey.com", "/index.html");
+        assert(url3.scheme() == "http");
+        assert(url3.authority() == "www.sourcey.com");
+        assert(url3.host() == "www.sourcey.com");
+        assert(url3.path() == "/index.html");
+    
+        URL url4("http", "www.sourcey.com:8000", "/index.html");
+        assert(url4.scheme() == "http");
+        assert(url4.authority() == "www.sourcey.com:8000");
+        assert(url4.host() == "www.sourcey.com");
+        assert(url4.path() == "/index.html");
+
+        URL url5("http", "user@www.sourcey.com:8000", "/index.html");
+        assert(url5.scheme() == "http");
+        assert(url5.userInfo() == "user");
+        assert(url5.host() == "www.sourcey.com");
+        assert(url5.port() == 8000);
+        assert(url5.authority() == "user@www.sourcey.com:8000");
+        assert(url5.path() == "/index.html");
+
+        URL url6("http", "user@www.sourcey.com:80", "/index.html");
+        assert(url6.scheme() == "http");
+        assert(url6.userInfo() == "user");
+        assert(url6.host() == "www.sourcey.com");
+        assert(url6.port() == 80);
+        assert(url6.authority() == "user@www.sourcey.com:80");
+        assert(url6.path() == "/index.html");
+
+        URL url7("http", "www.sourcey.com", "/index.html", "query=test", "fragment");
+        assert(url7.scheme() == "http");
+        assert(url7.authority() == "www.sourcey.com");
+        assert(url7.path() == "/index.html");
+        assert(url7.pathEtc() == "/index.html?query=test#fragment");
+        assert(url7.query() == "query=test");
+        assert(url7.fragment() == "fragment");
+
+        URL url8("http", "www.sourcey.com", "/index.html?query=test#fragment");
+        assert(url8.scheme() == "http");
+        assert(url8.authority() == "www.sourcey.com");
+        assert(url8.path() == "/index.html");
+        assert(url8.pathEtc() == "/index.html?query=test#fragment");
+        assert(url8.query() == "query=test");
+        assert(url8.fragment() == "fragment");
+    }
+
+    
+    //
+    /// HTTP Client Tests
+    //
+
+
+    struct HTTPClientTest
+        /// Initializes a polymorphic HTTP client connection for 
+        /// testing callbacks, and also optionally raises the server.
+    {
+        http::Server server;
+        http::Client client;
+        int numSuccess;
+        ClientConnection* conn;
+        RandomDataSource dataSource;        
+
+        HTTPClientTest() :
+            numSuccess(0),
+            conn(0),
+            server(TEST_HTTP_PORT, new OurServerResponderFactory) 
+        {
+            // need some TLC
+        }
+        
+        template<class ConnectionT>
+        ConnectionT* create(const http::URL& url, bool raiseServer = true)
+        {
+            if (raiseServer)
+                server.start();
+
+            conn = (ClientConnection*)client.createConnectionT<ConnectionT>(url);        
+            conn->Connect += sdelegate(this, &HTTPClientTest::onConnect);    
+            conn->Headers += sdelegate(this, &HTTPClientTest::onHeaders);
+            conn->Incoming.emitter += sdelegate(this, &HTTPClientTest::onPayload); // fix syntax
+            //conn->Payload += sdelegate(this, &HTTPClientTest::onPayload);
+            conn->Complete += sdelegate(this, &HTTPClientTest::onComplete);
+            conn->Close += sdelegate(this, &HTTPClientTest::onClose);
+            return (ConnectionT*)conn;
+        }
+
+        void shutdown()
+        {
+            // Stop the client and server to release the loop
+            server.shutdown();
+            client.shutdown();
+        }
+            
+        void onConnect(void*)
+        {
+            DebugL << "On connect" <<  endl;
+            
+            // Bounce backwards and forwards a few times :)
+            //conn->write("BOUNCE", 6);
+
+            // Start the output stream when the socket connects.
+            //dataSource.conn = this->conn;
+            //dataSource.start();
+        }
+
+        void onHeaders(void*, Response& res)
+        {
+            DebugL << "On headers" <<  endl;
+            
+            // Bounce backwards and forwards a few times :)
+            //conn->write("BOUNCE", 6);
+        }
+        
+        void onPayload(void*, scy::IPacket& packet)
+        {    
+            DebugL << "On payload: " << packet.size() << endl;
+        }
+
+        /*
+        void onPayload(void*, Buffer& buf)
+        {
+            DebugL << "On response payload: " << buf << endl;
+
+            if (buf.toString() == "BOUNCE")
+                numSuccess++;
+            
+            DebugL << "On response payload: " << buf << ": " << numSuccess << endl;
+            if (numSuccess >= 100) {
+                
+                DebugL << "SUCCESS: " << numSuccess << endl;
+                conn->close();
+            }
+            else
+                conn->send(string("BOUNCE"), 6);
+        }
+        */
+
+        void onComplete(void*, const Response& res)
+        {        
+            std::ostringstream os;
+            res.write(os);
+            DebugL << "Response complete: " << os.str() << endl;
+        }
+
+        void onClose(void*)
+        {    
+            DebugL << "Connection closed" << endl;
+            shutdown();
+        }
+    };
+    
+    
+    //
+    /// Default HTTP Client Connection Test
+    //
+    void runClientConnectionDownloadTest() 
+    {    
+        {
+            auto conn = http::Client::instance().createConnection("http://localhost:3000/packages/spotinstaller/download/2667/SpotInstaller.exe");
+            conn->Complete += sdelegate(this, &Tests::onClientConnectionDownloadComplete);    
+            conn->request().setMethod("GET");
+            conn->request().setKeepAlive(false);
+            conn->setReadStream(new std::ofstream("SpotInstaller.exe", std::ios_base::out | std::ios_base::binary));
+            conn->send();
+        }
+        runLoop();
+    }
+
+    void runSecureClientConnectionDownloadTest() 
+    {    
+        {
+            auto conn = http::Client::instance().createConnection("https://anionu.com/assets/download/25/SpotInstaller.exe");
+            conn->Complete += sdelegate(this, &Tests::onClientConnectionDownloadComplete);    
+            conn->request().setMethod("GET");
+            conn->request().setKeepAlive(false);
+            conn->setReadStream(new std::ofstream("SpotInstaller.exe", std::ios_base::out | std::ios_base::binary));
+            conn->send();
+        }
+        runLoop();
+    }
+
+    void onClientConnectionDownloadComplete(void* sender, const http::Response& response)
+    {
+        auto conn = reinterpret_cast<http::ClientConnection*>(sender);
+
+        TraceL << "Server response: " << response << endl;
+    }
+
+    
+    void runSecureClientConnectionTest() 
+    {    
+        {
+            auto conn = http::Client::instance().createConnection("https://anionu.com/");
+            conn->Complete += sdelegate(this, &Tests::onClientConnectionComplete);    
+            conn->request().setMethod("GET");
+            conn->request().setKeepAlive(false);
+            conn->setReadStream(new std::stringstream);    
+            conn->send();
+        }
+        runLoop();
+    }
+    
+    void runClientConnectionTest() 
+    {    
+        {
+            auto conn = http::Client::instance().createConnection("http://localhost:3000/");
+            conn->Complete += sdelegate(this, &Tests::onClientConnectionComplete);    
+            conn->request().setMethod("GET");
+            conn->request().setKeepAlive(false);
+            conn->setReadStream(new std::stringstream);    
+            conn->send();
+        }
+        runLoop();
+    }
+    
+
+    void onClientConnectionComplete(void* sender, const http::Response& response)
+    {
+        auto conn = reinterpret_cast<http::ClientConnection*>(sender);
+
+        TraceL << "Server response: " 
+            << response << conn->readStream<std::stringstream>()->str() << endl;
+    }
+        
+    /*
+    
+    void runClientConnectionTest() 
+    {    
+        HTTPClientTest test;
+        test.create<ClientConnection>()->send(); // default GET request
+        runLoop();
+    }
+    
+    void runClientConnectionChunkedTest() 
+    {    
+        HTTPClientTest test;        
+        auto conn = test.create<ClientConnection>(false, "127.0.0.1", TEST_HTTP_PORT);
+        conn->request().setKeepAlive(true);
+        conn->request().setURI("/chunked");
+        //conn->request().body << "BOUNCE" << endl;
+        conn->send();
+        runLoop();
+    }
+
+    void runWebSocketSecureClientConnectionTest() 
+    {    
+        HTTPClientTest test;
+        auto conn = test.create<WebSocketSecureClientConnection>(false, "127.0.0.1", TEST_HTTPS_PORT);
+        conn->request().setURI("/websocket");
+        //conn->request().body << "BOUNCE" << endl;
+        conn->send();
+        runLoop();
+    }
+    
+    void runWebSocketClientConnectionTest() 
+    {    
+        HTTPClientTest test;
+        auto conn = test.create<WebSocketClientConnection>(http::URL("127.0.0.1", TEST_HTTP_PORT), false);
+        conn->shouldSendHead(false);
+        conn->request().setURI("/websocket");
+        //conn->request().body << "BOUNCE" << endl;
+        conn->send();
+        runLoop();
+    }
+    */
+    
+    
+    //
+    /// Standalone HTTP Client Connection Test
+    //
+    
+    void testStandaloneHTTPClientConnection()
+    {
+        {
+            ClientConnection conn("http://localhost:3000/");
+            conn.Headers += sdelegate(this, &Tests::onStandaloneHTTPClientConnectionHeaders);
+            //conn->Payload += sdelegate(this, &Tests::onStandaloneHTTPClientConnectionPayload);
+            conn.Complete += sdelegate(this, &Tests::onStandaloneHTTPClientConnectionComplete);
+            conn.setReadStream(new std::stringstream);
+            conn.send(); // send default GET /
+            runLoop();
+        }
+    }    
+    
+    void onStandaloneHTTPClientConnectionHeaders(void*, Response& res)
+    {    
+        DebugL << "On response headers: " << res << endl;
+    }
+    
+    //void onStandaloneHTTPClientConnectionPayload(void*, Buffer& buf)
+    //{    
+    //    assert(0);
+    //    DebugL << "On response payload: " << buf.size() << endl;
+    //}
+    
+    void onStandaloneHTTPClientConnectionComplete(void* sender, const Response& response)
+    {        
+        auto self = reinterpret_cast<ClientConnection*>(sender);
+        DebugL << "On response complete" 
+            << response << self->readStream<std::stringstream>()->str() << endl;
+        self->close();
+    }
+        
+    
+    //
+    /// Client WebSocket Test
+    //
+    
+    void testClientWebSocket() 
+    {
+        //http::Server srv(TEST_HTTP_PORT, new OurServerResponderFactory);
+        //srv.start();
+
+        // ws://echo.websocket.org        
+        //SocketClientEchoTest<http::ws::WebSocket> test(net::Address("174.129.224.73", 1339));
+        //SocketClientEchoTest<http::ws::WebSocket> test(net::Address("174.129.224.73", 80));
+
+        //DebugL << "TCP Socket Test: Starting" << endl;
+        //SocketClientEchoTest<http::ws::WebSocket> test(net::Address("127.0.0.1", TEST_HTTP_PORT));
+        //test.start();
+
+        runLoop();
+    }
+
+        
+    //
+    /// Google Drive Upload Test
+    //
+    
+    void testGoogleDriveMultipartUpload() 
+    {
+        // https://developers.google.com/drive/web/manage-uploads
+        // Need a current OAuth2 access_token with https://www.googleapis.com/auth/drive.file access scope for this to work
+        std::string accessToken("ya29.1.AADtN_WY53y0jEgN_SWcmfp6VvAQ6asnYqbDi5CKEfzwL7lfNqtbUiLeL4v07b_I");        
+        std::string metadata("{ \"title\": \"My File\" }");
+
+#if 0
+        auto conn = http::Client::instance().createConnection("https://www.googleapis.com/drive/v2/files");
+        conn->Complete += sdelegate(this, &Tests::onAssetUploadComplete);
+        conn->OutgoingProgress += sdelegate(this, &Tests::onAssetUploadProgress);
+        conn->request().setMethod("POST");
+        conn->request().setContentType("application/json");
+        conn->request().setContentLength(2);
+        conn->request().add("Authorization", "Bearer " + accessToken);
+        
+        // Send the request
+        conn->send("{}", 2);
+#endif
+
+        // Create the transaction
+        auto conn = http::Client::instance().createConnection("https://www.googleapis.com/upload/drive/v2/files?uploadType=multipart");
+        conn->request().setMethod("POST");
+        conn->request().setChunkedTransferEncoding(false);
+        conn->request().add("Authorization", "Bearer " + accessToken);
+        conn->Complete += sdelegate(this, &Tests::onAssetUploadComplete);
+        conn->OutgoingProgress += sdelegate(this, &Tests::onAssetUploadProgress);
+
+        // Attach a HTML form writer for uploading files
+        auto form = http::FormWriter::create(*conn, http::FormWriter::ENCODING_MULTIPART_RELATED);
+        
+        form->addPart("metadata", new http::StringPart(metadata, "application/json; charset=UTF-8"));
+        //form->addPart("file", new http::StringPart("jew", "text/plain"));
+        //form->addPart("file", new http::FilePart("D:/test.txt", "text/plain"));
+        form->addPart("file", new http::FilePart("D:/test.jpg", "image/jpeg"));
+        
+        // Send the request
+        conn->send();
+
+        runLoop();
+    }
+
+    void onAssetUploadProgress(void* sender, const double& progress)
+    {
+        DebugL << "Upload Progress:" << progress << endl;
+    }
+
+    void onAssetUploadComplete(void* sender, const http::Response& response)
+    {
+        auto conn = reinterpret_cast<http::ClientConnection*>(sender);
+
+        DebugL << "Transaction Complete:" 
+            << "\n\tRequest Head: " << conn->request()
+            << "\n\tResponse Head: " << response
+            //<< "\n\tResponse Body: " << trans->incomingBuffer()
+            << endl;
+
+        //assert(response.success());
+    }
+
+
+    //
+    /// HTTP Server Test
+    //
+    
+    void runHTTPServerTest() 
+    {
+        http::Server srv(TEST_HTTP_PORT, new OurServerResponderFactory);
+        srv.start();
+        
+        app.waitForShutdown(Tests::onKillHTTPServer, &srv);
+    }
+    
+    static void onPrintHTTPServerHandle(uv_handle_t* handle, void* arg) 
+    {
+        //DebugL << "#### Active HTTPServer Handle: " << handle << endl;
+        DebugL << "#### Active HTTPServer Handle: " << handle << endl;
+    }
+
+    static void onKillHTTPServer(void* opaque)
+    {
+        DebugL << "Kill Signal: " << opaque << endl;
+    
+        // print active handles
+        uv_walk(uv::defaultLoop(), Tests::onPrintHTTPServerHandle, NULL);
+            
+        reinterpret_cast<http::Server*>(opaque)->shutdown();
+    }
+
+};
+
+
+} } // namespace scy::http
+
+
+int main(int argc, char** argv) 
+{    
+    Logger::instance().add(new ConsoleChannel("debug", LTrace));
+    {
+        http::Tests app;
+    }
+    Logger::destroy();
+    return 0;
+}
+
+
+        /*
+    // ============================================================================
+    // HTTP ClientConnection Test
+    //
+    void runHTTPClientTest() 
+    {
+        DebugL << "Starting" << endl;    
+
+        // Setup the transaction
+        http::Request req("GET", "http://google.com");
+        http::Response res;
+        http::ClientConnection txn(&req);
+        txn.Complete += sdelegate(this, &Tests::onComplete);
+        txn.DownloadProgress += sdelegate(this, &Tests::onIncomingProgress);    
+        txn.send();
+
+        // Run the looop
+        app.run();
+        //util::pause();
+
+        DebugL << "Ending" << endl;
+    }        
+
+    void onComplete(void* sender, http::Response& response)
+    {
+        DebugL << "On Complete: " << &response << endl;
+    }
+
+    void onIncomingProgress(void* sender, http::TransferProgress& progress)
+    {
+        DebugL << "On Progress: " << progress.progress() << endl;
+    }
+        */
+    
+/*
+struct Result {
+    int numSuccess;
+    std::string name;
+    Stopwatch sw;
+
+    void reset() {
+        numSuccess = 0;
+        sw.reset();
+    }
+};
+
+static Result Benchmark;
+*/
@@ -0,0 +1,283 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_MEDIA_VideoContext_H
+#define SCY_MEDIA_VideoContext_H
+
+
+#include "scy/base.h"
+
+#ifdef HAVE_FFMPEG
+
+#include "scy/timer.h"
+#include "scy/media/types.h"
+#include "scy/media/format.h"
+#include "scy/media/fpscounter.h"
+#include "scy/mutex.h"
+
+#include <map>
+#include <atomic>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/buffer.h>
+#include <libavutil/fifo.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+#include <libswscale/swscale.h>
+}
+
+
+namespace scy {
+namespace av {
+
+
+struct VideoConversionContext;
+
+    
+AVFrame* createVideoFrame(AVPixelFormat pixelFmt, int width, int height);
+    // Returns a packed frame backed by a VideoFramePool buffer.
+    // Release the frame with av_frame_free().
+
+void initVideoEncoderContext(AVCodecContext* ctx, AVCodec* codec, VideoCodec& oparams);
+void initDecodedVideoPacket(const AVStream* stream, const AVCodecContext* ctx, const AVFrame* frame, AVPacket* opacket, double* pts);
+void initVideoCodecFromContext(const AVCodecContext* ctx, VideoCodec& params);
+AVRational getCodecTimeBase(AVCodec* c, double fps);
+
+
+//
+// Video Frame Pool
+//
+
+
+class VideoFramePool
+    /// Recycles the picture buffers of video frames.
+    /// Buffers are drawn from an AVBufferPool per pixel format, size
+    /// and line alignment, and return to their pool when the frame
+    /// is released with av_frame_free(), so contexts which are
+    /// recreated at the same resolution reuse their picture memory.
+    /// Decoder pictures and conversion output frames, including
+    /// those of encoders which convert their input, use the pool,
+    /// while encoder input frames reference the caller's data.
+{
+public:
+    VideoFramePool();
+    ~VideoFramePool();
+
+    static VideoFramePool& instance();
+        // Returns the default VideoFramePool singleton.
+
+    static void shutdown();
+        // Shuts down the default pool and deletes the singleton.
+        // Frames still in use remain valid.
+
+    AVFrame* get(AVPixelFormat pixelFmt, int width, int height, int align = 1);
+        // Returns a frame with its format, size and planes set up
+        // for the given line alignment, or nullptr on failure.
+
+    static int getBuffer(AVCodecContext* ctx, AVFrame* frame, int flags);
+        // An AVCodecContext::get_buffer2 callback which decodes into
+        // buffers from the default pool. Hardware formats and codecs
+        // without direct rendering use avcodec_default_get_buffer2().
+
+    void clear();
+        // Frees all idle buffers and pools. Buffers still in use 
+        // are freed when their frame is released.
+
+    UInt64 allocations() const;
+        // Returns the number of picture buffers allocated by all pools.
+
+    UInt64 acquisitions() const;
+        // Returns the number of frames returned by get().
+        // The difference to allocations() is the number of reuses.
+
+    std::size_t numPools() const;
+
+protected:
+    struct Key 
+    {
+        AVPixelFormat pixelFmt;
+        int width;
+        int height;
+        int align;
+
+        bool operator < (const Key& r) const;
+    };
+
+    mutable Mutex _mutex;
+    std::map<Key, AVBufferPool*> _pools;
+    std::atomic<UInt64> _acquisitions;
+};
+
+
+//
+// Video Context
+//
+
+
+struct VideoContext
+    /// Base video context which all encoders and decoders extend
+{
+    VideoContext();
+    virtual ~VideoContext();
+        
+    virtual void create();
+        // Create the AVCodecContext using default values
+
+    virtual void open();
+        // Open the AVCodecContext
+
+    virtual void close();    
+        // Close the AVCodecContext
+
+    AVStream* stream;        // encoder or decoder stream
+    AVCodecContext* ctx;    // encoder or decoder context
+    AVCodec* codec;            // encoder or decoder codec
+    AVFrame* frame;            // encoded or decoded frame
+    FPSCounter fps;            // encoder or decoder fps rate
+    //FPSCounter1 fps1;
+    double pts;                // pts in decimal seconds
+    
+    Stopwatch frameDuration;
+    std::string error;        // error message
+};
+
+
+//
+// Video Encoder Context
+//
+
+
+struct VideoEncoderContext: public VideoContext
+{
+    VideoEncoderContext(AVFormatContext* format);
+    virtual ~VideoEncoderContext();    
+    
+    virtual void create();
+    //virtual void open();
+    virtual void close();
+    
+    virtual bool encode(unsigned char* data, int size, Int64 pts, AVPacket& opacket);
+    virtual bool encode(AVPacket& ipacket, AVPacket& opacket);
+    virtual bool encode(AVFrame* iframe, AVPacket& opacket);
+    virtual bool flush(AVPacket& opacket);
+    
+    virtual void createConverter();
+    virtual void freeConverter();
+    
+    VideoConversionContext* conv;
+    AVFormatContext* format;
+
+    UInt8*    buffer;
+    int        bufferSize;
+
+    VideoCodec    iparams;
+    VideoCodec    oparams;
+};
+
+
+//
+// Video Codec Encoder Context
+//
+
+
+struct VideoCodecEncoderContext: public VideoContext
+{
+    VideoCodecEncoderContext();
+    virtual ~VideoCodecEncoderContext();    
+    
+    virtual void create();
+    //virtual void open(); //const VideoCodec& params
+    virtual void close();
+    
+    virtual bool encode(unsigned char* data, int size, AVPacket& opacket);
+    virtual bool encode(AVPacket& ipacket, AVPacket& opacket);
+    virtual bool encode(AVFrame* iframe, AVPacket& opacket);
+        
+    VideoConversionContext* conv;
+
+    UInt8*            buffer;
+    int                bufferSize;
+
+    VideoCodec    iparams;
+    VideoCodec    oparams;
+};
+
+
+//
+// Video Decode Context
+//
+
+
+struct VideoDecoderContext: public VideoContext
+{
+    VideoDecoderContext();
+    virtual ~VideoDecoderContext();
+    
+    virtual void create(AVFormatContext *ic, int streamID);    
+    //virtual void open();
+    virtual void close();    
+    
+    virtual bool decode(UInt8* data, int size, AVPacket& opacket);
+    virtual bool decode(AVPacket& ipacket, AVPacket& opacket);
+        // Decodes a the given input packet.
+        // Returns true an output packet was returned, 
+        // false otherwise.
+    
+    virtual bool flush(AVPacket& opacket);
+        // Flushes buffered frames.
+        // This method should be called after decoding
+        // until false is returned.
+
+    //double maxFPS; 
+        // Maximum decoding FPS. 
+        // FPS is calculated from ipacket PTS. 
+        // Extra frames will be dropped.
+};
+
+
+//
+// Video Conversion Context
+//
+
+
+struct VideoConversionContext
+{
+    VideoConversionContext();
+    virtual ~VideoConversionContext();    
+    
+    virtual void create(const VideoCodec& iparams, const VideoCodec& oparams);
+    virtual void free();
+
+    virtual AVFrame* convert(AVFrame* iframe);
+
+    AVFrame* oframe;
+    struct SwsContext* ctx;
+    VideoCodec iparams;
+    VideoCodec oparams;
+};
+
+
+} } // namespace scy::av
+
+
+#endif
+#endif    // SCY_MEDIA_VideoContext_H
@@ -0,0 +1,116 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Net_ShardRunner_H
+#define SCY_Net_ShardRunner_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/async.h"
+#include "scy/synccontext.h"
+#include "scy/thread.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+
+namespace scy {
+namespace net {
+
+
+class ShardRunner
+    /// ShardRunner runs an event loop on each of a number of threads,
+    /// and a server, or shard, on each loop. It is used by the sharded
+    /// HTTP and TURN servers.
+    ///
+    /// Each shard is created, started, stopped and destroyed on its own
+    /// thread, which owns the shard and its loop until stop() is called.
+    /// The shard table is built before any thread is started and is not
+    /// changed until every thread has exited, so the methods below may
+    /// be called from the shard threads without locking. Each shard's
+    /// stopper is guarded by a mutex, since a shard thread may clear
+    /// it at any time once its loop exits.
+{
+public:
+    typedef std::function<async::Startable*(int index, uv::Loop* loop)> Factory;
+        // Creates the shard with the given index on the shard thread.
+        // The returned shard is started on its loop, and is stopped and
+        // deleted on the same thread when the runner is stopped.
+        // An exception thrown by the factory or by start() is reported
+        // by ShardRunner::start().
+
+    ShardRunner(int numThreads = 0);
+        // Creates the runner. One thread is used
+        // per CPU core if numThreads is 0.
+
+    virtual ~ShardRunner();
+        // Stops the shards if they are running.
+
+    void start(const Factory& factory);
+        // Starts the shard threads and waits until every shard is
+        // started. If any shard fails to start the others are stopped
+        // and a std::runtime_error with the first error is thrown.
+
+    void stop();
+        // Stops the shards and waits for their threads to exit.
+
+    bool running() const;
+        // Returns true between start() and stop().
+
+    int numThreads() const;
+
+protected:
+    struct Shard
+    {
+        enum State
+        {
+            Starting,
+            Running,
+            Failed,
+            Stopped
+        };
+
+        int index;
+        Thread* thread;
+        SyncContext* stopper; // set while running, guarded by _mutex
+        std::atomic<int> state;
+        std::string error;
+
+        Shard(int index) : index(index), thread(nullptr),
+            stopper(nullptr), state(Starting) {}
+    };
+
+    void run(Shard& shard, const Factory& factory);
+        // Runs the shard event loop on the shard thread.
+
+    std::vector<Shard*> _shards;
+    int _numThreads;
+    Mutex _mutex; // guards Shard::stopper
+
+private:
+    ShardRunner(const ShardRunner&); // = delete;
+    ShardRunner& operator=(const ShardRunner&); // = delete;
+};
+
+
+} } // namespace scy::net
+
+
+#endif // SCY_Net_ShardRunner_H
@@ -0,0 +1,151 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Net_TCPSocket_H
+#define SCY_Net_TCPSocket_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/net/tcpsocket.h"
+#include "scy/net/socket.h"
+#include "scy/net/address.h"
+#include "scy/net/types.h"
+#include "scy/stream.h"
+
+
+namespace scy {
+namespace net {
+
+
+class TCPSocket: public Stream, public net::Socket
+{
+public:    
+    typedef std::shared_ptr<TCPSocket> Ptr;
+    typedef std::vector<Ptr> Vec;
+
+    TCPSocket(uv::Loop* loop = uv::defaultLoop()); 
+    virtual ~TCPSocket();
+    
+    virtual bool shutdown();
+    virtual void close();
+    
+    virtual void connect(const net::Address& peerAddress);
+
+    virtual int send(const char* data, std::size_t len, int flags = 0);
+    virtual int send(const char* data, std::size_t len, const net::Address& peerAddress, int flags = 0);
+    virtual int send(const ConstBuffer* bufs, std::size_t count, int flags = 0);
+    virtual int send(const ConstBuffer* bufs, std::size_t count, const net::Address& peerAddress, int flags = 0);
+    
+    virtual void bind(const net::Address& address, unsigned flags = 0);
+    virtual void listen(int backlog = 64);    
+    
+    virtual void acceptConnection();
+
+    virtual void setNoDelay(bool enable);
+    virtual void setKeepAlive(int enable, unsigned int delay);
+
+    virtual void setCork(bool enable, std::size_t flushThreshold = 16384);
+        // Enables or disables write coalescing (cork mode).
+        //
+        // While corked, small writes made during the same event loop
+        // iteration are buffered and flushed as a single write once  
+        // the current loop iteration completes, or as soon as the
+        // buffered data reaches flushThreshold bytes. 
+        // Writes which are larger than the threshold are sent
+        // directly after flushing any buffered data.
+        //
+        // Buffered writes are copied, so the caller's buffers need
+        // not remain valid once send() returns.
+        //
+        // Disabling cork mode flushes any buffered data.
+
+    bool corked() const;
+        // Returns true if cork mode is enabled.
+
+    virtual bool flush();
+        // Writes any data buffered in cork mode to the stream.
+        // Returns false if the underlying socket is closed.
+
+    std::size_t coalescedWrites() const;
+        // Returns the number of writes which were coalesced  
+        // into a preceding write while in cork mode.
+
+    virtual uv::Loop* loop() const;
+
+    virtual PooledBuffer* recvBuffer() const;
+        // Returns the pooled buffer holding the data currently being
+        // dispatched, or nullptr if no receive pool is set.
+        // See Stream::setRecvBufferPool()
+            
+    void setError(const scy::Error& err);
+    const scy::Error& error() const;
+    
+    virtual bool closed() const;
+        // Returns true if the native socket handle is closed.
+    
+    net::Address address() const;
+        // Returns the IP address and port number of the socket.
+        // A wildcard address is returned if the socket is not connected.
+        
+    net::Address peerAddress() const;
+        // Returns the IP address and port number of the peer socket.
+        // A wildcard address is returned if the socket is not connected.
+
+    net::TransportType transport() const;
+        // Returns the TCP transport protocol.
+    
+#ifdef _WIN32
+    void setSimultaneousAccepts(bool enable);
+#endif
+    
+    Signal<const net::TCPSocket::Ptr&> AcceptConnection;
+    
+public:
+    virtual void onConnect(uv_connect_t* handle, int status);
+    virtual void onAcceptConnection(uv_stream_t* handle, int status);
+    virtual void onRead(const char* data, std::size_t len);
+    virtual void onRecv(const MutableBuffer& buf);
+    virtual void onError(const scy::Error& error);
+    virtual void onClose();
+        
+protected:
+    virtual void init();
+    virtual int openReusePort(const net::Address& address);
+    virtual void corkWrite(const ConstBuffer* bufs, std::size_t count);
+    virtual void startCorkFlush();
+    virtual void stopCorkFlush();
+    //virtual void* self() { return this; }
+
+    //std::unique_ptr<uv_connect_t> _connectReq;
+    uv_connect_t* _connectReq;
+    uv_check_t* _corkCheck;
+    uv_idle_t* _corkIdle;
+    Buffer _corkBuffer;
+    std::size_t _corkSize;
+    std::size_t _corkThreshold;
+    std::size_t _corkWrites;
+    std::size_t _coalescedWrites;
+    bool _corked;
+};
+
+
+} } // namespace scy::net
+
+
+#endif // SCY_Net_TCPSocket_H
\ No newline at end of file
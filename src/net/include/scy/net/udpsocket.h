@@ -0,0 +1,168 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Net_UDPSocket_H
+#define SCY_Net_UDPSocket_H
+
+
+#include "scy/uv/uvpp.h"
+#include "scy/net/socket.h"    
+#include "scy/net/types.h"
+#include "scy/net/address.h"
+
+
+namespace scy {
+namespace net {
+
+
+struct UDPBatchContext;
+
+    
+class UDPSocket: public net::Socket, public uv::Handle
+{
+public:
+    typedef std::shared_ptr<UDPSocket> Ptr;
+    typedef std::vector<Ptr> Vec;
+
+    UDPSocket(uv::Loop* loop = uv::defaultLoop());
+    virtual ~UDPSocket();
+    
+    virtual void connect(const net::Address& peerAddress);
+    virtual void close();    
+
+    virtual void bind(const net::Address& address, unsigned flags = 0);
+
+    virtual int send(const char* data, std::size_t len, int flags = 0);
+    virtual int send(const char* data, std::size_t len, const net::Address& peerAddress, int flags = 0);
+    virtual int send(const ConstBuffer* bufs, std::size_t count, int flags = 0);
+    virtual int send(const ConstBuffer* bufs, std::size_t count, const net::Address& peerAddress, int flags = 0);
+    
+    virtual bool setBroadcast(bool flag);
+    virtual bool setMulticastLoop(bool flag);
+    virtual bool setMulticastTTL(int ttl);
+    
+    virtual net::Address address() const;
+    virtual net::Address peerAddress() const;
+
+    net::TransportType transport() const;
+        /// Returns the UDP transport protocol.
+            
+    virtual void setError(const scy::Error& err);        
+    virtual const scy::Error& error() const;
+
+    virtual bool closed() const;
+        /// Returns true if the native socket 
+        /// handle is closed.
+
+    virtual bool active() const;
+        /// Returns true if the socket is receiving, either 
+        /// via libuv or the batch mode poll handle.
+
+    virtual uv::Loop* loop() const;
+
+    void setRecvBufferPool(const BufferPool::Ptr& pool);
+        /// Sets the pool from which receive buffers are allocated.
+        /// When set each datagram is read into a reference counted
+        /// slab which may be retained past the receive callback.
+
+    virtual PooledBuffer* recvBuffer() const;
+        /// Returns the pooled buffer holding the datagram currently
+        /// being dispatched, or nullptr if no pool is set.
+        /// The buffer is only valid during the receive callback:
+        /// call duplicate() on it to retain the data past the 
+        /// callback, and release() once done with it.
+
+    void setRecvHeadroom(std::size_t headroom);
+        /// Reserves the given number of writable bytes in front of 
+        /// each received datagram, so protocol headers can be 
+        /// prepended in place before the data is forwarded.
+
+    std::size_t recvHeadroom() const;
+        /// Returns the receive headroom in bytes.
+    
+    bool setBatchMode(bool enable, std::size_t batchSize = 32, std::size_t slotSize = 2048);
+        /// Enables batched datagram I/O using recvmmsg(2) and sendmmsg(2).
+        ///
+        /// Up to batchSize datagrams are received per system call and
+        /// dispatched via onRecvBatch(). Each datagram is read into a
+        /// slot of slotSize bytes, or into a pooled buffer if a receive
+        /// pool is set, and larger datagrams are dropped.
+        ///
+        /// Outgoing datagrams are copied into a send queue which is 
+        /// flushed with a single system call at the end of the current
+        /// loop iteration, or as soon as batchSize datagrams are queued.
+        ///
+        /// Returns false if batched I/O is not supported on this platform.
+        /// The mode may be set before or after bind().
+
+    bool batchMode() const;
+        /// Returns true if batched I/O is enabled.
+
+    virtual bool flush();
+        /// Sends any datagrams queued in batch mode.
+        /// Returns false if the socket is in error.
+
+    virtual void onRecvBatch(const MutableBuffer* bufs, const net::Address* addresses, std::size_t count);
+        /// Called with each batch of datagrams received in batch mode.
+        /// The default implementation emits BatchRecv and then 
+        /// dispatches each datagram to onRecv().
+    
+    virtual void onRecv(const MutableBuffer& buf, const net::Address& address);
+
+    Signal3<const MutableBuffer*, const net::Address*, std::size_t> BatchRecv;
+        /// Signals each batch of datagrams received in batch mode,
+        /// prior to dispatching them individually via Recv.
+
+protected:    
+    virtual void init();    
+    virtual int openReusePort(const Address& address);
+    virtual bool recvStart();
+    virtual bool recvStop();
+
+    static void onRecv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned flags);
+    static void afterSend(uv_udp_send_t* req, int status); 
+    static void allocRecvBuffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t* buf);
+    static void onBatchPoll(uv_poll_t* handle, int status, int events);
+
+    virtual bool batchRecvStart();
+    virtual void batchRecv();
+    virtual void queueBatchSend(const ConstBuffer* bufs, std::size_t count, const net::Address& peerAddress);
+    virtual void freeBatch();
+
+    virtual void onError(const scy::Error& error);
+    virtual void onClose();
+    
+    net::Address _peer;
+    Buffer _buffer;
+    BufferPool::Ptr _recvPool;
+    PooledBuffer* _recvBuffer;  // owned, reused unless retained
+    PooledBuffer* _batchBuffer; // batch slab being dispatched
+    UDPBatchContext* _batch;
+    std::size_t _batchSize;
+    std::size_t _batchSlotSize;
+    std::size_t _recvHeadroom;
+
+    friend struct UDPBatchContext;
+};
+
+
+} } // namespace scy::net
+
+
+#endif // SCY_Net_UDPSocket_H
\ No newline at end of file
@@ -0,0 +1,338 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/address.h"
+#include "scy/logger.h"
+#include "scy/memory.h"
+#include "scy/types.h"
+
+#include "uv.h"
+
+
+using std::endl;
+
+
+namespace scy {
+namespace net {
+
+
+//
+// Address
+//
+
+
+Address::Address()
+{
+    memset(&_addr, 0, sizeof(_addr));
+    _addr.v4.sin_family = AF_INET;
+}
+
+
+Address::Address(const std::string& addr, UInt16 port)
+{
+    init(addr, port);
+}
+
+
+Address::Address(const std::string& addr, const std::string& port)
+{
+    init(addr, resolveService(port));
+}
+
+
+Address::Address(const std::string& hostAndPort)
+{
+    assert(!hostAndPort.empty());
+
+    std::string host;
+    std::string port;
+    std::string::const_iterator it  = hostAndPort.begin();
+    std::string::const_iterator end = hostAndPort.end();
+    if (*it == '[') {
+        ++it;
+        while (it != end && *it != ']') host += *it++;
+        if (it == end) throw std::runtime_error("Invalid address: Malformed IPv6 address");
+        ++it;
+    }
+    else {
+        while (it != end && *it != ':') host += *it++;
+    }
+    if (it != end && *it == ':') {
+        ++it;
+        while (it != end) port += *it++;
+    }
+    else throw std::runtime_error("Invalid address: Missing port number");
+    init(host, resolveService(port));
+}
+
+
+Address::Address(const struct sockaddr* addr, socklen_t length)
+{
+    init(addr, length);
+}
+
+
+void Address::init(const std::string& host, UInt16 port)
+{
+    //TraceLS(this) << "Parse: " << host << ":" << port << endl;
+
+    memset(&_addr, 0, sizeof(_addr));
+    if (uv_inet_pton(AF_INET, host.c_str(), &_addr.v4.sin_addr) == 0) {
+        _addr.v4.sin_family = AF_INET;
+        _addr.v4.sin_port = htons(port);
+    }
+#if defined(LibSourcey_HAVE_IPv6)
+    else if (uv_inet_pton(AF_INET6, host.c_str(), &_addr.v6.sin6_addr) == 0) {
+        _addr.v6.sin6_family = AF_INET6;
+        _addr.v6.sin6_port = htons(port);
+    }
+#endif
+    else
+        throw std::runtime_error("Invalid IP address format: " + host);
+}
+
+
+void Address::init(const struct sockaddr* addr, socklen_t length)
+{
+    // Only the family, port, host address and scope are copied 
+    // so padding and flow information never affect comparison.
+    memset(&_addr, 0, sizeof(_addr));
+    if (length == sizeof(struct sockaddr_in)) {
+        auto in = reinterpret_cast<const struct sockaddr_in*>(addr);
+        _addr.v4.sin_family = AF_INET;
+        _addr.v4.sin_port = in->sin_port;
+        _addr.v4.sin_addr = in->sin_addr;
+    }
+#if defined(LibSourcey_HAVE_IPv6)
+    else if (length == sizeof(struct sockaddr_in6)) {
+        auto in6 = reinterpret_cast<const struct sockaddr_in6*>(addr);
+        _addr.v6.sin6_family = AF_INET6;
+        _addr.v6.sin6_port = in6->sin6_port;
+        _addr.v6.sin6_addr = in6->sin6_addr;
+        _addr.v6.sin6_scope_id = in6->sin6_scope_id;
+    }
+#endif
+    else throw std::runtime_error("Invalid address length passed to Address()");
+}
+
+
+std::string Address::host() const
+{
+    char dest[46];
+    if (_addr.sa.sa_family == AF_INET) {
+        if (uv_ip4_name(&_addr.v4, dest, 16) != 0)
+            throw std::runtime_error("Cannot parse IPv4 hostname");
+    }
+#if defined(LibSourcey_HAVE_IPv6)
+    else {
+        if (uv_ip6_name(&_addr.v6, dest, 46) != 0)
+            throw std::runtime_error("Cannot parse IPv6 hostname");
+    }
+#endif
+    return dest;
+}
+
+
+UInt16 Address::port() const
+{
+    return ntohs(_addr.v4.sin_port); // same offset for sockaddr_in6
+}
+
+
+Address::Family Address::family() const
+{
+    return _addr.sa.sa_family == AF_INET6 ? Address::IPv6 : Address::IPv4;
+}
+
+
+socklen_t Address::length() const
+{
+#if defined(LibSourcey_HAVE_IPv6)
+    if (_addr.sa.sa_family == AF_INET6)
+        return sizeof(_addr.v6);
+#endif
+    return sizeof(_addr.v4);
+}
+
+
+const struct sockaddr* Address::addr() const
+{
+    return &_addr.sa;
+}
+
+
+int Address::af() const
+{
+    return _addr.sa.sa_family;
+}
+
+
+bool Address::valid() const 
+{
+    if (port() == 0)
+        return false;
+    if (_addr.sa.sa_family == AF_INET)
+        return _addr.v4.sin_addr.s_addr != 0;
+#if defined(LibSourcey_HAVE_IPv6)
+    if (_addr.sa.sa_family == AF_INET6)
+        return !IN6_IS_ADDR_UNSPECIFIED(&_addr.v6.sin6_addr);
+#endif
+    return true;
+}
+
+
+std::size_t Address::hash() const
+{
+    // FNV-1a over the IP address bytes and port.
+    const UInt8* data;
+    std::size_t len;
+#if defined(LibSourcey_HAVE_IPv6)
+    if (_addr.sa.sa_family == AF_INET6) {
+        data = reinterpret_cast<const UInt8*>(&_addr.v6.sin6_addr);
+        len = sizeof(_addr.v6.sin6_addr);
+    }
+    else 
+#endif
+    {
+        data = reinterpret_cast<const UInt8*>(&_addr.v4.sin_addr);
+        len = sizeof(_addr.v4.sin_addr);
+    }
+
+    UInt32 hash = 2166136261U;
+    for (std::size_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * 16777619U;
+    UInt16 port = _addr.v4.sin_port;
+    hash = (hash ^ (port & 0xFF)) * 16777619U;
+    hash = (hash ^ (port >> 8)) * 16777619U;
+    return hash;
+}
+
+
+std::string Address::toString() const
+{
+    std::string result;
+    if (family() == Address::IPv6)
+        result.append("[");
+    result.append(host());
+    if (family() == Address::IPv6)
+        result.append("]");
+    result.append(":");
+    result.append(util::itostr<UInt16>(port()));
+    return result;
+}
+
+
+bool Address::operator < (const Address& addr) const
+{
+    if (af() != addr.af()) 
+        return af() < addr.af();
+
+    int r;
+#if defined(LibSourcey_HAVE_IPv6)
+    if (af() == AF_INET6) {
+        r = memcmp(&_addr.v6.sin6_addr, &addr._addr.v6.sin6_addr, sizeof(_addr.v6.sin6_addr));
+        if (r == 0 && port() == addr.port())
+            return _addr.v6.sin6_scope_id < addr._addr.v6.sin6_scope_id;
+    }
+    else
+#endif
+        r = memcmp(&_addr.v4.sin_addr, &addr._addr.v4.sin_addr, sizeof(_addr.v4.sin_addr));
+    if (r != 0)
+        return r < 0;
+    return port() < addr.port();
+}
+
+
+bool Address::operator == (const Address& addr) const
+{
+    return af() == addr.af() && 
+        memcmp(&_addr, &addr._addr, length()) == 0;
+}
+
+
+bool Address::operator != (const Address& addr) const
+{
+    return !(*this == addr);
+}
+
+
+void Address::swap(Address& addr)
+{
+    std::swap(_addr, addr._addr);
+}
+
+
+//
+// Static helpers
+//
+
+
+bool Address::validateIP(const std::string& addr)
+{
+    char ia[sizeof(struct in6_addr)];
+    if (uv_inet_pton(AF_INET, addr.c_str(), &ia) == 0)
+        return true;
+    else if (uv_inet_pton(AF_INET6, addr.c_str(), &ia) == 0)
+        return true;
+    return false;
+}
+
+
+UInt16 Address::resolveService(const std::string& service)
+{
+    UInt16 port = util::strtoi<UInt16>(service);
+    if (port && port > 0) //, port) && port <= 0xFFFF
+        return (UInt16) port;
+
+    struct servent* se = getservbyname(service.c_str(), nullptr);
+    if (se)
+        return ntohs(se->s_port);
+    else
+        throw std::runtime_error("Service not found: " + service);
+}
+
+
+} } // namespace scy::net
+
+
+
+// Copyright (c) 2005-2006, Applied Informatics Software Engineering GmbH.
+// and Contributors.
+//
+// Permission is hereby granted, free of charge, to any person or organization
+// obtaining a copy of the software and accompanying documentation covered by
+// this license (the "Software") to use, reproduce, display, distribute,
+// execute, and transmit the Software, and to prepare derivative works of the
+// Software, and to permit third-parties to whom the Software is furnished to
+// do so, all subject to the following:
+//
+// The copyright notices in the Software and this entire statement, including
+// the above license grant, this restriction and the following disclaimer,
+// must be included in all copies of the Software, in whole or in part, and
+// all derivative works of the Software, unless such copies or derivative
+// works are solely in the form of machine-executable object code generated by
+// a source language processor.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+// SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+// FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+// ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+// DEALINGS IN THE SOFTWARE.
\ No newline at end of file
@@ -0,0 +1,188 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/shardrunner.h"
+#include "scy/platform.h"
+#include "scy/logger.h"
+#include "scy/stream.h"
+
+#include <thread>
+#include <cstdlib>
+#include <stdexcept>
+
+
+using std::endl;
+
+
+namespace scy {
+namespace net {
+
+
+ShardRunner::ShardRunner(int numThreads) :
+    _numThreads(numThreads > 0 ? numThreads : std::max<int>(1, std::thread::hardware_concurrency()))
+{
+}
+
+
+ShardRunner::~ShardRunner()
+{
+    stop();
+}
+
+
+void ShardRunner::start(const Factory& factory)
+{
+    assert(_shards.empty());
+    TraceL << "Starting " << _numThreads << " shards" << endl;
+
+    // Build the shard table before starting any thread so
+    // it never changes while the shard threads are live.
+    for (int i = 0; i < _numThreads; i++)
+        _shards.push_back(new Shard(i));
+    for (auto shard : _shards) {
+        shard->thread = new Thread([this, shard, factory]() {
+            run(*shard, factory);
+        });
+    }
+
+    // Wait until every shard is started so bind
+    // errors are reported to the caller.
+    std::string error;
+    for (auto shard : _shards) {
+        while (shard->state == Shard::Starting)
+            scy::sleep(1);
+        if (shard->state == Shard::Failed && error.empty())
+            error = shard->error;
+    }
+    if (!error.empty()) {
+        stop();
+        throw std::runtime_error(error);
+    }
+}
+
+
+void ShardRunner::stop()
+{
+    if (_shards.empty())
+        return;
+
+    TraceL << "Stopping" << endl;
+    {
+        // The stopper is only posted to under lock, since the shard
+        // thread clears it before the stopper is closed or destroyed.
+        Mutex::ScopedLock lock(_mutex);
+        for (auto shard : _shards) {
+            if (shard->stopper)
+                shard->stopper->post();
+        }
+    }
+    for (auto shard : _shards) {
+        shard->thread->join();
+        delete shard->thread;
+        delete shard;
+    }
+    _shards.clear();
+}
+
+
+bool ShardRunner::running() const
+{
+    return !_shards.empty();
+}
+
+
+int ShardRunner::numThreads() const
+{
+    return _numThreads;
+}
+
+
+void ShardRunner::run(Shard& shard, const Factory& factory)
+{
+    // The event loop and the shard are created on the shard
+    // thread, which owns them until the runner is stopped.
+    uv::Loop* loop = uv_loop_new();
+    {
+        async::Startable* server = nullptr;
+        SyncContext stopper(loop);
+        stopper.start([&]() {
+            {
+                Mutex::ScopedLock lock(_mutex);
+                shard.stopper = nullptr;
+            }
+            server->stop();
+            stopper.close();
+        });
+
+        try {
+            server = factory(shard.index, loop);
+            server->start();
+            Mutex::ScopedLock lock(_mutex);
+            shard.stopper = &stopper;
+            shard.state = Shard::Running;
+        }
+        catch (std::exception& exc) {
+            ErrorL << "Shard failed to start: " << exc.what() << endl;
+            shard.error = exc.what();
+            if (server)
+                server->stop();
+            stopper.close();
+            shard.state = Shard::Failed;
+        }
+
+        // Run until stopped. The loop may also exit on its own,
+        // so the stopper is cleared again before it is destroyed.
+        uv_run(loop, UV_RUN_DEFAULT);
+        {
+            Mutex::ScopedLock lock(_mutex);
+            shard.stopper = nullptr;
+        }
+        delete server;
+    }
+
+    // Run the loop once more to complete handles
+    // closed by the shard destructor.
+    uv_run(loop, UV_RUN_NOWAIT);
+    int err = uv_loop_close(loop);
+    if (err) {
+        // Close any handles left open and run the loop until they, 
+        // and any writes still in flight, have completed.
+        WarnL << "Shard event loop has active handles on exit" << endl;
+        uv_walk(loop, [](uv_handle_t* handle, void*) {
+            if (!uv_is_closing(handle))
+                uv_close(handle, nullptr);
+        }, nullptr);
+        uv_run(loop, UV_RUN_DEFAULT);
+        err = uv_loop_close(loop);
+    }
+
+    // The write request pool may only be destroyed once the loop 
+    // is closed, since pending writes release into it. 
+    if (err == 0) {
+        WriteRequestPool::destroy(loop);
+        free(loop);
+    }
+    else
+        ErrorL << "Shard event loop could not be closed: " << uv_strerror(err) << endl;
+    if (shard.state == Shard::Running)
+        shard.state = Shard::Stopped;
+}
+
+
+} } // namespace scy::net
@@ -0,0 +1,213 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/socketadapter.h"
+#include "scy/net/socket.h"
+
+
+using std::endl;
+
+
+namespace scy {
+namespace net {
+
+
+SocketAdapter::SocketAdapter(SocketAdapter* sender, SocketAdapter* receiver) : 
+     _sender(sender)
+{
+    //TraceLS(this) << "Create" << endl;    
+    assert(sender != this);
+    //assert(receiver != this);
+
+    if (receiver)
+        addReceiver(receiver);
+}
+    
+
+SocketAdapter::~SocketAdapter()
+{
+    //TraceLS(this) << "Destroy" << endl;    
+    
+#if 0
+    // Delete child adapters
+    // In order to prevent deletion, the outside 
+    // application must nullify the adapter pointers
+    if (_recvAdapter)
+        delete _recvAdapter;
+    if (_sender)
+        delete _sender;
+#endif
+}
+
+    
+int SocketAdapter::send(const char* data, std::size_t len, int flags)
+{
+    assert(_sender); // should have output adapter if default impl is used
+    if (!_sender) return -1;
+    return _sender->send(data, len, flags);
+}
+
+
+int SocketAdapter::send(const char* data, std::size_t len, const Address& peerAddress, int flags)
+{
+    assert(_sender); // should have output adapter if default impl is used
+    if (!_sender) return -1;
+    return _sender->send(data, len, peerAddress, flags);
+}
+
+
+int SocketAdapter::send(const ConstBuffer* bufs, std::size_t count, int flags)
+{
+    if (_sender)
+        return _sender->send(bufs, count, flags);
+
+    // End of the chain: flatten for adapters which only implement send()
+    Buffer buf;
+    for (std::size_t i = 0; i < count; i++)
+        buf.insert(buf.end(), bufferCast<const char*>(bufs[i]), 
+            bufferCast<const char*>(bufs[i]) + bufs[i].size());
+    return send(buf.data(), buf.size(), flags);
+}
+
+
+int SocketAdapter::send(const ConstBuffer* bufs, std::size_t count, const Address& peerAddress, int flags)
+{
+    if (_sender)
+        return _sender->send(bufs, count, peerAddress, flags);
+
+    // End of the chain: flatten for adapters which only implement send()
+    Buffer buf;
+    for (std::size_t i = 0; i < count; i++)
+        buf.insert(buf.end(), bufferCast<const char*>(bufs[i]), 
+            bufferCast<const char*>(bufs[i]) + bufs[i].size());
+    return send(buf.data(), buf.size(), peerAddress, flags);
+}
+
+
+int SocketAdapter::sendPacket(const IPacket& packet, int flags)
+{    
+    // Try to cast as RawPacket so we can send without copying any data.
+    auto raw = dynamic_cast<const RawPacket*>(&packet);
+    if (raw)
+        return send((const char*)raw->data(), raw->size(), flags);
+
+    // Gathered packets are sent as a single vectored write.
+    auto gathered = dynamic_cast<const GatheredPacket*>(&packet);
+    if (gathered)
+        return send(gathered->buffers(), gathered->count(), flags);
+    
+    // Dynamically generated packets need to be written to a
+    // temp buffer for sending. 
+    else {
+        Buffer buf;
+        packet.write(buf);
+        return send(buf.data(), buf.size(), flags);
+    }
+}
+
+
+int SocketAdapter::sendPacket(const IPacket& packet, const Address& peerAddress, int flags)
+{    
+    // Try to cast as RawPacket so we can send without copying any data.
+    auto raw = dynamic_cast<const RawPacket*>(&packet);
+    if (raw)
+        return send((const char*)raw->data(), raw->size(), peerAddress, flags);
+
+    // Gathered packets are sent as a single vectored write.
+    auto gathered = dynamic_cast<const GatheredPacket*>(&packet);
+    if (gathered)
+        return send(gathered->buffers(), gathered->count(), peerAddress, flags);
+    
+    // Dynamically generated packets need to be written to a
+    // temp buffer for sending. 
+    else {
+        Buffer buf; //(2048);
+        //buf.reserve(2048);
+        packet.write(buf);
+        return send(buf.data(), buf.size(), peerAddress, flags);
+    }
+}
+
+
+void SocketAdapter::sendPacket(IPacket& packet)
+{
+    int res = sendPacket(packet, 0);
+    if (res < 0)
+        throw std::runtime_error("Invalid socket operation");
+}
+
+
+void SocketAdapter::onSocketConnect()
+{
+    Connect.emit(self());
+}
+
+
+void SocketAdapter::onSocketRecv(const MutableBuffer& buffer, const Address& peerAddress)
+{
+    Recv.emit(self(), buffer, peerAddress);
+}
+
+
+void SocketAdapter::onSocketError(const scy::Error& error) //const Error& error
+{
+    Error.emit(self(), error);
+}
+
+
+void SocketAdapter::onSocketClose()
+{
+    Close.emit(self());
+}
+
+
+void SocketAdapter::addReceiver(SocketAdapter* adapter, int priority) 
+{    
+    Connect += delegate(adapter, &net::SocketAdapter::onSocketConnect, priority);
+    Recv += delegate(adapter, &net::SocketAdapter::onSocketRecv, priority);
+    Error += delegate(adapter, &net::SocketAdapter::onSocketError, priority);
+    Close += delegate(adapter, &net::SocketAdapter::onSocketClose, priority);
+}
+
+
+void SocketAdapter::removeReceiver(SocketAdapter* adapter)  
+{    
+    Connect -= delegate(adapter, &net::SocketAdapter::onSocketConnect);
+    Recv -= delegate(adapter, &net::SocketAdapter::onSocketRecv);
+    Error -= delegate(adapter, &net::SocketAdapter::onSocketError);
+    Close -= delegate(adapter, &net::SocketAdapter::onSocketClose);
+}
+
+
+void SocketAdapter::setSender(SocketAdapter* adapter, bool freeExisting)
+{
+    if (_sender == adapter) return;
+    if (_sender && freeExisting)
+        delete _sender;
+    _sender = adapter;
+}
+
+
+SocketAdapter* SocketAdapter::sender()
+{
+    return _sender;
+}
+
+
+} } // namespace scy::net
\ No newline at end of file
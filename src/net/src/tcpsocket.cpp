@@ -0,0 +1,533 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "scy/net/tcpsocket.h"
+#include "scy/logger.h"
+//#if POSIX
+//#include <sys/socket.h>
+//#endif
+
+#ifdef LINUX
+#include <unistd.h>
+#endif
+
+
+using std::endl;
+
+
+namespace scy {
+namespace net {
+
+
+TCPSocket::TCPSocket(uv::Loop* loop) :
+    Stream(loop),
+    _corkCheck(nullptr),
+    _corkIdle(nullptr),
+    _corkSize(0),
+    _corkThreshold(16384),
+    _corkWrites(0),
+    _coalescedWrites(0),
+    _corked(false)
+{
+    TraceLS(this) << "Create" << endl;
+    init();    
+}
+
+    
+TCPSocket::~TCPSocket() 
+{    
+    TraceLS(this) << "Destroy" << endl;    
+    close();
+}
+
+
+void TCPSocket::init()
+{
+    if (ptr()) return;
+
+    TraceLS(this) << "Init" << endl;
+    auto tcp = new uv_tcp_t;
+    tcp->data = this;
+    _ptr = reinterpret_cast<uv_handle_t*>(tcp);
+    _closed = false;
+    _error.reset();
+    int r = uv_tcp_init(loop(), tcp);
+    if (r)
+        setUVError("Cannot initialize TCP socket", r);
+}
+
+
+namespace internal {
+
+    UVStatusCallbackWithType(TCPSocket, onConnect, uv_connect_t);
+    UVStatusCallbackWithType(TCPSocket, onAcceptConnection, uv_stream_t);
+
+    static void onCorkCheck(uv_check_t* handle)
+    {
+        static_cast<TCPSocket*>(handle->data)->flush();
+    }
+
+    static void onCorkIdle(uv_idle_t*)
+    {
+        // The idle handle only ensures that the loop does not block
+        // for I/O while corked data is waiting to be flushed.
+    }
+
+}
+
+
+void TCPSocket::connect(const net::Address& peerAddress) 
+{
+    TraceLS(this) << "Connecting to " << peerAddress << endl;
+    init();
+    auto req = new uv_connect_t;
+    req->data = this;
+    int r = uv_tcp_connect(req, ptr<uv_tcp_t>(), peerAddress.addr(), internal::onConnect);
+    if (r) setAndThrowError("TCP connect failed", r);
+}
+
+
+void TCPSocket::bind(const net::Address& address, unsigned flags) 
+{
+    TraceLS(this) << "Binding on " << address << endl;
+    init();
+    int r;
+    if (flags & ReusePort) {
+        flags &= ~ReusePort;
+        r = openReusePort(address);
+        if (r) setAndThrowError("Cannot open TCP socket with SO_REUSEPORT", r);
+    }
+    switch (address.af()) {
+    case AF_INET:
+        r = uv_tcp_bind(ptr<uv_tcp_t>(), address.addr(), flags);
+        break;
+    //case AF_INET6:
+    //    r = uv_tcp_bind6(ptr<uv_tcp_t>(), *reinterpret_cast<const sockaddr_in6*>(address.addr()));
+    //    break;
+    default:
+        throw std::runtime_error("Unexpected address family");
+    }
+    if (r) setAndThrowError("TCP bind failed", r);
+}
+
+
+int TCPSocket::openReusePort(const net::Address& address)
+{
+    int fd = createReusePortSocket(address.af(), SOCK_STREAM);
+    if (fd < 0)
+        return fd;
+
+    int r = uv_tcp_open(ptr<uv_tcp_t>(), fd);
+#ifdef LINUX
+    if (r)
+        ::close(fd);
+#endif
+    return r;
+}
+
+
+void TCPSocket::listen(int backlog) 
+{
+    TraceLS(this) << "Listening" << endl;
+    init();
+    int r = uv_listen(ptr<uv_stream_t>(), backlog, internal::onAcceptConnection);
+    if (r) setAndThrowError("TCP listen failed", r);
+}
+
+
+bool TCPSocket::shutdown()
+{
+    TraceLS(this) << "Shutdown" << endl;
+    flush();
+    return Stream::shutdown();
+}
+
+
+void TCPSocket::close()
+{
+    TraceLS(this) << "Close" << endl;
+    flush();
+    stopCorkFlush();
+    if (_corkCheck) {
+        uv_close(reinterpret_cast<uv_handle_t*>(_corkCheck), [](uv_handle_t* handle) {
+            delete reinterpret_cast<uv_check_t*>(handle);
+        });
+        uv_close(reinterpret_cast<uv_handle_t*>(_corkIdle), [](uv_handle_t* handle) {
+            delete reinterpret_cast<uv_idle_t*>(handle);
+        });
+        _corkCheck = nullptr;
+        _corkIdle = nullptr;
+    }
+    Stream::close();
+}
+
+
+void TCPSocket::setNoDelay(bool enable) 
+{
+    init();
+    int r = uv_tcp_nodelay(ptr<uv_tcp_t>(), enable ? 1 : 0);
+    if (r) setUVError("TCP socket error", r);
+}
+
+
+void TCPSocket::setKeepAlive(int enable, unsigned int delay) 
+{
+    init();
+    int r = uv_tcp_keepalive(ptr<uv_tcp_t>(), enable, delay);
+    if (r) setUVError("TCP socket error", r);
+}
+
+
+void TCPSocket::setCork(bool enable, std::size_t flushThreshold) 
+{
+    TraceLS(this) << "Set cork: " << enable << ": " << flushThreshold << endl;
+    _corkThreshold = flushThreshold;
+    if (_corked == enable) 
+        return;
+    if (!enable)
+        flush();
+    _corked = enable;
+}
+
+
+bool TCPSocket::corked() const
+{
+    return _corked;
+}
+
+
+bool TCPSocket::flush()
+{
+    stopCorkFlush();
+    if (_corkBuffer.empty()) {
+        _corkWrites = 0;
+        return active();
+    }
+
+    TraceLS(this) << "Flush: " << _corkSize << ": " << _corkWrites << " writes" << endl;
+    if (_corkWrites > 1)
+        _coalescedWrites += _corkWrites - 1;
+    _corkWrites = 0;
+    _corkSize = 0;
+
+    // Pass ownership of the buffered data to the write request
+    Buffer payload;
+    payload.swap(_corkBuffer);
+    if (!Stream::write(std::move(payload))) {
+        WarnL << "Flush error" << endl;    
+        return false;
+    }
+    return true;
+}
+
+
+std::size_t TCPSocket::coalescedWrites() const
+{
+    return _coalescedWrites;
+}
+
+
+void TCPSocket::corkWrite(const ConstBuffer* bufs, std::size_t count)
+{
+    // Buffered data is always copied since the caller's buffers 
+    // need not outlive the send call, and the flush is deferred.
+    for (std::size_t i = 0; i < count; i++) {
+        auto data = bufferCast<const char*>(bufs[i]);
+        _corkBuffer.insert(_corkBuffer.end(), data, data + bufs[i].size());
+        _corkSize += bufs[i].size();
+    }
+    _corkWrites++;
+    startCorkFlush();
+}
+
+
+void TCPSocket::startCorkFlush()
+{
+    if (!_corkCheck) {
+        _corkCheck = new uv_check_t;
+        _corkCheck->data = this;
+        uv_check_init(loop(), _corkCheck);
+        _corkIdle = new uv_idle_t;
+        _corkIdle->data = this;
+        uv_idle_init(loop(), _corkIdle);
+    }
+
+    // The check handle flushes buffered data at the end of the current
+    // loop iteration, and the idle handle prevents the loop from 
+    // blocking for I/O in the meantime.
+    uv_check_start(_corkCheck, internal::onCorkCheck);
+    uv_idle_start(_corkIdle, internal::onCorkIdle);
+}
+
+
+void TCPSocket::stopCorkFlush()
+{
+    if (_corkCheck) {
+        uv_check_stop(_corkCheck);
+        uv_idle_stop(_corkIdle);
+    }
+}
+
+
+#ifdef _WIN32
+void TCPSocket::setSimultaneousAccepts(bool enable) 
+{
+    init();
+    int r = uv_tcp_simultaneous_accepts(ptr<uv_tcp_t>(), enable ? 1 : 0);
+    if (r) setUVError("TCP socket error", r);
+}
+#endif
+
+
+int TCPSocket::send(const char* data, std::size_t len, int flags) 
+{    
+    return send(data, len, peerAddress(), flags);
+}
+
+
+int TCPSocket::send(const char* data, std::size_t len, const net::Address& peerAddress, int flags) 
+{
+    //assert(len <= net::MAX_TCP_PACKET_SIZE); // libuv handles this for us
+    
+    TraceLS(this) << "Send: " << len << endl;    
+    assert(Thread::currentID() == tid());
+    
+#if 0
+    if (len < 300)
+        TraceLS(this) << "Send: " << len << ": " << std::string(data, len) << endl;
+    else {
+        std::string str(data, len);
+        TraceLS(this) << "Send: START: " << len << ": " << str.substr(0, 100) << endl;
+        TraceLS(this) << "Send: END: " << len << ": " << str.substr(str.length() - 100, str.length()) << endl;
+    }
+#endif
+
+    if (_corked) {
+        ConstBuffer buf(data, len);
+        return TCPSocket::send(&buf, 1, peerAddress, flags);
+    }
+
+    if (!Stream::write(data, len)) {
+        WarnL << "Send error" << endl;    
+        return -1;
+    }
+
+    // R is -1 on error, otherwise return len
+    // TODO: Return native error code?
+    return len;
+}
+
+
+int TCPSocket::send(const ConstBuffer* bufs, std::size_t count, int flags) 
+{    
+    return send(bufs, count, peerAddress(), flags);
+}
+
+
+int TCPSocket::send(const ConstBuffer* bufs, std::size_t count, const net::Address& /* peerAddress */, int /* flags */) 
+{
+    assert(Thread::currentID() == tid());
+
+    std::size_t len = 0;
+    for (std::size_t i = 0; i < count; i++)
+        len += bufs[i].size();
+    TraceLS(this) << "Send: " << len << ": " << count << " buffers" << endl;    
+
+    if (_corked) {
+        if (!active()) {
+            WarnL << "Send error" << endl;    
+            return -1;
+        }
+
+        // Buffer small writes until the end of the loop iteration, 
+        // and flush early once the threshold is reached.
+        if (len < _corkThreshold) {
+            corkWrite(bufs, count);
+            if (_corkSize >= _corkThreshold && !flush())
+                return -1;
+            return len;
+        }
+
+        // Large writes are sent directly once buffered data is flushed
+        if (!flush())
+            return -1;
+    }
+
+    if (!Stream::write(bufs, count)) {
+        WarnL << "Send error" << endl;    
+        return -1;
+    }
+    return len;
+}
+
+
+void TCPSocket::acceptConnection()
+{
+    // Create the shared socket pointer;
+    // if it is not handled it will be destroyed.
+    // TODO: Allow accepted sockets to use different event loops.
+    auto socket = net::makeSocket<net::TCPSocket>(loop()); //std::make_shared<net::TCPSocket>(this->loop());
+    TraceLS(this) << "Accept connection: " << socket->ptr() << endl;
+    uv_accept(ptr<uv_stream_t>(), socket->ptr<uv_stream_t>()); // uv_accept should always work
+    socket->readStart();        
+    AcceptConnection.emit(Socket::self(), socket);
+}
+
+
+net::Address TCPSocket::address() const
+{
+    if (!active())
+        return net::Address();
+        //throw std::runtime_error("Invalid TCP socket: No address");
+    
+    struct sockaddr_storage address;
+    int addrlen = sizeof(address);
+    int r = uv_tcp_getsockname(ptr<uv_tcp_t>(),
+                                reinterpret_cast<sockaddr*>(&address),
+                                &addrlen);
+    if (r)
+        return net::Address();
+        //throwLastError("Invalid TCP socket: No address");
+
+    return net::Address(reinterpret_cast<const sockaddr*>(&address), addrlen);
+}
+
+
+net::Address TCPSocket::peerAddress() const
+{
+    //TraceLS(this) << "Get peer address: " << closed() << endl;
+    if (!active())
+        return net::Address();
+        //throw std::runtime_error("Invalid TCP socket: No peer address");
+
+    struct sockaddr_storage address;
+    int addrlen = sizeof(address);
+    int r = uv_tcp_getpeername(ptr<uv_tcp_t>(),
+                                reinterpret_cast<sockaddr*>(&address),
+                                &addrlen);
+
+    if (r)
+        return net::Address();
+        //throwLastError("Invalid TCP socket: No peer address");
+
+    return net::Address(reinterpret_cast<const sockaddr*>(&address), addrlen);
+}
+
+
+void TCPSocket::setError(const scy::Error& err)
+{
+    assert(!error().any());
+    Stream::setError(err);
+}
+
+        
+const scy::Error& TCPSocket::error() const
+{
+    return Stream::error();
+}
+
+
+net::TransportType TCPSocket::transport() const 
+{ 
+    return net::TCP; 
+}
+    
+
+bool TCPSocket::closed() const
+{
+    return Stream::closed();
+}
+
+
+uv::Loop* TCPSocket::loop() const
+{
+    return uv::Handle::loop();
+}
+
+
+PooledBuffer* TCPSocket::recvBuffer() const
+{
+    return Stream::recvBuffer();
+}
+
+
+//
+// Callbacks
+
+void TCPSocket::onRead(const char* data, std::size_t len)
+{
+    TraceLS(this) << "On read: " << len << endl;
+
+    // Note: The const_cast here is relatively safe since the given 
+    // data pointer is the underlying _buffer.data() pointer, but
+    // a better way should be devised.
+    onRecv(mutableBuffer(const_cast<char*>(data), len));
+}
+
+
+void TCPSocket::onRecv(const MutableBuffer& buf)
+{
+    TraceLS(this) << "Recv: " << buf.size() << endl;
+    onSocketRecv(buf, peerAddress());
+}
+
+
+void TCPSocket::onConnect(uv_connect_t* handle, int status)
+{
+    TraceLS(this) << "On connect" << endl;
+    
+    // Error handled by static callback proxy
+    if (status == 0) {
+        if (readStart())
+            onSocketConnect();
+    }
+    else {
+        setUVError("Connection failed", status);    
+        //ErrorLS(this) << "Connection failed: " << error().message << endl;
+    }
+    delete handle;
+}
+
+
+void TCPSocket::onAcceptConnection(uv_stream_t*, int status) 
+{        
+    if (status == 0) {
+        TraceLS(this) << "On accept connection" << endl;
+        acceptConnection();
+    }
+    else
+        ErrorLS(this) << "Accept connection failed" << endl;
+}
+
+
+void TCPSocket::onError(const scy::Error& error) 
+{        
+    DebugLS(this) << "Error: " << error.message << endl;
+    onSocketError(error);
+    close(); // close on error
+}
+
+
+void TCPSocket::onClose() 
+{        
+    TraceLS(this) << "On close" << endl;    
+    onSocketClose();
+}
+
+
+} } // namespace scy::net
\ No newline at end of file
@@ -0,0 +1,984 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/net/udpsocket.h"
+#include "scy/net/types.h"
+#include "scy/logger.h"
+#include "scy/stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef LINUX
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+
+using namespace std;
+
+
+namespace scy {
+namespace net {
+
+    
+#if 0
+UDPSocket::UDPSocket() : 
+    net::Socket(new UDPSocket, false)
+{
+}
+
+
+UDPSocket::UDPSocket(UDPSocket* base, bool shared) : 
+    net::Socket(base, shared) 
+{
+}
+
+
+UDPSocket::UDPSocket(const Socket& socket) : 
+    net::Socket(socket)
+{
+    if (!dynamic_cast<UDPSocket*>(_base))
+        throw std::runtime_error("Cannot assign incompatible socket");
+}
+    
+
+UDPSocket& UDPSocket::base() const
+{
+    return static_cast<UDPSocket&>(*_base);
+}
+#endif
+
+
+//
+// Batch Context
+//
+
+
+struct UDPBatchContext 
+    /// Holds the recvmmsg(2) and sendmmsg(2) state for 
+    /// UDPSocket batch mode.
+{
+    uv_poll_t* poll;
+    uv_check_t* check;
+    uv_idle_t* idle;
+    int fd;                     // duplicate of the socket descriptor
+    std::size_t size;           // datagrams per system call
+    std::size_t slotSize;       // receive slot size
+    bool dispatching;           // inside the receive callback
+    bool released;              // released while dispatching
+    std::size_t queued;         // datagrams queued for sending
+    std::size_t fallbackPending; // datagrams handed to uv_udp_send
+
+    std::vector<PooledBuffer*> recvSlabs;
+    std::vector<PooledBuffer*> batchSlabs;
+    std::vector<MutableBuffer> batchBufs;
+    std::vector<net::Address> batchAddrs;
+    Buffer recvData;
+    Buffer sendData;
+    std::vector<std::size_t> sendOffsets;
+#ifdef LINUX
+    std::vector<mmsghdr> recvMsgs;
+    std::vector<iovec> recvIov;
+    std::vector<sockaddr_storage> recvAddrs;
+    std::vector<mmsghdr> sendMsgs;
+    std::vector<iovec> sendIov;
+    std::vector<sockaddr_storage> sendAddrs;
+#endif
+
+    UDPBatchContext(std::size_t size, std::size_t slotSize) :
+        poll(nullptr), check(nullptr), idle(nullptr), fd(-1),
+        size(size), slotSize(slotSize), dispatching(false), released(false),
+        queued(0), fallbackPending(0)
+    {
+    }
+
+    ~UDPBatchContext() 
+    {
+        for (auto slab : recvSlabs)
+            slab->release();
+    }
+};
+
+
+namespace internal {
+
+    static void onBatchCheck(uv_check_t* handle)
+    {
+        static_cast<UDPSocket*>(handle->data)->flush();
+    }
+
+    static void onBatchIdle(uv_idle_t*)
+    {
+        // The idle handle only ensures that the loop does not block
+        // for I/O while queued datagrams are waiting to be flushed.
+    }
+
+}
+
+
+//
+// UDP Base
+//
+
+
+UDPSocket::UDPSocket(uv::Loop* loop) :
+    uv::Handle(loop), 
+    _recvBuffer(nullptr),
+    _batchBuffer(nullptr),
+    _batch(nullptr),
+    _batchSize(0),
+    _batchSlotSize(2048),
+    _recvHeadroom(0)
+{
+    TraceLS(this) << "Create" << endl;
+    init();
+}
+
+
+UDPSocket::~UDPSocket()
+{
+    TraceLS(this) << "Destroy" << endl;
+    freeBatch();
+    if (_recvBuffer)
+        _recvBuffer->release();
+}
+
+
+void UDPSocket::init() 
+{
+    if (ptr()) return;
+    
+    TraceLS(this) << "Init" << endl;
+    uv_udp_t* udp = new uv_udp_t;
+    udp->data = this; //instance();
+    _closed = false;
+    _ptr = reinterpret_cast<uv_handle_t*>(udp);
+    int r = uv_udp_init(loop(), udp);
+    if (r)
+        setUVError("Cannot initialize UDP socket", r);
+}
+
+
+void UDPSocket::connect(const Address& peerAddress) 
+{
+    _peer = peerAddress;
+
+    // Send the Connected signal to mimic TCP behaviour  
+    // since socket implementations are interchangable.
+    //emitConnect();
+    onSocketConnect();
+}
+
+
+void UDPSocket::close()
+{
+    TraceLS(this) << "Closing" << endl;    
+    flush();
+    recvStop();
+    freeBatch();
+    uv::Handle::close();
+}
+
+
+void UDPSocket::bind(const Address& address, unsigned flags) 
+{    
+    TraceLS(this) << "Binding on " << address << endl;
+
+    int r;
+    if (flags & ReusePort) {
+        flags &= ~ReusePort;
+        r = openReusePort(address);
+        if (r)
+            setAndThrowError("Cannot open UDP socket with SO_REUSEPORT", r); 
+    }
+
+    switch (address.af()) {
+    case AF_INET:
+        r = uv_udp_bind(ptr<uv_udp_t>(), address.addr(), flags);
+        break;
+    //case AF_INET6:
+    //    r = uv_udp_bind6(ptr<uv_udp_t>(), address.addr(), flags);
+    //    break;
+    default:
+        throw std::runtime_error("Unexpected address family");
+    }
+
+    // Throw and exception of error
+    if (r)
+        setAndThrowError("Cannot bind UDP socket", r); 
+    
+    // Open the receiver channel
+    recvStart();
+}
+
+
+int UDPSocket::openReusePort(const Address& address)
+{
+    int fd = createReusePortSocket(address.af(), SOCK_DGRAM);
+    if (fd < 0)
+        return fd;
+
+    int r = uv_udp_open(ptr<uv_udp_t>(), fd);
+#ifdef LINUX
+    if (r)
+        ::close(fd);
+#endif
+    return r;
+}
+
+
+int UDPSocket::send(const char* data, std::size_t len, int flags) 
+{    
+    assert(_peer.valid());
+    return send(data, len, _peer, flags);
+}
+
+
+namespace internal {
+
+    struct SendRequest 
+        /// SendRequest owns a copy of the datagram for the lifetime
+        /// of the send, since libuv may queue the datagram until the
+        /// socket is writable. Requests are recycled per thread so 
+        /// the payload is only allocated when it needs to grow.
+    {
+        enum { 
+            MaxRetainedPayload = 4096 // Payload capacity kept when recycled
+        };
+
+        uv_udp_send_t req;
+        uv_buf_t buf;
+        Buffer payload; 
+        bool batched;
+
+        SendRequest() : batched(false) {}
+    };
+
+
+    struct SendRequestPool
+        /// A free list of SendRequests for the current thread.
+        /// Requests complete on the loop thread which issued them.
+    {
+        enum { MaxFree = 256 };
+
+        std::vector<SendRequest*> free;
+
+        ~SendRequestPool()
+        {
+            for (auto sr : free)
+                delete sr;
+        }
+
+        SendRequest* acquire(std::size_t size)
+        {
+            SendRequest* sr;
+            if (free.empty())
+                sr = new SendRequest;
+            else {
+                sr = free.back();
+                free.pop_back();
+            }
+            sr->payload.reserve(size);
+            return sr;
+        }
+
+        void release(SendRequest* sr)
+        {
+            sr->batched = false;
+            sr->payload.clear();
+            if (sr->payload.capacity() > SendRequest::MaxRetainedPayload)
+                Buffer().swap(sr->payload);
+            if (free.size() < MaxFree)
+                free.push_back(sr);
+            else
+                delete sr;
+        }
+    };
+
+
+    static thread_local SendRequestPool sendRequestPool;
+
+}
+
+
+int UDPSocket::send(const char* data, std::size_t len, const Address& peerAddress, int /* flags */) 
+{    
+    TraceLS(this) << "Send: " << len << ": " << peerAddress << endl;
+    assert(Thread::currentID() == tid());
+    //assert(len <= net::MAX_UDP_PACKET_SIZE);
+
+    if (_peer.valid() && _peer != peerAddress) {
+        ErrorLS(this) << "Peer not authorized: " << peerAddress << endl;
+        return -1;
+    }
+
+    if (!peerAddress.valid()) {
+        ErrorLS(this) << "Peer not valid: " << peerAddress << endl;
+        return -1;
+    }
+
+    if (_batch) {
+        ConstBuffer buf(data, len);
+        queueBatchSend(&buf, 1, peerAddress);
+        return len;
+    }
+    
+    // libuv queues datagrams until the socket is writable, so the
+    // data is copied into a pooled request rather than borrowed from 
+    // the caller, which is often a stack or receive buffer.
+    int r;    
+    auto sr = internal::sendRequestPool.acquire(len);
+    sr->payload.assign(data, data + len);
+    sr->buf = uv_buf_init(sr->payload.data(), len);
+    r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, peerAddress.addr(), UDPSocket::afterSend);
+
+#if 0
+    switch (peerAddress.af()) {
+    case AF_INET:
+        r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, peerAddress.addr(), UDPSocket::afterSend);
+        break;
+    case AF_INET6:
+        r = uv_udp_send6(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1,
+            *reinterpret_cast<const sockaddr_in6*>(peerAddress.addr()), UDPSocket::afterSend);
+        break;
+    default:
+        throw std::runtime_error("Unexpected address family");
+    }
+#endif
+    if (r) {
+        ErrorLS(this) << "Send failed: " << uv_err_name(r) << endl;
+        setUVError("Invalid UDP socket", r); 
+        internal::sendRequestPool.release(sr);
+    }
+    
+    // R is -1 on error, otherwise return len
+    return r ? r : len;
+}
+
+
+
+int UDPSocket::send(const ConstBuffer* bufs, std::size_t count, int flags) 
+{    
+    assert(_peer.valid());
+    return send(bufs, count, _peer, flags);
+}
+
+
+int UDPSocket::send(const ConstBuffer* bufs, std::size_t count, const Address& peerAddress, int /* flags */) 
+{    
+    assert(Thread::currentID() == tid());
+
+    std::size_t len = 0;
+    for (std::size_t i = 0; i < count; i++)
+        len += bufs[i].size();
+    TraceLS(this) << "Send: " << len << ": " << count << " buffers: " << peerAddress << endl;
+
+    if (_peer.valid() && _peer != peerAddress) {
+        ErrorLS(this) << "Peer not authorized: " << peerAddress << endl;
+        return -1;
+    }
+
+    if (!peerAddress.valid()) {
+        ErrorLS(this) << "Peer not valid: " << peerAddress << endl;
+        return -1;
+    }
+
+    if (_batch) {
+        queueBatchSend(bufs, count, peerAddress);
+        return len;
+    }
+    
+    // The buffers are gathered into a pooled request, as for 
+    // single buffer sends, since the datagram may be queued.
+    auto sr = internal::sendRequestPool.acquire(len);
+    for (std::size_t i = 0; i < count; i++) {
+        const char* data = bufferCast<const char*>(bufs[i]);
+        sr->payload.insert(sr->payload.end(), data, data + bufs[i].size());
+    }
+    sr->buf = uv_buf_init(sr->payload.data(), len);
+
+    int r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, peerAddress.addr(), UDPSocket::afterSend);
+    if (r) {
+        ErrorLS(this) << "Send failed: " << uv_err_name(r) << endl;
+        setUVError("Invalid UDP socket", r); 
+        internal::sendRequestPool.release(sr);
+    }
+    
+    return r ? r : len;
+}
+
+   
+bool UDPSocket::setBroadcast(bool flag)
+{
+    if (!ptr()) return false;
+    return uv_udp_set_broadcast(ptr<uv_udp_t>(), flag ? 1 : 0) == 0;
+}
+
+
+bool UDPSocket::setMulticastLoop(bool flag)
+{
+    if (!ptr()) return false;
+    return uv_udp_set_broadcast(ptr<uv_udp_t>(), flag ? 1 : 0) == 0;
+}
+
+
+bool UDPSocket::setMulticastTTL(int ttl)
+{
+    assert(ttl > 0 && ttl < 255);
+    if (!ptr()) return false;
+    return uv_udp_set_broadcast(ptr<uv_udp_t>(), ttl) == 0;
+}
+
+
+bool UDPSocket::recvStart() 
+{
+    if (_batchSize && batchRecvStart())
+        return true;
+
+    // UV_EALREADY means that the socket is already bound but that's okay
+    // TODO: No need for boolean value as this method can throw exceptions
+    // since it is called internally by bind().
+    int r = uv_udp_recv_start(ptr<uv_udp_t>(), UDPSocket::allocRecvBuffer, onRecv);
+    if (r && r != UV_EALREADY) {
+        setAndThrowError("Cannot start recv on invalid UDP socket", r);
+        return false;
+    }  
+    return true;
+}
+
+
+bool UDPSocket::recvStop() 
+{
+    // This method must not throw since it is called internally via libuv callbacks.
+    if (!ptr()) return false;
+    if (_batch && _batch->poll)
+        uv_poll_stop(_batch->poll);
+    return uv_udp_recv_stop(ptr<uv_udp_t>()) == 0;
+}
+
+
+void UDPSocket::onRecv(const MutableBuffer& buf, const net::Address& address)
+{
+    TraceLS(this) << "Recv: " << buf.size() << endl;    
+    //emitRecv(buf, address);
+    onSocketRecv(buf, address);
+}
+
+
+void UDPSocket::setError(const scy::Error& err)
+{
+    uv::Handle::setError(err);
+}
+
+        
+const scy::Error& UDPSocket::error() const
+{
+    return uv::Handle::error();
+}
+
+
+net::Address UDPSocket::address() const
+{    
+    if (!active())
+        return net::Address();
+        //throw std::runtime_error("Invalid UDP socket: No address");
+    
+    struct sockaddr address;
+    int addrlen = sizeof(address);
+    int r = uv_udp_getsockname(ptr<uv_udp_t>(), &address, &addrlen);
+    if (r)
+        return net::Address();
+        //throwLastError("Invalid UDP socket: No address");
+
+    return Address(&address, addrlen);
+}
+
+
+net::Address UDPSocket::peerAddress() const
+{
+    if (!_peer.valid())
+        return net::Address();
+        //throw std::runtime_error("Invalid UDP socket: No peer address");
+    return _peer;
+}
+
+
+net::TransportType UDPSocket::transport() const 
+{ 
+    return net::UDP; 
+}
+    
+
+bool UDPSocket::closed() const
+{
+    return uv::Handle::closed();
+}
+
+
+bool UDPSocket::active() const
+{
+    if (_batch && uv_is_active(reinterpret_cast<uv_handle_t*>(_batch->poll)))
+        return true;
+    return uv::Handle::active();
+}
+
+
+//
+// Callbacks
+
+void UDPSocket::onRecv(uv_udp_t* handle, ssize_t nread, const uv_buf_t* buf, const struct sockaddr* addr, unsigned /* flags */) 
+{    
+    auto socket = static_cast<UDPSocket*>(handle->data);
+    TraceL << "On recv: " << nread << endl;
+            
+    if (nread < 0) {
+        //assert(0 && "unexpected error");    
+        TraceL << "Recv error: " << uv_err_name(nread)<< endl;
+        socket->setUVError("UDP error", nread);
+        return;
+    }
+    
+    if (nread == 0) {
+        assert(addr == NULL);
+        // Returning unused buffer, this is not an error
+        // 11/12/13: This happens on linux but not windows
+        //socket->setUVError("End of file", UV_EOF);
+        // Any pooled buffer is kept for the next read.
+        return;
+    }
+    
+    // The pooled buffer is referenced for the duration of the 
+    // callback, since the callback may destroy the socket. 
+    // Only the local reference may be used afterwards.
+    PooledBuffer* pooled = socket->_recvBuffer;
+    if (pooled)
+        pooled->duplicate();
+    socket->onRecv(mutableBuffer(buf->base, nread), net::Address(addr, addr->sa_family == AF_INET6 ? 
+        sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in)));
+    if (pooled)
+        pooled->release();
+}
+
+
+void UDPSocket::afterSend(uv_udp_send_t* req, int status) 
+{
+    auto sr = reinterpret_cast<internal::SendRequest*>(req);
+    auto socket = reinterpret_cast<UDPSocket*>(sr->req.handle->data);    
+    if (sr->batched && socket->_batch && socket->_batch->fallbackPending)
+        socket->_batch->fallbackPending--;
+    if (status) {        
+        ErrorL << "Send error: " << uv_err_name(status) << endl;
+        socket->setUVError("UDP send error", status);
+    }
+    internal::sendRequestPool.release(sr);
+}
+
+
+void UDPSocket::onBatchPoll(uv_poll_t* handle, int status, int events)
+{
+    auto socket = static_cast<UDPSocket*>(handle->data);
+    if (status) {
+        socket->setUVError("UDP error", status);
+        return;
+    }
+    if (events & UV_READABLE)
+        socket->batchRecv();
+}
+
+
+void UDPSocket::allocRecvBuffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
+{
+    auto self = static_cast<UDPSocket*>(handle->data);    
+    //TraceL << "Allocating Buffer: " << suggested_size << endl;    
+    
+    // Reserve the recommended buffer size
+    // XXX: libuv wants us to allocate 65536 bytes for UDP .. hmmm
+    //if (suggested_size > self->_buffer.available())
+    //    self->_buffer.reserve(suggested_size); 
+    //assert(self->_buffer.capacity() >= suggested_size);
+    // The socket holds a reference to the current pooled buffer,
+    // which is reused unless the application retained it.
+    if (self->_recvPool) {
+        if (self->_recvBuffer && self->_recvBuffer->refCount() > 1) {
+            self->_recvBuffer->release();
+            self->_recvBuffer = nullptr;
+        }
+        if (!self->_recvBuffer)
+            self->_recvBuffer = self->_recvPool->get();
+        buf->base = self->_recvBuffer->data() + self->_recvHeadroom;
+        buf->len = self->_recvBuffer->capacity() - self->_recvHeadroom;
+        return;
+    }
+
+    // The buffer is allocated on first read
+    if (self->_buffer.empty())
+        self->_buffer.resize(65536);
+    assert(self->_buffer.size() >= suggested_size);
+
+    // Reset the buffer position on each read
+    //self->_buffer.position(0);
+    buf->base = self->_buffer.data() + self->_recvHeadroom;
+    buf->len = self->_buffer.size() - self->_recvHeadroom;
+
+    //return uv_buf_init(self->_buffer.data(), suggested_size);
+}
+
+
+void UDPSocket::onError(const scy::Error& error) 
+{        
+    ErrorLS(this) << "Error: " << error.message << endl;    
+    //emitError(error);
+    onSocketError(error);
+    close(); // close on error
+}
+
+
+void UDPSocket::onClose() 
+{        
+    ErrorLS(this) << "On close" << endl;    
+    //emitClose();
+    onSocketClose();
+}
+
+
+uv::Loop* UDPSocket::loop() const
+{
+    return uv::Handle::loop();
+}
+
+
+bool UDPSocket::setBatchMode(bool enable, std::size_t batchSize, std::size_t slotSize)
+{
+    TraceLS(this) << "Set batch mode: " << enable << ": " << batchSize << endl;
+#ifdef LINUX
+    _batchSize = enable ? std::max<std::size_t>(batchSize, 1) : 0;
+    _batchSlotSize = slotSize;
+
+    // Restart the receiver if the socket is already bound
+    if (ptr() && nativeSocketFd(ptr<uv_udp_t>()) != -1) {
+        flush();
+        recvStop();
+        freeBatch();
+        recvStart();
+    }
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+
+bool UDPSocket::batchMode() const
+{
+    return _batch != nullptr;
+}
+
+
+bool UDPSocket::flush()
+{
+    if (!_batch || !_batch->queued)
+        return !error().any();
+
+    auto ctx = _batch;
+    uv_check_stop(ctx->check);
+    uv_idle_stop(ctx->idle);
+
+    std::size_t sent = 0;
+#ifdef LINUX
+    // Datagrams already handed to libuv must be sent first 
+    // to preserve ordering, so queue behind them.
+    if (!ctx->fallbackPending) {
+        for (std::size_t i = 0; i < ctx->queued; i++) {
+            std::size_t end = i + 1 < ctx->queued ? ctx->sendOffsets[i + 1] : ctx->sendData.size();
+            ctx->sendIov[i].iov_base = ctx->sendData.data() + ctx->sendOffsets[i];
+            ctx->sendIov[i].iov_len = end - ctx->sendOffsets[i];
+        }
+        while (sent < ctx->queued) {
+            int n = ::sendmmsg(ctx->fd, &ctx->sendMsgs[sent], ctx->queued - sent, MSG_DONTWAIT);
+            if (n < 0) {
+                if (errno == EINTR) 
+                    continue;
+                break;
+            }
+            sent += n;
+        }
+    }
+#endif
+
+    TraceLS(this) << "Flush: " << sent << " of " << ctx->queued << " datagrams" << endl;
+
+    // Hand anything the kernel did not accept to libuv, which 
+    // retries once the socket is writable and reports errors.
+    int r = 0;
+    for (std::size_t i = sent; i < ctx->queued && !r; i++) {
+        std::size_t end = i + 1 < ctx->queued ? ctx->sendOffsets[i + 1] : ctx->sendData.size();
+        auto sr = internal::sendRequestPool.acquire(end - ctx->sendOffsets[i]);
+        sr->batched = true;
+        sr->payload.assign(ctx->sendData.begin() + ctx->sendOffsets[i], ctx->sendData.begin() + end);
+        sr->buf = uv_buf_init(sr->payload.data(), sr->payload.size());
+        r = uv_udp_send(&sr->req, ptr<uv_udp_t>(), &sr->buf, 1, 
+            reinterpret_cast<const sockaddr*>(&ctx->sendAddrs[i]), UDPSocket::afterSend);
+        if (r) {
+            ErrorLS(this) << "Send failed: " << uv_err_name(r) << endl;
+            internal::sendRequestPool.release(sr);
+        }
+        else ctx->fallbackPending++;
+    }
+
+    ctx->queued = 0;
+    ctx->sendData.clear();
+    ctx->sendOffsets.clear();
+    if (r)
+        setUVError("Invalid UDP socket", r); 
+    return r == 0;
+}
+
+
+void UDPSocket::queueBatchSend(const ConstBuffer* bufs, std::size_t count, const net::Address& peerAddress)
+{
+    auto ctx = _batch;
+    assert(ctx->queued < ctx->size);
+
+#ifdef LINUX
+    std::memcpy(&ctx->sendAddrs[ctx->queued], peerAddress.addr(), peerAddress.length());
+    ctx->sendMsgs[ctx->queued].msg_hdr.msg_namelen = peerAddress.length();
+#endif
+    ctx->sendOffsets.push_back(ctx->sendData.size());
+    for (std::size_t i = 0; i < count; i++)
+        ctx->sendData.insert(ctx->sendData.end(), bufferCast<const char*>(bufs[i]), 
+            bufferCast<const char*>(bufs[i]) + bufs[i].size());
+
+    if (++ctx->queued == ctx->size)
+        flush();
+    else if (ctx->queued == 1) {
+        uv_check_start(ctx->check, internal::onBatchCheck);
+        uv_idle_start(ctx->idle, internal::onBatchIdle);
+    }
+}
+
+
+bool UDPSocket::batchRecvStart()
+{
+#ifdef LINUX
+    if (!_batch) {
+        int fd = ::dup(nativeSocketFd(ptr<uv_udp_t>()));
+        if (fd < 0) {
+            WarnLS(this) << "Cannot enable batch mode: " << errno << endl;
+            return false;
+        }
+
+        // Read into pooled buffers if a receive pool is set
+        std::size_t slotSize = _recvPool ? _recvPool->bufferSize() : _batchSlotSize;
+        auto ctx = new UDPBatchContext(_batchSize, slotSize);
+        ctx->fd = fd;
+        ctx->recvMsgs.resize(ctx->size);
+        ctx->recvIov.resize(ctx->size);
+        ctx->recvAddrs.resize(ctx->size);
+        ctx->sendMsgs.resize(ctx->size);
+        ctx->sendIov.resize(ctx->size);
+        ctx->sendAddrs.resize(ctx->size);
+        std::memset(&ctx->recvMsgs[0], 0, sizeof(mmsghdr) * ctx->size);
+        std::memset(&ctx->sendMsgs[0], 0, sizeof(mmsghdr) * ctx->size);
+        if (_recvPool) {
+            for (std::size_t i = 0; i < ctx->size; i++)
+                ctx->recvSlabs.push_back(_recvPool->get());
+        }
+        else ctx->recvData.resize(ctx->size * slotSize);
+        for (std::size_t i = 0; i < ctx->size; i++) {
+            ctx->recvMsgs[i].msg_hdr.msg_iov = &ctx->recvIov[i];
+            ctx->recvMsgs[i].msg_hdr.msg_iovlen = 1;
+            ctx->recvMsgs[i].msg_hdr.msg_name = &ctx->recvAddrs[i];
+            ctx->sendMsgs[i].msg_hdr.msg_iov = &ctx->sendIov[i];
+            ctx->sendMsgs[i].msg_hdr.msg_iovlen = 1;
+            ctx->sendMsgs[i].msg_hdr.msg_name = &ctx->sendAddrs[i];
+        }
+
+        ctx->poll = new uv_poll_t;
+        ctx->poll->data = this;
+        uv_poll_init(loop(), ctx->poll, fd);
+        ctx->check = new uv_check_t;
+        ctx->check->data = this;
+        uv_check_init(loop(), ctx->check);
+        ctx->idle = new uv_idle_t;
+        ctx->idle->data = this;
+        uv_idle_init(loop(), ctx->idle);
+        _batch = ctx;
+    }
+
+    uv_udp_recv_stop(ptr<uv_udp_t>());
+    int r = uv_poll_start(_batch->poll, UV_READABLE, UDPSocket::onBatchPoll);
+    if (r) {
+        setAndThrowError("Cannot start batch recv on UDP socket", r);
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+void UDPSocket::batchRecv()
+{
+#ifdef LINUX
+    auto ctx = _batch;
+    ctx->dispatching = true;
+
+    // Read until the socket is drained, but bound the number 
+    // of rounds so other handles are not starved.
+    for (int round = 0; round < 4 && !ctx->released; round++) {
+        for (std::size_t i = 0; i < ctx->size; i++) {
+            ctx->recvIov[i].iov_base = (ctx->recvSlabs.empty() ? 
+                ctx->recvData.data() + i * ctx->slotSize : ctx->recvSlabs[i]->data()) + _recvHeadroom;
+            ctx->recvIov[i].iov_len = ctx->slotSize - _recvHeadroom;
+            ctx->recvMsgs[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            ctx->recvMsgs[i].msg_hdr.msg_flags = 0;
+        }
+
+        int n = ::recvmmsg(ctx->fd, &ctx->recvMsgs[0], ctx->size, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                setUVError("UDP error", -errno);
+            break;
+        }
+
+        ctx->batchBufs.clear();
+        ctx->batchAddrs.clear();
+        ctx->batchSlabs.clear();
+        for (int i = 0; i < n; i++) {
+            auto& hdr = ctx->recvMsgs[i].msg_hdr;
+            if (hdr.msg_flags & MSG_TRUNC) {
+                WarnLS(this) << "Dropping truncated datagram" << endl;
+                continue;
+            }
+            ctx->batchBufs.push_back(mutableBuffer(ctx->recvIov[i].iov_base, ctx->recvMsgs[i].msg_len));
+            ctx->batchAddrs.push_back(net::Address(reinterpret_cast<const sockaddr*>(&ctx->recvAddrs[i]), hdr.msg_namelen));
+            if (!ctx->recvSlabs.empty())
+                ctx->batchSlabs.push_back(ctx->recvSlabs[i]);
+        }
+
+        TraceLS(this) << "Batch recv: " << n << endl;
+        if (!ctx->batchBufs.empty())
+            onRecvBatch(&ctx->batchBufs[0], &ctx->batchAddrs[0], ctx->batchBufs.size());
+
+        // Replace the pooled buffers which were retained by the 
+        // application, they stay referenced by their owners.
+        if (!ctx->released && _recvPool && !ctx->recvSlabs.empty()) {
+            for (int i = 0; i < n; i++) {
+                if (ctx->recvSlabs[i]->refCount() > 1) {
+                    ctx->recvSlabs[i]->release();
+                    ctx->recvSlabs[i] = _recvPool->get();
+                }
+            }
+        }
+
+        if (static_cast<std::size_t>(n) < ctx->size)
+            break;
+    }
+
+    ctx->dispatching = false;
+    if (ctx->released)
+        delete ctx;
+#endif
+}
+
+
+void UDPSocket::onRecvBatch(const MutableBuffer* bufs, const net::Address* addresses, std::size_t count)
+{
+    TraceLS(this) << "Recv batch: " << count << endl;
+
+    // The batch context outlives the dispatch, and is marked released
+    // if the socket is closed or destroyed by a callback, in which case
+    // the socket must not be touched again.
+    auto ctx = _batch;
+    BatchRecv.emit(this, bufs, addresses, count);
+    for (std::size_t i = 0; i < count && !ctx->released; i++) {
+        _batchBuffer = i < ctx->batchSlabs.size() ? ctx->batchSlabs[i] : nullptr;
+        onRecv(bufs[i], addresses[i]);
+        if (!ctx->released)
+            _batchBuffer = nullptr;
+    }
+}
+
+
+void UDPSocket::freeBatch()
+{
+    if (!_batch)
+        return;
+
+    auto ctx = _batch;
+    _batch = nullptr;
+    uv_close(reinterpret_cast<uv_handle_t*>(ctx->poll), [](uv_handle_t* handle) {
+        delete reinterpret_cast<uv_poll_t*>(handle);
+    });
+    uv_close(reinterpret_cast<uv_handle_t*>(ctx->check), [](uv_handle_t* handle) {
+        delete reinterpret_cast<uv_check_t*>(handle);
+    });
+    uv_close(reinterpret_cast<uv_handle_t*>(ctx->idle), [](uv_handle_t* handle) {
+        delete reinterpret_cast<uv_idle_t*>(handle);
+    });
+
+#ifdef LINUX
+    // The duplicate descriptor shares the socket with the libuv handle,
+    // so its epoll registration must be removed explicitly before close.
+    struct epoll_event ev;
+    std::memset(&ev, 0, sizeof(ev));
+    ::epoll_ctl(uv_backend_fd(loop()), EPOLL_CTL_DEL, ctx->fd, &ev);
+    ::close(ctx->fd);
+#endif
+
+    // Deferred until the receive callback returns
+    if (ctx->dispatching)
+        ctx->released = true;
+    else
+        delete ctx;
+}
+
+
+void UDPSocket::setRecvBufferPool(const BufferPool::Ptr& pool)
+{
+    _recvPool = pool;
+}
+
+
+PooledBuffer* UDPSocket::recvBuffer() const
+{
+    return _batchBuffer ? _batchBuffer : _recvBuffer;
+}
+
+
+void UDPSocket::setRecvHeadroom(std::size_t headroom)
+{
+    assert(headroom < _batchSlotSize);
+    _recvHeadroom = headroom;
+}
+
+
+std::size_t UDPSocket::recvHeadroom() const
+{
+    return _recvHeadroom;
+}
+
+
+} } // namespace scy::net
\ No newline at end of file
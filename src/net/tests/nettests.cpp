@@ -0,0 +1,763 @@
+#include "scy/base.h"
+#include "scy/application.h"
+#include "scy/time.h"
+#include "scy/timer.h"
+#include "scy/idler.h"
+#include "scy/logger.h"
+#include "scy/bufferpool.h"
+#include "scy/net/tcpsocket.h"
+#include "scy/net/sslsocket.h"
+#include "scy/net/sslmanager.h"
+#include "scy/net/sslcontext.h"
+#include "scy/net/udpsocket.h"
+#include "scy/net/address.h"
+
+#include "echoserver.h"
+#include "clientsockettest.h"
+
+#include "assert.h"
+
+
+using namespace std;
+using namespace scy;
+
+
+/*
+// Detect memory leaks on winders
+#if defined(_DEBUG) && defined(_WIN32)
+#include "MemLeakDetect/MemLeakDetect.h"
+#include "MemLeakDetect/MemLeakDetect.cpp"
+CMemLeakDetect memLeakDetect;
+#endif
+*/
+
+
+namespace scy {
+namespace net {
+
+
+#define TEST_SSL 1
+
+
+class Tests
+{
+public:
+    Application app; 
+
+    Tests()
+    {    
+#ifdef _MSC_VER
+        _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+        {            
+
+#if TEST_SSL
+        SSLManager::initNoVerifyClient();
+
+            // Raise a SSL echo server
+            //Handle<SSLEchoServer> sslServer(new SSLEchoServer(1338, true), false);
+            //sslServer->run();
+#endif
+
+            // Raise a TCP echo server
+            //Handle<TCPEchoServer> tcpServer(new TCPEchoServer(1337, true), false); //true
+            //tcpServer->run();
+
+            runAddressTest();
+            runSocketAdapterTest();
+            //runTCPSocketTest();    
+            runTCPCorkTest();
+            runRecvBufferPoolTest();
+            runUDPBatchBenchmark();
+            runUDPSocketTest();
+
+#if TEST_SSL
+            //runSSLSocketTest();
+#endif    
+
+#if TEST_SSL
+            // Shutdown SSL
+            SSLManager::instance().shutdown();
+#endif
+
+            // Shutdown the garbage collector so we can free memory.
+            //GarbageCollector::instance().shutdown();
+        
+            // Run the final cleanup
+            runCleanup();
+        }
+    }
+    
+    // ============================================================================
+    // Address Test
+    //
+    void runAddressTest() 
+    {
+        TraceL << "Starting" << endl;        
+        
+        Address sa1("192.168.1.100", 100);
+        assert(sa1.host() == "192.168.1.100");
+        assert(sa1.port() == 100);
+
+        Address sa2("192.168.1.100", "100");
+        assert(sa2.host() == "192.168.1.100");
+        assert(sa2.port() == 100);
+
+        Address sa3("192.168.1.100", "ftp");
+        assert(sa3.host() == "192.168.1.100");
+        assert(sa3.port() == 21);
+        
+        Address sa7("192.168.2.120:88");
+        assert(sa7.host() == "192.168.2.120");
+        assert(sa7.port() == 88);
+
+        Address sa8("[192.168.2.120]:88");
+        assert(sa8.host() == "192.168.2.120");
+        assert(sa8.port() == 88);
+
+        try {
+            Address sa3("192.168.1.100", "f00bar");
+            assert(0 && "bad service name - must throw");
+        }
+        catch (std::exception&) {}
+
+        try {
+            Address sa6("192.168.2.120", "80000");
+            assert(0 && "invalid port - must throw");
+        }
+        catch (std::exception&) {}
+
+        try {
+            Address sa5("192.168.2.260", 80);
+            assert(0 && "invalid address - must throw");
+        }
+        catch (std::exception&) {}
+
+        try {
+            Address sa9("[192.168.2.260:", 88);
+            assert(0 && "invalid address - must throw");
+        }
+        catch (std::exception&) {}
+
+        try {
+            Address sa9("[192.168.2.260]");
+            assert(0 && "invalid address - must throw");
+        }
+        catch (std::exception&) {}
+
+        // Binary comparison, ordering and hashing
+        Address sa10("192.168.1.100", 100);
+        Address sa11(sa1.addr(), sa1.length());
+        assert(sa1 == sa10);
+        assert(sa1 == sa11);
+        assert(std::hash<Address>()(sa1) == std::hash<Address>()(sa11));
+        assert(!(sa1 != sa2));
+        assert(sa1 != Address("192.168.1.100", 101));
+        assert(sa1 != Address("192.168.1.101", 100));
+        assert(sa1 < Address("192.168.1.100", 101));
+        assert(sa1 < Address("192.168.1.101", 99));
+        assert(!(sa1 < sa10) && !(sa10 < sa1));
+        assert(!Address().valid());
+        assert(!Address("0.0.0.0", 100).valid());
+        assert(Address() == Address("0.0.0.0", 0));
+
+#if defined(LibSourcey_HAVE_IPv6)
+        assert(!Address("::", 100).valid());
+        assert(Address("::1", 100).valid());
+
+        Address sa12("[::1]:100");
+        assert(sa12.family() == Address::IPv6);
+        assert(sa12.host() == "::1");
+        assert(sa12.port() == 100);
+        assert(sa12 == Address(sa12.addr(), sa12.length()));
+        assert(sa12 != Address("[::2]:100"));
+        assert(sa1 < sa12);
+#endif
+    }    
+    
+    // ============================================================================
+    // TCP Socket Test
+    //
+    void runTCPSocketTest() 
+    {
+        TraceL << "TCP Socket Test: Starting" << endl;            
+        ClientSocketTest<net::TCPSocket> test(1337);
+        test.run();
+        runLoop();
+    }        
+
+    // ============================================================================
+    // SSL Socket Test
+    //
+    void runSSLSocketTest() 
+    {        
+        ClientSocketTest<net::SSLSocket> test(1338);
+        test.run();
+        runLoop();
+    }
+    
+    // ============================================================================
+    // UDP Socket Test
+    //
+    int UDPPacketSize;
+    int UDPNumPacketsWanted;
+    int UDPNumPacketsReceived;
+    net::Address udpServerAddr;
+    net::UDPSocket* udpClientSock;
+    /*
+    net::UDPSocket* serverSock;
+    net::Address serverBindAddr;    
+    net::Address clientBindAddr;    
+    net::Address clientSendAddr;
+    */
+    
+    void runUDPSocketTest() 
+    {
+        // Notes: Sending over home wireless network via
+        // ADSL to US server round trip stays around 200ms
+        // when sending 1450kb packets at 50ms intervals.
+        // At 40ms send intervals latency increated to around 400ms.
+
+        TraceL << "UDP Socket Test: Starting" << endl;
+        
+        //UDPPacketSize = 10000;
+        UDPPacketSize = 1450;
+        UDPNumPacketsWanted = 100;
+        UDPNumPacketsReceived = 0;
+        
+        //serverBindAddr.swap(net::Address("0.0.0.0", 1337));     //
+        //udpServerAddr.swap(net::Address("74.207.248.97", 1337));     //
+        //udpServerAddr.swap(net::Address("127.0.0.1", 1337));     //
+
+        //clientBindAddr.swap(net::Address("0.0.0.0", 1338));    
+        //clientSendAddr.swap(net::Address("58.7.41.244", 1337));     //
+        //clientSendAddr.swap(net::Address("127.0.0.1", 1337));     //
+
+        //net::UDPSocket serverSock;
+        //serverSock.Recv += sdelegate(this, &Tests::onUDPSocketServerRecv);
+        //serverSock.bind(serverBindAddr);
+        //this->serverSock = &serverSock;
+        
+        net::UDPSocket clientSock;
+        //clientSock.Recv += sdelegate(this, &Tests::onUDPClientSocketRecv);        
+        assert(0 && "fixme");
+        clientSock.bind(net::Address("0.0.0.0", 0));    
+        clientSock.connect(udpServerAddr);    
+        this->udpClientSock = &clientSock;
+
+        //for (unsigned i = 0; i < UDPNumPacketsWanted; i++)
+        //    clientSock.send("bounce", 6, serverBindAddr);        
+
+        // Start the send timer
+        Timer timer;
+        timer.Timeout += sdelegate(this, &Tests::onUDPClientSendTimer);
+        timer.start(50, 50);
+        timer.handle().ref();
+            
+        runLoop();
+        
+        //this->serverSock = nullptr;
+        this->udpClientSock = nullptr;
+    }
+    
+    /*
+    void onUDPSocketServerRecv(void* sender, net::SocketPacket& packet)
+    {
+        std::string payload(packet.data(), packet.size());        
+        DebugL << "UDPSocket server recv from " 
+            << packet.info->peerAddress << ": payloadLength=" << payload.length() << endl;
+        
+        // Send the unix ticks milisecond for checking RTT
+        //payload.assign(util::itostr(time::ticks()));
+        
+        // Relay back to the client to check RTT
+        //packet.info->socket->send(packet, packet.info->peerAddress);
+        //packet.info->socket->send(payload.c_str(), payload.length(), packet.info->peerAddress);        
+
+        packet.info->socket->send(payload.c_str(), payload.length(), clientSendAddr);    
+        
+    }
+    */
+
+    void onUDPClientSendTimer(void*)
+    {
+      /*
+        std::string payload(util::itostr(time::ticks()));
+        payload.append(UDPPacketSize - payload.length(), 'x');
+        udpClientSock->send(payload.c_str(), payload.length(), udpServerAddr);
+        */
+        std::string payload;
+        payload.append(UDPPacketSize, 'x');
+        udpClientSock->send(payload.c_str(), payload.length(), udpServerAddr);
+    }
+
+    void onUDPClientSocketRecv(void* sender, net::SocketPacket& packet)
+    {                
+        std::string payload(packet.data(), packet.size());
+        
+        DebugL << "UDPSocket recv from " << packet.info->peerAddress << ": " 
+            << "payload=" << payload.length()
+            << endl;
+            
+      /*
+        std::string payload(packet.data(), packet.size());
+        payload.erase(std::remove(payload.begin(), payload.end(), 'x'), payload.end());
+        UInt64 sentAt = util::strtoi<UInt64>(payload);
+        UInt64 latency = time::ticks() - sentAt;
+
+        DebugL << "UDPSocket recv from " << packet.info->peerAddress << ": " 
+            << "payload=" << payload.length() << ", " 
+            << "latency=" << latency 
+            << endl;
+            */
+        
+
+        /*
+        UDPNumPacketsReceived++;
+        if (UDPNumPacketsReceived == UDPNumPacketsWanted) {
+
+            // Close the client socket dereferencing the main loop.
+            packet.info->socket->close();            
+
+            // The server socket is still active so unref the loop once
+            // to cause the destruction of both the socket instances.
+            app.stop();
+        }
+        */
+    }
+    
+    
+    // ============================================================================
+    // Socket Adapter Test
+    //
+    // Vectored sends are forwarded along the adapter chain, and only
+    // flattened by an adapter at the end of the chain.
+    //
+    struct RecordingAdapter: public SocketAdapter
+    {
+        std::string data;
+        std::size_t count;
+
+        RecordingAdapter() : count(0) {}
+
+        virtual int send(const char* data, std::size_t len, int flags = 0)
+        {
+            this->data.append(data, len);
+            count++;
+            return len;
+        }
+
+        virtual int send(const ConstBuffer* bufs, std::size_t count, int flags = 0)
+        {
+            int len = 0;
+            for (std::size_t i = 0; i < count; i++) {
+                data.append(bufferCast<const char*>(bufs[i]), bufs[i].size());
+                len += bufs[i].size();
+            }
+            this->count += count;
+            return len;
+        }
+    };
+
+    struct ScalarAdapter: public SocketAdapter
+    {
+        std::string data;
+        std::size_t count;
+
+        ScalarAdapter() : count(0) {}
+
+        using SocketAdapter::send;
+
+        virtual int send(const char* data, std::size_t len, int flags = 0)
+        {
+            this->data.append(data, len);
+            count++;
+            return len;
+        }
+    };
+
+    void runSocketAdapterTest() 
+    {
+        TraceL << "Socket Adapter Test: Starting" << endl;
+
+        ConstBuffer bufs[3] = { 
+            ConstBuffer("head", 4), 
+            ConstBuffer("body", 4), 
+            ConstBuffer("tail", 4) 
+        };
+
+        RecordingAdapter recorder;
+        SocketAdapter forwarder(&recorder);
+        int sent = forwarder.send(bufs, 3);
+        assert(sent == 12);
+        assert(recorder.count == 3);
+        assert(recorder.data == "headbodytail");
+
+        ScalarAdapter scalar;
+        sent = scalar.send(bufs, 3);
+        assert(sent == 12);
+        assert(scalar.count == 1);
+        assert(scalar.data == "headbodytail");
+    }
+    
+    
+    // ============================================================================
+    // TCP Cork Test
+    //
+    // Sends several small writes and one larger segment in a single loop
+    // iteration, and checks they are coalesced into one write.
+    //
+    const static int TCPCorkNumSmallWrites = 8;
+
+    net::TCPSocket* tcpCorkServerSock;
+    net::TCPSocket* tcpCorkClientSock;
+    net::TCPSocket::Ptr tcpCorkAcceptedSock;
+    std::string tcpCorkLarge;
+    std::string tcpCorkExpected;
+    std::string tcpCorkReceived;
+
+    void runTCPCorkTest() 
+    {
+        TraceL << "TCP Cork Test: Starting" << endl;
+
+        tcpCorkLarge.assign(net::WriteRequest::MaxCopySize * 2, 'L');
+        tcpCorkExpected.clear();
+        tcpCorkReceived.clear();
+
+        net::TCPSocket serverSock;
+        net::TCPSocket clientSock;
+        tcpCorkServerSock = &serverSock;
+        tcpCorkClientSock = &clientSock;
+        serverSock.AcceptConnection += delegate(this, &Tests::onTCPCorkAccept);
+        serverSock.bind(net::Address("127.0.0.1", 0));
+        serverSock.listen();
+        clientSock.Connect += sdelegate(this, &Tests::onTCPCorkConnect);
+        clientSock.connect(net::Address("127.0.0.1", serverSock.address().port()));
+
+        runLoop();
+        
+        assert(tcpCorkReceived == tcpCorkExpected);
+        assert(clientSock.coalescedWrites() == TCPCorkNumSmallWrites);
+        tcpCorkAcceptedSock.reset();
+    }
+
+    void onTCPCorkConnect(void* sender)
+    {
+        auto& sock = *tcpCorkClientSock;
+        sock.setCork(true);
+        for (int i = 0; i < TCPCorkNumSmallWrites; i++) {
+            // Corked writes are copied, so stack data may be reused
+            char data[16];
+            int len = snprintf(data, sizeof(data), "small-%d;", i);
+            int sent = sock.send(data, len);
+            assert(sent == len);
+            tcpCorkExpected.append(data, len);
+            if (i == TCPCorkNumSmallWrites / 2) {
+                // Segments over WriteRequest::MaxCopySize are copied too
+                std::string large(tcpCorkLarge);
+                sent = sock.send(large.data(), large.size());
+                assert(sent == (int)large.size());
+                tcpCorkExpected.append(large);
+                large.assign(large.size(), 'X');
+            }
+        }
+        assert(sock.coalescedWrites() == 0);
+    }
+
+    void onTCPCorkAccept(const net::TCPSocket::Ptr& sock)
+    {
+        tcpCorkAcceptedSock = sock;
+        sock->Recv += sdelegate(this, &Tests::onTCPCorkRecv);
+    }
+
+    void onTCPCorkRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress)
+    {
+        tcpCorkReceived.append(bufferCast<const char*>(buffer), buffer.size());
+        if (tcpCorkReceived.size() >= tcpCorkExpected.size()) {
+            tcpCorkAcceptedSock->close();
+            tcpCorkClientSock->close();
+            tcpCorkServerSock->close();
+        }
+    }
+    
+    
+    // ============================================================================
+    // Receive Buffer Pool Test
+    //
+    // Retains the pooled buffer of a first read, checks it is not reused
+    // for the next read, and destroys the socket from its own callback.
+    //
+    BufferPool::Ptr recvPool;
+    PooledBuffer* recvPoolRetained;
+    int recvPoolReads;
+    net::TCPSocket* recvPoolServerSock;
+    net::TCPSocket* recvPoolClientSock;
+    net::TCPSocket::Ptr recvPoolAcceptedSock;
+    net::UDPSocket* recvPoolUDPSock;
+    net::UDPSocket* recvPoolUDPClientSock;
+
+    void runRecvBufferPoolTest() 
+    {
+        TraceL << "Receive Buffer Pool Test: Starting" << endl;
+        // TCP
+        {
+            recvPool = std::make_shared<BufferPool>(4096, 4);
+            recvPoolRetained = nullptr;
+            recvPoolReads = 0;
+            net::TCPSocket serverSock;
+            net::TCPSocket clientSock;
+            recvPoolServerSock = &serverSock;
+            recvPoolClientSock = &clientSock;
+            serverSock.AcceptConnection += delegate(this, &Tests::onRecvPoolAccept);
+            serverSock.bind(net::Address("127.0.0.1", 0));
+            serverSock.listen();
+            clientSock.Connect += sdelegate(this, &Tests::onRecvPoolConnect);
+            clientSock.connect(net::Address("127.0.0.1", serverSock.address().port()));
+            runLoop();
+            assert(recvPoolReads == 2);
+            assert(!recvPoolAcceptedSock);
+            assert(recvPool->allocated() == 2);
+        }
+
+        // UDP
+        {
+            recvPool = std::make_shared<BufferPool>(4096, 4);
+            recvPoolRetained = nullptr;
+            recvPoolReads = 0;
+            recvPoolUDPSock = new net::UDPSocket;
+            recvPoolUDPSock->setRecvBufferPool(recvPool);
+            recvPoolUDPSock->Recv += sdelegate(this, &Tests::onRecvPoolUDPRecv);
+            recvPoolUDPSock->bind(net::Address("127.0.0.1", 0));
+            net::UDPSocket clientSock;
+            recvPoolUDPClientSock = &clientSock;
+            clientSock.bind(net::Address("127.0.0.1", 0));
+            clientSock.send("first", 5, recvPoolUDPSock->address());
+            clientSock.send("second", 6, recvPoolUDPSock->address());
+            runLoop();
+            assert(recvPoolReads == 2);
+            assert(!recvPoolUDPSock);
+
+            // All slabs are back on the free list
+            assert(recvPool->allocated() == 2);
+            assert(recvPool->available() == 2);
+        }
+        recvPool.reset();
+    }
+
+    void onRecvPoolConnect(void* sender)
+    {
+        recvPoolClientSock->send("first", 5);
+    }
+
+    void onRecvPoolAccept(const net::TCPSocket::Ptr& sock)
+    {
+        recvPoolAcceptedSock = sock;
+        sock->setRecvBufferPool(recvPool);
+        sock->Recv += sdelegate(this, &Tests::onRecvPoolTCPRecv);
+    }
+
+    void onRecvPoolTCPRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress)
+    {
+        if (checkRecvPoolRead(recvPoolAcceptedSock->recvBuffer(), buffer)) {
+            recvPoolClientSock->send("second", 6);
+            return;
+        }
+
+        // Writing to a pooled packet copies the payload first
+        {
+            SocketPacket packet(recvPoolAcceptedSock, buffer, peerAddress, recvPoolAcceptedSock->recvBuffer());
+            assert(packet.slab);
+            SocketPacket copy(packet);
+            assert(copy.data() == packet.data());
+            copy.mutableData()[0] = 'S';
+            assert(!copy.slab);
+            assert(copy.data() != packet.data());
+            assert(std::string(copy.data(), copy.size()) == "Second");
+            assert(std::string(bufferCast<const char*>(buffer), buffer.size()) == "second");
+        }
+
+        // Destroy the socket from its own callback
+        recvPoolClientSock->close();
+        recvPoolServerSock->close();
+        recvPoolAcceptedSock->close();
+        recvPoolAcceptedSock.reset();
+    }
+
+    void onRecvPoolUDPRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress)
+    {
+        if (checkRecvPoolRead(recvPoolUDPSock->recvBuffer(), buffer))
+            return;
+
+        // Destroy the socket from its own callback
+        recvPoolUDPClientSock->close();
+        delete recvPoolUDPSock;
+        recvPoolUDPSock = nullptr;
+    }
+
+    bool checkRecvPoolRead(PooledBuffer* pooled, const MutableBuffer& buffer)
+        // Retains the first read and checks the second one.
+        // Returns true for the first read.
+    {
+        assert(pooled);
+        assert(pooled->contains(bufferCast<const char*>(buffer)));
+        if (recvPoolReads++ == 0) {
+            assert(std::string(bufferCast<const char*>(buffer), buffer.size()) == "first");
+            pooled->duplicate();
+            recvPoolRetained = pooled;
+            return true;
+        }
+
+        // The retained buffer is not reused for the second read
+        assert(pooled != recvPoolRetained);
+        assert(std::string(bufferCast<const char*>(buffer), buffer.size()) == "second");
+        std::size_t offset = bufferCast<const char*>(buffer) - pooled->data();
+        assert(std::string(recvPoolRetained->data() + offset, 5) == "first");
+        recvPoolRetained->release();
+        recvPoolRetained = nullptr;
+        return false;
+    }
+    
+    
+    // ============================================================================
+    // UDP Batch Benchmark
+    //
+    // Compares loopback packets/sec with UDPSocket batch mode on and off.
+    //
+    const static int UDPBenchPackets = 200000;
+    const static int UDPBenchPacketSize = 172; // G.711 RTP packet
+    const static int UDPBenchBurstSize = 32;
+    const static int UDPBenchMaxInFlight = 128;
+
+    int UDPBenchNumSent;
+    int UDPBenchNumReceived;
+    int UDPBenchNumBatches;
+    net::UDPSocket* udpBenchServerSock;
+    net::UDPSocket* udpBenchClientSock;
+
+    void runUDPBatchBenchmark() 
+    {
+        TraceL << "UDP Batch Benchmark: Starting" << endl;
+        double plain = runUDPBenchmark(false);
+        double batched = runUDPBenchmark(true);
+        cout << "UDP batch benchmark: " 
+            << "plain=" << plain << "pps, " 
+            << "batched=" << batched << "pps, "
+            << "speedup=" << (batched / plain) << endl;
+    }
+
+    double runUDPBenchmark(bool batch) 
+    {
+        UDPBenchNumSent = 0;
+        UDPBenchNumReceived = 0;
+        UDPBenchNumBatches = 0;
+        
+        net::UDPSocket serverSock;
+        net::UDPSocket clientSock;
+        if (batch && !(serverSock.setBatchMode(true) && clientSock.setBatchMode(true))) {
+            WarnL << "UDP batch mode not supported" << endl;
+            return 0;
+        }
+        serverSock.Recv += sdelegate(this, &Tests::onUDPBenchRecv);
+        serverSock.BatchRecv += sdelegate(this, &Tests::onUDPBenchRecvBatch);
+        serverSock.bind(net::Address("127.0.0.1", 0));
+        clientSock.bind(net::Address("127.0.0.1", 0));
+        udpBenchServerSock = &serverSock;
+        udpBenchClientSock = &clientSock;
+
+        // Send in bursts while keeping the number of packets in flight
+        // below the socket receive buffer so loopback does not drop.
+        net::Address serverAddr("127.0.0.1", serverSock.address().port());
+        std::string payload(UDPBenchPacketSize, 'x');
+        Idler sender(app.loop);
+        sender.start([&]() {
+            if (UDPBenchNumSent >= UDPBenchPackets) {
+                sender.cancel();
+                return;
+            }
+            if (UDPBenchNumSent - UDPBenchNumReceived > UDPBenchMaxInFlight)
+                return;
+            for (int i = 0; i < UDPBenchBurstSize; i++, UDPBenchNumSent++)
+                clientSock.send(payload.c_str(), payload.length(), serverAddr);
+        });
+
+        UInt64 start = uv_hrtime();
+        runLoop();
+        double secs = (uv_hrtime() - start) / 1e9;
+        double pps = UDPBenchNumReceived / secs;
+        
+        DebugL << "UDP benchmark: " 
+            << "batch=" << batch << ", " 
+            << "sent=" << UDPBenchNumSent << ", " 
+            << "received=" << UDPBenchNumReceived << ", " 
+            << "batches=" << UDPBenchNumBatches << ", " 
+            << "pps=" << pps
+            << endl;
+        return pps;
+    }
+
+    void onUDPBenchRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress)
+    {
+        assert(buffer.size() == UDPBenchPacketSize);
+        if (++UDPBenchNumReceived == UDPBenchPackets) {
+            udpBenchServerSock->close();
+            udpBenchClientSock->close();
+        }
+    }
+
+    void onUDPBenchRecvBatch(void* sender, const MutableBuffer* buffers, const net::Address* peerAddresses, std::size_t count)
+    {
+        UDPBenchNumBatches++;
+    }
+
+    // ============================================================================
+    // Timer Test
+    // TODO: Move to Base tests
+    //
+    const static int numTimerTicks = 5;
+
+    void runTimerTest() 
+    {
+        TraceL << "Timer Test: Starting" << endl;
+        Timer timer;
+        timer.Timeout += sdelegate(this, &Tests::onOnTimerTimeout);
+        timer.start(10, 10);
+        
+        runLoop();
+    }
+
+    void onOnTimerTimeout(void* sender)
+    {
+        Timer* timer = static_cast<Timer*>(sender);
+        TraceL << "On Timer: " << timer->count() << endl;
+
+        if (timer->count() == numTimerTicks)
+            timer->stop(); // event loop will be released
+    }
+
+    void runLoop() {
+        DebugL << "#################### Running" << endl;
+        app.run();
+        DebugL << "#################### Ended" << endl;
+    }
+
+    void runCleanup() {
+        DebugL << "#################### Finalizing" << endl;
+        app.finalize();
+        DebugL << "#################### Exiting" << endl;
+    }
+};
+
+
+} } // namespace scy::net
+
+
+int main(int argc, char** argv) 
+{    
+    Logger::instance().add(new ConsoleChannel("debug", LTrace));
+    Logger::instance().setWriter(new AsyncLogWriter);    
+    {
+        net::Tests run;
+    }
+    Logger::destroy();
+    return 0;
+}
@@ -0,0 +1,131 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_Sked_Scheduler_H
+#define SCY_Sked_Scheduler_H
+
+
+#include "scy/logger.h"
+#include "scy/taskrunner.h"
+#include "scy/json/iserializable.h"
+#include "scy/sked/task.h"
+#include "scy/sked/taskfactory.h"
+#include "scy/singleton.h"
+
+#include <vector>
+#include <unordered_map>
+
+
+namespace scy {
+namespace sked {
+
+
+static std::string DepreciatedDateFormat = "%Y-%m-%d %H:%M:%S %Z";
+
+
+class Scheduler: public TaskRunner, public json::ISerializable
+    /// The Scheduler manages and runs tasks
+    /// that need to be executed at specific times.
+    ///
+    /// Pending tasks are kept in a min-heap ordered by their next
+    /// trigger time, and the scheduler thread sleeps until the 
+    /// earliest deadline or until the schedule changes. The heap
+    /// is only updated when a task is scheduled or has run, so the 
+    /// cost of firing a task is logarithmic in the number of tasks.
+{
+public:
+    Scheduler();
+    virtual ~Scheduler();
+
+    virtual void schedule(sked::Task* task);
+    virtual void cancel(sked::Task* task);
+    virtual void clear();
+
+    virtual void reschedule(sked::Task* task);
+        // Updates the position of the task in the schedule.
+        // This must be called if the trigger of a scheduled 
+        // task is modified after the task was scheduled.
+
+    virtual bool destroy(scy::Task* task);
+    virtual bool exists(scy::Task* task) const;
+
+    virtual void serialize(json::Value& root);
+    virtual void deserialize(json::Value& root);
+
+    virtual void print(std::ostream& ost);
+
+    static Scheduler& getDefault();
+        // Returns the default Scheduler singleton,
+        // although Scheduler instances may also be
+        // initialized individually.
+
+    static sked::TaskFactory& factory();
+        // Returns the TaskFactory singleton.
+
+protected:
+    virtual void runNext();
+        // Runs the next due task, or sleeps until the next
+        // deadline or until the schedule changes.
+
+    virtual void update();
+        // Deletes destroyed tasks and rebuilds the timer heap.
+
+    virtual bool add(scy::Task* task);
+    virtual bool remove(scy::Task* task);
+
+    void rebuild(TaskList& deleted);
+        // Moves destroyed tasks to the deleted list and rebuilds
+        // the timer heap. The caller deletes the tasks once the
+        // mutex is released. Must be called with the mutex held,
+        // and only from the scheduler thread.
+
+    void compact();
+        // Removes stale entries from the timer heap.
+        // Must be called with the mutex held.
+
+    void push(sked::Task* task);
+        // Adds a heap entry for the next task timeout.
+        // Must be called with the mutex held.
+
+    struct Entry
+    {
+        Timestamp::TimeVal deadline;
+        UInt64 seq;
+        sked::Task* task;
+
+        bool operator > (const Entry& r) const { return deadline > r.deadline; }
+    };
+
+    struct Slot
+    {
+        std::size_t index; // position in the task list
+        UInt64 seq;        // sequence of the live heap entry, or 0
+    };
+
+    std::vector<Entry> _heap;
+    std::unordered_map<scy::Task*, Slot> _index;
+    UInt64 _seq;
+    bool _dirty;
+};
+
+
+} } // namespace scy::sked
+
+
+#endif // SCY_Sked_Scheduler_H
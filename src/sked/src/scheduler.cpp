@@ -0,0 +1,400 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/sked/scheduler.h"
+#include "scy/logger.h"
+#include "scy/platform.h"
+#include "scy/datetime.h"
+#include "scy/singleton.h"
+
+#include <algorithm>
+#include <functional>
+#include "assert.h"
+
+
+using namespace std;
+
+
+namespace scy {
+namespace sked {
+
+
+Scheduler::Scheduler() :
+    _seq(0),
+    _dirty(false)
+{    
+}
+
+
+Scheduler::~Scheduler() 
+{    
+    cancelRunner();
+}
+
+
+void Scheduler::schedule(sked::Task* task)
+{
+    // New tasks are pushed onto the heap when they are added
+    if (exists(task))
+        reschedule(task);
+    else
+        TaskRunner::start(task);
+}
+
+
+void Scheduler::cancel(sked::Task* task) 
+{
+    TaskRunner::cancel(task);
+    wakeUp();
+}
+
+
+void Scheduler::clear() 
+{
+    TaskList tasks;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        tasks.swap(_tasks);
+        tasks.insert(tasks.end(), _deleted.begin(), _deleted.end());
+        _deleted.clear();
+        _index.clear();
+        _heap.clear();
+        _wakeUp.broadcast();
+    }
+    for (auto it = tasks.begin(); it != tasks.end(); ++it) {    
+        TraceLS(this) << "Clear: Destroying task: " << *it << endl;
+        delete reinterpret_cast<sked::Task*>(*it);
+    }
+}
+
+
+void Scheduler::reschedule(sked::Task* task)
+{
+    Mutex::ScopedLock lock(_mutex);
+    push(task);
+}
+
+
+bool Scheduler::destroy(scy::Task* task)
+{
+    {
+        Mutex::ScopedLock lock(_mutex);
+        _dirty = true;
+    }
+    return TaskRunner::destroy(task);
+}
+
+
+bool Scheduler::exists(scy::Task* task) const
+{
+    Mutex::ScopedLock lock(_mutex);
+    return _index.find(task) != _index.end();
+}
+
+
+bool Scheduler::add(scy::Task* task)
+{
+    TraceLS(this) << "Add task: " << task << endl;
+    Mutex::ScopedLock lock(_mutex);
+    if (_index.find(task) != _index.end())
+        return false;
+    
+    sked::Task* t = reinterpret_cast<sked::Task*>(task);
+    {
+        Mutex::ScopedLock lock(t->_mutex);
+        if (!t->_scheduler)
+            t->_scheduler = this;
+    }
+
+    Slot slot = { _tasks.size(), 0 };
+    _index[task] = slot;
+    _tasks.push_back(task);
+    push(t);
+    onAdd(task);
+    return true;
+}
+
+
+bool Scheduler::remove(scy::Task* task)
+{
+    TraceLS(this) << "Remove task: " << task << endl;
+    Mutex::ScopedLock lock(_mutex);
+    auto it = _index.find(task);
+    if (it == _index.end())
+        return false;
+
+    // Swap the last task into the vacated slot so removal 
+    // doesn't need to shift the whole task list.
+    std::size_t index = it->second.index;
+    _index.erase(it);
+    if (index != _tasks.size() - 1) {
+        _tasks[index] = _tasks.back();
+        _index[_tasks[index]].index = index;
+    }
+    _tasks.pop_back();
+    onRemove(task);
+    return true;
+}
+
+
+void Scheduler::push(sked::Task* task)
+{
+    auto it = _index.find(task);
+    if (it == _index.end())
+        return;
+    
+    Entry entry;
+    {
+        Mutex::ScopedLock lock(task->_mutex);
+        if (!task->_trigger) {
+            // Tasks without a trigger are never run
+            it->second.seq = 0;
+            return;
+        }
+        entry.deadline = task->_trigger->scheduleAt.timestamp().epochMicroseconds();
+    }
+    entry.seq = ++_seq;
+    entry.task = task;
+    it->second.seq = entry.seq;
+    _heap.push_back(entry);
+    std::push_heap(_heap.begin(), _heap.end(), std::greater<Entry>());
+
+    // Rescheduled tasks leave stale entries behind, 
+    // so compact the heap if they start to pile up.
+    if (_heap.size() > _index.size() * 2 + 64)
+        compact();
+
+    // Only wake the scheduler if the next deadline moved
+    if (_heap.front().seq == entry.seq)
+        _wakeUp.broadcast();
+}
+
+
+void Scheduler::runNext() 
+{
+    // Clock changes are picked up at least this often
+    static const Int64 kMaxWaitMs = 1000;
+
+    bool async = _runner && _runner->async();
+    sked::Task* task = nullptr;
+    TaskList deleted;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        if (_dirty)
+            rebuild(deleted);
+        
+        // Pop the next due task, discarding stale heap entries
+        Int64 wait = kMaxWaitMs;
+        Timestamp::TimeVal now = Timestamp().epochMicroseconds();
+        while (!_heap.empty()) {
+            const Entry& top = _heap.front();
+            auto it = _index.find(top.task);
+            if (it == _index.end() || it->second.seq != top.seq) {
+                std::pop_heap(_heap.begin(), _heap.end(), std::greater<Entry>());
+                _heap.pop_back();
+                continue;
+            }
+            if (top.deadline > now) {
+                wait = std::min<Int64>((top.deadline - now + 999) / 1000, kMaxWaitMs);
+                break;
+            }
+            task = top.task;
+            it->second.seq = 0;
+            std::pop_heap(_heap.begin(), _heap.end(), std::greater<Entry>());
+            _heap.pop_back();
+            break;
+        }
+
+        // Sleep until the next deadline, or until woken 
+        // by a change to the schedule.
+        if (!task && deleted.empty()) {
+            if (async && !_runner->cancelled())
+                _wakeUp.tryWait(_mutex, static_cast<long>(wait));
+            return;
+        }
+    }
+
+    // Delete destroyed tasks outside the lock so 
+    // their destructors may use the scheduler.
+    for (auto it = deleted.begin(); it != deleted.end(); ++it) {
+        TraceLS(this) << "Destroy: " << *it << endl;
+        delete reinterpret_cast<sked::Task*>(*it);
+    }
+    if (!task)
+        return;
+    
+#if _DEBUG
+    {
+        DateTime now;
+        Timespan remaining = task->trigger().scheduleAt - now;
+        TraceLS(this) << "Waiting: "
+            << "\n\tPID: " << task
+            << "\n\tMilliseconds: " << remaining.totalMilliseconds()
+            << "\n\tCurrentTime: " << DateTimeFormatter::format(now, DateTimeFormat::ISO8601_FORMAT)
+            << "\n\tScheduledAt: " << DateTimeFormatter::format(task->trigger().scheduleAt, DateTimeFormat::ISO8601_FORMAT)
+            << endl;
+    }
+#endif
+    
+    // The task may have been cancelled or destroyed 
+    // since it was popped from the heap.
+    if (task->beforeRun()) {    
+        TraceLS(this) << "Running: " << task << endl;
+        task->run();    
+        if (task->afterRun())
+            onRun(task);
+        else {
+            TraceLS(this) << "Destroy After Run: " << task << endl;
+            task->_destroyed = true; //destroy();
+        }
+    }
+    else
+        TraceLS(this) << "Skipping Task: " << task << endl;
+    
+    // Destroy the task if needed, otherwise 
+    // schedule the next timeout.
+    if (task->destroyed()) {
+        TraceLS(this) << "Destroy Task: " << task << endl;    
+        remove(task);
+        delete task;
+    }
+    else if (!task->cancelled())
+        reschedule(task);
+}
+
+
+void Scheduler::update()
+{
+    TaskList deleted;
+    {
+        Mutex::ScopedLock lock(_mutex);
+        rebuild(deleted);
+    }
+    for (auto it = deleted.begin(); it != deleted.end(); ++it) {
+        TraceLS(this) << "Destroy: " << *it << endl;
+        delete reinterpret_cast<sked::Task*>(*it);
+    }
+}
+
+
+void Scheduler::rebuild(TaskList& deleted)
+{
+    //TraceLS(this) << "Updating: " << _tasks.size() << endl;
+    _dirty = false;
+
+    // Collect destroyed tasks and compact the task list
+    std::size_t n = 0;
+    for (std::size_t i = 0; i < _tasks.size(); i++) {
+        sked::Task* task = reinterpret_cast<sked::Task*>(_tasks[i]);
+        if (task->destroyed()) {
+            _index.erase(task);
+            onRemove(task);
+            deleted.push_back(task);
+        }
+        else {
+            _index[task].index = n;
+            _tasks[n++] = task;
+        }
+    }
+    _tasks.resize(n);
+    deleted.insert(deleted.end(), _deleted.begin(), _deleted.end());
+    _deleted.clear();
+    compact();
+}
+
+
+void Scheduler::compact()
+{
+    // Drop stale entries and restore the heap property
+    std::size_t m = 0;
+    for (std::size_t i = 0; i < _heap.size(); i++) {
+        auto it = _index.find(_heap[i].task);
+        if (it != _index.end() && it->second.seq == _heap[i].seq)
+            _heap[m++] = _heap[i];
+    }
+    _heap.resize(m);
+    std::make_heap(_heap.begin(), _heap.end(), std::greater<Entry>());
+}
+
+
+void Scheduler::serialize(json::Value& root)
+{
+    TraceLS(this) << "Serializing" << endl;
+    
+    Mutex::ScopedLock lock(_mutex);
+    for (auto it = _tasks.begin(); it != _tasks.end(); ++it) {
+        sked::Task* task = reinterpret_cast<sked::Task*>(*it);
+        TraceLS(this) << "Serializing: " << task << endl;
+        json::Value& entry = root[root.size()];
+        task->serialize(entry);
+        task->trigger().serialize(entry["trigger"]);
+    }
+}
+
+
+void Scheduler::deserialize(json::Value& root)
+{
+    TraceLS(this) << "Deserializing" << endl;
+    
+    for (auto it = root.begin(); it != root.end(); it++) {
+        sked::Task* task = nullptr;
+        sked::Trigger* trigger = nullptr;
+        try {
+            json::assertMember(*it, "trigger");
+            task = factory().createTask((*it)["type"].asString());
+            task->deserialize((*it));
+            trigger = factory().createTrigger((*it)["trigger"]["type"].asString());
+            trigger->deserialize((*it)["trigger"]);
+            task->setTrigger(trigger);
+            schedule(task);
+        }
+        catch (std::exception& exc) {
+            if (task)
+                delete task;
+            if (trigger)
+                delete trigger;
+            ErrorLS(this) << "Deserialization Error: " << exc.what() << endl;
+        }
+    }
+}
+
+
+void Scheduler::print(std::ostream& ost)
+{
+    json::StyledWriter writer;
+    json::Value data;
+    serialize(data);
+    ost << writer.write(data);
+}
+
+
+Scheduler& Scheduler::getDefault() 
+{
+    static Singleton<Scheduler> sh;
+    return *sh.get();
+}
+
+
+TaskFactory& Scheduler::factory() 
+{
+    return TaskFactory::getDefault();
+}
+
+
+} } // namespace scy::sked
@@ -0,0 +1,171 @@
+#include "scy/base.h"
+#include "scy/platform.h"
+#include "scy/filesystem.h"
+#include "scy/logger.h"
+#include "scy/util.h"
+#include "scy/stun/message.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <stdexcept>
+
+
+using namespace std;
+using namespace scy;
+
+
+/*
+// Detect Memory Leaks
+#ifdef _DEBUG
+#include "MemLeakDetect/MemLeakDetect.cpp"
+#include "MemLeakDetect/MemLeakDetect.h"
+CMemLeakDetect memLeakDetect;
+#endif
+*/
+
+
+namespace scy {
+namespace stun {
+    
+
+class Tests
+{
+public:
+    Tests()
+    {                    
+        testMessageIntegrity();
+        testMessageIntegrityVector();
+        //testXorAddress();
+        testReuestTypes();
+    }
+
+    
+    void testMessageIntegrity() 
+    {    
+        std::string username("someuser");
+        std::string password("somepass");
+        
+        stun::Message request(stun::Message::Request, stun::Message::Allocate);
+        //request.setType(stun::Message::Allocate);
+        
+        auto usernameAttr = new stun::Username;
+        usernameAttr->copyBytes(username.c_str(), username.size());
+        request.add(usernameAttr);
+        
+        auto integrityAttr = new stun::MessageIntegrity;
+        integrityAttr->setKey(password);
+        request.add(integrityAttr);
+
+        Buffer buf;
+        request.write(buf);
+
+        stun::Message response;
+        response.read(constBuffer(buf));
+        
+        integrityAttr = response.get<stun::MessageIntegrity>();
+        assert(integrityAttr->verifyHmac(password));
+    }
+    
+    void testMessageIntegrityVector() 
+    {    
+        // Sample request from http://tools.ietf.org/html/rfc5769#section-2.1
+        // The FINGERPRINT attribute follows MESSAGE-INTEGRITY, so the 
+        // header length must be adjusted before computing the HMAC.
+        const unsigned char sample[] = {
+            0x00, 0x01, 0x00, 0x58, 0x21, 0x12, 0xa4, 0x42, 0xb7, 0xe7, 0xa7, 0x01, 
+            0xbc, 0x34, 0xd6, 0x86, 0xfa, 0x87, 0xdf, 0xae, 0x80, 0x22, 0x00, 0x10, 
+            0x53, 0x54, 0x55, 0x4e, 0x20, 0x74, 0x65, 0x73, 0x74, 0x20, 0x63, 0x6c, 
+            0x69, 0x65, 0x6e, 0x74, 0x00, 0x24, 0x00, 0x04, 0x6e, 0x00, 0x01, 0xff, 
+            0x80, 0x29, 0x00, 0x08, 0x93, 0x2f, 0xf9, 0xb1, 0x51, 0x26, 0x3b, 0x36, 
+            0x00, 0x06, 0x00, 0x09, 0x65, 0x76, 0x74, 0x6a, 0x3a, 0x68, 0x36, 0x76, 
+            0x59, 0x20, 0x20, 0x20, 0x00, 0x08, 0x00, 0x14, 0x9a, 0xea, 0xa7, 0x0c, 
+            0xbf, 0xd8, 0xcb, 0x56, 0x78, 0x1e, 0xf2, 0xb5, 0xb2, 0xd3, 0xf2, 0x49, 
+            0xc1, 0xb5, 0x71, 0xa2, 0x80, 0x28, 0x00, 0x04, 0xe5, 0x7a, 0x3b, 0xcf
+        };
+        
+        std::string data(reinterpret_cast<const char*>(sample), sizeof(sample));
+        stun::Message request;
+        std::size_t nread = request.read(constBuffer(data));
+        assert(nread == sizeof(sample));
+        
+        auto integrityAttr = request.get<stun::MessageIntegrity>();
+        assert(integrityAttr);
+        assert(integrityAttr->verifyHmac("VOkJxbRl1RmTxUk/WvJxBt"));
+        assert(!integrityAttr->verifyHmac("VOkJxbRl1RmTxUk/WvJxBu"));
+
+        // Copies of the attribute and of the message stay valid after
+        // the receive buffer is reused, while the read attribute does not.
+        stun::MessageIntegrity copy(*integrityAttr);
+        stun::Message requestCopy(request);
+        data[24] = 0;
+        assert(!integrityAttr->verifyHmac("VOkJxbRl1RmTxUk/WvJxBt"));
+        assert(copy.verifyHmac("VOkJxbRl1RmTxUk/WvJxBt"));
+        assert(requestCopy.get<stun::MessageIntegrity>()->verifyHmac("VOkJxbRl1RmTxUk/WvJxBt"));
+    }
+    
+    void testReuestTypes() 
+    {    
+        UInt16 type = stun::Message::Indication | stun::Message::SendIndication;
+
+        //assert(IS_STUN_INDICATION(type));
+        
+        UInt16 classType = type & 0x0110;
+        UInt16 methodType = type & 0x000F;
+        
+        assert(classType == stun::Message::Indication);
+        assert(methodType == stun::Message::SendIndication);
+
+        stun::Message request(stun::Message::Indication, stun::Message::SendIndication);
+        //assert(IS_STUN_INDICATION(request.classType() | request.methodType()));
+            
+        assert(request.classType() != stun::Message::Request);
+        assert(request.classType() == stun::Message::Indication);
+
+        stun::Message request1(stun::Message::Request, stun::Message::Allocate);
+        //assert(IS_STUN_REQUEST(request1.classType() | request1.methodType()));
+    }
+    
+    
+    void testXorAddress() 
+    {    
+        assert(5555 == 0x15B3);
+        assert(5555 ^ (kMagicCookie >> 16) == 0x34A1);
+        
+        net::Address addr("192.168.1.1", 5555);
+        DebugL << "Source Address: " << addr << endl;
+        
+        stun::Message request(stun::Message::Request, stun::Message::Allocate);
+        //stun::Message request;
+        //request.setType(stun::Message::Allocate);
+        
+        auto addrAttr = new stun::XorRelayedAddress;
+        addrAttr->setAddress(addr);
+        request.add(addrAttr);
+        DebugL << "Request Address: " << addrAttr->address() << endl;
+
+        Buffer buf;
+        request.write(buf);
+
+        stun::Message response;
+        response.read(constBuffer(buf));
+                
+        addrAttr = response.get<stun::XorRelayedAddress>();    
+        
+        DebugL << "Response Address: " << addrAttr->address() << endl;
+        assert(addrAttr->address() == addr);
+    }
+};
+
+
+} } // namespace scy::stun
+
+
+int main(int argc, char** argv) 
+{    
+    Logger::instance().add(new ConsoleChannel("Test", LTrace));
+    {
+        stun::Tests app;
+    }    
+    Logger::destroy();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,112 @@
+#ifndef SCY_MediaServer_H
+#define SCY_MediaServer_H
+
+
+#include "scy/logger.h"
+#include "scy/application.h"
+#include "scy/util.h"
+#include "scy/packetstream.h"
+#include "scy/packetbroadcaster.h"
+#include "scy/media/avencoder.h"
+#include "scy/media/mediafactory.h"
+#include "scy/http/server.h"
+#include "scy/net/tcpsocket.h"
+#include "config.h"
+
+#include <map>
+
+
+namespace scy {
+
+
+class MediaServer;
+
+
+// ----------------------------------------------------------------------------
+// HTTP Streaming Options
+//
+struct StreamingOptions: public av::EncoderOptions
+{
+    std::string framing;        // HTTP response framing [chunked, multipart]
+    std::string encoding;        // The packet content encoding method [Base64, ...]
+
+    MediaServer* server;        // Media server instance
+    av::VideoCapture::Ptr videoCapture; // Video capture instance
+    av::AudioCapture::Ptr audioCapture; // Audio capture instance
+
+    StreamingOptions(MediaServer* server = nullptr,
+        av::VideoCapture::Ptr videoCapture = nullptr,
+        av::AudioCapture::Ptr audioCapture = nullptr);
+
+    virtual ~StreamingOptions();
+};
+
+
+// ----------------------------------------------------------------------------
+// Media Publisher
+//
+class MediaPublisher
+    /// MediaPublisher runs a single capture and encoder pipeline
+    /// and broadcasts the encoded packets to any number of viewer
+    /// streams, so the encoding cost does not grow with the number 
+    /// of viewers.
+{
+public:
+    typedef std::shared_ptr<MediaPublisher> Ptr;
+
+    MediaPublisher(const StreamingOptions& options);
+    virtual ~MediaPublisher();
+
+    void subscribe(PacketStream& stream, uv::Loop* loop, int queueSize = 16);
+        // Subscribes the viewer stream to the encoded packets.
+        // Packets are synchronized with the given event loop
+        // through a bounded queue which drops the oldest packets
+        // when the viewer falls behind.
+
+    PacketStream stream;
+    PacketBroadcaster* broadcaster; // managed by the stream
+};
+
+
+// ----------------------------------------------------------------------------
+// HTTP Media Server
+//
+class MediaServer: public http::Server
+{
+public:
+    MediaServer(UInt16 port);
+    virtual ~MediaServer();
+
+    MediaPublisher::Ptr getPublisher(const StreamingOptions& options);
+        // Returns the publisher for the capture source and output 
+        // format of the given options, creating one if no viewer
+        // is subscribed to a matching stream yet.
+
+    static void setupPacketStream(PacketStream& stream, const StreamingOptions& options, bool freeCaptures = true, bool attachPacketizers = false);
+    static void setupEncoder(PacketStream& stream, const StreamingOptions& options);
+    static void setupFraming(PacketStream& stream, const StreamingOptions& options);
+
+protected:
+    std::map<std::string, std::weak_ptr<MediaPublisher>> _publishers;
+    Mutex _mutex;
+};
+
+
+// ----------------------------------------------------------------------------
+// HTTP Streaming Connection Factory
+//
+class HTTPStreamingConnectionFactory: public http::ServerResponderFactory
+{
+public:
+    HTTPStreamingConnectionFactory(MediaServer* server);
+
+    http::ServerResponder* createResponder(http::ServerConnection& conn);
+    StreamingOptions createStreamingOptions(http::ServerConnection& conn);
+    MediaServer* _server;
+};
+
+
+} // namespace scy
+
+
+#endif
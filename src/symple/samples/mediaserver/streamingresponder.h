@@ -0,0 +1,87 @@
+#include "mediaserver.h"
+
+
+namespace scy { 
+
+
+class StreamingRequestHandler: public http::ServerResponder
+{
+public:
+    StreamingRequestHandler(http::ServerConnection& connection, const StreamingOptions& options) :
+        http::ServerResponder(connection), options(options)
+    {    
+        DebugLS(this) << "Create" << std::endl;
+    }
+
+    virtual ~StreamingRequestHandler() 
+    {
+        DebugLS(this) << "Destroy" << std::endl;
+    }
+        
+    virtual void onRequest(http::Request& request, http::Response& response) 
+    {
+        DebugLS(this) << "Handle request: " 
+            //<< "\n\tOutput Format: " << options.oformat.name
+            << "\n\tOutput Encoding: " << options.encoding
+            << "\n\tOutput Packetizer: " << options.framing
+            << std::endl;
+
+        // We will be sending our own headers
+        connection().shouldSendHeader(false);    
+
+        // Subscribe to the shared encoder pipeline and 
+        // add our own framing, which starts with the 
+        // response headers.
+        publisher = options.server->getPublisher(options);
+        publisher->subscribe(stream, connection().socket()->loop());
+        MediaServer::setupFraming(stream, options);
+
+        // Start the stream
+        stream.emitter += packetDelegate(this, &StreamingRequestHandler::onVideoEncoded);
+        stream.start();
+    }
+
+    virtual void onClose()
+    {
+        DebugLS(this) << "On close" << std::endl;
+        stream.emitter -= packetDelegate(this, &StreamingRequestHandler::onVideoEncoded);
+        stream.close();
+
+        // Release the publisher now rather than when the deferred
+        // connection is deleted, so the shared encoder stops as soon
+        // as its last viewer leaves.
+        publisher.reset();
+    }
+
+    void onVideoEncoded(void* sender, IPacket& packet)
+    {
+        DebugLS(this) << "Send packet: " 
+            << packet.size() << ": " << fpsCounter.fps << std::endl;
+        //assert(!connection().socket()->closed());
+
+        // Skip frames while the previous ones are still being
+        // written so slow viewers don't build up a backlog.
+        auto socket = dynamic_cast<net::TCPSocket*>(connection().socket().get());
+        if (socket && socket->writeQueueSize() > MAX_WRITE_QUEUE_SIZE) {
+            DebugLS(this) << "Dropping packet: " << socket->writeQueueSize() << std::endl;
+            return;
+        }
+
+        try {    
+            connection().socket()->sendPacket(packet);
+            fpsCounter.tick();        
+        }
+        catch (std::exception& exc) {
+            ErrorLS(this) << exc.what() << std::endl;
+            connection().close();
+        }
+    }
+    
+    MediaPublisher::Ptr publisher;
+    PacketStream stream;
+    StreamingOptions options;
+    av::FPSCounter fpsCounter;
+};
+
+
+} // namespace scy
\ No newline at end of file
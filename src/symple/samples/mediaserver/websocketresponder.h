@@ -0,0 +1,79 @@
+#include "mediaserver.h"
+#include "scy/http/websocket.h"
+
+
+namespace scy { 
+
+// ----------------------------------------------------------------------------
+//
+class WebSocketRequestHandler: public http::ServerResponder
+{
+public:
+    WebSocketRequestHandler(http::ServerConnection& connection, const StreamingOptions& options) :         
+        http::ServerResponder(connection), options(options)
+    {    
+        DebugLS(this) << "Create" << std::endl;
+        
+        // Subscribe to the shared encoder pipeline
+        publisher = options.server->getPublisher(options);
+        publisher->subscribe(stream, connection.socket()->loop());
+        MediaServer::setupFraming(stream, options);
+
+        // Start the stream
+        stream.emitter += packetDelegate(this, &WebSocketRequestHandler::onVideoEncoded);
+        stream.start();
+    }
+
+    virtual ~WebSocketRequestHandler() 
+    {
+        DebugLS(this) << "Destroy" << std::endl;            
+    }
+        
+    void onClose() 
+    {
+        DebugLS(this) << "On close" << std::endl;
+        
+        stream.emitter -= packetDelegate(this, &WebSocketRequestHandler::onVideoEncoded);
+        stream.close();    
+
+        // Release the publisher now rather than when the deferred
+        // connection is deleted, so the shared encoder stops as soon
+        // as its last viewer leaves.
+        publisher.reset();
+    }
+    
+    void onVideoEncoded(void* sender, IPacket& packet)
+    {
+        DebugLS(this) << "Sending Packet: "
+            << &connection() << ": " << packet.size() << ": " << fpsCounter.fps << std::endl;
+        //assert(!connection().socket()->closed());
+
+        // Skip frames while the previous ones are still being
+        // written so slow viewers don't build up a backlog.
+        auto socket = dynamic_cast<net::TCPSocket*>(connection().socket().get());
+        if (socket && socket->writeQueueSize() > MAX_WRITE_QUEUE_SIZE) {
+            DebugLS(this) << "Dropping packet: " << socket->writeQueueSize() << std::endl;
+            return;
+        }
+
+        try {                
+            if (connection().socket()->sendPacket(packet, http::ws::Binary) < 0)
+                throw std::runtime_error("Invalid socket operation");
+            //connection().sendData(packet.data(), packet.size(), http::WebSocket::Binary);
+            fpsCounter.tick();        
+        }
+        catch (std::exception& exc) {
+            ErrorLS(this) << "Error: " << exc.what() << std::endl;
+            connection().close();
+        }
+    }
+    
+    MediaPublisher::Ptr publisher;
+    PacketStream stream;
+    StreamingOptions options;
+    av::FPSCounter fpsCounter;
+};
+
+
+} // namespace scy
+
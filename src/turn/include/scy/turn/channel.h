@@ -0,0 +1,195 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TURN_Channel_H
+#define SCY_TURN_Channel_H
+
+
+#include "scy/turn/permission.h"
+#include "scy/net/address.h"
+
+#include <unordered_map>
+
+
+namespace scy {
+namespace turn {
+
+
+// A channel binding lasts for 10 minutes unless refreshed.
+const int CHANNEL_LIFETIME = 10 * 60 * 1000;
+
+// An expired channel number or peer may not be rebound 
+// elsewhere for 5 minutes (RFC 5766 section 11).
+const int CHANNEL_REBIND_DELAY = 5 * 60 * 1000;
+
+// The range of valid channel numbers.
+const UInt16 kMinChannelNumber = 0x4000;
+const UInt16 kMaxChannelNumber = 0x7FFE;
+
+// The ChannelData message header size.
+const int kChannelDataHeaderSize = 4;
+
+
+inline bool isChannelData(const char* data, std::size_t len)
+    // Returns true if the buffer begins with a ChannelData message.
+    // The first two bits of a ChannelData message are 0b01, which 
+    // distinguishes them from STUN messages which begin with 0b00.
+{
+    return len >= kChannelDataHeaderSize && (static_cast<UInt8>(data[0]) & 0xC0) == 0x40;
+}
+
+
+inline void writeChannelDataHeader(char* data, UInt16 number, UInt16 len)
+    // Writes the 4 byte ChannelData header to the given buffer.
+{
+    data[0] = static_cast<char>(number >> 8);
+    data[1] = static_cast<char>(number & 0xFF);
+    data[2] = static_cast<char>(len >> 8);
+    data[3] = static_cast<char>(len & 0xFF);
+}
+
+
+inline UInt16 readChannelNumber(const char* data)
+{
+    return static_cast<UInt16>((static_cast<UInt8>(data[0]) << 8) | static_cast<UInt8>(data[1]));
+}
+
+
+inline UInt16 readChannelDataLength(const char* data)
+{
+    return static_cast<UInt16>((static_cast<UInt8>(data[2]) << 8) | static_cast<UInt8>(data[3]));
+}
+
+
+struct ChannelPeerKey 
+    /// ChannelPeerKey is the binary transport address of a channel peer.
+{
+    PermissionKey ip;
+    UInt16 port;
+
+    ChannelPeerKey() : port(0) {}
+    explicit ChannelPeerKey(const net::Address& address) : 
+        ip(address), port(address.port()) {}
+
+    bool operator ==(const ChannelPeerKey& r) const
+    {
+        return port == r.port && ip == r.ip;
+    }
+
+    bool operator !=(const ChannelPeerKey& r) const
+    {
+        return !(*this == r);
+    }
+};
+
+
+struct ChannelPeerKeyHash 
+{
+    std::size_t operator()(const ChannelPeerKey& key) const
+    {
+        return PermissionKeyHash()(key.ip) ^ (static_cast<std::size_t>(key.port) << 1);
+    }
+};
+
+
+struct ChannelBinding 
+{
+    UInt16 number;
+    net::Address peerAddress;
+    UInt64 expiresAt; // monotonic milliseconds
+
+    ChannelBinding(UInt16 number, const net::Address& peerAddress, UInt64 expiresAt) : 
+        number(number), peerAddress(peerAddress), expiresAt(expiresAt)
+    {
+    }
+};
+
+
+class ChannelTable
+    /// ChannelTable holds the channel to peer bindings of an allocation.
+    /// Bindings are indexed by channel number and by binary peer 
+    /// transport address, so ChannelData can be relayed in either
+    /// direction without string formatting or memory allocation.
+    ///
+    /// Once a binding is removed its channel number and peer are
+    /// held back for the rebind delay, during which neither may be
+    /// bound to anything other than each other.
+{
+public:
+    ChannelTable(UInt64 lifetime = CHANNEL_LIFETIME, 
+        UInt64 rebindDelay = CHANNEL_REBIND_DELAY);
+
+    bool bind(UInt16 number, const net::Address& peerAddress);
+        // Creates or refreshes a channel binding.
+        // Returns false if the channel number is invalid, or if
+        // either the channel or the peer is bound elsewhere, or
+        // was bound elsewhere within the rebind delay.
+
+    bool canBind(UInt16 number, const net::Address& peerAddress) const;
+        // Returns true if bind() would currently succeed.
+
+    bool unbind(UInt16 number);
+        // Removes a channel binding and starts its rebind delay.
+
+    const ChannelBinding* get(UInt16 number) const;
+        // Returns the binding for the channel number, or nullptr.
+
+    const ChannelBinding* get(const net::Address& peerAddress) const;
+        // Returns the binding for the peer address, or nullptr.
+
+    UInt16 nextNumber() const;
+        // Returns the lowest unbound channel number, or 0 if 
+        // all channel numbers are in use.
+
+    std::size_t expire();
+    std::size_t expire(UInt64 now);
+        // Removes expired bindings and returns the number removed.
+        // The rebind delay of an expired binding runs from the
+        // time it expired.
+
+    UInt64 nextExpiry() const;
+        // Returns the earliest binding expiry time, 
+        // or 0 if the table is empty.
+
+    std::vector<ChannelBinding> list() const;
+    void clear();
+    std::size_t size() const;
+    bool empty() const;
+
+protected:
+    typedef std::unordered_map<UInt16, ChannelBinding> Map;
+    typedef std::unordered_map<ChannelPeerKey, UInt16, ChannelPeerKeyHash> PeerMap;
+
+    bool guarded(UInt16 number, const ChannelPeerKey& key, UInt64 now) const;
+    void retire(Map::iterator it, UInt64 guardUntil);
+    void release(UInt16 number, const ChannelPeerKey& key);
+
+    Map _channels;
+    PeerMap _peers;
+    Map _guards; // removed bindings, expiresAt is the end of the rebind delay
+    PeerMap _guardPeers;
+    UInt64 _lifetime;
+    UInt64 _rebindDelay;
+};
+
+
+} } // namespace scy::turn
+
+
+#endif // SCY_TURN_Channel_H
@@ -0,0 +1,166 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TURN_Permission_H
+#define SCY_TURN_Permission_H
+
+
+#include "scy/turn/fivetuple.h"
+#include "scy/turn/timerwheel.h"
+#include "scy/timer.h"
+#include "scy/net/address.h"
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <unordered_map>
+
+
+namespace scy {
+namespace turn {
+
+
+// The Permission Lifetime MUST be 300 seconds (= 5 minutes).
+const int PERMISSION_LIFETIME = 3 * 60 * 1000;
+
+// The resolution of the permission expiry wheel.
+const int PERMISSION_EXPIRY_RESOLUTION = 5 * 1000;
+
+
+struct PermissionKey 
+    /// PermissionKey is the binary IPv4 or IPv6 address 
+    /// used to index permissions without string formatting.
+{
+    UInt8 family; // AF_INET, AF_INET6 or 0 if invalid
+    UInt8 addr[16];
+
+    PermissionKey();
+    explicit PermissionKey(const net::Address& address);
+    explicit PermissionKey(const std::string& ip);
+
+    bool valid() const { return family != 0; }
+    std::size_t length() const { return family == AF_INET6 ? 16 : 4; }
+
+    bool isLocal() const;
+        // Returns true for 127.x.x.x and 192.168.x.x addresses.
+
+    std::string toString() const;
+        // Returns the printable IP address.
+
+    bool operator ==(const PermissionKey& r) const;
+};
+
+
+struct PermissionKeyHash 
+{
+    std::size_t operator()(const PermissionKey& key) const;
+};
+
+
+struct Permission 
+{
+    std::string ip;
+    PermissionKey key;
+    UInt64 expiresAt; // monotonic milliseconds
+    UInt32 generation;
+
+    Permission(const std::string& ip, const PermissionKey& key, UInt64 expiresAt, UInt32 generation = 0) : 
+        ip(ip), key(key), expiresAt(expiresAt), generation(generation)
+    {
+    }
+
+    bool expired(UInt64 now) const
+    {
+        return expiresAt <= now;
+    }
+
+    bool operator ==(const std::string& r) const
+    {
+        return ip == r;
+    }
+};
+
+
+typedef std::vector<Permission> PermissionList;
+
+
+class PermissionTable
+    /// PermissionTable is a hash indexed set of permissions keyed 
+    /// by binary IP address. Lookups require no string formatting
+    /// or memory allocation, and expired permissions are reclaimed
+    /// via a timing wheel rather than by scanning the table.
+{
+public:
+    PermissionTable(UInt64 lifetime = PERMISSION_LIFETIME, 
+                    UInt64 resolution = PERMISSION_EXPIRY_RESOLUTION);
+
+    bool add(const std::string& ip);
+        // Installs or refreshes the permission for the given IP.
+        // Returns false if the IP address is invalid.
+
+    bool remove(const std::string& ip);
+        // Removes the permission for the given IP.
+
+    void clear();
+        // Removes all permissions.
+
+    bool has(const PermissionKey& key) const;
+    bool has(const net::Address& address) const;
+    bool has(const std::string& ip) const;
+        // Returns true if a permission exists for the given IP.
+        // Expired permissions are valid until removed by expire().
+
+    std::size_t expire();
+    std::size_t expire(UInt64 now);
+        // Removes expired permissions and returns the number removed.
+
+    UInt64 nextExpiry() const;
+        // Returns the earliest permission expiry time, 
+        // or 0 if the table is empty.
+
+    PermissionList list() const;
+        // Returns a copy of the installed permissions.
+
+    std::size_t size() const;
+    bool empty() const;
+
+    static UInt64 now();
+        // Returns the monotonic time in milliseconds.
+
+protected:
+    struct Entry 
+    {
+        PermissionKey key;
+        UInt32 generation;
+    };
+
+    typedef std::unordered_map<PermissionKey, Permission, PermissionKeyHash> Map;
+
+    Map _map;
+    TimerWheel<Entry> _wheel;
+    UInt64 _lifetime;
+    UInt32 _generation;
+};
+
+
+} } // namespace scy::turn
+
+
+#endif // SCY_TURN_Permission_H
@@ -0,0 +1,223 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TURN_Server_H
+#define SCY_TURN_Server_H
+
+
+#include "scy/net/tcpsocket.h"
+#include "scy/net/udpsocket.h"
+#include "scy/timer.h"
+#include "scy/stun/message.h"
+#include "scy/turn/server/serverallocation.h"
+#include "scy/turn/server/udpallocation.h"
+#include "scy/turn/server/tcpallocation.h"
+#include "scy/turn/timerwheel.h"
+#include "scy/turn/util.h"
+
+
+#include <assert.h>
+#include <string>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace scy {
+namespace turn {
+
+    
+struct ServerOptions 
+    /// Configuration options for the TURN server.
+{
+    std::string software;
+    std::string realm;
+
+    UInt32 allocationDefaultLifetime;
+    UInt32 allocationMaxLifetime;    
+    int allocationMaxPermissions;
+    int timerInterval;
+    int earlyMediaBufferSize;
+    
+    net::Address listenAddr; // The TCP and UDP bind() address
+    std::string externalIP;  // The external public facing IP address of the server
+
+    bool enableTCP;
+    bool enableUDP;
+
+    int udpBatchSize;        // Datagrams per recvmmsg/sendmmsg call on the UDP
+                             // listen and relay sockets, or 0 to disable (Linux only)
+
+    bool reusePort;          // Bind the listen sockets with SO_REUSEPORT so several
+                             // servers can share the listen address (Linux only)
+
+    int credentialCacheSize; // Maximum number of long-term credential keys
+                             // cached by credentialKey()
+
+    ServerOptions() {
+        software                            = "Sourcey STUN/TURN Server [rfc5766]";
+        realm                                = "sourcey.com";
+        listenAddr                            = net::Address("0.0.0.0", 3478);
+        externalIP                            = "";
+        allocationDefaultLifetime            = 2 * 60 * 1000;
+        allocationMaxLifetime                = 15 * 60 * 1000;
+        allocationMaxPermissions            = 10;
+        timerInterval                        = 10 * 1000;
+        earlyMediaBufferSize                = 8192;
+        enableTCP                            = true;
+        enableUDP                            = true;
+        udpBatchSize                        = 0;
+        reusePort                            = false;
+        credentialCacheSize                    = 1024;
+    }
+};
+    
+
+struct ServerObserver 
+    /// The ServerObserver receives callbacks for and is responsible
+    /// for managing allocation and bandwidth quotas, authentication 
+    /// methods and authentication.
+{
+    virtual void onServerAllocationCreated(Server* server, IAllocation* alloc) = 0;
+    virtual void onServerAllocationRemoved(Server* server, IAllocation* alloc) = 0;
+
+    virtual AuthenticationState authenticateRequest(Server* server, Request& request) = 0;
+        // The observer class can implement authentication 
+        // using the long-term credential mechanism of [RFC5389].
+        // The class design is such that authentication can be preformed
+        // asynchronously against a remote database, or locally.
+        // The default implementation returns true to all requests.
+        //
+        // The MESSAGE-INTEGRITY attribute references the receive buffer,
+        // so asynchronous implementations must keep a copy of the request,
+        // whose attributes own their data, before returning Authenticating.
+        //
+        // To mitigate either intentional or unintentional denial-of-service
+        // attacks against the server by clients with valid usernames and
+        // passwords, it is RECOMMENDED that the server impose limits on both
+        // the number of allocations active at one time for a given username and
+        // on the amount of bandwidth those allocations can use.  The server
+        // should reject new allocations that would exceed the limit on the
+        // allowed number of allocations active at one time with a 486
+        // (Allocation Quota Exceeded) (see Section 6.2), and should discard
+        // application data traffic that exceeds the bandwidth quota.
+};
+
+
+typedef std::unordered_map<FiveTuple, ServerAllocation*, FiveTupleHash> ServerAllocationMap;
+typedef std::unordered_map<UInt32, TCPAllocation*> TCPConnectionMap;
+typedef std::unordered_map<net::Address, net::TCPSocket::Ptr> TCPSocketMap;
+
+
+class Server
+    /// TURN server rfc5766 implementation
+{
+public:
+    Server(ServerObserver& observer, const ServerOptions& options = ServerOptions(), uv::Loop* loop = uv::defaultLoop());
+        // Creates the server on the given event loop. All server and
+        // allocation sockets run on the loop, so the server must be
+        // created, started and stopped from the loop thread.
+    virtual ~Server();
+
+    virtual void start();
+    virtual void stop();
+    
+    void handleRequest(Request& request, AuthenticationState state);
+    void handleAuthorizedRequest(Request& request);
+    void handleBindingRequest(Request& request);
+    void handleAllocateRequest(Request& request);
+    void handleConnectionBindRequest(Request& request);
+    
+    const std::string& credentialKey(const std::string& username, 
+        const std::string& realm, const std::string& password);
+        // Returns the long-term credential key for the given user, 
+        // which is the MD5 hash of username:realm:password [RFC5389].
+        // Keys are cached by username and realm and only recomputed
+        // when the password changes, so observers can call this from 
+        // authenticateRequest() without rehashing the credentials on 
+        // every Allocate and Refresh request. The returned reference 
+        // is valid until the next call.
+
+    void respond(Request& request, stun::Message& response);
+    void respondError(Request& request, int errorCode, const char* errorDesc);
+    
+    const ServerAllocationMap& allocations() const;
+    void addAllocation(ServerAllocation* alloc);
+    void removeAllocation(ServerAllocation* alloc);
+    ServerAllocation* getAllocation(const FiveTuple& tuple);
+    
+    void scheduleTimer(ServerAllocation* alloc);
+        // Schedules the allocation's next onTimer() call at the 
+        // time returned by ServerAllocation::nextExpiry().
+        // Allocations are only visited by the timer when due.
+
+    void addTCPConnection(UInt32 connectionID, TCPAllocation* alloc);
+    void removeTCPConnection(UInt32 connectionID);
+    TCPAllocation* getTCPAllocation(const UInt32& connectionID);
+        // TCP connection IDs are indexed by the server so 
+        // ConnectionBind requests are matched in constant time.
+
+    net::TCPSocket::Ptr getTCPSocket(const net::Address& remoteAddr);
+    void releaseTCPSocket(net::Socket* socket);
+    
+    ServerObserver& observer();
+    ServerOptions& options();
+    net::UDPSocket& udpSocket();
+    net::TCPSocket& tcpSocket();
+    Timer& timer();
+    uv::Loop* loop() const;
+    
+    void onTCPAcceptConnection(void* sender, const net::TCPSocket::Ptr& sock);
+    void onTCPSocketClosed(void* sender);
+    void onSocketRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress);
+    void onTimer(void*);
+    
+private:    
+    struct AllocationTimer 
+    {
+        FiveTuple tuple;
+        UInt64 deadline;
+    };
+
+    struct Credential 
+    {
+        std::string password;
+        std::string key;
+    };
+
+    ServerObserver& _observer;
+    ServerOptions _options;
+    uv::Loop* _loop;
+    net::UDPSocket _udpSocket;
+    net::TCPSocket _tcpSocket;    
+    TCPSocketMap _tcpSockets;
+    std::unordered_map<net::Socket*, net::Address> _tcpSocketPeers;
+    ServerAllocationMap    _allocations;
+    TCPConnectionMap _tcpConnections;
+    TimerWheel<AllocationTimer> _timerWheel;
+    Timer _timer;
+    std::unordered_map<std::string, Credential> _credentials;
+    std::string _credentialLookup;
+};
+
+
+} } //  namespace scy::turn
+
+
+#endif // SCY_TURN_Server_H
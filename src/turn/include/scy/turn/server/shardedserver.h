@@ -0,0 +1,115 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TURN_SERVER_ShardedServer_H
+#define SCY_TURN_SERVER_ShardedServer_H
+
+
+#include "scy/turn/server/server.h"
+#include "scy/net/shardrunner.h"
+#include "scy/mutex.h"
+
+#include <atomic>
+#include <vector>
+
+
+namespace scy {
+namespace turn {
+
+
+class ShardedServer: public ServerObserver
+    /// ShardedServer runs a TURN server on each of a number of event
+    /// loop threads so relay throughput scales across CPU cores.
+    ///
+    /// Each shard owns a Server with its own SO_REUSEPORT listen socket
+    /// and allocation table. The kernel hashes the 5-tuple of incoming
+    /// datagrams to one of the listen sockets, so every request for a
+    /// UDP allocation is received by the shard which created it, and 
+    /// shards share no state on the relay path.
+    ///
+    /// TCP is not supported in sharded mode, and enableTCP is ignored.
+    /// A TCP allocation's ConnectionBind request arrives on a new client
+    /// connection, which the kernel may hand to any shard, while the
+    /// peer connection is owned by the allocation's shard. Run a single
+    /// Server to relay over TCP.
+    ///
+    /// The ShardedServer observes each shard and keeps a read-mostly view
+    /// of the allocation counts which may be read from any thread.
+    /// Observer callbacks are forwarded to the application observer:
+    /// authenticateRequest() is called concurrently from the shard
+    /// threads so it must be thread safe, while the allocation created
+    /// and removed callbacks are serialized.
+{
+public:
+    ShardedServer(ServerObserver& observer, const ServerOptions& options = ServerOptions(), int numThreads = 0);
+        // Creates the sharded server. One shard is created per 
+        // CPU core if numThreads is 0.
+
+    virtual ~ShardedServer();
+
+    virtual void start();
+        // Starts the shard threads and waits until each shard is
+        // listening. Throws an exception if any shard fails to start.
+
+    virtual void stop();
+        // Stops the shards and waits for their threads to exit.
+
+    int numThreads() const;
+
+    std::size_t numAllocations() const;
+        // Returns the number of allocations across all shards.
+
+    std::size_t numAllocations(int shard) const;
+        // Returns the number of allocations owned by the given shard.
+
+    ServerObserver& observer();
+    ServerOptions& options();
+        // Returns the options passed to each shard on start().
+        // TCP is always disabled; see the class description.
+
+protected:
+    struct ShardStats
+    {
+        std::atomic<std::size_t> allocations;
+
+        ShardStats() : allocations(0) {}
+    };
+
+    class ShardServer;
+
+    virtual AuthenticationState authenticateRequest(Server* server, Request& request);
+    virtual void onServerAllocationCreated(Server* server, IAllocation* alloc);
+    virtual void onServerAllocationRemoved(Server* server, IAllocation* alloc);
+
+    ServerObserver& _observer;
+    ServerOptions _options;
+    net::ShardRunner _runner;
+    std::vector<ShardStats> _stats;
+    mutable Mutex _mutex;
+
+private:
+    ShardedServer(const ShardedServer&); // = delete;
+    ShardedServer& operator=(const ShardedServer&); // = delete;
+};
+
+
+} } //  namespace scy::turn
+
+
+#endif // SCY_TURN_SERVER_ShardedServer_H
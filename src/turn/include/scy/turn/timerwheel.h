@@ -0,0 +1,136 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_TURN_TimerWheel_H
+#define SCY_TURN_TimerWheel_H
+
+
+#include "scy/types.h"
+
+#include <vector>
+
+
+namespace scy {
+namespace turn {
+
+
+template <class EntryT>
+class TimerWheel
+    /// TimerWheel is a hashed timing wheel for coarse grained
+    /// expiry of a large number of entries.
+    ///
+    /// Entries are scheduled into the slot of their deadline tick,
+    /// and advance() hands the entries of each elapsed slot back to 
+    /// the owner. Since deadlines are usually extended lazily, the
+    /// owner checks the current deadline of each entry and either
+    /// expires it or schedules it again. Entries which no longer
+    /// exist are simply dropped by the owner.
+    ///
+    /// Scheduling and expiry are O(1) per entry, and refreshing an
+    /// entry requires no wheel operation at all.
+{
+public:
+    TimerWheel(UInt64 span, UInt64 resolution) : 
+        _resolution(resolution ? resolution : 1), 
+        _numSlots(span / _resolution + 2), 
+        _tick(0),
+        _started(false)
+    {
+    }
+
+    void schedule(const EntryT& entry, UInt64 deadline)
+        // Schedules the entry to be returned by advance() once
+        // the given deadline in milliseconds has elapsed.
+    {
+        if (_slots.empty())
+            _slots.resize(_numSlots);
+
+        // Deadlines which have already elapsed go into
+        // the next slot to be processed.
+        UInt64 tick = deadline / _resolution;
+        if (_started && tick < _tick)
+            tick = _tick;
+        _slots[tick % _numSlots].push_back(entry);
+    }
+
+    template <class HandlerT>
+    void advance(UInt64 now, HandlerT handler)
+        // Advances the wheel to the given time in milliseconds and
+        // calls handler(entry) for each entry of every elapsed slot.
+        // The handler may schedule entries again.
+    {
+        if (_slots.empty())
+            return;
+
+        // Process each slot at most once when the 
+        // wheel has not been advanced for a full turn.
+        UInt64 nowTick = now / _resolution;
+        if (!_started || nowTick - _tick > _numSlots) {
+            _tick = nowTick > _numSlots ? nowTick - _numSlots : 0;
+            _started = true;
+        }
+
+        // Only slots whose interval has fully elapsed are processed,
+        // so every entry with a deadline in the slot has expired.
+        // The tick is incremented before calling the handler so 
+        // entries scheduled again land in the next pending slot.
+        while (_tick < nowTick) {
+            _elapsed.clear();
+            _elapsed.swap(_slots[_tick++ % _numSlots]);
+            for (auto it = _elapsed.begin(); it != _elapsed.end(); ++it)
+                handler(*it);
+        }
+    }
+
+    void clear()
+        // Removes all scheduled entries.
+    {
+        _slots.clear();
+        _elapsed.clear();
+    }
+
+    std::size_t size() const
+        // Returns the number of scheduled entries,
+        // including those which may be stale.
+    {
+        std::size_t n = 0;
+        for (auto it = _slots.begin(); it != _slots.end(); ++it)
+            n += it->size();
+        return n;
+    }
+
+    UInt64 resolution() const
+    {
+        return _resolution;
+    }
+
+protected:
+    std::vector<std::vector<EntryT>> _slots;
+    std::vector<EntryT> _elapsed;
+    UInt64 _resolution;
+    UInt64 _numSlots;
+    UInt64 _tick;
+    bool _started;
+};
+
+
+} } // namespace scy::turn
+
+
+#endif // SCY_TURN_TimerWheel_H
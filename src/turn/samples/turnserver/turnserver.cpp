@@ -0,0 +1,163 @@
+#include "scy/application.h"
+#include "scy/turn/server/server.h"
+#include "scy/turn/server/shardedserver.h"
+#include "scy/crypto/hash.h"
+
+
+using namespace std;
+using namespace scy;
+using namespace scy::uv;
+using namespace scy::net;
+using namespace scy::turn;
+
+
+const std::string SERVER_BIND_IP     ("0.0.0.0");
+const int         SERVER_BIND_PORT   (3478);
+const std::string SERVER_EXTERNAL_IP ("127.0.0.1"); //202.173.167.126
+
+const std::string SERVER_USERNAME    ("username");
+const std::string SERVER_PASSWORD    ("password");
+const std::string SERVER_REALM       ("sourcey.com");
+ 
+
+class RelayServer: public ServerObserver
+{
+public:
+    ServerOptions options;
+    int threads;
+    std::unique_ptr<Server> server;
+    std::unique_ptr<ShardedServer> shardedServer;
+
+    RelayServer(const ServerOptions& so, int threads = 1) : 
+        options(so), threads(threads)
+    {
+    }
+
+    virtual ~RelayServer() 
+    {
+    }
+
+    void start() 
+    {
+        // Run a sharded server with one event loop per thread if
+        // more than one thread is used. Sharded servers only relay UDP.
+        if (threads > 1) {
+            shardedServer.reset(new ShardedServer(*this, options, threads));
+            shardedServer->start();
+        }
+        else {
+            server.reset(new Server(*this, options));
+            server->start();
+        }
+    }
+
+    void stop() 
+    {
+        if (shardedServer)
+            shardedServer->stop();
+        if (server)
+            server->stop();
+    }
+    
+    virtual AuthenticationState authenticateRequest(Server* server, Request& request)
+        // Note: Called concurrently from each thread when sharded.
+    {
+        DebugL << "Authenticating: " << request.transactionID() << endl;
+
+        // The authentication information (e.g., username, password, realm, and
+        // nonce) is used to both verify subsequent requests and to compute the
+        // message integrity of responses.  The username, realm, and nonce
+        // values are initially those used in the authenticated Allocate request
+        // that creates the allocation, though the server can change the nonce
+        // value during the lifetime of the allocation using a 438 (Stale Nonce)
+        // reply.  Note that, rather than storing the password explicitly, for
+        // security reasons, it may be desirable for the server to store the key
+        // value, which is an MD5 hash over the username, realm, and password
+        // (see [RFC5389]).
+
+        // Note that the long-term credential mechanism cannot be used to
+        // protect indications, since indications cannot be challenged. Usages
+        // utilizing indications must either use a short-term credential or omit
+        // authentication and message integrity for them.
+        if (request.methodType() == stun::Message::SendIndication ||
+            request.methodType() == stun::Message::Binding)
+            return Authorized;
+
+        // The initial packet from the client does not include the USERNAME, REALM, NONCE, 
+        // or MESSAGE-INTEGRITY attributes. If these attributes are not provided we return
+        // a 401 (Unauthorized) response.
+        auto usernameAttr = request.get<stun::Username>();
+        auto realmAttr = request.get<stun::Realm>();
+        auto nonceAttr = request.get<stun::Nonce>();
+        auto integrityAttr = request.get<stun::MessageIntegrity>();
+        if (!usernameAttr || !realmAttr || !nonceAttr || !integrityAttr) {
+            DebugL << "Authenticating: Unauthorized STUN Request" << endl;
+            return turn::NotAuthorized;
+        }
+        
+        // Determine authentication status and return either Authorized, 
+        // Unauthorized or Authenticating.
+        // The key is cached by the server, so it is only computed once.
+        request.hash = server->credentialKey(SERVER_USERNAME, SERVER_REALM, SERVER_PASSWORD);
+
+#if ENABLE_AUTHENTICATION
+        DebugL << "Verifying HMAC: username=" << SERVER_USERNAME << ", realm=" << SERVER_REALM << endl;
+
+        if (integrityAttr->verifyHmac(request.hash))
+            return turn::Authorized;
+        return turn::NotAuthorized;    
+#else            
+        // Since no authentication is required we just return Authorized.
+        return turn::Authorized;
+#endif
+    }
+
+    virtual void onServerAllocationCreated(Server* server, IAllocation* alloc) 
+    {
+        DebugL << "Allocation Created" << endl;
+    }
+
+    virtual void onServerAllocationRemoved(Server* server, IAllocation* alloc)
+    {        
+        DebugL << "Allocation Removed" << endl;
+    }
+};
+
+
+int main(int argc, char** argv)
+{    
+#ifdef _MSC_VER
+    _CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+#endif
+
+    // Usage: turnserver [--threads N]
+    // TCP relaying is disabled when more than one thread is used.
+    OptionParser optparse(argc, argv, "--");
+    int threads = optparse.has("threads") ? util::strtoi<int>(optparse.get("threads")) : 1;
+
+    Logger::instance().add(new ConsoleChannel("debug", LTrace));    
+    //Logger::instance().setWriter(new AsyncLogWriter);    
+    {
+        Application app;
+        {
+            ServerOptions opts;        
+            opts.software                        = "Sourcey STUN/TURN Server [rfc5766]";
+            opts.realm                            = "sourcey.com";
+            opts.listenAddr                        = net::Address(SERVER_BIND_IP, SERVER_BIND_PORT);
+            opts.externalIP                        = SERVER_EXTERNAL_IP;
+            opts.allocationDefaultLifetime        = 2 * 60 * 1000;
+            opts.allocationMaxLifetime            = 10 * 60 * 1000;
+            opts.timerInterval                    = 5 * 1000;
+            //opts.enableUDP                      = false;
+            //opts.udpBatchSize                   = 32;
+    
+            RelayServer srv(opts, threads);
+            srv.start();
+            app.waitForShutdown([](void* opaque) {
+                reinterpret_cast<RelayServer*>(opaque)->stop();
+            }, &srv);
+        }
+    }
+    Logger::destroy();
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,261 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/turn/channel.h"
+#include "scy/logger.h"
+
+
+using namespace std;
+
+
+namespace scy {
+namespace turn {
+
+
+ChannelTable::ChannelTable(UInt64 lifetime, UInt64 rebindDelay) :
+    _lifetime(lifetime),
+    _rebindDelay(rebindDelay)
+{
+}
+
+
+bool ChannelTable::bind(UInt16 number, const net::Address& peerAddress)
+{
+    if (number < kMinChannelNumber || number > kMaxChannelNumber) {
+        WarnL << "Invalid channel number: " << number << endl;
+        return false;
+    }
+
+    ChannelPeerKey key(peerAddress);
+    if (!key.ip.valid())
+        return false;
+
+    // A channel may not be bound to a different peer, 
+    // and a peer may not be bound to a different channel.
+    UInt64 now = PermissionTable::now();
+    auto it = _channels.find(number);
+    if (it != _channels.end()) {
+        if (ChannelPeerKey(it->second.peerAddress) != key) {
+            WarnL << "Channel " << number << " already bound to " << it->second.peerAddress << endl;
+            return false;
+        }
+        TraceL << "Refreshing channel: " << number << ": " << peerAddress << endl;
+        it->second.expiresAt = now + _lifetime;
+        return true;
+    }
+
+    if (_peers.find(key) != _peers.end()) {
+        WarnL << "Peer " << peerAddress << " already bound to another channel" << endl;
+        return false;
+    }
+
+    // Nor may they be until the rebind delay of a previous 
+    // binding to something else has elapsed.
+    if (guarded(number, key, now)) {
+        WarnL << "Channel " << number << " or peer " << peerAddress << " was recently bound elsewhere" << endl;
+        return false;
+    }
+
+    TraceL << "Create channel: " << number << ": " << peerAddress << endl;
+    release(number, key);
+    _channels.insert(std::make_pair(number, ChannelBinding(number, peerAddress, now + _lifetime)));
+    _peers.insert(std::make_pair(key, number));
+    return true;
+}
+
+
+bool ChannelTable::canBind(UInt16 number, const net::Address& peerAddress) const
+{
+    if (number < kMinChannelNumber || number > kMaxChannelNumber)
+        return false;
+
+    ChannelPeerKey key(peerAddress);
+    if (!key.ip.valid())
+        return false;
+
+    auto it = _channels.find(number);
+    if (it != _channels.end())
+        return ChannelPeerKey(it->second.peerAddress) == key;
+    return _peers.find(key) == _peers.end() && 
+        !guarded(number, key, PermissionTable::now());
+}
+
+
+bool ChannelTable::unbind(UInt16 number)
+{
+    auto it = _channels.find(number);
+    if (it == _channels.end())
+        return false;
+    retire(it, PermissionTable::now() + _rebindDelay);
+    return true;
+}
+
+
+const ChannelBinding* ChannelTable::get(UInt16 number) const
+{
+    auto it = _channels.find(number);
+    return it != _channels.end() ? &it->second : nullptr;
+}
+
+
+const ChannelBinding* ChannelTable::get(const net::Address& peerAddress) const
+{
+    if (_peers.empty())
+        return nullptr;
+    auto it = _peers.find(ChannelPeerKey(peerAddress));
+    return it != _peers.end() ? get(it->second) : nullptr;
+}
+
+
+UInt16 ChannelTable::nextNumber() const
+{
+    for (UInt32 number = kMinChannelNumber; number <= kMaxChannelNumber; number++) {
+        if (_channels.find(static_cast<UInt16>(number)) == _channels.end())
+            return static_cast<UInt16>(number);
+    }
+    return 0;
+}
+
+
+std::size_t ChannelTable::expire()
+{
+    return expire(PermissionTable::now());
+}
+
+
+std::size_t ChannelTable::expire(UInt64 now)
+{
+    // Allocations only hold a handful of channels, 
+    // so a scan is cheaper than maintaining a wheel.
+    std::size_t removed = 0;
+    for (auto it = _channels.begin(); it != _channels.end();) {
+        if (it->second.expiresAt <= now) {
+            InfoL << "Removing Expired Channel: " << it->first << ": " << it->second.peerAddress << endl;
+            UInt64 guardUntil = it->second.expiresAt + _rebindDelay;
+            retire(it++, guardUntil);
+            removed++;
+        } 
+        else ++it;
+    }
+
+    for (auto it = _guards.begin(); it != _guards.end();) {
+        if (it->second.expiresAt <= now) {
+            _guardPeers.erase(ChannelPeerKey(it->second.peerAddress));
+            it = _guards.erase(it);
+        } 
+        else ++it;
+    }
+    return removed;
+}
+
+
+UInt64 ChannelTable::nextExpiry() const
+{
+    UInt64 next = 0;
+    for (auto it = _channels.begin(); it != _channels.end(); ++it) {
+        if (!next || it->second.expiresAt < next)
+            next = it->second.expiresAt;
+    }
+    return next;
+}
+
+
+std::vector<ChannelBinding> ChannelTable::list() const
+{
+    std::vector<ChannelBinding> channels;
+    channels.reserve(_channels.size());
+    for (auto it = _channels.begin(); it != _channels.end(); ++it)
+        channels.push_back(it->second);
+    return channels;
+}
+
+
+void ChannelTable::clear()
+{
+    _channels.clear();
+    _peers.clear();
+    _guards.clear();
+    _guardPeers.clear();
+}
+
+
+std::size_t ChannelTable::size() const
+{
+    return _channels.size();
+}
+
+
+bool ChannelTable::empty() const
+{
+    return _channels.empty();
+}
+
+
+bool ChannelTable::guarded(UInt16 number, const ChannelPeerKey& key, UInt64 now) const
+{
+    // The channel was recently bound to a different peer.
+    auto it = _guards.find(number);
+    if (it != _guards.end() && it->second.expiresAt > now &&
+        ChannelPeerKey(it->second.peerAddress) != key)
+        return true;
+
+    // The peer was recently bound to a different channel.
+    auto pit = _guardPeers.find(key);
+    if (pit != _guardPeers.end() && pit->second != number) {
+        it = _guards.find(pit->second);
+        if (it != _guards.end() && it->second.expiresAt > now)
+            return true;
+    }
+    return false;
+}
+
+
+void ChannelTable::retire(Map::iterator it, UInt64 guardUntil)
+{
+    ChannelPeerKey key(it->second.peerAddress);
+    ChannelBinding guard(it->second);
+    guard.expiresAt = guardUntil;
+    _peers.erase(key);
+    _channels.erase(it);
+
+    // Neither the number nor the peer is guarded while bound, 
+    // so the guard cannot collide with an existing one.
+    _guards.insert(std::make_pair(guard.number, guard));
+    _guardPeers.insert(std::make_pair(key, guard.number));
+}
+
+
+void ChannelTable::release(UInt16 number, const ChannelPeerKey& key)
+{
+    // Drops any guards held by the number and the peer 
+    // before they are bound to one another.
+    auto it = _guards.find(number);
+    if (it != _guards.end()) {
+        _guardPeers.erase(ChannelPeerKey(it->second.peerAddress));
+        _guards.erase(it);
+    }
+    auto pit = _guardPeers.find(key);
+    if (pit != _guardPeers.end()) {
+        _guards.erase(pit->second);
+        _guardPeers.erase(pit);
+    }
+}
+
+
+} } // namespace scy::turn
@@ -0,0 +1,1157 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/turn/client/client.h"
+#include "scy/net/udpsocket.h"
+#include "scy/net/tcpsocket.h"
+#include "scy/crypto/hash.h"
+#include "scy/hex.h"
+#include "scy/logger.h"
+#include "scy/application.h"
+
+#include <assert.h>
+#include <iostream>
+#include <algorithm>
+
+
+using namespace std;
+
+
+namespace scy {
+namespace turn {
+
+
+Client::Client(ClientObserver& observer, const Options& options) : 
+    _observer(observer),
+    _options(options),
+    _socket(nullptr) //, false
+{
+}
+
+
+Client::~Client() 
+{
+    TraceL << "Destroy" << endl;
+    shutdown();
+    //assert(_socket->/*base().*/refCount() == 1);
+    //assert(closed());
+}
+
+
+void Client::initiate() 
+{
+    TraceL << "TURN client connecting to " 
+        << _options.serverAddr << endl;
+    
+    assert(!_permissions.empty() && "must set permissions");
+    
+    auto udpSocket = dynamic_cast<net::UDPSocket*>(_socket.get());
+    if (udpSocket) {
+        udpSocket->bind(net::Address("0.0.0.0", 0));
+        //udpSocket->setBroadcast(true);
+    }
+
+    _socket->Recv += sdelegate(this, &Client::onSocketRecv, -1); // using PacketSocket for STUN transactions
+    _socket->Connect += sdelegate(this, &Client::onSocketConnect);
+    _socket->Close += sdelegate(this, &Client::onSocketClose);
+    _socket->connect(_options.serverAddr);
+    //_socket
+    //else
+    //    onSocketConnect(&_socket->base());
+}
+
+
+void Client::shutdown()
+{
+    {
+        //Mutex::ScopedLock lock(_mutex); 
+        _timer.stop();
+    
+        for (auto it = _transactions.begin(); it != _transactions.end();) {
+            TraceL << "Shutdown base: Delete transaction: " << *it << endl;    
+            (*it)->StateChange -= sdelegate(this, &Client::onTransactionProgress);
+            //delete *it;
+            (*it)->dispose();
+            it = _transactions.erase(it);
+        }
+
+        _socket->Connect -= sdelegate(this, &Client::onSocketConnect);
+        _socket->Recv -= sdelegate(this, &Client::onSocketRecv);
+        //_socket->Error -= sdelegate(this, &Client::onSocketError);
+        _socket->Close -= sdelegate(this, &Client::onSocketClose);
+        if (!_socket->closed()) {
+            _socket->close();
+        }
+        //assert(_socket->/*base().*/refCount() == 1);
+    }
+}
+
+
+void Client::onSocketConnect(void*)
+{
+    TraceL << "Client connected" << endl;    
+    _socket->Connect -= sdelegate(this, &Client::onSocketConnect);
+
+    _timer.Timeout += sdelegate(this, &Client::onTimer);
+    _timer.start(_options.timerInterval, _options.timerInterval);
+
+    sendAllocate();
+}
+
+    
+void Client::onSocketRecv(void* sender, const MutableBuffer& buffer, const net::Address& peerAddress) 
+{
+    TraceL << "Control socket recv: " << buffer.size() << endl;    
+    
+    stun::Message message;
+    //auto socket = reinterpret_cast<net::Socket*>(sender);        
+    char* buf = bufferCast<char*>(buffer);
+    std::size_t len = buffer.size();
+    std::size_t nread = 0;
+    while (len > 0) {
+        if (isChannelData(buf, len)) {
+            nread = kChannelDataHeaderSize + readChannelDataLength(buf);
+            if (nread > len) {
+                WarnL << "Truncated ChannelData received" << endl;
+                break;
+            }
+            handleChannelData(buf, nread);
+
+            // Over TCP ChannelData messages are padded to a multiple of 4 bytes.
+            if (transportProtocol() == 6)
+                nread = std::min<std::size_t>((nread + 3) & ~std::size_t(3), len);
+        }
+        else if ((nread = message.read(constBuffer(buf, len))) > 0)
+            handleResponse(message);
+        else
+            break;
+        buf += nread;
+        len -= nread;
+    }
+    if (len == buffer.size())
+        WarnL << "Non STUN packet received" << endl;
+    
+#if 0
+    stun::Message message;
+    if (message.read(constBuffer(packet.data(), packet.size())))
+        handleResponse(message);
+    else
+        WarnL << "Non STUN packet received" << endl;
+#endif
+}
+
+
+void Client::onSocketClose(void* sender)  //, const Error& error
+{
+    assert(sender == _socket.get());
+    TraceL << "Control socket closed: " << sender << ": " << _socket->error().message << endl;    
+    assert(_socket->closed());
+    shutdown();    
+    setState(this, ClientState::Failed, _socket->error().message);
+}
+
+
+void Client::sendRefresh()
+{
+    // 7. Refreshing an Allocation
+    // 
+    // A Refresh transaction can be used to either (a) refresh an existing
+    // allocation and update its time-to-expiry or (b) delete an existing
+    // allocation.
+    // 
+    // If a client wishes to continue using an allocation, then the client
+    // MUST refresh it before it expires.  It is suggested that the client
+    // refresh the allocation roughly 1 minute before it expires.  If a
+    // client no longer wishes to use an allocation, then it SHOULD
+    // explicitly delete the allocation.  A client MAY refresh an allocation
+    // at any time for other reasons.
+        
+    TraceL << "Send refresh allocation request" << endl;    
+
+    auto transaction = createTransaction();        
+    transaction->request().setClass(stun::Message::Request);
+    transaction->request().setMethod(stun::Message::Refresh);
+
+    stun::Lifetime* lifetimeAttr = new stun::Lifetime;
+    lifetimeAttr->setValue((UInt32)_options.lifetime / 1000);
+    transaction->request().add(lifetimeAttr);
+    
+    sendAuthenticatedTransaction(transaction);
+}
+
+
+void Client::handleRefreshResponse(const stun::Message& response) 
+{
+    TraceL << "Received a Refresh Response: " << response.toString() << endl;    
+
+    assert(response.methodType() ==  stun::Message::Refresh);    
+
+    // 7.3. Receiving a Refresh Response
+    // 
+    // 
+    // If the client receives a success response to its Refresh request with
+    // a non-zero lifetime, it updates its copy of the allocation data
+    // structure with the time-to-expiry value contained in the response.
+    // 
+    // If the client receives a 437 (Allocation Mismatch) error response to
+    // a request to delete the allocation, then the allocation no longer
+    // exists and it should consider its request as having effectively
+    // succeeded.    
+    auto errorAttr = response.get<stun::ErrorCode>();
+    if (errorAttr) {
+        assert(errorAttr->errorCode() == 437);
+        return;
+    }
+
+    auto lifetimeAttr = response.get<stun::Lifetime>();
+    if (!lifetimeAttr) {
+        assert(0);
+        return;
+    }
+
+    setLifetime(lifetimeAttr->value());
+    
+    TraceL << "Refreshed allocation expires in: " << timeRemaining() << endl;    
+
+    // If lifetime is 0 the allocation will be cleaned up by garbage collection.
+}
+
+
+bool Client::removeTransaction(stun::Transaction* transaction)
+{
+    TraceL << "Removing transaction: " << transaction << endl;
+
+    //Mutex::ScopedLock lock(_mutex);     
+    for (auto it = _transactions.begin(); it != _transactions.end(); ++it) {
+        if (*it == transaction) {
+            (*it)->StateChange -= sdelegate(this, &Client::onTransactionProgress);
+            _transactions.erase(it);
+            return true;
+        }
+    }
+    assert(0 && "unknown transaction");
+    return false;
+}
+
+
+void Client::authenticateRequest(stun::Message& request)
+{    
+    //Mutex::ScopedLock lock(_mutex); 
+
+    // Authenticate messages once the server provides us with realm and noonce
+    if (_realm.empty())
+        return;
+
+    if (_options.username.size()) {
+        auto usernameAttr = new stun::Username;
+        usernameAttr->copyBytes(_options.username.c_str(), _options.username.size());
+        request.add(usernameAttr);
+    }
+    
+    if (_realm.size()) {
+        auto realmAttr = new stun::Realm;
+        realmAttr->copyBytes(_realm.c_str(), _realm.size());
+        request.add(realmAttr);
+    }
+    
+    if (_nonce.size()) {
+        auto nonceAttr = new stun::Nonce;        
+        nonceAttr->copyBytes(_nonce.c_str(), _nonce.size());
+        request.add(nonceAttr);
+    }
+
+    if (_realm.size() && _options.password.size()) {        
+        crypto::Hash engine("md5");
+        engine.update(_options.username + ":" + _realm + ":" + _options.password);
+        //return hex::encode(engine.digest());        
+        //std::string key(crypto::hash("MD5", _options.username + ":" + _realm + ":" + _options.password));
+        TraceL << "Generating HMAC: data=" << (_options.username + ":" + _realm + ":" + _options.password) << ", key=" << engine.digestStr() << endl;
+        auto integrityAttr = new stun::MessageIntegrity;
+        integrityAttr->setKey(engine.digestStr());
+        request.add(integrityAttr);
+    }
+}
+
+
+bool Client::sendAuthenticatedTransaction(stun::Transaction* transaction)
+{    
+    authenticateRequest(transaction->request());
+    TraceL << "Send authenticated transaction: " << transaction->request().toString() << endl;
+    return transaction->send();
+}
+
+
+stun::Transaction* Client::createTransaction(const net::Socket::Ptr& socket)
+{
+    //Mutex::ScopedLock lock(_mutex);     
+    //socket = socket ? socket : _socket;
+    //assert(socket && !socket->isNull());
+    auto transaction = new stun::Transaction(socket ? socket : _socket, _options.serverAddr, _options.timeout, 1);
+    transaction->StateChange += sdelegate(this, &Client::onTransactionProgress);    
+    _transactions.push_back(transaction);
+    return transaction;
+}
+
+
+bool Client::handleResponse(const stun::Message& response)
+{
+    TraceL << "Handle response: " << response.toString() << endl;
+    
+    // Send this response to the appropriate handler.    
+    if (response.methodType() ==  stun::Message::Allocate) {
+        if (response.classType() == stun::Message::SuccessResponse)    
+            handleAllocateResponse(response);
+
+        else if (response.classType() == stun::Message::ErrorResponse)    
+            handleAllocateErrorResponse(response);
+
+        // Must be a Transaction response
+        else assert(0 && "no response state");
+    }
+    
+    else if (response.methodType() ==  stun::Message::Refresh)    
+        handleRefreshResponse(response);
+
+    //else if (response.methodType() ==  stun::Message::Refresh &&
+    //    response.classType() == stun::Message::ErrorResponse)&&
+    //    response.classType() == stun::Message::SuccessResponse
+    //    handleRefreshErrorResponse(response);
+
+    else if (response.methodType() ==  stun::Message::CreatePermission &&
+        response.classType() == stun::Message::SuccessResponse)    
+        handleCreatePermissionResponse(response);
+
+    else if (response.methodType() ==  stun::Message::CreatePermission &&
+        response.classType() == stun::Message::ErrorResponse)    
+        handleCreatePermissionErrorResponse(response);
+
+    else if (response.methodType() ==  stun::Message::ChannelBind &&
+        response.classType() == stun::Message::SuccessResponse)    
+        handleChannelBindResponse(response);
+
+    else if (response.methodType() ==  stun::Message::ChannelBind &&
+        response.classType() == stun::Message::ErrorResponse)
+        WarnL << "Channel bind failed: " << response.toString() << endl;
+
+    else if (response.methodType() ==  stun::Message::DataIndication)    
+        handleDataIndication(response);
+
+    else 
+        return false;
+
+    return true;
+}
+
+
+void Client::sendAllocate() 
+{
+    TraceL << "Send allocation request" << endl;
+
+    assert(!_options.username.empty());
+    assert(!_options.password.empty());
+    //assert(_options.lifetime);
+    //_lifetime = _options.lifetime;
+
+    // The client forms an Allocate request as follows.
+    // 
+    // The client first picks a host transport address.  It is RECOMMENDED
+    // that the client pick a currently unused transport address, typically
+    // by allowing the underlying OS to pick a currently unused port for a
+    // new socket.
+    // 
+    // The client then picks a transport protocol to use between the client
+    // and the server.  The transport protocol MUST be one of UDP, TCP, or
+    // TLS-over-TCP.  Since this specification only allows UDP between the
+    // server and the peers, it is RECOMMENDED that the client pick UDP
+    // unless it has a reason to use a different transport.  One reason to
+    // pick a different transport would be that the client believes, either
+    // through configuration or by experiment, that it is unable to contact
+    // any TURN server using UDP.  See Section 2.1 for more discussion.
+    // 
+    // The client also picks a server transport address, which SHOULD be
+    // done as follows.  The client receives (perhaps through configuration)
+    // a domain name for a TURN server.  The client then uses the DNS
+    // procedures described in [RFC5389], but using an SRV service name of
+    // "turn" (or "turns" for TURN over TLS) instead of "stun" (or "stuns").
+    // For example, to find servers in the example.com domain, the client
+    // performs a lookup for '_turn._udp.example.com',
+    // '_turn._tcp.example.com', and '_turns._tcp.example.com' if the client
+    // wants to communicate with the server using UDP, TCP, or TLS-over-TCP,
+    // respectively.
+    //     
+    auto transaction = createTransaction();
+    //stun::Message request(stun::Message::Request, stun::Message::Allocate);
+    transaction->request().setClass(stun::Message::Request);
+    transaction->request().setMethod(stun::Message::Allocate);
+
+    // The client MUST include a REQUESTED-TRANSPORT attribute in the
+    // request.  This attribute specifies the transport protocol between the
+    // server and the peers (note that this is NOT the transport protocol
+    // that appears in the 5-tuple).
+    // 
+    auto transportAttr = new stun::RequestedTransport;
+    transportAttr->setValue(transportProtocol() << 24);
+    transaction->request().add(transportAttr);
+    
+    // If the client wishes the server to initialize the time-to-expiry
+    // field of the allocation to some value other than the default
+    // lifetime, then it MAY include a LIFETIME attribute specifying its
+    // desired value.  This is just a request, and the server may elect to
+    // use a different value.  Note that the server will ignore requests to
+    // initialize the field to less than the default value.
+    // 
+    if (_options.lifetime) {
+        auto lifetimeAttr = new stun::Lifetime;
+        lifetimeAttr->setValue((UInt32)_options.lifetime / 1000);
+        transaction->request().add(lifetimeAttr);
+    }
+
+    // If the client wishes to later use the DONT-FRAGMENT attribute in one
+    // or more Send indications on this allocation, then the client SHOULD
+    // include the DONT-FRAGMENT attribute in the Allocate transaction->request().  This
+    // allows the client to test whether this attribute is supported by the
+    // server.
+    // 
+    // If the client requires the port number of the relayed transport
+    // address be even, the client includes the EVEN-PORT attribute.  If
+    // this attribute is not included, then the port can be even or odd.  By
+    // setting the R bit in the EVEN-PORT attribute to 1, the client can
+    // request that the server reserve the next highest port number (on the
+    // same IP address) for a subsequent allocation.  If the R bit is 0, no
+    // such request is made.
+    // 
+    // The client MAY also include a RESERVATION-TOKEN attribute in the
+    // request to ask the server to use a previously reserved port for the
+    // allocation.  If the RESERVATION-TOKEN attribute is included, then the
+    // client MUST omit the EVEN-PORT attribute.
+    // 
+    // Once constructed, the client sends the Allocate request on the
+    // 5-tuple.
+    //     
+
+    sendAuthenticatedTransaction(transaction);
+}
+
+
+//  At this point the response has already been authenticated, but we 
+//  have not checked for existing allocations on this 5 tuple.
+void Client::handleAllocateResponse(const stun::Message& response) 
+{
+    TraceL << "Allocate success response" << endl;
+
+    assert(response.methodType() ==  stun::Message::Allocate);    
+    
+    //Mutex::ScopedLock lock(_mutex);
+
+    // If the client receives an Allocate success response, then it MUST
+    // check that the mapped address and the relayed transport address are
+    // in an address family that the client understands and is prepared to
+    // handle.  This specification only covers the case where these two
+    // addresses are IPv4 addresses.  If these two addresses are not in an
+    // address family which the client is prepared to handle, then the
+    // client MUST delete the allocation (Section 7) and MUST NOT attempt to
+    // create another allocation on that server until it believes the
+    // mismatch has been fixed.
+    // 
+    //    The IETF is currently considering mechanisms for transitioning
+    //    between IPv4 and IPv6 that could result in a client originating an
+    //    Allocate request over IPv6, but the request would arrive at the
+    //    server over IPv4, or vice versa.
+    // 
+    // Otherwise, the client creates its own copy of the allocation data
+    // structure to track what is happening on the server.  In particular,
+    // the client needs to remember the actual lifetime received back from
+    // the server, rather than the value sent to the server in the request.
+    //     
+    auto lifetimeAttr = response.get<stun::Lifetime>();
+    if (!lifetimeAttr) {
+        assert(0);
+        return;
+    }
+    
+    auto mappedAttr = response.get<stun::XorMappedAddress>();
+    if (!mappedAttr || mappedAttr->family() != 1) {
+        assert(0);
+        return;
+    }
+    _mappedAddress = mappedAttr->address(); //net::Address(mappedAttr->address().host(), mappedAttr->address().port());
+
+    // The client must also remember the 5-tuple used for the request and
+    // the username and password it used to authenticate the request to
+    // ensure that it reuses them for subsequent messages.  The client also
+    // needs to track the channels and permissions it establishes on the
+    // server.
+    // 
+    // The client will probably wish to send the relayed transport address
+    // to peers (using some method not specified here) so the peers can
+    // communicate with it.  The client may also wish to use the server-
+    // reflexive address it receives in the XOR-MAPPED-ADDRESS attribute in
+    // its ICE processing.    
+    // 
+    auto relayedAttr = response.get<stun::XorRelayedAddress>();
+    if (!relayedAttr || (relayedAttr && relayedAttr->family() != 1)) {
+        assert(0);
+        return;
+    }
+
+    if (relayedAttr->address().host() == "0.0.0.0") {
+        assert(0 && "invalid loopback address");
+        return;
+    }
+    
+    // Use the relay server host and relayed port    
+    _relayedAddress = net::Address(relayedAttr->address().host(), relayedAttr->address().port()); //_options.serverAddr.host()    
+
+    TraceL << "Allocation created:" 
+        << "\n\tRelayed address: " << _relayedAddress //.toString()
+        << "\n\tMapped address: " << _mappedAddress //.toString()
+        << "\n\tLifetime: " << lifetimeAttr->value()
+        << endl;
+    
+    // Once the allocation is created we transition to Authorizing while
+    // peer permissions are created.
+    setState(this, ClientState::Authorizing);
+
+    // If the permission list has entries create them now.
+    // A successful response here will set the client state to Success.
+    if (!closed())
+        sendCreatePermission();    
+}
+
+
+void Client::handleAllocateErrorResponse(const stun::Message& response) 
+{        
+    TraceL << "Allocate error response" << endl;
+
+    assert(response.methodType() ==  stun::Message::Allocate &&
+        response.classType() == stun::Message::ErrorResponse);    
+    
+    auto errorAttr = response.get<stun::ErrorCode>();
+    if (!errorAttr) {
+        assert(0);
+        return;
+    }
+    
+    TraceL << "Allocation error response: " 
+        << errorAttr->errorCode() << ": " << errorAttr->reason() << endl;
+
+    // If the client receives an Allocate error response, then the
+    // processing depends on the actual error code returned:
+
+    // o  (Request timed out): There is either a problem with the server, or
+    //    a problem reaching the server with the chosen transport.  The
+    //    client considers the current transaction as having failed but MAY
+    //    choose to retry the Allocate request using a different transport
+    //    (e.g., TCP instead of UDP).
+
+    switch (errorAttr->errorCode()) {
+        // 300 (Try Alternate): The server would like the client to use the
+        // server specified in the ALTERNATE-SERVER attribute instead.  The
+        // client considers the current transaction as having failed, but
+        // SHOULD try the Allocate request with the alternate server before
+        // trying any other servers (e.g., other servers discovered using the
+        // SRV procedures).  When trying the Allocate request with the
+        // alternate server, the client follows the ALTERNATE-SERVER
+        // procedures specified in [RFC5389].
+        case 300:
+            // Return the error to the client.
+            assert(0);
+            break;                        
+
+        // 400 (Bad Request): The server believes the client's request is
+        // malformed for some reason.  The client considers the current
+        // transaction as having failed.  The client MAY notify the client or
+        // operator and SHOULD NOT retry the request with this server until
+        // it believes the problem has been fixed.
+        case 400:
+            // Return the error to the client.
+            assert(0);
+            break;
+
+        // 401 (NotAuthorized): If the client has followed the procedures of
+        // the long-term credential mechanism and still gets this error, then
+        // the server is not accepting the client's credentials.  In this
+        // case, the client considers the current transaction as having
+        // failed and SHOULD notify the client or operator.  The client SHOULD
+        // NOT send any further requests to this server until it believes the
+        // problem has been fixed.
+        case 401:    
+            {
+                //Mutex::ScopedLock lock(_mutex); 
+                if (_realm.empty() || _nonce.empty()) {
+                
+                    // REALM
+                    const stun::Realm* realmAttr = response.get<stun::Realm>();
+                    if (realmAttr) {
+                        _realm = realmAttr->asString();
+                    }
+                
+                    // NONCE
+                    const stun::Nonce* nonceAttr = response.get<stun::Nonce>();                    
+                    if (nonceAttr) {
+                        _nonce = nonceAttr->asString();
+                    }
+                
+                    // Now that our realm and nonce are set we can re-send the allocate request.
+                    if (_realm.size() && _nonce.size()) {                    
+                        TraceL << "Resending allocation request" << endl;
+                        sendAllocate();
+                        return;
+                    }
+                }
+            }
+            
+            break;
+
+        // 403 (Forbidden): The request is valid, but the server is refusing
+        // to perform it, likely due to administrative restrictions.  The
+        // client considers the current transaction as having failed.  The
+        // client MAY notify the client or operator and SHOULD NOT retry the
+        // same request with this server until it believes the problem has
+        // been fixed.
+        case 403:
+            // Return the error to the client.
+            assert(0);
+            break;
+
+        // 420 (Unknown Attribute): If the client included a DONT-FRAGMENT
+        // attribute in the request and the server rejected the request with
+        // a 420 error code and listed the DONT-FRAGMENT attribute in the
+        // UNKNOWN-ATTRIBUTES attribute in the error response, then the
+        // client now knows that the server does not support the DONT-
+        // FRAGMENT attribute.  The client considers the current transaction
+        // as having failed but MAY choose to retry the Allocate request
+        // without the DONT-FRAGMENT attribute.
+        case 420:
+            assert(0);
+            break;
+
+        // 437 (Allocation Mismatch): This indicates that the client has
+        // picked a 5-tuple that the server sees as already in use.  One way
+        // this could happen is if an intervening NAT assigned a mapped
+        // transport address that was used by another client that recently
+        // crashed.  The client considers the current transaction as having
+        // failed.  The client SHOULD pick another client transport address
+        // and retry the Allocate request (using a different transaction id).
+        // The client SHOULD try three different client transport addresses
+        // before giving up on this server.  Once the client gives up on the
+        // server, it SHOULD NOT try to create another allocation on the
+        // server for 2 minutes.
+        case 437:
+            assert(0);
+            break;
+
+        // 438 (Stale Nonce): See the procedures for the long-term credential
+        // mechanism [RFC5389].
+        case 438:
+            assert(0);
+            break;
+
+        // 441 (Wrong Credentials): The client should not receive this error
+        // in response to a Allocate request.  The client MAY notify the client
+        // or operator and SHOULD NOT retry the same request with this server
+        // until it believes the problem has been fixed.
+        case 441:
+            assert(0);
+            break;
+
+        // 442 (Unsupported Transport Address): The client should not receive
+        // this error in response to a request for a UDP allocation.  The
+        // client MAY notify the client or operator and SHOULD NOT reattempt
+        // the request with this server until it believes the problem has
+        // been fixed.
+        case 442:
+            assert(0);
+            break;
+
+        // 486 (Allocation Quota Reached): The server is currently unable to
+        // create any more allocations with this username.  The client
+        // considers the current transaction as having failed.  The client
+        // SHOULD wait at least 1 minute before trying to create any more
+        // allocations on the server.
+        case 486:
+            // controlConn.disconnect();
+            // controlConn.startConnectionTimer(60000);
+            //assert(0);
+            break;
+
+        // 508 (Insufficient Capacity): The server has no more relayed
+        // transport addresses available, or has none with the requested
+        // properties, or the one that was reserved is no longer available.
+        // The client considers the current operation as having failed.  If
+        // the client is using either the EVEN-PORT or the RESERVATION-TOKEN
+        // attribute, then the client MAY choose to remove or modify this
+        // attribute and try again immediately.  Otherwise, the client SHOULD
+        // wait at least 1 minute before trying to create any more
+        // allocations on this server.
+        case 508:
+            // controlConn.disconnect();
+            // controlConn.startConnectionTimer(60000);
+            //assert(0);
+            break;
+            
+        // An unknown error response MUST be handled as described in [RFC5389].
+        default:
+            assert(0);
+            break;
+    }
+
+    setState(this, ClientState::Failed, util::format("(%d) %s", (int)errorAttr->errorCode(), errorAttr->reason().c_str()));
+
+    if (!closed()) {
+        _observer.onAllocationFailed(*this, errorAttr->errorCode(), errorAttr->reason()); // may result in deletion
+    }
+}
+
+
+void Client::addPermission(const IPList& peerIPs)
+{    
+    for (auto it = peerIPs.begin(); it != peerIPs.end(); ++it) {
+        addPermission(*it);
+    }
+}
+
+
+void Client::addPermission(const std::string& peerIP)
+{
+    IAllocation::addPermission(peerIP);
+}
+
+
+void Client::sendCreatePermission()
+{
+    TraceL << "Send Create Permission Request" << endl;
+
+    assert(!_permissions.empty());
+
+    // The client who wishes to install or refresh one or more permissions
+    // can send a CreatePermission request to the server.
+    // 
+    // When forming a CreatePermission request, the client MUST include at
+    // least one XOR-PEER-ADDRESS attribute, and MAY include more than one
+    // such attribute.  The IP address portion of each XOR-PEER-ADDRESS
+    // attribute contains the IP address for which a permission should be
+    // installed or refreshed.  The port portion of each XOR-PEER-ADDRESS
+    // attribute will be ignored and can be any arbitrary value.  The
+    // various XOR-PEER-ADDRESS attributes can appear in any order.
+
+    auto transaction = createTransaction();
+    //stun::Message request(stun::Message::Request, stun::Message::Allocate);
+    transaction->request().setClass(stun::Message::Request);
+    transaction->request().setMethod(stun::Message::CreatePermission);
+    
+    PermissionList permissions(_permissions.list());
+    for (auto it = permissions.begin(); it != permissions.end(); ++it) {
+        TraceL << "Create permission request: " << (*it).ip << endl;
+        auto peerAttr = new stun::XorPeerAddress;
+        peerAttr->setAddress(net::Address((*it).ip, 0));
+        //peerAttr->setFamily(1);
+        //peerAttr->setPort(0);
+        //peerAttr->setIP((*it).ip);
+        transaction->request().add(peerAttr);
+    }
+
+    sendAuthenticatedTransaction(transaction);
+}
+
+
+void Client::handleCreatePermissionResponse(const stun::Message& /* response */) 
+{
+    // If the client receives a valid CreatePermission success response,
+    // then the client updates its data structures to indicate that the
+    // permissions have been installed or refreshed.    
+    TraceL << "Permission created" << endl;
+    
+    // Send all queued requests...
+    // TODO: To via onStateChange Success callback
+    {
+        //Mutex::ScopedLock lock(_mutex);         
+        while (!_pendingIndications.empty()) {
+            _socket->sendPacket(_pendingIndications.front());
+            _pendingIndications.pop_front();
+        }
+    }
+    
+    if (!closed()) {        
+        _observer.onAllocationPermissionsCreated(*this, permissions());
+        
+        /*
+        auto transaction = reinterpret_cast<stun::Transaction*>(response.opaque);
+        for (int i = 0; i < 100; i++) {
+            auto peerAttr = transaction->request().get<stun::XorPeerAddress>(i);
+            if (!peerAttr || (peerAttr && peerAttr->family() != 1))
+                break;    
+            _observer.onAllocationPermissionsCreated(*this, std::string(peerAttr->address().host()));
+        }
+        */
+    }
+
+    // Once permissions have been created the allocation 
+    // process is considered a success.
+    TraceL << "Allocation Success" << endl;
+    setState(this, ClientState::Success);
+}
+
+
+void Client::handleCreatePermissionErrorResponse(const stun::Message& /* response */) 
+{    
+    WarnL << "Permission Creation Failed" << endl;
+
+    removeAllPermissions();
+    
+    setState(this, ClientState::Failed, "Cannot create server permissions.");
+}
+
+
+void Client::sendChannelBind(const net::Address& peerAddress) 
+{
+    // A channel binding is created or refreshed using a ChannelBind
+    // transaction. A ChannelBind transaction also creates or refreshes a
+    // permission towards the peer (see Section 8).
+    // 
+    // To initiate the ChannelBind transaction, the client forms a
+    // ChannelBind request.  The channel to be bound is specified in a
+    // CHANNEL-NUMBER attribute, and the peer's transport address is
+    // specified in an XOR-PEER-ADDRESS attribute.  Section 11.2 describes
+    // the restrictions on these attributes.
+    // 
+    // Rebinding a channel to the same transport address that it is already
+    // bound to provides a way to refresh a channel binding and the
+    // corresponding permission without sending data to the peer.  Note
+    // however, that permissions need to be refreshed more frequently than
+    // channels.
+    UInt16 number = 0;
+    auto binding = _channels.get(peerAddress);
+    if (binding)
+        number = binding->number;
+    else {
+        // Pick the lowest channel number which can be bound to the
+        // peer and is not awaiting a bind response.
+        for (UInt16 n = kMinChannelNumber; n <= kMaxChannelNumber && !number; ++n) {
+            if (!_channels.canBind(n, peerAddress))
+                continue;
+            bool pending = false;
+            for (auto it = _transactions.begin(); it != _transactions.end() && !pending; ++it) {
+                auto attr = (*it)->request().get<stun::ChannelNumber>();
+                pending = attr && (attr->value() >> 16) == n;
+            }
+            if (!pending)
+                number = n;
+        }
+    }
+    if (!number)
+        throw std::runtime_error("No channel numbers available for peer: " + peerAddress.toString());
+
+    TraceL << "Send channel bind request: " << number << ": " << peerAddress << endl;
+
+    auto transaction = createTransaction();
+    transaction->request().setClass(stun::Message::Request);
+    transaction->request().setMethod(stun::Message::ChannelBind);
+    
+    // The CHANNEL-NUMBER attribute contains the number of the channel
+    // in the first two bytes, followed by two bytes of RFFU.
+    auto channelAttr = new stun::ChannelNumber;
+    channelAttr->setValue(UInt32(number) << 16);
+    transaction->request().add(channelAttr);
+
+    auto peerAttr = new stun::XorPeerAddress;
+    peerAttr->setAddress(peerAddress);
+    transaction->request().add(peerAttr);
+
+    sendAuthenticatedTransaction(transaction);
+}
+
+
+void Client::handleChannelBindResponse(const stun::Message& response) 
+{
+    // When the client receives a ChannelBind success response, it updates
+    // its data structures to record that the channel binding is now active.
+    // It also updates its data structures to record that the corresponding
+    // permission has been installed or refreshed.
+    auto transaction = reinterpret_cast<stun::Transaction*>(response.opaque);
+    if (!transaction)
+        return;
+
+    auto channelAttr = transaction->request().get<stun::ChannelNumber>();
+    auto peerAttr = transaction->request().get<stun::XorPeerAddress>();
+    if (!channelAttr || !peerAttr) {
+        assert(0);
+        return;
+    }
+    
+    UInt16 number = static_cast<UInt16>(channelAttr->value() >> 16);
+    if (!_channels.bind(number, peerAttr->address())) {
+        WarnL << "Cannot bind channel: " << number << ": " << peerAttr->address() << endl;
+        return;
+    }
+    
+    IAllocation::addPermission(peerAttr->address().host());
+
+    TraceL << "Channel bound: " << number << ": " << peerAttr->address() << endl;
+}
+
+
+void Client::handleChannelData(const char* data, std::size_t size) 
+{
+    // If the ChannelData message is received on a channel that is not
+    // bound to any peer, then the message is silently discarded.
+    UInt16 number = readChannelNumber(data);
+    auto binding = _channels.get(number);
+    if (!binding) {
+        TraceL << "ChannelData for unbound channel: " << number << endl;
+        return;
+    }
+
+    if (!closed()) {
+        _observer.onRelayDataReceived(*this, data + kChannelDataHeaderSize, 
+            size - kChannelDataHeaderSize, binding->peerAddress);
+    }
+}
+
+
+void Client::sendData(const char* data, std::size_t size, const net::Address& peerAddress) 
+{
+    // If a channel is bound to the peer then send the data as 
+    // ChannelData, which avoids the overhead of a Send indication.
+    auto binding = _channels.get(peerAddress);
+    if (binding && size <= 0xFFFF && stateEquals(ClientState::Success)) {
+        char header[kChannelDataHeaderSize];
+        writeChannelDataHeader(header, binding->number, static_cast<UInt16>(size));
+        static const char padding[3] = { 0, 0, 0 };
+        ConstBuffer bufs[3] = { 
+            constBuffer(header, kChannelDataHeaderSize),
+            constBuffer(data, size),
+            constBuffer(padding, transportProtocol() == 6 ? (4 - (size % 4)) % 4 : 0)
+        };
+        _socket->send(bufs, bufs[2].size() ? 3 : 2, _options.serverAddr);
+        return;
+    }
+
+    TraceL << "Send Data Indication to peer: " << peerAddress << endl;
+    
+    //auto request = new stun::Message;
+    stun::Message request;
+    request.setClass(stun::Message::Indication);
+    request.setMethod(stun::Message::SendIndication);
+
+    // The client can use a Send indication to pass data to the server for
+    // relaying to a peer.  A client may use a Send indication even if a
+    // channel is bound to that peer.  However, the client MUST ensure that
+    // there is a permission installed for the IP address of the peer to
+    // which the Send indication is being sent; this prevents a third party
+    // from using a TURN server to send data to arbitrary destinations.
+    // 
+    // When forming a Send indication, the client MUST include an XOR-PEER-
+    // ADDRESS attribute and a DATA attribute.  The XOR-PEER-ADDRESS
+    // attribute contains the transport address of the peer to which the
+    // data is to be sent, and the DATA attribute contains the actual
+    // application data to be sent to the peer.
+    //     
+    // The client MAY include a DONT-FRAGMENT attribute in the Send
+    // indication if it wishes the server to set the DF bit on the UDP
+    // datagram sent to the peer.
+
+    auto peerAttr = new stun::XorPeerAddress;
+    peerAttr->setAddress(peerAddress);
+    //peerAttr->setFamily(1);
+    //peerAttr->setPort(peerAddress.port());
+    //peerAttr->setIP(peerAddress.host());
+    request.add(peerAttr);
+
+    auto dataAttr = new stun::Data;
+    dataAttr->copyBytes(data, size);
+    request.add(dataAttr);
+
+    // Ensure permissions exist for the peer.
+    if (!hasPermission(peerAddress.host())) {
+        //delete request;
+        throw std::runtime_error("No permission exists for peer IP: " + peerAddress.host());
+    } 
+
+    // If permission exists and is currently being negotiated with
+    // the server then queue the outgoing request.
+    // Queued requests will be sent when the CreatePermission
+    // callback is received from the server.
+    else if (stateEquals(ClientState::Authorizing)) {    
+        TraceL << "Queueing outgoing request: " 
+            << request.toString() << endl;
+        //Mutex::ScopedLock lock(_mutex);
+        _pendingIndications.push_back(request);    
+        assert(_pendingIndications.size() < 100); // something is wrong...
+    }
+
+    // If a permission exists on server and client send our data!
+    else {
+        _socket->sendPacket(request, _options.serverAddr);
+        //delete request;
+    }
+}
+
+
+void Client::handleDataIndication(const stun::Message& response) 
+{
+    // When the client receives a Data indication, it checks that the Data
+    // indication contains both an XOR-PEER-ADDRESS and a DATA attribute,
+    // and discards the indication if it does not.  The client SHOULD also
+    // check that the XOR-PEER-ADDRESS attribute value contains an IP
+    // address with which the client believes there is an active permission,
+    // and discard the Data indication otherwise.  Note that the DATA
+    // attribute is allowed to contain zero bytes of data.
+    // 
+    //    NOTE: The latter check protects the client against an attacker who
+    //    somehow manages to trick the server into installing permissions
+    //    not desired by the client.
+    // 
+    // If the Data indication passes the above checks, the client delivers
+    // the data octets inside the DATA attribute to the application, along
+    // with an indication that they were received from the peer whose
+    // transport address is given by the XOR-PEER-ADDRESS attribute.
+
+    auto peerAttr = response.get<stun::XorPeerAddress>();
+    if (!peerAttr || (peerAttr && peerAttr->family() != 1)) {
+        assert(0);
+        return;
+    }
+
+    auto dataAttr = response.get<stun::Data>();
+    if (!dataAttr) {
+        assert(0);
+        return;
+    }    
+
+    TraceL << "Handle Data indication: " << response.toString() << endl;
+
+    if (!closed()) {
+        _observer.onRelayDataReceived(*this, dataAttr->bytes(), dataAttr->size(), peerAttr->address());
+    }
+}
+
+
+void Client::onTransactionProgress(void* sender, TransactionState& state, const TransactionState&) 
+{
+    TraceL << "Transaction state change: " << sender << ": " << state << endl;
+
+    auto transaction = reinterpret_cast<stun::Transaction*>(sender);
+    transaction->response().opaque = transaction;    
+    
+    if (!closed())
+        _observer.onTransactionResponse(*this, *transaction);
+
+    switch (state.id()) {    
+    case TransactionState::Running:
+        return;
+
+    case TransactionState::Success: 
+        {    
+            TraceL << "STUN transaction success:" 
+                << "\n\tState: " << state.toString()
+                << "\n\tFrom: " << transaction->peerAddress().toString()
+                << "\n\tRequest: " << transaction->request().toString()
+                << "\n\tResponse: " << transaction->response().toString()
+                << endl;
+            
+            if (removeTransaction(transaction)) {
+                if (!handleResponse(transaction->response())) {
+                    TraceL << "Unhandled STUN response: " << transaction->response().toString() << endl;    
+                }
+            }
+        }
+        break;
+
+    case TransactionState::Failed:
+        WarnL << "STUN transaction error:" 
+                << "\n\tState: " << state.toString()
+                << "\n\tFrom: " << transaction->peerAddress().toString()
+                << "\n\tData: " << transaction->response().toString()
+                << endl;
+
+        // TODO: More flexible response error handling
+        if (removeTransaction(transaction)) {
+            setState(this, ClientState::Failed, state.message());
+        }
+        break;
+    }
+}
+
+
+void Client::onTimer(void*)
+{    
+    //Mutex::ScopedLock lock(_mutex); 
+
+    if (expired())
+        // Attempt to re-allocate
+        sendAllocate();
+
+    else if (timeRemaining() < lifetime() * 0.33)
+        sendRefresh();
+
+    // Refresh channel bindings which are nearing expiry.
+    else if (!_channels.empty() && stateEquals(ClientState::Success)) {
+        UInt64 now = PermissionTable::now();
+        auto bindings = _channels.list();
+        for (auto it = bindings.begin(); it != bindings.end(); ++it) {
+            if (it->expiresAt < now + static_cast<UInt64>(CHANNEL_LIFETIME * 0.33))
+                sendChannelBind(it->peerAddress);
+        }
+    }
+
+    _observer.onTimer(*this);
+}
+
+
+void Client::onStateChange(ClientState& state, const ClientState& oldState) 
+{
+    _observer.onClientStateChange(*this, state, oldState);
+}
+    
+
+int Client::transportProtocol()
+{
+    return 17; // UDP
+}
+
+
+bool Client::closed() const
+{
+    return stateEquals(ClientState::None) || stateEquals(ClientState::Failed);
+}
+
+
+Client::Options& Client::options() 
+{ 
+    //Mutex::ScopedLock lock(_mutex);
+    return _options; 
+}
+
+
+net::Address Client::mappedAddress() const 
+{ 
+    //Mutex::ScopedLock lock(_mutex);
+    return _mappedAddress; 
+}
+
+
+net::Address Client::relayedAddress() const 
+{ 
+    //Mutex::ScopedLock lock(_mutex);
+    return _relayedAddress; 
+}
+
+
+} } //  namespace scy::turn
@@ -0,0 +1,246 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/turn/permission.h"
+#include "scy/logger.h"
+#include "scy/uv/uvpp.h"
+
+#include <cstring>
+
+
+using namespace std;
+
+
+namespace scy {
+namespace turn {
+
+
+//
+// Permission Key
+//
+
+
+PermissionKey::PermissionKey() : 
+    family(0)
+{
+    std::memset(addr, 0, sizeof(addr));
+}
+
+
+PermissionKey::PermissionKey(const net::Address& address) : 
+    family(0)
+{
+    std::memset(addr, 0, sizeof(addr));
+    switch (address.af()) {
+    case AF_INET:
+        family = AF_INET;
+        std::memcpy(addr, &reinterpret_cast<const sockaddr_in*>(address.addr())->sin_addr, 4);
+        break;
+    case AF_INET6:
+        family = AF_INET6;
+        std::memcpy(addr, &reinterpret_cast<const sockaddr_in6*>(address.addr())->sin6_addr, 16);
+        break;
+    }
+}
+
+
+PermissionKey::PermissionKey(const std::string& ip) : 
+    family(0)
+{
+    std::memset(addr, 0, sizeof(addr));
+    if (uv_inet_pton(AF_INET, ip.c_str(), addr) == 0)
+        family = AF_INET;
+    else if (uv_inet_pton(AF_INET6, ip.c_str(), addr) == 0)
+        family = AF_INET6;
+}
+
+
+bool PermissionKey::isLocal() const
+{
+    return family == AF_INET && (addr[0] == 127 || (addr[0] == 192 && addr[1] == 168));
+}
+
+
+std::string PermissionKey::toString() const
+{
+    char buf[64] = { 0 };
+    if (valid())
+        uv_inet_ntop(family, addr, buf, sizeof(buf));
+    return buf;
+}
+
+
+bool PermissionKey::operator ==(const PermissionKey& r) const
+{
+    return family == r.family && std::memcmp(addr, r.addr, length()) == 0;
+}
+
+
+std::size_t PermissionKeyHash::operator()(const PermissionKey& key) const
+{
+    // FNV-1a over the address bytes
+    std::size_t hash = 2166136261u;
+    for (std::size_t i = 0; i < key.length(); i++) {
+        hash ^= key.addr[i];
+        hash *= 16777619u;
+    }
+    return hash ^ key.family;
+}
+
+
+//
+// Permission Table
+//
+
+
+PermissionTable::PermissionTable(UInt64 lifetime, UInt64 resolution) :
+    _wheel(lifetime, resolution),
+    _lifetime(lifetime),
+    _generation(0)
+{
+}
+
+
+bool PermissionTable::add(const std::string& ip)
+{
+    PermissionKey key(ip);
+    if (!key.valid()) {
+        WarnL << "Cannot create permission for invalid IP: " << ip << endl;
+        return false;
+    }
+
+    // If the permission is already installed then refresh it.
+    // The expiry wheel is reconciled lazily on expire().
+    UInt64 expiresAt = now() + _lifetime;
+    auto it = _map.find(key);
+    if (it != _map.end()) {
+        TraceL << "Refreshing permission: " << ip << endl;
+        it->second.expiresAt = expiresAt;
+        return true;
+    }
+
+    // Otherwise create it...
+    TraceL << "Create permission: " << ip << endl;
+    Entry entry = { key, ++_generation };
+    _map.insert(std::make_pair(key, Permission(ip, key, expiresAt, entry.generation)));
+    _wheel.schedule(entry, expiresAt);
+    return true;
+}
+
+
+bool PermissionTable::remove(const std::string& ip)
+{
+    return _map.erase(PermissionKey(ip)) > 0;
+}
+
+
+void PermissionTable::clear()
+{
+    _map.clear();
+    _wheel.clear();
+}
+
+
+bool PermissionTable::has(const PermissionKey& key) const
+{
+    return _map.find(key) != _map.end();
+}
+
+
+bool PermissionTable::has(const net::Address& address) const
+{
+    return has(PermissionKey(address));
+}
+
+
+bool PermissionTable::has(const std::string& ip) const
+{
+    return has(PermissionKey(ip));
+}
+
+
+std::size_t PermissionTable::expire()
+{
+    return expire(now());
+}
+
+
+std::size_t PermissionTable::expire(UInt64 now)
+{
+    std::size_t removed = 0;
+    _wheel.advance(now, [&](const Entry& entry) {
+        auto it = _map.find(entry.key);
+
+        // Drop stale entries for removed or re-created permissions
+        if (it == _map.end() || it->second.generation != entry.generation)
+            return;
+
+        if (it->second.expired(now)) {
+            InfoL << "Removing Expired Permission: " << it->second.ip << endl;
+            _map.erase(it);
+            removed++;
+        }
+
+        // The permission was refreshed since it was scheduled
+        else _wheel.schedule(entry, it->second.expiresAt);
+    });
+    return removed;
+}
+
+
+UInt64 PermissionTable::nextExpiry() const
+{
+    UInt64 next = 0;
+    for (auto it = _map.begin(); it != _map.end(); ++it) {
+        if (!next || it->second.expiresAt < next)
+            next = it->second.expiresAt;
+    }
+    return next;
+}
+
+
+PermissionList PermissionTable::list() const
+{
+    PermissionList permissions;
+    permissions.reserve(_map.size());
+    for (auto it = _map.begin(); it != _map.end(); ++it)
+        permissions.push_back(it->second);
+    return permissions;
+}
+
+
+std::size_t PermissionTable::size() const
+{
+    return _map.size();
+}
+
+
+bool PermissionTable::empty() const
+{
+    return _map.empty();
+}
+
+
+UInt64 PermissionTable::now()
+{
+    return uv_hrtime() / 1000000;
+}
+
+
+} } // namespace scy::turn
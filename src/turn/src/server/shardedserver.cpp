@@ -0,0 +1,168 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "scy/turn/server/shardedserver.h"
+#include "scy/logger.h"
+
+#include <stdexcept>
+
+
+using namespace std;
+
+
+namespace scy {
+namespace turn {
+
+
+class ShardedServer::ShardServer: public Server, public async::Startable
+    /// The Server run by each shard. The shard index is
+    /// used to record allocation counts in the shard stats.
+{
+public:
+    ShardServer(ShardedServer& observer, int index, uv::Loop* loop) :
+        Server(observer, observer.options(), loop),
+        index(index)
+    {
+    }
+
+    virtual void start() 
+    { 
+        Server::start(); 
+    }
+
+    virtual void stop() 
+    { 
+        Server::stop(); 
+    }
+
+    const int index;
+};
+
+
+ShardedServer::ShardedServer(ServerObserver& observer, const ServerOptions& options, int numThreads) :
+    _observer(observer),
+    _options(options),
+    _runner(numThreads),
+    _stats(_runner.numThreads())
+{
+    // Each shard binds its own listen socket to the shared address.
+    _options.reusePort = true;
+}
+
+
+ShardedServer::~ShardedServer() 
+{
+    stop();
+}
+
+
+void ShardedServer::start()
+{
+    assert(!_runner.running());
+
+    // ConnectionBind requests can't be routed to the shard which owns
+    // the peer connection, so TCP allocations are not supported.
+    if (_options.enableTCP) {
+        WarnL << "TCP relaying is not supported by sharded servers" << endl;
+        _options.enableTCP = false;
+    }
+
+    for (auto& stats : _stats)
+        stats.allocations = 0;
+
+    try {
+        _runner.start([this](int index, uv::Loop* loop) {
+            return new ShardServer(*this, index, loop);
+        });
+    }
+    catch (std::exception& exc) {
+        throw std::runtime_error(std::string("Cannot start TURN server shard: ") + exc.what());
+    }
+    
+    InfoL << "Started " << numThreads() << " shards on " << _options.listenAddr << endl;
+}
+
+
+void ShardedServer::stop()
+{
+    _runner.stop();
+}
+
+
+int ShardedServer::numThreads() const
+{
+    return _runner.numThreads();
+}
+
+
+std::size_t ShardedServer::numAllocations() const
+{
+    std::size_t count = 0;
+    for (auto& stats : _stats)
+        count += stats.allocations.load(std::memory_order_relaxed);
+    return count;
+}
+
+
+std::size_t ShardedServer::numAllocations(int index) const
+{
+    assert(index >= 0 && index < static_cast<int>(_stats.size()));
+    return _stats[index].allocations.load(std::memory_order_relaxed);
+}
+
+
+ServerObserver& ShardedServer::observer()
+{
+    return _observer;
+}
+
+
+ServerOptions& ShardedServer::options()
+{
+    return _options;
+}
+
+
+AuthenticationState ShardedServer::authenticateRequest(Server* server, Request& request)
+{
+    return _observer.authenticateRequest(server, request);
+}
+
+
+void ShardedServer::onServerAllocationCreated(Server* server, IAllocation* alloc)
+{
+    auto index = static_cast<ShardServer*>(server)->index;
+    _stats[index].allocations.fetch_add(1, std::memory_order_relaxed);
+
+    Mutex::ScopedLock lock(_mutex);
+    _observer.onServerAllocationCreated(server, alloc);
+}
+
+
+void ShardedServer::onServerAllocationRemoved(Server* server, IAllocation* alloc)
+{
+    auto index = static_cast<ShardServer*>(server)->index;
+    _stats[index].allocations.fetch_sub(1, std::memory_order_relaxed);
+
+    Mutex::ScopedLock lock(_mutex);
+    _observer.onServerAllocationRemoved(server, alloc);
+}
+
+
+} } // namespace scy::turn
@@ -0,0 +1,581 @@
+#include "scy/base.h"
+#include "scy/application.h"
+#include "scy/logger.h"
+#include "scy/util.h"
+#include "scy/turn/server/server.h"
+#include "scy/turn/server/udpallocation.h"
+#include "scy/turn/server/shardedserver.h"
+#include "scy/turn/channel.h"
+#include "scy/turn/permission.h"
+#include "scy/turn/timerwheel.h"
+#include "scy/net/tcpsocket.h"
+#include "scy/net/udpsocket.h"
+
+#include <assert.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+
+
+using namespace std;
+using namespace scy;
+
+
+#define TEST_TURN_PORT 34780
+
+
+namespace scy {
+namespace turn {
+
+
+class Tests: public ServerObserver
+{
+public:
+    Application app;
+    int allocationsCreated;
+    int allocationsRemoved;
+    std::vector<std::string> clientRecv;
+    std::vector<std::string> peerRecv;
+    bool connected;
+
+    Tests() :
+        allocationsCreated(0),
+        allocationsRemoved(0),
+        connected(false)
+    {
+        testTimerWheel();
+        testAllocationTimer();
+        testPermissionTable();
+        testChannelTable();
+        testChannelBind();
+        testChannelDataPadding();
+        testShardedServer();
+        app.run();
+        app.finalize();
+    }
+
+
+    // ============================================================================
+    // Timer Wheel Test
+    //
+    void testTimerWheel()
+    {
+        TimerWheel<int> wheel(1000, 10);
+        std::vector<int> expired;
+        auto collect = [&](const int& entry) { expired.push_back(entry); };
+
+        wheel.schedule(1, 105);
+        wheel.schedule(2, 250);
+        wheel.schedule(3, 999);
+        assert(wheel.size() == 3);
+
+        // Only slots which have fully elapsed are returned
+        wheel.advance(100, collect);
+        assert(expired.empty());
+        wheel.advance(110, collect);
+        assert(expired.size() == 1 && expired[0] == 1);
+
+        // Elapsed deadlines go into the next pending slot
+        wheel.schedule(4, 50);
+        wheel.advance(120, collect);
+        assert(expired.size() == 2 && expired[1] == 4);
+
+        wheel.advance(1010, collect);
+        assert(expired.size() == 4 && expired[2] == 2 && expired[3] == 3);
+        assert(wheel.size() == 0);
+    }
+
+
+    // ============================================================================
+    // Allocation Timer Test
+    //
+    void testAllocationTimer()
+    {
+        ServerOptions opts;
+        opts.listenAddr = net::Address("127.0.0.1", 0);
+        opts.timerInterval = 10;
+        Server server(*this, opts);
+
+        // A fresh allocation is not visited until it is due
+        new UDPAllocation(server, FiveTuple(net::Address("127.0.0.1", 40000),
+            net::Address("127.0.0.1", 3478), net::UDP), "user", 600);
+        auto alloc = new UDPAllocation(server, FiveTuple(net::Address("127.0.0.1", 40001),
+            net::Address("127.0.0.1", 3478), net::UDP), "user", 600);
+        assert(server.allocations().size() == 2);
+        advanceTimer(server);
+        assert(server.allocations().size() == 2);
+        assert(allocationsRemoved == 0);
+
+        // Expiring the allocation early is only noticed
+        // once the timer is rescheduled
+        alloc->setLifetime(0);
+        advanceTimer(server);
+        assert(server.allocations().size() == 2);
+        alloc->updateTimer();
+        advanceTimer(server);
+        assert(server.allocations().size() == 1);
+        assert(allocationsRemoved == 1);
+
+        server.stop();
+        assert(allocationsRemoved == 2);
+    }
+
+    void advanceTimer(Server& server)
+    {
+        scy::sleep(server.options().timerInterval * 3);
+        server.onTimer(nullptr);
+    }
+
+
+    // ============================================================================
+    // Permission Table Test
+    //
+    void testPermissionTable()
+    {
+        // Keys are binary addresses, so the port is ignored and
+        // the string and address forms compare equal
+        assert(PermissionKey(net::Address("192.168.1.2", 5000)) == PermissionKey("192.168.1.2"));
+        assert(!(PermissionKey("192.168.1.2") == PermissionKey("192.168.1.3")));
+        assert(PermissionKey("192.168.1.2").isLocal() && !PermissionKey("10.0.0.1").isLocal());
+        assert(PermissionKey("::1").valid() && PermissionKey("::1").toString() == "::1");
+        assert(!PermissionKey("peer").valid());
+
+        PermissionTable permissions(100, 10);
+        bool added = permissions.add("peer");
+        assert(!added);
+        added = permissions.add("127.0.0.1");
+        assert(added);
+        added = permissions.add("192.168.1.2");
+        assert(added);
+        added = permissions.add("::1");
+        assert(added);
+        assert(permissions.size() == 3);
+        assert(permissions.has(net::Address("127.0.0.1", 1234)));
+        assert(permissions.has(PermissionKey("::1")));
+        assert(permissions.has("192.168.1.2"));
+        assert(!permissions.has(net::Address("127.0.0.2", 1234)));
+        assert(!permissions.has("10.0.0.1"));
+        UInt64 expiresAt = permissions.nextExpiry();
+        assert(expiresAt);
+
+        // Refreshing extends the permission without rescheduling it
+        scy::sleep(30);
+        added = permissions.add("127.0.0.1");
+        assert(added);
+        assert(permissions.size() == 3);
+        UInt64 refreshedAt = 0;
+        PermissionList list = permissions.list();
+        for (auto it = list.begin(); it != list.end(); ++it) {
+            if (it->ip == "127.0.0.1")
+                refreshedAt = it->expiresAt;
+        }
+        assert(refreshedAt >= expiresAt + 30);
+
+        // Permissions are only removed once their wheel slot has
+        // elapsed, and refreshed permissions are scheduled again
+        std::size_t expired = permissions.expire(expiresAt - 20);
+        assert(expired == 0);
+        expired = permissions.expire(expiresAt + 20);
+        assert(expired == 2);
+        assert(permissions.size() == 1 && permissions.has("127.0.0.1"));
+        assert(permissions.nextExpiry() == refreshedAt);
+        expired = permissions.expire(refreshedAt - 20);
+        assert(expired == 0);
+        expired = permissions.expire(refreshedAt + 20);
+        assert(expired == 1);
+        assert(permissions.empty() && !permissions.nextExpiry());
+
+        // The wheel entry of a removed permission does not expire
+        // a permission which was created again in its place
+        PermissionTable recreated(100, 10);
+        added = recreated.add("10.0.0.1");
+        assert(added);
+        expiresAt = recreated.nextExpiry();
+        bool removed = recreated.remove("10.0.0.1");
+        assert(removed);
+        assert(!recreated.has("10.0.0.1"));
+        scy::sleep(30);
+        added = recreated.add("10.0.0.1");
+        assert(added);
+        assert(recreated.nextExpiry() >= expiresAt + 30);
+        expired = recreated.expire(expiresAt + 20);
+        assert(expired == 0);
+        assert(recreated.has("10.0.0.1"));
+        expired = recreated.expire(recreated.nextExpiry() + 20);
+        assert(expired == 1);
+        assert(recreated.empty());
+    }
+
+
+    // ============================================================================
+    // Channel Table Test
+    //
+    void testChannelTable()
+    {
+        net::Address peer1("127.0.0.1", 5001);
+        net::Address peer2("127.0.0.1", 5002);
+        ChannelTable channels(20, 50);
+
+        // Channel numbers must lie in 0x4000 through 0x7FFE
+        bool bound = channels.bind(0x3FFF, peer1);
+        assert(!bound);
+        bound = channels.bind(0x7FFF, peer1);
+        assert(!bound);
+        bound = channels.bind(kMinChannelNumber, peer1);
+        assert(bound);
+        assert(channels.get(peer1)->number == kMinChannelNumber);
+        assert(channels.nextNumber() == kMinChannelNumber + 1);
+
+        // A bound channel or peer cannot be rebound elsewhere
+        bound = channels.bind(kMinChannelNumber, peer2);
+        assert(!bound);
+        bound = channels.bind(kMinChannelNumber + 1, peer1);
+        assert(!bound);
+        assert(channels.canBind(kMinChannelNumber + 1, peer2));
+
+        // Binding the same pair again refreshes the binding
+        UInt64 expiresAt = channels.get(kMinChannelNumber)->expiresAt;
+        scy::sleep(5);
+        bound = channels.bind(kMinChannelNumber, peer1);
+        assert(bound);
+        assert(channels.get(kMinChannelNumber)->expiresAt > expiresAt);
+        assert(channels.size() == 1);
+
+        // Once expired neither the channel nor the peer may
+        // be rebound elsewhere until the rebind delay elapses, 
+        // but the pair itself may be bound again
+        expiresAt = channels.get(kMinChannelNumber)->expiresAt;
+        std::size_t expired = channels.expire(expiresAt);
+        assert(expired == 1);
+        assert(channels.empty() && !channels.get(peer1));
+        bound = channels.bind(kMinChannelNumber, peer2);
+        assert(!bound);
+        bound = channels.bind(kMinChannelNumber + 1, peer1);
+        assert(!bound);
+        assert(!channels.canBind(kMinChannelNumber, peer2));
+        bound = channels.bind(kMinChannelNumber, peer1);
+        assert(bound);
+        bool unbound = channels.unbind(kMinChannelNumber);
+        assert(unbound);
+        bound = channels.bind(kMinChannelNumber + 1, peer1);
+        assert(!bound);
+        bound = channels.bind(kMinChannelNumber + 1, peer2);
+        assert(bound);
+        unbound = channels.unbind(kMinChannelNumber + 1);
+        assert(unbound);
+
+        scy::sleep(60);
+        channels.expire();
+        bound = channels.bind(kMinChannelNumber, peer2);
+        assert(bound);
+        bound = channels.bind(kMinChannelNumber + 1, peer1);
+        assert(bound);
+        assert(channels.size() == 2);
+    }
+
+
+    // ============================================================================
+    // Channel Bind Test
+    //
+    void testChannelBind()
+    {
+        ServerOptions opts;
+        opts.listenAddr = net::Address("127.0.0.1", 0);
+        opts.externalIP = "127.0.0.1";
+        opts.enableTCP = false;
+        Server server(*this, opts);
+        server.start();
+        net::Address serverAddr("127.0.0.1", server.udpSocket().address().port());
+
+        net::UDPSocket client;
+        client.bind(net::Address("127.0.0.1", 0));
+        client.Recv += sdelegate(this, &Tests::onClientRecv);
+        net::UDPSocket peer1;
+        peer1.bind(net::Address("127.0.0.1", 0));
+        peer1.Recv += sdelegate(this, &Tests::onPeerRecv);
+        net::UDPSocket peer2;
+        peer2.bind(net::Address("127.0.0.1", 0));
+        
+        auto alloc = new UDPAllocation(server, FiveTuple(client.address(),
+            serverAddr, net::UDP), "user", 600);
+        net::Address relayAddr("127.0.0.1", alloc->relayedAddress().port());
+
+        // Channel numbers outside of 0x4000 through 0x7FFE are rejected
+        int res = sendChannelBind(client, serverAddr, 0x3FFF, peer1.address());
+        assert(res == stun::Message::ErrorResponse);
+        res = sendChannelBind(client, serverAddr, 0x7FFF, peer1.address());
+        assert(res == stun::Message::ErrorResponse);
+
+        // A bound channel cannot be rebound to another peer, 
+        // but rebinding it to the same peer refreshes it
+        res = sendChannelBind(client, serverAddr, 0x4000, peer1.address());
+        assert(res == stun::Message::SuccessResponse);
+        res = sendChannelBind(client, serverAddr, 0x4000, peer2.address());
+        assert(res == stun::Message::ErrorResponse);
+        res = sendChannelBind(client, serverAddr, 0x4001, peer1.address());
+        assert(res == stun::Message::ErrorResponse);
+        res = sendChannelBind(client, serverAddr, 0x4000, peer1.address());
+        assert(res == stun::Message::SuccessResponse);
+
+        // ChannelData from the client is relayed to the bound peer
+        char frame[kChannelDataHeaderSize + 5];
+        writeChannelDataHeader(frame, 0x4000, 5);
+        std::memcpy(frame + kChannelDataHeaderSize, "hello", 5);
+        client.send(frame, sizeof(frame), serverAddr);
+        bool received = runUntil([&]() { return !peerRecv.empty(); });
+        assert(received);
+        assert(peerRecv[0] == "hello");
+
+        // ChannelData on an unbound channel is discarded
+        writeChannelDataHeader(frame, 0x4001, 5);
+        client.send(frame, sizeof(frame), serverAddr);
+
+        // Data from the peer is relayed to the client as ChannelData
+        clientRecv.clear();
+        peer1.send("world", 5, relayAddr);
+        received = runUntil([&]() { return !clientRecv.empty(); });
+        assert(received);
+        assert(clientRecv[0].size() == kChannelDataHeaderSize + 5);
+        assert(isChannelData(clientRecv[0].data(), clientRecv[0].size()));
+        assert(readChannelNumber(clientRecv[0].data()) == 0x4000);
+        assert(readChannelDataLength(clientRecv[0].data()) == 5);
+        assert(clientRecv[0].substr(kChannelDataHeaderSize) == "world");
+        assert(peerRecv.size() == 1);
+
+        client.Recv -= sdelegate(this, &Tests::onClientRecv);
+        peer1.Recv -= sdelegate(this, &Tests::onPeerRecv);
+        client.close();
+        peer1.close();
+        peer2.close();
+        server.stop();
+        clientRecv.clear();
+        peerRecv.clear();
+    }
+
+
+    // ============================================================================
+    // ChannelData Padding Test
+    //
+    void testChannelDataPadding()
+    {
+        ServerOptions opts;
+        opts.listenAddr = net::Address("127.0.0.1", 0);
+        opts.externalIP = "127.0.0.1";
+        opts.enableUDP = false;
+        Server server(*this, opts);
+        server.start();
+        net::Address serverAddr("127.0.0.1", server.tcpSocket().address().port());
+
+        net::TCPSocket client;
+        client.Connect += sdelegate(this, &Tests::onClientConnect);
+        client.Recv += sdelegate(this, &Tests::onClientRecv);
+        client.connect(serverAddr);
+        bool done = runUntil([&]() { return connected; });
+        assert(done);
+        net::UDPSocket peer;
+        peer.bind(net::Address("127.0.0.1", 0));
+        peer.Recv += sdelegate(this, &Tests::onPeerRecv);
+
+        new UDPAllocation(server, FiveTuple(client.address(),
+            serverAddr, net::TCP), "user", 600);
+        int res = sendChannelBind(client, serverAddr, 0x4000, peer.address());
+        assert(res == stun::Message::SuccessResponse);
+
+        // Over TCP each ChannelData message is padded to a multiple 
+        // of 4 bytes, so the second message starts at offset 12
+        const char* payloads[] = { "hello", "abc", "four" };
+        Buffer stream;
+        for (auto payload : payloads) {
+            std::size_t size = std::strlen(payload);
+            std::size_t offset = stream.size();
+            stream.resize(offset + ((kChannelDataHeaderSize + size + 3) & ~std::size_t(3)), 0);
+            writeChannelDataHeader(&stream[offset], 0x4000, static_cast<UInt16>(size));
+            std::memcpy(&stream[offset + kChannelDataHeaderSize], payload, size);
+        }
+        assert(stream.size() == 12 + 8 + 8);
+        client.send(stream.data(), stream.size());
+        done = runUntil([&]() { return peerRecv.size() == 3; });
+        assert(done);
+        assert(peerRecv[0] == "hello");
+        assert(peerRecv[1] == "abc");
+        assert(peerRecv[2] == "four");
+
+        client.Connect -= sdelegate(this, &Tests::onClientConnect);
+        client.Recv -= sdelegate(this, &Tests::onClientRecv);
+        peer.Recv -= sdelegate(this, &Tests::onPeerRecv);
+        client.close();
+        peer.close();
+        server.stop();
+        clientRecv.clear();
+        peerRecv.clear();
+        connected = false;
+    }
+
+    // ============================================================================
+    // Sharded Server Test
+    //
+    void testShardedServer()
+    {
+        const int numShards = 4;
+        const int numClients = 16;
+        ServerOptions opts;
+        opts.listenAddr = net::Address("127.0.0.1", TEST_TURN_PORT);
+        opts.externalIP = "127.0.0.1";
+        ShardedServer server(*this, opts, numShards);
+        server.start();
+        assert(server.numThreads() == numShards);
+        assert(!server.options().enableTCP);
+        assert(server.numAllocations() == 0);
+        allocationsCreated = 0;
+        allocationsRemoved = 0;
+
+        std::vector<net::UDPSocket*> clients;
+        for (int i = 0; i < numClients; i++) {
+            auto client = new net::UDPSocket;
+            client->bind(net::Address("127.0.0.1", 0));
+            client->Recv += sdelegate(this, &Tests::onClientRecv);
+            clients.push_back(client);
+
+            stun::Message request(stun::Message::Request, stun::Message::Allocate);
+            auto usernameAttr = new stun::Username;
+            usernameAttr->copyBytes("user", 4);
+            request.add(usernameAttr);
+            auto transportAttr = new stun::RequestedTransport;
+            transportAttr->setValue(17 << 24);
+            request.add(transportAttr);
+            stun::Message response;
+            int res = sendRequest(*client, opts.listenAddr, request, &response);
+            assert(res == stun::Message::SuccessResponse);
+            auto relayAttr = response.get<stun::XorRelayedAddress>();
+            assert(relayAttr && relayAttr->address().port() != TEST_TURN_PORT);
+        }
+
+        // The kernel spreads the clients over the shards, and 
+        // each allocation is counted by the shard that owns it
+        std::size_t total = 0;
+        int activeShards = 0;
+        for (int i = 0; i < numShards; i++) {
+            total += server.numAllocations(i);
+            if (server.numAllocations(i))
+                activeShards++;
+        }
+        assert(total == numClients);
+        assert(server.numAllocations() == numClients);
+        assert(activeShards > 1);
+
+        // Later requests on each 5-tuple reach the shard which owns
+        // the allocation rather than failing with a mismatch
+        for (auto client : clients) {
+            stun::Message request(stun::Message::Request, stun::Message::Refresh);
+            auto lifetimeAttr = new stun::Lifetime;
+            lifetimeAttr->setValue(600);
+            request.add(lifetimeAttr);
+            int res = sendRequest(*client, opts.listenAddr, request);
+            assert(res == stun::Message::SuccessResponse);
+        }
+        assert(server.numAllocations() == numClients);
+
+        // Stopping joins the shard threads once their 
+        // allocations have been removed
+        server.stop();
+        assert(allocationsCreated == numClients);
+        assert(allocationsRemoved == numClients);
+        assert(server.numAllocations() == 0);
+        server.stop();
+
+        for (auto client : clients) {
+            client->Recv -= sdelegate(this, &Tests::onClientRecv);
+            client->close();
+            delete client;
+        }
+        clientRecv.clear();
+    }
+
+    int sendChannelBind(net::Socket& socket, const net::Address& serverAddr, 
+        UInt16 number, const net::Address& peerAddress)
+    {
+        stun::Message request(stun::Message::Request, stun::Message::ChannelBind);
+        auto channelAttr = new stun::ChannelNumber;
+        channelAttr->setValue(UInt32(number) << 16);
+        request.add(channelAttr);
+        auto peerAttr = new stun::XorPeerAddress;
+        peerAttr->setAddress(peerAddress);
+        request.add(peerAttr);
+        return sendRequest(socket, serverAddr, request);
+    }
+
+    int sendRequest(net::Socket& socket, const net::Address& serverAddr, 
+        const stun::Message& request, stun::Message* response = nullptr)
+    {
+        // Returns the class of the server's response, or 0
+        // if no response is received.
+        clientRecv.clear();
+        socket.sendPacket(request, serverAddr);
+        if (!runUntil([&]() { return !clientRecv.empty(); }))
+            return 0;
+
+        stun::Message message;
+        if (!message.read(constBuffer(clientRecv[0].data(), clientRecv[0].size())) ||
+            message.transactionID() != request.transactionID() ||
+            message.methodType() != request.methodType())
+            return 0;
+        if (response)
+            *response = message;
+        return message.classType();
+    }
+
+    bool runUntil(std::function<bool()> done, int timeout = 1000)
+    {
+        // Runs the event loop until the condition is met.
+        for (int i = 0; i < timeout && !done(); i++) {
+            uv_run(app.loop, UV_RUN_NOWAIT);
+            scy::sleep(1);
+        }
+        return done();
+    }
+
+    void onClientConnect(void*)
+    {
+        connected = true;
+    }
+
+    void onClientRecv(void*, const MutableBuffer& buffer, const net::Address&)
+    {
+        clientRecv.push_back(std::string(bufferCast<const char*>(buffer), buffer.size()));
+    }
+
+    void onPeerRecv(void*, const MutableBuffer& buffer, const net::Address&)
+    {
+        peerRecv.push_back(std::string(bufferCast<const char*>(buffer), buffer.size()));
+    }
+
+    void onServerAllocationCreated(Server* server, IAllocation* alloc)
+    {
+        allocationsCreated++;
+    }
+
+    void onServerAllocationRemoved(Server* server, IAllocation* alloc)
+    {
+        allocationsRemoved++;
+    }
+
+    AuthenticationState authenticateRequest(Server* server, Request& request)
+    {
+        return Authorized;
+    }
+};
+
+
+} } // namespace scy::turn
+
+
+int main(int argc, char** argv)
+{
+    Logger::instance().add(new ConsoleChannel("Test", LTrace));
+    {
+        turn::Tests app;
+    }
+    Logger::destroy();
+    return 0;
+}
@@ -0,0 +1,72 @@
+//
+// LibSourcey
+// Copyright (C) 2005, Sourcey <http://sourcey.com>
+//
+// LibSourcey is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// LibSourcey is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#ifndef SCY_HTTP_Base64PacketEncoder_H
+#define SCY_HTTP_Base64PacketEncoder_H
+
+
+#include "scy/packetstream.h"
+#include "scy/signal.h"
+#include "scy/base64.h"
+#include <sstream>
+
+
+namespace scy { 
+
+
+class Base64PacketEncoder: public PacketProcessor
+    /// Base64 encodes each packet. The output buffer is owned by
+    /// the encoder and reused for every packet, so once it has grown
+    /// to the size of the largest packet encoding does not allocate.
+    /// Downstream processors which retain the emitted packet must 
+    /// copy it.
+{
+public:
+    Base64PacketEncoder() :
+        PacketProcessor(this->emitter)
+    {
+    }
+
+    virtual void process(IPacket& packet)
+    {        
+        RawPacket& p = dynamic_cast<RawPacket&>(packet); // cast or throw
+
+        // Encoded size plus line feeds, with room to spare
+        std::size_t required = p.size() * 2 + 4;
+        if (_buffer.size() < required)
+            _buffer.resize(required);
+
+        base64::Encoder enc;
+        std::size_t size = enc.encode((const char*)p.data(), p.size(), &_buffer[0]);        
+        size += enc.finalize(&_buffer[size]);
+
+        emit(&_buffer[0], size);
+    }
+
+    PacketSignal emitter;
+
+protected:
+    Buffer _buffer;
+};
+
+
+} // namespace scy
+
+
+#endif
\ No newline at end of file